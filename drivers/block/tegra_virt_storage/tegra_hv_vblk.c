@@ -46,10 +46,92 @@
 #include <linux/dma-mapping.h>
 #include <asm/cacheflush.h>
 #include <linux/version.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/kthread.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
 #include "tegra_vblk.h"
 
 static int vblk_major;
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+static unsigned int vblk_hw_queues;
+module_param_named(hw_queues, vblk_hw_queues, uint, 0444);
+MODULE_PARM_DESC(hw_queues,
+	"Number of blk-mq hardware queues per device (0 = one per online CPU)");
+#endif
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+static unsigned int vblk_poll_queues;
+module_param_named(poll_queues, vblk_poll_queues, uint, 0444);
+MODULE_PARM_DESC(poll_queues,
+	"Number of blk-mq poll queues per device for polled I/O");
+#endif
+
+static bool vblk_zero_copy = true;
+module_param_named(zero_copy, vblk_zero_copy, bool, 0444);
+MODULE_PARM_DESC(zero_copy,
+	"Use scatter list zero-copy I/O when the server supports it");
+
+/**
+ * vblk_hold_queue: Account a new inflight request unless the queue is
+ *		being suspended.
+ */
+static bool vblk_hold_queue(struct vblk_dev *vblkdev)
+{
+	atomic_inc(&vblkdev->inflight_reqs);
+	/* Pairs with the barrier in tegra_hv_vblk_suspend() */
+	smp_mb__after_atomic();
+
+	if (READ_ONCE(vblkdev->queue_state) == VBLK_QUEUE_ACTIVE)
+		return true;
+
+	if (atomic_dec_and_test(&vblkdev->inflight_reqs))
+		complete(&vblkdev->req_queue_empty);
+
+	return false;
+}
+
+static void vblk_release_queue(struct vblk_dev *vblkdev)
+{
+	if (atomic_dec_and_test(&vblkdev->inflight_reqs) &&
+		(READ_ONCE(vblkdev->queue_state) == VBLK_QUEUE_SUSPENDED)) {
+		complete(&vblkdev->req_queue_empty);
+	}
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+/**
+ * vblk_get_req_by_tag: Claim the vsc request slot owned by a blk-mq tag.
+ *
+ * Slots are partitioned between hardware queues and blk-mq never hands
+ * out the same tag twice within a queue, so no lock is needed here.
+ */
+static struct vsc_request *vblk_get_req_by_tag(struct vblk_dev *vblkdev,
+		struct vblk_hw_queue *hwq, struct request *rq)
+{
+	struct vsc_request *req;
+	uint32_t slot;
+
+	if (rq->tag < 0 || (uint32_t)rq->tag >= vblkdev->hw_queue_depth) {
+		dev_err(vblkdev->device, "Invalid tag %d on hw queue %u!\n",
+			rq->tag, hwq->index);
+		return NULL;
+	}
+
+	slot = hwq->slot_base + (uint32_t)rq->tag;
+	req = &vblkdev->reqs[slot];
+	if (test_and_set_bit_lock(slot, vblkdev->pending_reqs)) {
+		dev_err(vblkdev->device,
+			"Request index %d is already active!\n", slot);
+		return NULL;
+	}
+	req->vs_req.req_id = slot;
+
+	return req;
+}
+#else
 /**
  * vblk_get_req: Get a handle to free vsc request.
  */
@@ -58,23 +140,24 @@ static struct vsc_request *vblk_get_req(struct vblk_dev *vblkdev)
 	struct vsc_request *req = NULL;
 	unsigned long bit;
 
-	mutex_lock(&vblkdev->req_lock);
+	if (!vblk_hold_queue(vblkdev))
+		return NULL;
 
-	if (vblkdev->queue_state != VBLK_QUEUE_ACTIVE)
-		goto exit;
+	do {
+		bit = find_first_zero_bit(vblkdev->pending_reqs,
+				vblkdev->max_requests);
+		if (bit >= vblkdev->max_requests) {
+			vblk_release_queue(vblkdev);
+			return NULL;
+		}
+	} while (test_and_set_bit_lock(bit, vblkdev->pending_reqs));
 
-	bit = find_first_zero_bit(vblkdev->pending_reqs, vblkdev->max_requests);
-	if (bit < vblkdev->max_requests) {
-		req = &vblkdev->reqs[bit];
-		req->vs_req.req_id = bit;
-		set_bit(bit, vblkdev->pending_reqs);
-		vblkdev->inflight_reqs++;
-	}
+	req = &vblkdev->reqs[bit];
+	req->vs_req.req_id = bit;
 
-exit:
-	mutex_unlock(&vblkdev->req_lock);
 	return req;
 }
+#endif
 
 static struct vsc_request *vblk_get_req_by_sr_num(struct vblk_dev *vblkdev,
 		uint32_t num)
@@ -84,7 +167,6 @@ static struct vsc_request *vblk_get_req_by_sr_num(struct vblk_dev *vblkdev,
 	if (num >= vblkdev->max_requests)
 		return NULL;
 
-	mutex_lock(&vblkdev->req_lock);
 	req = &vblkdev->reqs[num];
 	if (test_bit(req->id, vblkdev->pending_reqs) == 0) {
 		dev_err(vblkdev->device,
@@ -92,7 +174,6 @@ static struct vsc_request *vblk_get_req_by_sr_num(struct vblk_dev *vblkdev,
 			req->id);
 		req = NULL;
 	}
-	mutex_unlock(&vblkdev->req_lock);
 
 	/* Assuming serial number is same as index into request array */
 	return req;
@@ -118,32 +199,39 @@ static void vblk_put_req(struct vsc_request *req)
 		return;
 	}
 
-	mutex_lock(&vblkdev->req_lock);
 	if (req != &vblkdev->reqs[req->id]) {
 		dev_err(vblkdev->device,
 			"Request Index %d does not match with the request!\n",
 				req->id);
-		goto exit;
+		return;
 	}
 
 	if (test_bit(req->id, vblkdev->pending_reqs) == 0) {
 		dev_err(vblkdev->device,
 			"Request index %d is not active!\n",
 			req->id);
-	} else {
-		clear_bit(req->id, vblkdev->pending_reqs);
-		memset(&req->vs_req, 0, sizeof(struct vs_request));
-		req->req = NULL;
-		memset(&req->iter, 0, sizeof(struct req_iterator));
-		vblkdev->inflight_reqs--;
-
-		if ((vblkdev->inflight_reqs == 0) &&
-			(vblkdev->queue_state == VBLK_QUEUE_SUSPENDED)) {
-			complete(&vblkdev->req_queue_empty);
-		}
+		return;
 	}
-exit:
-	mutex_unlock(&vblkdev->req_lock);
+
+	memset(&req->vs_req, 0, sizeof(struct vs_request));
+	req->req = NULL;
+	req->ioctl_req = NULL;
+	memset(&req->iter, 0, sizeof(struct req_iterator));
+	clear_bit_unlock(req->id, vblkdev->pending_reqs);
+
+	vblk_release_queue(vblkdev);
+}
+
+static void vblk_lat_record(struct vblk_dev *vblkdev,
+		enum vblk_lat_stage stage, u64 start_ns, u64 end_ns)
+{
+	u64 ns = (end_ns > start_ns) ? (end_ns - start_ns) : 0;
+	uint32_t idx = 0;
+
+	if (ns != 0)
+		idx = min_t(uint32_t, ilog2(ns), VBLK_LAT_BUCKETS - 1);
+
+	atomic64_inc(&vblkdev->lat.buckets[stage][idx]);
 }
 
 static int vblk_send_config_cmd(struct vblk_dev *vblkdev)
@@ -237,9 +325,177 @@ static void req_error_handler(struct vblk_dev *vblkdev, struct request *breq)
 #endif
 }
 
+static void vblk_end_request(struct vblk_dev *vblkdev, struct request *breq,
+		unsigned int bytes)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+	blk_mq_end_request(breq, BLK_STS_OK);
+#else
+	if (blk_end_request(breq, 0, bytes)) {
+		dev_err(vblkdev->device, "Error completing request!\n");
+	}
+#endif
+}
 
+static void vblk_unmap_req(struct vblk_dev *vblkdev,
+		struct vsc_request *vsc_req)
+{
+	struct scatterlist *sg;
+	int i;
 
-static void handle_non_ioctl_resp(struct vblk_dev *vblkdev,
+	if (vsc_req->sg_num_ents == 0)
+		return;
+
+	if (vsc_req->xfer_mode == VBLK_XFER_IOVA) {
+		dma_unmap_sg(vblkdev->device, vsc_req->sg_lst,
+			vsc_req->sg_num_ents, DMA_BIDIRECTIONAL);
+	} else {
+		/* Bounced segments carry a zero DMA length */
+		for_each_sg(vsc_req->sg_lst, sg, vsc_req->sg_num_ents, i) {
+			if (sg_dma_len(sg) != 0)
+				dma_unmap_page(vblkdev->device,
+					sg_dma_address(sg), sg_dma_len(sg),
+					vsc_req->sg_dir);
+		}
+	}
+	vsc_req->sg_num_ents = 0;
+}
+
+static inline bool vblk_sg_zero_copy(struct vblk_dev *vblkdev,
+		struct scatterlist *sg)
+{
+	uint32_t align = vblkdev->config.blk_config.hardblk_size;
+
+	/* Sub-block segments would have the server DMA partial blocks and,
+	 * for reads, share cache lines with unrelated data.
+	 */
+	return IS_ALIGNED(sg->offset, align) && IS_ALIGNED(sg->length, align);
+}
+
+static inline uint32_t vblk_sgl_table_len(uint32_t nents)
+{
+	return ALIGN(nents * sizeof(struct vs_blk_sg_entry), L1_CACHE_BYTES);
+}
+
+/**
+ * vblk_prep_sgl: Describe a read/write request to the server with a
+ *		scatter list.
+ *
+ * Block aligned segments are mapped so that the server transfers them
+ * directly to/from the bio pages. The remaining segments are bounced
+ * through the request's mempool chunk, right after the scatter list.
+ * Returns false if the request has to be bounced as a whole.
+ */
+static bool vblk_prep_sgl(struct vblk_dev *vblkdev,
+		struct vsc_request *vsc_req,
+		struct request *bio_req)
+{
+	struct vs_blk_sg_entry *ent = vsc_req->mempool_virt;
+	struct scatterlist *sg;
+	uint64_t bounce_bytes = 0;
+	uint32_t bounce_off;
+	uint32_t sg_cnt;
+	dma_addr_t addr;
+	int i;
+
+	vsc_req->sg_dir = (req_op(bio_req) == REQ_OP_READ) ?
+		DMA_FROM_DEVICE : DMA_TO_DEVICE;
+
+	sg_init_table(vsc_req->sg_lst, queue_max_segments(vblkdev->queue));
+	sg_cnt = blk_rq_map_sg(vblkdev->queue, bio_req, vsc_req->sg_lst);
+	if (sg_cnt == 0)
+		return false;
+
+	for_each_sg(vsc_req->sg_lst, sg, sg_cnt, i) {
+		if (!vblk_sg_zero_copy(vblkdev, sg))
+			bounce_bytes += sg->length;
+	}
+
+	bounce_off = vblk_sgl_table_len(sg_cnt);
+	if ((bounce_bytes == blk_rq_bytes(bio_req)) ||
+		((bounce_off + bounce_bytes) > vsc_req->mempool_len))
+		return false;
+
+	for_each_sg(vsc_req->sg_lst, sg, sg_cnt, i) {
+		if (vblk_sg_zero_copy(vblkdev, sg)) {
+			addr = dma_map_page(vblkdev->device, sg_page(sg),
+					sg->offset, sg->length,
+					vsc_req->sg_dir);
+			if (dma_mapping_error(vblkdev->device, addr)) {
+				dev_err(vblkdev->device,
+					"dma_map_page failed\n");
+				vsc_req->sg_num_ents = i;
+				vblk_unmap_req(vblkdev, vsc_req);
+				return false;
+			}
+			sg_dma_address(sg) = addr;
+			sg_dma_len(sg) = sg->length;
+			ent[i].addr = addr;
+			ent[i].flags = 0;
+		} else {
+			sg_dma_len(sg) = 0;
+			if (vsc_req->sg_dir == DMA_TO_DEVICE)
+				memcpy(vsc_req->mempool_virt + bounce_off,
+					sg_virt(sg), sg->length);
+			ent[i].addr = vsc_req->mempool_offset + bounce_off;
+			ent[i].flags = VS_BLK_SG_F_MEMPOOL;
+			bounce_off += sg->length;
+		}
+		ent[i].len = sg->length;
+	}
+
+	vsc_req->sg_num_ents = sg_cnt;
+	vsc_req->vs_req.blkdev_req.blk_req.num_sg_ents = sg_cnt;
+
+	return true;
+}
+
+/* Copy the bounced segments of a completed scatter list read */
+static void vblk_sgl_copy_in(struct vsc_request *vsc_req)
+{
+	struct scatterlist *sg;
+	uint32_t bounce_off = vblk_sgl_table_len(vsc_req->sg_num_ents);
+	int i;
+
+	for_each_sg(vsc_req->sg_lst, sg, vsc_req->sg_num_ents, i) {
+		if (sg_dma_len(sg) != 0)
+			continue;
+		memcpy(sg_virt(sg), vsc_req->mempool_virt + bounce_off,
+			sg->length);
+		bounce_off += sg->length;
+	}
+}
+
+static void vblk_account_xfer(struct vblk_dev *vblkdev,
+		struct vsc_request *vsc_req,
+		struct request *bio_req)
+{
+	struct scatterlist *sg;
+	uint64_t zero_copy = 0;
+	int i;
+
+	switch (vsc_req->xfer_mode) {
+	case VBLK_XFER_IOVA:
+		zero_copy = blk_rq_bytes(bio_req);
+		break;
+	case VBLK_XFER_SGL:
+		for_each_sg(vsc_req->sg_lst, sg, vsc_req->sg_num_ents, i)
+			zero_copy += sg_dma_len(sg);
+		break;
+	default:
+		break;
+	}
+
+	atomic64_add(zero_copy, &vblkdev->zero_copy_bytes);
+	atomic64_add(blk_rq_bytes(bio_req) - zero_copy,
+		&vblkdev->copy_bytes);
+}
+
+/**
+ * handle_non_ioctl_resp: Finish the data transfer of a completed block
+ *		request. Returns false if the request has to be failed.
+ */
+static bool handle_non_ioctl_resp(struct vblk_dev *vblkdev,
 		struct vsc_request *vsc_req,
 		struct vs_blk_response *blk_resp)
 {
@@ -247,25 +503,29 @@ static void handle_non_ioctl_resp(struct vblk_dev *vblkdev,
 	void *buffer;
 	size_t size;
 	size_t total_size = 0;
-	bool invoke_req_err_hand = false;
+	bool req_ok = true;
 	struct request *const bio_req = vsc_req->req;
 	struct vs_blk_request *const blk_req =
 		&(vsc_req->vs_req.blkdev_req.blk_req);
 
 	if (blk_resp->status != 0) {
-		invoke_req_err_hand = true;
+		req_ok = false;
 		goto end;
 	}
 
 	if (req_op(bio_req) != REQ_OP_FLUSH) {
 		if (blk_req->num_blks !=
 		    blk_resp->num_blks) {
-			invoke_req_err_hand = true;
+			req_ok = false;
 			goto end;
 		}
 	}
 
-	if (req_op(bio_req) == REQ_OP_READ) {
+	if ((req_op(bio_req) == REQ_OP_READ) &&
+		(vsc_req->xfer_mode == VBLK_XFER_SGL)) {
+		vblk_sgl_copy_in(vsc_req);
+	} else if ((req_op(bio_req) == REQ_OP_READ) &&
+		(vsc_req->xfer_mode == VBLK_XFER_BOUNCE)) {
 		rq_for_each_segment(bvec, bio_req, vsc_req->iter) {
 			size = bvec.bv_len;
 			buffer = page_address(bvec.bv_page) +
@@ -280,12 +540,10 @@ static void handle_non_ioctl_resp(struct vblk_dev *vblkdev,
 					total_size;
 			}
 
-			if (!vblkdev->config.blk_config.use_vm_address) {
-				memcpy(buffer,
-					vsc_req->mempool_virt +
-					total_size,
-					size);
-			}
+			memcpy(buffer,
+				vsc_req->mempool_virt +
+				total_size,
+				size);
 
 			total_size += size;
 			if (total_size ==
@@ -296,32 +554,9 @@ static void handle_non_ioctl_resp(struct vblk_dev *vblkdev,
 	}
 
 end:
-	if (vblkdev->config.blk_config.use_vm_address) {
-		if ((req_op(bio_req) == REQ_OP_READ) ||
-			(req_op(bio_req) == REQ_OP_WRITE)) {
-			dma_unmap_sg(vblkdev->device,
-				vsc_req->sg_lst,
-				vsc_req->sg_num_ents,
-				DMA_BIDIRECTIONAL);
-			devm_kfree(vblkdev->device, vsc_req->sg_lst);
-		}
-	}
+	vblk_unmap_req(vblkdev, vsc_req);
 
-	if (!invoke_req_err_hand) {
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
-			blk_mq_end_request(bio_req, BLK_STS_OK);
-#else
-			if (blk_end_request(bio_req, 0,
-				blk_req->num_blks *
-				vblkdev->config.blk_config.hardblk_size)) {
-				dev_err(vblkdev->device,
-					"Error completing fs request!\n");
-			}
-#endif
-	} else {
-
-		req_error_handler(vblkdev, bio_req);
-	}
+	return req_ok;
 }
 
 /**
@@ -333,9 +568,11 @@ static bool complete_bio_req(struct vblk_dev *vblkdev)
 {
 	int status = 0;
 	struct vsc_request *vsc_req = NULL;
-	struct vs_request *vs_req;
 	struct vs_request req_resp;
 	struct request *bio_req;
+	unsigned int bytes = 0;
+	bool req_ok = false;
+	u64 resp_ns;
 
 	/* First check if ivc read queue is empty */
 	if (!tegra_hv_ivc_can_read(vblkdev->ivck))
@@ -362,8 +599,10 @@ static bool complete_bio_req(struct vblk_dev *vblkdev)
 		goto complete_bio_exit;
 	}
 
+	resp_ns = ktime_get_ns();
+	vblk_lat_record(vblkdev, VBLK_LAT_SERVER, vsc_req->send_ns, resp_ns);
+
 	bio_req = vsc_req->req;
-	vs_req = &vsc_req->vs_req;
 
 	if ((bio_req != NULL) && (status == 0)) {
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0)
@@ -374,29 +613,37 @@ static bool complete_bio_req(struct vblk_dev *vblkdev)
 			vblk_complete_ioctl_req(vblkdev, vsc_req,
 					req_resp.blkdev_resp.
 					ioctl_resp.status);
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
-				blk_mq_end_request(bio_req, BLK_STS_OK);
-#else
-				if (blk_end_request(bio_req, 0, 0)) {
-					dev_err(vblkdev->device,
-						"Error completing private request!\n");
-				}
-#endif
+			req_ok = true;
 		}  else {
-			handle_non_ioctl_resp(vblkdev, vsc_req,
+			bytes = vsc_req->vs_req.blkdev_req.blk_req.num_blks *
+				vblkdev->config.blk_config.hardblk_size;
+			req_ok = handle_non_ioctl_resp(vblkdev, vsc_req,
 				&(req_resp.blkdev_resp.blk_resp));
 		}
-
-	} else if ((bio_req != NULL) && (status != 0)) {
-		req_error_handler(vblkdev, bio_req);
+	} else if (bio_req != NULL) {
+		vblk_unmap_req(vblkdev, vsc_req);
 	} else {
 		dev_err(vblkdev->device,
 			"VSC request %d has null bio request!\n",
 			vsc_req->id);
 	}
 
+	/*
+	 * Release the slot before ending the request: with blk-mq the slot
+	 * is owned by the request tag, which may be reused as soon as the
+	 * request is completed.
+	 */
 	vblk_put_req(vsc_req);
 
+	if (bio_req != NULL) {
+		if (req_ok)
+			vblk_end_request(vblkdev, bio_req, bytes);
+		else
+			req_error_handler(vblkdev, bio_req);
+	}
+
+	vblk_lat_record(vblkdev, VBLK_LAT_COMPLETE, resp_ns, ktime_get_ns());
+
 complete_bio_exit:
 	return true;
 
@@ -444,81 +691,103 @@ static bool bio_req_sanity_check(struct vblk_dev *vblkdev,
 }
 
 /**
- * submit_bio_req: Fetch a bio request and submit it to
- * server for processing.
+ * vblk_prep_discard_ranges: Batch all ranges of a multi-range discard
+ *		request into a single VS_BLK_DISCARD_RANGES request.
  */
-static bool submit_bio_req(struct vblk_dev *vblkdev)
+static bool vblk_prep_discard_ranges(struct vblk_dev *vblkdev,
+		struct vsc_request *vsc_req,
+		struct request *bio_req)
+{
+	struct vs_blk_range *range = vsc_req->mempool_virt;
+	struct vs_blk_request *blk_req =
+		&vsc_req->vs_req.blkdev_req.blk_req;
+	uint32_t hardblk_size = vblkdev->config.blk_config.hardblk_size;
+	uint64_t start, bytes;
+	uint64_t num_blks = 0;
+	uint32_t n = 0;
+	struct bio *bio;
+
+	__rq_for_each_bio(bio, bio_req) {
+		start = bio->bi_iter.bi_sector * (uint64_t)SECTOR_SIZE;
+		bytes = bio->bi_iter.bi_size;
+
+		if ((n >= vblkdev->max_discard_ranges) ||
+			((start % hardblk_size) != 0) ||
+			((bytes % hardblk_size) != 0) ||
+			(start >= vblkdev->size) ||
+			(bytes > (vblkdev->size - start))) {
+			dev_err(vblkdev->device,
+				"Invalid discard range %u start 0x%llx size 0x%llx\n",
+				n, start, bytes);
+			return false;
+		}
+
+		range[n].blk_offset = start / hardblk_size;
+		range[n].num_blks = bytes / hardblk_size;
+		range[n].reserved = 0;
+		num_blks += range[n].num_blks;
+		n++;
+	}
+
+	if ((n == 0) || (num_blks > U32_MAX))
+		return false;
+
+	vsc_req->vs_req.blkdev_req.req_op = VS_BLK_DISCARD_RANGES;
+	blk_req->blk_offset = range[0].blk_offset;
+	blk_req->num_blks = (uint32_t)num_blks;
+	blk_req->data_offset = vsc_req->mempool_offset;
+	blk_req->num_ranges = n;
+
+	atomic64_inc(&vblkdev->discard_batches);
+	atomic64_add(n, &vblkdev->discard_ranges);
+
+	return true;
+}
+
+/**
+ * prep_bio_req: Translate a block request into the vs_request of its
+ *		vsc request slot. Does not touch the IVC channel.
+ */
+static bool prep_bio_req(struct vblk_dev *vblkdev,
+		struct vsc_request *vsc_req,
+		struct request *bio_req)
 {
-	struct vsc_request *vsc_req = NULL;
-	struct request *bio_req = NULL;
 	struct vs_request *vs_req;
 	struct bio_vec bvec;
 	size_t size;
 	size_t total_size = 0;
 	void *buffer;
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
-	struct req_entry *entry = NULL;
-#endif
-	size_t sz;
 	uint32_t sg_cnt;
 	dma_addr_t  sg_dma_addr = 0;
 
-	/* Check if ivc queue is full */
-	if (!tegra_hv_ivc_can_write(vblkdev->ivck))
-		goto bio_exit;
-
-	if (vblkdev->queue == NULL)
-		goto bio_exit;
-
-	vsc_req = vblk_get_req(vblkdev);
-	if (vsc_req == NULL)
-		goto bio_exit;
-
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
-	spin_lock(&vblkdev->queue_lock);
-	if(!list_empty(&vblkdev->req_list)) {
-		entry = list_first_entry(&vblkdev->req_list, struct req_entry,
-						list_entry);
-		list_del(&entry->list_entry);
-		bio_req = entry->req;
-		kfree(entry);
-	}
-	spin_unlock(&vblkdev->queue_lock);
-#else
-	spin_lock(vblkdev->queue->queue_lock);
-	bio_req = blk_fetch_request(vblkdev->queue);
-	spin_unlock(vblkdev->queue->queue_lock);
-#endif
-
-	if (bio_req == NULL)
-		goto bio_exit;
+	vsc_req->req = bio_req;
+	vsc_req->sg_num_ents = 0;
+	vsc_req->xfer_mode = VBLK_XFER_BOUNCE;
 
-	if ((vblkdev->config.blk_config.use_vm_address) &&
+	if ((vblkdev->xfer_mode == VBLK_XFER_IOVA) &&
 		((req_op(bio_req) == REQ_OP_READ) ||
 		(req_op(bio_req) == REQ_OP_WRITE))) {
-		sz = (sizeof(struct scatterlist)
-			* bio_req->nr_phys_segments);
-		vsc_req->sg_lst =  devm_kzalloc(vblkdev->device, sz,
-					GFP_KERNEL);
-		if (vsc_req->sg_lst == NULL) {
-			dev_err(vblkdev->device,
-				"SG mem allocation failed\n");
-			goto bio_exit;
-		}
+		/* sg_lst is preallocated for queue_max_segments() entries */
 		sg_init_table(vsc_req->sg_lst,
-			bio_req->nr_phys_segments);
+			queue_max_segments(vblkdev->queue));
 		sg_cnt = blk_rq_map_sg(vblkdev->queue, bio_req,
 				vsc_req->sg_lst);
-		vsc_req->sg_num_ents = sg_nents(vsc_req->sg_lst);
 		if (dma_map_sg(vblkdev->device, vsc_req->sg_lst,
-			vsc_req->sg_num_ents, DMA_BIDIRECTIONAL) == 0) {
+			sg_cnt, DMA_BIDIRECTIONAL) == 0) {
 			dev_err(vblkdev->device, "dma_map_sg failed\n");
-			goto bio_exit;
+			return false;
 		}
+		vsc_req->sg_num_ents = sg_cnt;
+		vsc_req->xfer_mode = VBLK_XFER_IOVA;
 		sg_dma_addr = sg_dma_address(vsc_req->sg_lst);
+	} else if ((vblkdev->xfer_mode == VBLK_XFER_SGL) &&
+		((req_op(bio_req) == REQ_OP_READ) ||
+		(req_op(bio_req) == REQ_OP_WRITE))) {
+		vsc_req->xfer_mode = VBLK_XFER_SGL;
+		if (!vblk_prep_sgl(vblkdev, vsc_req, bio_req))
+			vsc_req->xfer_mode = VBLK_XFER_BOUNCE;
 	}
 
-	vsc_req->req = bio_req;
 	vs_req = &vsc_req->vs_req;
 
 	vs_req->type = VS_DATA_REQ;
@@ -540,7 +809,7 @@ static bool submit_bio_req(struct vblk_dev *vblkdev)
 		} else {
 			dev_err(vblkdev->device,
 				"Request direction is not read/write!\n");
-			goto bio_exit;
+			goto prep_fail;
 		}
 
 		vsc_req->iter.bio = NULL;
@@ -548,9 +817,15 @@ static bool submit_bio_req(struct vblk_dev *vblkdev)
 			vs_req->blkdev_req.blk_req.blk_offset = 0;
 			vs_req->blkdev_req.blk_req.num_blks =
 				vblkdev->config.blk_config.num_blks;
+		} else if ((req_op(bio_req) == REQ_OP_DISCARD) &&
+			(blk_rq_nr_discard_segments(bio_req) > 1)) {
+			if (!vblk_prep_discard_ranges(vblkdev, vsc_req,
+					bio_req)) {
+				goto prep_fail;
+			}
 		} else {
 			if (!bio_req_sanity_check(vblkdev, bio_req, vsc_req)) {
-				goto bio_exit;
+				goto prep_fail;
 			}
 
 			vs_req->blkdev_req.blk_req.blk_offset = ((blk_rq_pos(bio_req) *
@@ -560,7 +835,8 @@ static bool submit_bio_req(struct vblk_dev *vblkdev)
 				SECTOR_SIZE) /
 				vblkdev->config.blk_config.hardblk_size);
 
-			if (!vblkdev->config.blk_config.use_vm_address) {
+			if (vsc_req->xfer_mode != VBLK_XFER_IOVA) {
+				/* Bounce data or the scatter list */
 				vs_req->blkdev_req.blk_req.data_offset =
 							vsc_req->mempool_offset;
 			} else {
@@ -571,59 +847,264 @@ static bool submit_bio_req(struct vblk_dev *vblkdev)
 			}
 		}
 
-		if (req_op(bio_req) == REQ_OP_WRITE) {
-			rq_for_each_segment(bvec, bio_req, vsc_req->iter) {
-				size = bvec.bv_len;
-				buffer = page_address(bvec.bv_page) +
-						bvec.bv_offset;
+		if ((req_op(bio_req) == REQ_OP_WRITE) &&
+			(vsc_req->xfer_mode == VBLK_XFER_BOUNCE)) {
+			rq_for_each_segment(bvec, bio_req, vsc_req->iter) {
+				size = bvec.bv_len;
+				buffer = page_address(bvec.bv_page) +
+						bvec.bv_offset;
+
+				if ((total_size + size) >
+					(vs_req->blkdev_req.blk_req.num_blks *
+					vblkdev->config.blk_config.hardblk_size))
+				{
+					size = (vs_req->blkdev_req.blk_req.num_blks *
+						vblkdev->config.blk_config.hardblk_size) -
+						total_size;
+				}
+
+				memcpy(vsc_req->mempool_virt + total_size,
+					buffer, size);
+
+				total_size += size;
+				if (total_size == (vs_req->blkdev_req.blk_req.num_blks *
+					vblkdev->config.blk_config.hardblk_size)) {
+					break;
+				}
+			}
+		}
+
+		if ((req_op(bio_req) == REQ_OP_READ) ||
+			(req_op(bio_req) == REQ_OP_WRITE))
+			vblk_account_xfer(vblkdev, vsc_req, bio_req);
+	} else {
+		if (vblk_prep_ioctl_req(vblkdev,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+			(struct vblk_ioctl_req *)bio_req->completion_data,
+#else
+			(struct vblk_ioctl_req *)bio_req->special,
+#endif
+			vsc_req)) {
+			dev_err(vblkdev->device,
+				"Failed to prepare ioctl request!\n");
+			goto prep_fail;
+		}
+	}
+
+	return true;
+
+prep_fail:
+	vblk_unmap_req(vblkdev, vsc_req);
+	return false;
+}
+
+/**
+ * send_bio_req: Post a prepared vsc request to the server.
+ */
+static int send_bio_req(struct vblk_dev *vblkdev,
+		struct vsc_request *vsc_req)
+{
+	int ret;
+
+	spin_lock(&vblkdev->ivc_tx_lock);
+	ret = tegra_hv_ivc_write(vblkdev->ivck, &vsc_req->vs_req,
+				sizeof(struct vs_request));
+	spin_unlock(&vblkdev->ivc_tx_lock);
+
+	if (ret == sizeof(struct vs_request))
+		return 0;
+
+	return (ret < 0) ? ret : -EIO;
+}
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+static void vblk_request_work(struct work_struct *ws)
+{
+	struct vblk_dev *vblkdev =
+		container_of(ws, struct vblk_dev, work);
+	int notified;
+
+	/* Taking ivc lock before performing IVC read */
+	mutex_lock(&vblkdev->ivc_lock);
+	spin_lock(&vblkdev->ivc_tx_lock);
+	notified = tegra_hv_ivc_channel_notified(vblkdev->ivck);
+	spin_unlock(&vblkdev->ivc_tx_lock);
+	if (notified != 0) {
+		mutex_unlock(&vblkdev->ivc_lock);
+		return;
+	}
+
+	while (complete_bio_req(vblkdev))
+		;
+	mutex_unlock(&vblkdev->ivc_lock);
+}
+
+/*
+ * Requests are submitted straight from the dispatching CPU. The vsc request
+ * slot comes from the blk-mq tag and the IVC frame is guaranteed to be
+ * available since the number of slots never exceeds the number of frames,
+ * so the only shared state left on this path is the IVC write itself.
+ */
+static blk_status_t vblk_request(struct blk_mq_hw_ctx *hctx,
+			const struct blk_mq_queue_data *bd)
+{
+	struct request *req = bd->rq;
+	struct vblk_hw_queue *hwq = hctx->driver_data;
+	struct vblk_dev *vblkdev = hwq->vblkdev;
+	struct vsc_request *vsc_req;
+	u64 start_ns = ktime_get_ns();
+	u64 send_ns;
+	int ret;
+
+	if (!vblk_hold_queue(vblkdev)) {
+		atomic64_inc(&hwq->busy);
+		return BLK_STS_RESOURCE;
+	}
+
+	vsc_req = vblk_get_req_by_tag(vblkdev, hwq, req);
+	if (vsc_req == NULL) {
+		vblk_release_queue(vblkdev);
+		return BLK_STS_IOERR;
+	}
+
+	blk_mq_start_request(req);
+
+	if (!prep_bio_req(vblkdev, vsc_req, req)) {
+		vblk_put_req(vsc_req);
+		return BLK_STS_IOERR;
+	}
+
+	/* The response may be reaped before send_bio_req() returns */
+	send_ns = ktime_get_ns();
+	vsc_req->send_ns = send_ns;
+
+	ret = send_bio_req(vblkdev, vsc_req);
+	if (ret != 0) {
+		vblk_unmap_req(vblkdev, vsc_req);
+		vblk_put_req(vsc_req);
+		/* Channel full or being reset: let blk-mq retry later */
+		if ((ret == -ENOMEM) || (ret == -ECONNRESET)) {
+			atomic64_inc(&hwq->busy);
+			return BLK_STS_RESOURCE;
+		}
+		dev_err(vblkdev->device,
+			"Request Id %d IVC write failed!\n", vsc_req->id);
+		return BLK_STS_IOERR;
+	}
+
+	/* vsc_req may already be completed and reused, use a local copy */
+	vblk_lat_record(vblkdev, VBLK_LAT_SEND, send_ns, ktime_get_ns());
+	vblk_lat_record(vblkdev, VBLK_LAT_SUBMIT, start_ns, send_ns);
+	atomic64_inc(&hwq->dispatched);
+
+	return BLK_STS_OK;
+}
+
+/* Reap IVC responses inline for REQ_HIPRI (io_uring IOPOLL) users */
+static int vblk_poll(struct blk_mq_hw_ctx *hctx)
+{
+	struct vblk_hw_queue *hwq = hctx->driver_data;
+	struct vblk_dev *vblkdev = hwq->vblkdev;
+	int found = 0;
+
+	/* Someone is already reaping, whatever is ready will be completed */
+	if (!mutex_trylock(&vblkdev->ivc_lock))
+		return 0;
+
+	while (complete_bio_req(vblkdev))
+		found++;
+	mutex_unlock(&vblkdev->ivc_lock);
+
+	if (found)
+		atomic64_add(found, &vblkdev->polled);
+
+	return found;
+}
+
+static int vblk_map_queues(struct blk_mq_tag_set *set)
+{
+	struct vblk_dev *vblkdev = set->driver_data;
+	struct blk_mq_queue_map *map;
+	uint32_t nr_default = vblkdev->nr_hw_queues - vblkdev->nr_poll_queues;
+
+	map = &set->map[HCTX_TYPE_DEFAULT];
+	map->nr_queues = nr_default;
+	map->queue_offset = 0;
+	blk_mq_map_queues(map);
+
+	if (set->nr_maps <= HCTX_TYPE_POLL)
+		return 0;
+
+	/* Reads share the default queues */
+	set->map[HCTX_TYPE_READ].nr_queues = 0;
+
+	map = &set->map[HCTX_TYPE_POLL];
+	map->nr_queues = vblkdev->nr_poll_queues;
+	map->queue_offset = nr_default;
+	blk_mq_map_queues(map);
+
+	return 0;
+}
+
+static int vblk_init_hctx(struct blk_mq_hw_ctx *hctx, void *data,
+			unsigned int index)
+{
+	struct vblk_dev *vblkdev = data;
+
+	if (index >= vblkdev->nr_hw_queues)
+		return -EINVAL;
+
+	hctx->driver_data = &vblkdev->hw_queues[index];
+
+	return 0;
+}
+#else
+/**
+ * submit_bio_req: Fetch a bio request and submit it to
+ * server for processing.
+ */
+static bool submit_bio_req(struct vblk_dev *vblkdev)
+{
+	struct vsc_request *vsc_req = NULL;
+	struct request *bio_req = NULL;
+	u64 start_ns = ktime_get_ns();
+	u64 send_ns;
+
+	/* Check if ivc queue is full */
+	if (!tegra_hv_ivc_can_write(vblkdev->ivck))
+		goto bio_exit;
+
+	if (vblkdev->queue == NULL)
+		goto bio_exit;
+
+	vsc_req = vblk_get_req(vblkdev);
+	if (vsc_req == NULL)
+		goto bio_exit;
+
+	spin_lock(vblkdev->queue->queue_lock);
+	bio_req = blk_fetch_request(vblkdev->queue);
+	spin_unlock(vblkdev->queue->queue_lock);
 
-				if ((total_size + size) >
-					(vs_req->blkdev_req.blk_req.num_blks *
-					vblkdev->config.blk_config.hardblk_size))
-				{
-					size = (vs_req->blkdev_req.blk_req.num_blks *
-						vblkdev->config.blk_config.hardblk_size) -
-						total_size;
-				}
+	if (bio_req == NULL)
+		goto bio_exit;
 
-				/* memcpy to mempool not needed as VM IOVA is
-				 * provided
-				 */
-				if (!vblkdev->config.blk_config.use_vm_address) {
-					memcpy(
-					vsc_req->mempool_virt + total_size,
-					buffer, size);
-				}
+	if (!prep_bio_req(vblkdev, vsc_req, bio_req))
+		goto bio_exit;
 
-				total_size += size;
-				if (total_size == (vs_req->blkdev_req.blk_req.num_blks *
-					vblkdev->config.blk_config.hardblk_size)) {
-					break;
-				}
-			}
-		}
-	} else {
-		if (vblk_prep_ioctl_req(vblkdev,
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
-			(struct vblk_ioctl_req *)bio_req->completion_data,
-#else
-			(struct vblk_ioctl_req *)bio_req->special,
-#endif
-			vsc_req)) {
-			dev_err(vblkdev->device,
-				"Failed to prepare ioctl request!\n");
-			goto bio_exit;
-		}
-	}
+	send_ns = ktime_get_ns();
+	vsc_req->send_ns = send_ns;
 
-	if (!tegra_hv_ivc_write(vblkdev->ivck, vs_req,
-				sizeof(struct vs_request))) {
+	if (send_bio_req(vblkdev, vsc_req) != 0) {
 		dev_err(vblkdev->device,
 			"Request Id %d IVC write failed!\n",
 				vsc_req->id);
+		vblk_unmap_req(vblkdev, vsc_req);
 		goto bio_exit;
 	}
 
+	vblk_lat_record(vblkdev, VBLK_LAT_SEND, send_ns, ktime_get_ns());
+	vblk_lat_record(vblkdev, VBLK_LAT_SUBMIT, start_ns, send_ns);
+
 	return true;
 
 bio_exit:
@@ -663,38 +1144,6 @@ static void vblk_request_work(struct work_struct *ws)
 }
 
 /* The simple form of the request function. */
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
-static blk_status_t vblk_request(struct blk_mq_hw_ctx *hctx,
-			const struct blk_mq_queue_data *bd)
-{
-	struct req_entry *entry;
-	struct request *req = bd->rq;
-	struct vblk_dev *vblkdev = hctx->queue->queuedata;
-
-	blk_mq_start_request(req);
-
-	/* malloc for req list entry */
-	entry = kmalloc(sizeof(struct req_entry), GFP_ATOMIC);
-	if (entry == NULL) {
-		dev_err(vblkdev->device, "Failed to allocate memory\n");
-		return BLK_STS_IOERR;
-	}
-
-	/* Initialise the entry */
-	entry->req = req;
-	INIT_LIST_HEAD(&entry->list_entry);
-
-	/* Insert the req to list */
-	spin_lock(&vblkdev->queue_lock);
-	list_add_tail(&entry->list_entry, &vblkdev->req_list);
-	spin_unlock(&vblkdev->queue_lock);
-
-	/* Now invoke the queue to handle data inserted in queue */
-	queue_work_on(WORK_CPU_UNBOUND, vblkdev->wq, &vblkdev->work);
-
-	return BLK_STS_OK;
-}
-#else
 static void vblk_request(struct request_queue *q)
 {
 	struct vblk_dev *vblkdev = q->queuedata;
@@ -822,6 +1271,28 @@ vblk_speed_mode_show(struct device *dev, struct device_attribute *attr,
 	return snprintf(buf, 32, "%s\n", vblk->config.speed_mode);
 }
 
+static ssize_t
+vblk_copy_bytes_show(struct device *dev, struct device_attribute *attr,
+			 char *buf)
+{
+	struct gendisk *disk = dev_to_disk(dev);
+	struct vblk_dev *vblk = disk->private_data;
+
+	return snprintf(buf, 32, "%lld\n",
+		(long long)atomic64_read(&vblk->copy_bytes));
+}
+
+static ssize_t
+vblk_zero_copy_bytes_show(struct device *dev, struct device_attribute *attr,
+			 char *buf)
+{
+	struct gendisk *disk = dev_to_disk(dev);
+	struct vblk_dev *vblk = disk->private_data;
+
+	return snprintf(buf, 32, "%lld\n",
+		(long long)atomic64_read(&vblk->zero_copy_bytes));
+}
+
 static const struct device_attribute dev_attr_phys_dev_ro =
 	__ATTR(phys_dev, 0444,
 	       vblk_phys_dev_show, NULL);
@@ -838,10 +1309,378 @@ static const struct device_attribute dev_attr_speed_mode_ro =
 	__ATTR(speed_mode, 0444,
 	       vblk_speed_mode_show, NULL);
 
+static const struct device_attribute dev_attr_copy_bytes_ro =
+	__ATTR(copy_bytes, 0444,
+	       vblk_copy_bytes_show, NULL);
+
+static const struct device_attribute dev_attr_zero_copy_bytes_ro =
+	__ATTR(zero_copy_bytes, 0444,
+	       vblk_zero_copy_bytes_show, NULL);
+
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
 static const struct blk_mq_ops vblk_mq_ops = {
 	.queue_rq	= vblk_request,
+	.init_hctx	= vblk_init_hctx,
+	.map_queues	= vblk_map_queues,
+	.poll		= vblk_poll,
+};
+
+/*
+ * Partition the request slots between the hardware queues. There is a
+ * single IVC channel per device, so each hardware queue is backed by its
+ * own range of vsc request slots (and mempool chunks) instead.
+ */
+static int vblk_init_mq_queue(struct vblk_dev *vblkdev)
+{
+	struct blk_mq_tag_set *set = &vblkdev->tag_set;
+	uint32_t nr_hw_queues;
+	uint32_t i;
+	int ret;
+
+	nr_hw_queues = vblk_hw_queues;
+	if (nr_hw_queues == 0) {
+		nr_hw_queues = min_t(uint32_t, num_online_cpus(),
+			vblkdev->max_requests / VBLK_MIN_HW_QUEUE_DEPTH);
+	}
+	nr_hw_queues = clamp_t(uint32_t, nr_hw_queues, 1,
+				vblkdev->max_requests);
+
+	/* Poll queues come on top and get their own slot partitions */
+	vblkdev->nr_poll_queues = min_t(uint32_t, vblk_poll_queues,
+				vblkdev->max_requests - nr_hw_queues);
+	nr_hw_queues += vblkdev->nr_poll_queues;
+
+	vblkdev->nr_hw_queues = nr_hw_queues;
+	vblkdev->hw_queue_depth = vblkdev->max_requests / nr_hw_queues;
+
+	for (i = 0; i < nr_hw_queues; i++) {
+		vblkdev->hw_queues[i].vblkdev = vblkdev;
+		vblkdev->hw_queues[i].index = i;
+		vblkdev->hw_queues[i].slot_base = i * vblkdev->hw_queue_depth;
+		atomic64_set(&vblkdev->hw_queues[i].dispatched, 0);
+		atomic64_set(&vblkdev->hw_queues[i].busy, 0);
+	}
+
+	memset(set, 0, sizeof(*set));
+	set->ops = &vblk_mq_ops;
+	set->nr_hw_queues = nr_hw_queues;
+	set->nr_maps = vblkdev->nr_poll_queues ? HCTX_MAX_TYPES : 1;
+	set->queue_depth = vblkdev->hw_queue_depth;
+	set->numa_node = NUMA_NO_NODE;
+	set->flags = BLK_MQ_F_SHOULD_MERGE;
+	set->driver_data = vblkdev;
+
+	ret = blk_mq_alloc_tag_set(set);
+	if (ret)
+		return ret;
+
+	vblkdev->queue = blk_mq_init_queue(set);
+	if (IS_ERR(vblkdev->queue)) {
+		ret = PTR_ERR(vblkdev->queue);
+		vblkdev->queue = NULL;
+		blk_mq_free_tag_set(set);
+		return ret;
+	}
+
+	dev_info(vblkdev->device, "%u hw queues (%u poll) of depth %u\n",
+		nr_hw_queues, vblkdev->nr_poll_queues,
+		vblkdev->hw_queue_depth);
+
+	return 0;
+}
+
+#define VBLK_BENCH_MAX_JOBS	64U
+#define VBLK_BENCH_MAX_IOS	1000000U
+
+static struct dentry *vblk_debugfs_root;
+
+struct vblk_bench_job {
+	struct block_device *bdev;
+	uint32_t nr_ios;
+	uint32_t block_size;
+	uint32_t nr_blocks;
+	uint32_t errors;
+	uint64_t lat_total_ns;
+	uint64_t lat_max_ns;
+	struct completion done;
+};
+
+/* One fio style "randread, iodepth=1" job */
+static int vblk_bench_thread(void *data)
+{
+	struct vblk_bench_job *job = data;
+	unsigned int order = get_order(job->block_size);
+	struct page *page;
+	struct bio *bio;
+	ktime_t start;
+	uint64_t lat;
+	uint32_t i;
+
+	page = alloc_pages(GFP_KERNEL, order);
+	if (page == NULL) {
+		job->errors = job->nr_ios;
+		goto done;
+	}
+
+	for (i = 0; i < job->nr_ios; i++) {
+		bio = bio_alloc(GFP_KERNEL, 1);
+		bio_set_dev(bio, job->bdev);
+		bio->bi_opf = REQ_OP_READ;
+		bio->bi_iter.bi_sector = (sector_t)(prandom_u32() %
+			job->nr_blocks) * (job->block_size >> SECTOR_SHIFT);
+		bio_add_page(bio, page, job->block_size, 0);
+
+		start = ktime_get();
+		if (submit_bio_wait(bio))
+			job->errors++;
+		lat = ktime_to_ns(ktime_sub(ktime_get(), start));
+		bio_put(bio);
+
+		job->lat_total_ns += lat;
+		if (lat > job->lat_max_ns)
+			job->lat_max_ns = lat;
+	}
+
+	__free_pages(page, order);
+done:
+	complete(&job->done);
+	return 0;
+}
+
+static int vblk_bench_run(struct vblk_dev *vblkdev, uint32_t num_jobs,
+		uint32_t ios_per_job, uint32_t block_size)
+{
+	struct vblk_bench_result *res = &vblkdev->bench;
+	struct vblk_bench_job *jobs;
+	struct block_device *bdev;
+	struct task_struct *task;
+	uint64_t nr_blocks;
+	ktime_t start;
+	uint32_t i;
+
+	jobs = kcalloc(num_jobs, sizeof(*jobs), GFP_KERNEL);
+	if (jobs == NULL)
+		return -ENOMEM;
+
+	bdev = blkdev_get_by_dev(disk_devt(vblkdev->gd), FMODE_READ, NULL);
+	if (IS_ERR(bdev)) {
+		kfree(jobs);
+		return PTR_ERR(bdev);
+	}
+
+	nr_blocks = min_t(uint64_t, vblkdev->size / block_size, U32_MAX);
+
+	start = ktime_get();
+	for (i = 0; i < num_jobs; i++) {
+		jobs[i].bdev = bdev;
+		jobs[i].nr_ios = ios_per_job;
+		jobs[i].block_size = block_size;
+		jobs[i].nr_blocks = (uint32_t)nr_blocks;
+		init_completion(&jobs[i].done);
+
+		task = kthread_run(vblk_bench_thread, &jobs[i],
+				"vblk_bench%u/%u", vblkdev->devnum, i);
+		if (IS_ERR(task)) {
+			jobs[i].errors = ios_per_job;
+			complete(&jobs[i].done);
+		}
+	}
+
+	memset(res, 0, sizeof(*res));
+	for (i = 0; i < num_jobs; i++) {
+		wait_for_completion(&jobs[i].done);
+		res->errors += jobs[i].errors;
+		res->lat_total_ns += jobs[i].lat_total_ns;
+		res->lat_max_ns = max(res->lat_max_ns, jobs[i].lat_max_ns);
+	}
+	res->elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	res->num_jobs = num_jobs;
+	res->ios_per_job = ios_per_job;
+	res->block_size = block_size;
+
+	blkdev_put(bdev, FMODE_READ);
+	kfree(jobs);
+
+	return 0;
+}
+
+static int vblk_bench_show(struct seq_file *s, void *data)
+{
+	struct vblk_dev *vblkdev = s->private;
+	struct vblk_bench_result *res = &vblkdev->bench;
+	uint64_t total_ios;
+
+	mutex_lock(&vblkdev->bench_lock);
+	total_ios = (uint64_t)res->num_jobs * res->ios_per_job;
+	if ((total_ios == 0) || (res->elapsed_ns == 0)) {
+		seq_puts(s, "usage: echo <jobs> <ios_per_job> <block_size> > bench\n");
+		goto out;
+	}
+
+	seq_printf(s, "jobs: %u\n", res->num_jobs);
+	seq_printf(s, "ios_per_job: %u\n", res->ios_per_job);
+	seq_printf(s, "block_size: %u\n", res->block_size);
+	seq_printf(s, "errors: %u\n", res->errors);
+	seq_printf(s, "elapsed_ns: %llu\n", res->elapsed_ns);
+	seq_printf(s, "iops: %llu\n",
+		div64_u64(total_ios * NSEC_PER_SEC, res->elapsed_ns));
+	seq_printf(s, "kib_per_sec: %llu\n",
+		div64_u64(total_ios * res->block_size * (NSEC_PER_SEC / 1024),
+			res->elapsed_ns));
+	seq_printf(s, "lat_avg_ns: %llu\n",
+		div64_u64(res->lat_total_ns, total_ios));
+	seq_printf(s, "lat_max_ns: %llu\n", res->lat_max_ns);
+out:
+	mutex_unlock(&vblkdev->bench_lock);
+	return 0;
+}
+
+static int vblk_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vblk_bench_show, inode->i_private);
+}
+
+static ssize_t vblk_bench_write(struct file *file, const char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	struct vblk_dev *vblkdev = file_inode(file)->i_private;
+	uint32_t max_io_bytes = vblkdev->reqs[0].mempool_len;
+	uint32_t num_jobs, ios_per_job, block_size;
+	char *kbuf;
+	int ret;
+
+	if (!(vblkdev->config.blk_config.req_ops_supported &
+			VS_BLK_READ_OP_F))
+		return -EOPNOTSUPP;
+
+	kbuf = memdup_user_nul(ubuf, min_t(size_t, count, 63));
+	if (IS_ERR(kbuf))
+		return PTR_ERR(kbuf);
+
+	ret = sscanf(kbuf, "%u %u %u", &num_jobs, &ios_per_job, &block_size);
+	kfree(kbuf);
+	if (ret != 3)
+		return -EINVAL;
+
+	if ((num_jobs == 0) || (num_jobs > VBLK_BENCH_MAX_JOBS) ||
+		(ios_per_job == 0) || (ios_per_job > VBLK_BENCH_MAX_IOS) ||
+		(block_size == 0) || (block_size > max_io_bytes) ||
+		(block_size > vblkdev->size) ||
+		((block_size % vblkdev->config.blk_config.hardblk_size) != 0))
+		return -EINVAL;
+
+	mutex_lock(&vblkdev->bench_lock);
+	ret = vblk_bench_run(vblkdev, num_jobs, ios_per_job, block_size);
+	mutex_unlock(&vblkdev->bench_lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations vblk_bench_fops = {
+	.owner		= THIS_MODULE,
+	.open		= vblk_bench_open,
+	.read		= seq_read,
+	.write		= vblk_bench_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int vblk_hw_queues_show(struct seq_file *s, void *data)
+{
+	struct vblk_dev *vblkdev = s->private;
+	struct vblk_hw_queue *hwq;
+	uint32_t i;
+
+	seq_printf(s, "inflight: %d\n", atomic_read(&vblkdev->inflight_reqs));
+	seq_printf(s, "polled: %lld\n",
+		(long long)atomic64_read(&vblkdev->polled));
+	seq_printf(s, "discard_batches: %lld\n",
+		(long long)atomic64_read(&vblkdev->discard_batches));
+	seq_printf(s, "discard_ranges: %lld\n",
+		(long long)atomic64_read(&vblkdev->discard_ranges));
+	for (i = 0; i < vblkdev->nr_hw_queues; i++) {
+		hwq = &vblkdev->hw_queues[i];
+		seq_printf(s, "hwq%u%s: slots %u-%u dispatched %lld busy %lld\n",
+			hwq->index,
+			(i >= vblkdev->nr_hw_queues - vblkdev->nr_poll_queues) ?
+				" (poll)" : "",
+			hwq->slot_base,
+			hwq->slot_base + vblkdev->hw_queue_depth - 1,
+			(long long)atomic64_read(&hwq->dispatched),
+			(long long)atomic64_read(&hwq->busy));
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(vblk_hw_queues);
+
+static const char * const vblk_lat_stage_names[VBLK_LAT_NUM_STAGES] = {
+	[VBLK_LAT_SUBMIT]	= "submit",
+	[VBLK_LAT_SEND]		= "ivc_send",
+	[VBLK_LAT_SERVER]	= "server",
+	[VBLK_LAT_COMPLETE]	= "complete",
+};
+
+static int vblk_latency_show(struct seq_file *s, void *data)
+{
+	struct vblk_dev *vblkdev = s->private;
+	uint32_t stage, i;
+	s64 count;
+
+	for (stage = 0; stage < VBLK_LAT_NUM_STAGES; stage++) {
+		seq_printf(s, "%s:\n", vblk_lat_stage_names[stage]);
+		for (i = 0; i < VBLK_LAT_BUCKETS; i++) {
+			count = atomic64_read(&vblkdev->lat.buckets[stage][i]);
+			if (count == 0)
+				continue;
+			seq_printf(s, "  %12llu ns: %lld\n",
+				(i == 0) ? 0ULL : (1ULL << i),
+				(long long)count);
+		}
+	}
+
+	return 0;
+}
+
+static int vblk_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vblk_latency_show, inode->i_private);
+}
+
+/* Any write clears the histogram */
+static ssize_t vblk_latency_write(struct file *file, const char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	struct vblk_dev *vblkdev = file_inode(file)->i_private;
+	uint32_t stage, i;
+
+	for (stage = 0; stage < VBLK_LAT_NUM_STAGES; stage++)
+		for (i = 0; i < VBLK_LAT_BUCKETS; i++)
+			atomic64_set(&vblkdev->lat.buckets[stage][i], 0);
+
+	return count;
+}
+
+static const struct file_operations vblk_latency_fops = {
+	.owner		= THIS_MODULE,
+	.open		= vblk_latency_open,
+	.read		= seq_read,
+	.write		= vblk_latency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
 };
+
+static void vblk_debugfs_init(struct vblk_dev *vblkdev)
+{
+	vblkdev->debugfs_dir = debugfs_create_dir(vblkdev->gd->disk_name,
+						vblk_debugfs_root);
+	debugfs_create_file("hw_queues", 0444, vblkdev->debugfs_dir,
+			vblkdev, &vblk_hw_queues_fops);
+	debugfs_create_file("bench", 0600, vblkdev->debugfs_dir,
+			vblkdev, &vblk_bench_fops);
+	debugfs_create_file("latency", 0600, vblkdev->debugfs_dir,
+			vblkdev, &vblk_latency_fops);
+}
 #endif
 /* Set up virtual device. */
 static void setup_device(struct vblk_dev *vblkdev)
@@ -857,31 +1696,10 @@ static void setup_device(struct vblk_dev *vblkdev)
 
 	spin_lock_init(&vblkdev->lock);
 	spin_lock_init(&vblkdev->queue_lock);
+	spin_lock_init(&vblkdev->ivc_tx_lock);
 	mutex_init(&vblkdev->ioctl_lock);
 	mutex_init(&vblkdev->ivc_lock);
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
-	vblkdev->queue = blk_mq_init_sq_queue(&vblkdev->tag_set, &vblk_mq_ops, 16,
-						BLK_MQ_F_SHOULD_MERGE);
-#else
-	vblkdev->queue = blk_init_queue(vblk_request, &vblkdev->queue_lock);
-#endif
-	if (vblkdev->queue == NULL) {
-		dev_err(vblkdev->device, "failed to init blk queue\n");
-		return;
-	}
-
-	vblkdev->queue->queuedata = vblkdev;
-
-	blk_queue_logical_block_size(vblkdev->queue,
-		vblkdev->config.blk_config.hardblk_size);
-	blk_queue_physical_block_size(vblkdev->queue,
-		vblkdev->config.blk_config.hardblk_size);
-
-	if (vblkdev->config.blk_config.req_ops_supported & VS_BLK_FLUSH_OP_F) {
-		blk_queue_write_cache(vblkdev->queue, true, false);
-	}
-
 	if (vblkdev->config.blk_config.max_read_blks_per_io !=
 		vblkdev->config.blk_config.max_write_blks_per_io) {
 		dev_err(vblkdev->device,
@@ -957,6 +1775,49 @@ static void setup_device(struct vblk_dev *vblkdev)
 		}
 	}
 
+	if (max_requests == 0) {
+		dev_err(vblkdev->device,
+			"maximum requests set to 0!\n");
+		return;
+	}
+
+	vblkdev->max_requests = max_requests;
+
+	if ((vblkdev->config.blk_config.use_vm_address &
+			VS_BLK_VM_ADDR_SGL) && vblk_zero_copy)
+		vblkdev->xfer_mode = VBLK_XFER_SGL;
+	else if (vblkdev->config.blk_config.use_vm_address &
+			VS_BLK_VM_ADDR_IOVA)
+		vblkdev->xfer_mode = VBLK_XFER_IOVA;
+	else
+		vblkdev->xfer_mode = VBLK_XFER_BOUNCE;
+	atomic64_set(&vblkdev->copy_bytes, 0);
+	atomic64_set(&vblkdev->zero_copy_bytes, 0);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+	if (vblk_init_mq_queue(vblkdev)) {
+		dev_err(vblkdev->device, "failed to init blk queue\n");
+		return;
+	}
+#else
+	vblkdev->queue = blk_init_queue(vblk_request, &vblkdev->queue_lock);
+	if (vblkdev->queue == NULL) {
+		dev_err(vblkdev->device, "failed to init blk queue\n");
+		return;
+	}
+#endif
+
+	vblkdev->queue->queuedata = vblkdev;
+
+	blk_queue_logical_block_size(vblkdev->queue,
+		vblkdev->config.blk_config.hardblk_size);
+	blk_queue_physical_block_size(vblkdev->queue,
+		vblkdev->config.blk_config.hardblk_size);
+
+	if (vblkdev->config.blk_config.req_ops_supported & VS_BLK_FLUSH_OP_F) {
+		blk_queue_write_cache(vblkdev->queue, true, false);
+	}
+
 	for (req_id = 0; req_id < max_requests; req_id++){
 		req = &vblkdev->reqs[req_id];
 		req->mempool_virt = (void *)((uintptr_t)vblkdev->shared_buffer +
@@ -965,16 +1826,22 @@ static void setup_device(struct vblk_dev *vblkdev)
 		req->mempool_len = max_io_bytes;
 		req->id = req_id;
 		req->vblkdev = vblkdev;
-	}
 
-	if (max_requests == 0) {
-		dev_err(vblkdev->device,
-			"maximum requests set to 0!\n");
-		return;
+		/* Scatter lists are mapped from the submission path, which
+		 * must not sleep, so size them for the worst case up front.
+		 */
+		if (vblkdev->xfer_mode != VBLK_XFER_BOUNCE) {
+			req->sg_lst = devm_kcalloc(vblkdev->device,
+				queue_max_segments(vblkdev->queue),
+				sizeof(struct scatterlist), GFP_KERNEL);
+			if (req->sg_lst == NULL) {
+				dev_err(vblkdev->device,
+					"SG mem allocation failed\n");
+				return;
+			}
+		}
 	}
-	mutex_init(&vblkdev->req_lock);
 
-	vblkdev->max_requests = max_requests;
 	blk_queue_max_hw_sectors(vblkdev->queue, max_io_bytes / SECTOR_SIZE);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
 	blk_queue_flag_set(QUEUE_FLAG_NONROT, vblkdev->queue);
@@ -991,6 +1858,15 @@ static void setup_device(struct vblk_dev *vblkdev)
 #endif
 		blk_queue_max_discard_sectors(vblkdev->queue,
 			vblkdev->config.blk_config.max_erase_blks_per_io);
+		/* Let the block layer merge discards into one request */
+		if (vblkdev->config.blk_config.req_ops_supported &
+			VS_BLK_DISCARD_RANGES_OP_F) {
+			vblkdev->max_discard_ranges = min_t(uint32_t,
+				VBLK_MAX_DISCARD_RANGES,
+				max_io_bytes / sizeof(struct vs_blk_range));
+			blk_queue_max_discard_segments(vblkdev->queue,
+				vblkdev->max_discard_ranges);
+		}
 		vblkdev->queue->limits.discard_granularity =
 			vblkdev->config.blk_config.hardblk_size;
 		if (vblkdev->config.blk_config.req_ops_supported &
@@ -1046,6 +1922,7 @@ static void setup_device(struct vblk_dev *vblkdev)
 	set_capacity(vblkdev->gd, (vblkdev->size / SECTOR_SIZE));
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
 	device_add_disk(vblkdev->device, vblkdev->gd, NULL);
+	vblk_debugfs_init(vblkdev);
 #else
 	device_add_disk(vblkdev->device, vblkdev->gd);
 #endif
@@ -1073,6 +1950,19 @@ static void setup_device(struct vblk_dev *vblkdev)
 		dev_warn(vblkdev->device, "Error adding speed_mode file!\n");
 		return;
 	}
+
+	if (device_create_file(disk_to_dev(vblkdev->gd),
+		&dev_attr_copy_bytes_ro)) {
+		dev_warn(vblkdev->device, "Error adding copy_bytes file!\n");
+		return;
+	}
+
+	if (device_create_file(disk_to_dev(vblkdev->gd),
+		&dev_attr_zero_copy_bytes_ro)) {
+		dev_warn(vblkdev->device,
+			"Error adding zero_copy_bytes file!\n");
+		return;
+	}
 }
 
 static void vblk_init_device(struct work_struct *ws)
@@ -1200,9 +2090,9 @@ static int tegra_hv_vblk_probe(struct platform_device *pdev)
 
 	INIT_WORK(&vblkdev->init, vblk_init_device);
 	INIT_WORK(&vblkdev->work, vblk_request_work);
-#if LINUX_VERSION_CODE > KERNEL_VERSION(4, 15, 0)
-	/* creating and initializing the an internal request list */
-	INIT_LIST_HEAD(&vblkdev->req_list);
+	atomic_set(&vblkdev->inflight_reqs, 0);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+	mutex_init(&vblkdev->bench_lock);
 #endif
 
 	if (devm_request_irq(vblkdev->device, vblkdev->ivck->irq,
@@ -1238,13 +2128,21 @@ static int tegra_hv_vblk_remove(struct platform_device *pdev)
 {
 	struct vblk_dev *vblkdev = platform_get_drvdata(pdev);
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+	debugfs_remove_recursive(vblkdev->debugfs_dir);
+#endif
+
 	if (vblkdev->gd) {
 		del_gendisk(vblkdev->gd);
 		put_disk(vblkdev->gd);
 	}
 
-	if (vblkdev->queue)
+	if (vblkdev->queue) {
 		blk_cleanup_queue(vblkdev->queue);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+		blk_mq_free_tag_set(&vblkdev->tag_set);
+#endif
+	}
 
 	destroy_workqueue(vblkdev->wq);
 	tegra_hv_ivc_unreserve(vblkdev->ivck);
@@ -1270,13 +2168,13 @@ static int tegra_hv_vblk_suspend(struct device *dev)
 		spin_unlock_irqrestore(&vblkdev->queue->queue_lock, flags);
 #endif
 
-		mutex_lock(&vblkdev->req_lock);
-		vblkdev->queue_state = VBLK_QUEUE_SUSPENDED;
+		WRITE_ONCE(vblkdev->queue_state, VBLK_QUEUE_SUSPENDED);
+		/* Pairs with the barrier in vblk_hold_queue() */
+		smp_mb();
 
 		/* Mark the queue as empty if inflight requests are 0 */
-		if (vblkdev->inflight_reqs == 0)
+		if (atomic_read(&vblkdev->inflight_reqs) == 0)
 			complete(&vblkdev->req_queue_empty);
-		mutex_unlock(&vblkdev->req_lock);
 
 		wait_for_completion(&vblkdev->req_queue_empty);
 		disable_irq(vblkdev->ivck->irq);
@@ -1285,7 +2183,9 @@ static int tegra_hv_vblk_suspend(struct device *dev)
 
 		/* Reset the channel */
 		mutex_lock(&vblkdev->ivc_lock);
+		spin_lock(&vblkdev->ivc_tx_lock);
 		tegra_hv_ivc_channel_reset(vblkdev->ivck);
+		spin_unlock(&vblkdev->ivc_tx_lock);
 		mutex_unlock(&vblkdev->ivc_lock);
 	}
 
@@ -1298,10 +2198,8 @@ static int tegra_hv_vblk_resume(struct device *dev)
 	unsigned long flags;
 
 	if (vblkdev->queue) {
-		mutex_lock(&vblkdev->req_lock);
-		vblkdev->queue_state = VBLK_QUEUE_ACTIVE;
 		reinit_completion(&vblkdev->req_queue_empty);
-		mutex_unlock(&vblkdev->req_lock);
+		WRITE_ONCE(vblkdev->queue_state, VBLK_QUEUE_ACTIVE);
 
 		enable_irq(vblkdev->ivck->irq);
 
@@ -1357,6 +2255,10 @@ static int __init tegra_hv_vblk_driver_init(void)
 		return -ENODEV;
 	}
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+	vblk_debugfs_root = debugfs_create_dir(DRV_NAME, NULL);
+#endif
+
 	return platform_driver_register(&tegra_hv_vblk_driver);
 }
 module_init(tegra_hv_vblk_driver_init);
@@ -1365,6 +2267,9 @@ static void __exit tegra_hv_vblk_driver_exit(void)
 {
 	unregister_blkdev(vblk_major, "vblk");
 	platform_driver_unregister(&tegra_hv_vblk_driver);
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 9, 0)
+	debugfs_remove_recursive(vblk_debugfs_root);
+#endif
 }
 module_exit(tegra_hv_vblk_driver_exit);
 
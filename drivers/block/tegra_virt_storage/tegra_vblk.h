@@ -25,6 +25,8 @@
 #include <linux/tegra-ivc.h>
 #include <linux/workqueue.h>
 #include <linux/mutex.h>
+#include <linux/atomic.h>
+#include <linux/dma-direction.h>
 #include <tegra_virt_storage_spec.h>
 
 #define DRV_NAME "tegra_hv_vblk"
@@ -43,6 +45,27 @@
 
 #define MAX_VSC_REQS 32
 
+/* Smallest request-slot partition handed to one blk-mq hardware queue */
+#define VBLK_MIN_HW_QUEUE_DEPTH 4
+
+/* Upper bound on ranges batched into one VS_BLK_DISCARD_RANGES request */
+#define VBLK_MAX_DISCARD_RANGES 256U
+
+/* log2(ns) latency buckets, the last one collects everything above */
+#define VBLK_LAT_BUCKETS 32
+
+enum vblk_lat_stage {
+	VBLK_LAT_SUBMIT,	/* queue_rq entry to IVC write */
+	VBLK_LAT_SEND,		/* IVC write and doorbell */
+	VBLK_LAT_SERVER,	/* IVC write to response read */
+	VBLK_LAT_COMPLETE,	/* response read to request end */
+	VBLK_LAT_NUM_STAGES,
+};
+
+struct vblk_lat_hist {
+	atomic64_t buckets[VBLK_LAT_NUM_STAGES][VBLK_LAT_BUCKETS];
+};
+
 struct vblk_ioctl_req {
 	uint32_t ioctl_id;
 	void *ioctl_buf;
@@ -50,12 +73,12 @@ struct vblk_ioctl_req {
 	int32_t status;
 };
 
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,9,0)
-struct req_entry {
-	struct list_head list_entry;
-	struct request *req;
+/* How the data of a read/write request reaches the server */
+enum vblk_xfer_mode {
+	VBLK_XFER_BOUNCE,	/* Copied through the mempool */
+	VBLK_XFER_IOVA,		/* Single contiguous IOVA range */
+	VBLK_XFER_SGL,		/* Per segment IOVA, bouncing unaligned ones */
 };
-#endif
 
 struct vsc_request {
 	struct vs_request vs_req;
@@ -70,6 +93,10 @@ struct vsc_request {
 	/* Scatter list for maping IOVA address */
 	struct scatterlist *sg_lst;
 	int sg_num_ents;
+	enum dma_data_direction sg_dir;
+	enum vblk_xfer_mode xfer_mode;
+	/* ktime_get_ns() just before the request was written to IVC */
+	u64 send_ns;
 };
 
 enum vblk_queue_state {
@@ -78,6 +105,31 @@ enum vblk_queue_state {
 	VBLK_QUEUE_ACTIVE,
 };
 
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5,9,0)
+/*
+ * Per blk-mq hardware queue context. Each hardware queue owns the
+ * vsc_request slots [slot_base, slot_base + hw_queue_depth) and the
+ * blk-mq driver tag of a request selects the slot within that range.
+ */
+struct vblk_hw_queue {
+	struct vblk_dev *vblkdev;
+	uint32_t index;
+	uint32_t slot_base;
+	atomic64_t dispatched;
+	atomic64_t busy;
+};
+
+struct vblk_bench_result {
+	uint32_t num_jobs;
+	uint32_t ios_per_job;
+	uint32_t block_size;
+	uint32_t errors;
+	uint64_t elapsed_ns;
+	uint64_t lat_total_ns;
+	uint64_t lat_max_ns;
+};
+#endif
+
 /*
 * The drvdata of virtual device.
 */
@@ -91,8 +143,19 @@ struct vblk_dev {
 	struct gendisk *gd;              /* The gendisk structure */
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(5,9,0)
 	struct blk_mq_tag_set tag_set;
-	struct list_head req_list;	/* List containing req */
+	uint32_t nr_hw_queues;		/* Including poll queues */
+	uint32_t nr_poll_queues;
+	uint32_t hw_queue_depth;
+	struct vblk_hw_queue hw_queues[MAX_VSC_REQS];
+	struct dentry *debugfs_dir;
+	struct mutex bench_lock;
+	struct vblk_bench_result bench;
+	atomic64_t polled;
 #endif
+	uint32_t max_discard_ranges;
+	atomic64_t discard_batches;
+	atomic64_t discard_ranges;
+	struct vblk_lat_hist lat;
 	uint32_t ivc_id;
 	uint32_t ivm_id;
 	struct tegra_hv_ivc_cookie *ivck;
@@ -108,10 +171,13 @@ struct vblk_dev {
 	spinlock_t queue_lock;
 	struct vsc_request reqs[MAX_VSC_REQS];
 	DECLARE_BITMAP(pending_reqs, MAX_VSC_REQS);
-	uint32_t inflight_reqs;
+	atomic_t inflight_reqs;
 	uint32_t max_requests;
-	struct mutex req_lock;
-	struct mutex ivc_lock;
+	enum vblk_xfer_mode xfer_mode;
+	atomic64_t copy_bytes;
+	atomic64_t zero_copy_bytes;
+	struct mutex ivc_lock;		/* IVC receive side and channel reset */
+	spinlock_t ivc_tx_lock;		/* IVC transmit side */
 	enum vblk_queue_state queue_state;
 	struct completion req_queue_empty;
 };
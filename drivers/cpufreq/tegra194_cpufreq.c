@@ -42,6 +42,9 @@
 #include <linux/version.h>
 #include <linux/pm_qos.h>
 #include <linux/workqueue.h>
+#include <linux/timer.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
 #include <linux/tegra-cpufreq.h>
 #include <soc/tegra/virt/syscalls.h>
 #include "tegra194-cpufreq.h"
@@ -57,6 +60,9 @@
 #define US_DELAY		500
 #define US_DELAY_MIN		2
 #define CPUFREQ_TBL_STEP_HZ	(50 * KHZ_TO_HZ * KHZ_TO_HZ)
+#define FREQ_SAMPLE_MS		20
+/* core clock counter wraps after ~2 sec, drop longer windows */
+#define FREQ_SAMPLE_MAX_MS	1000
 
 #define LOOP_FOR_EACH_CLUSTER(cl)	for (cl = 0; \
 					cl < MAX_CLUSTERS; cl++)
@@ -99,6 +105,34 @@ struct read_counters_work {
 	struct tegra_cpu_ctr c;
 };
 
+/*
+ * By default the frequency reported for a cpu is computed from counter
+ * snapshots taken on that cpu by a deferrable timer, so reading it neither
+ * wakes the cpu nor waits. precise_freq_feedback restores sampling the
+ * counters on demand over freq_compute_delay.
+ */
+static bool precise_freq_feedback;
+module_param(precise_freq_feedback, bool, 0644);
+MODULE_PARM_DESC(precise_freq_feedback,
+		 "Measure cpu frequency on every read instead of caching it");
+
+static uint freq_sample_ms = FREQ_SAMPLE_MS;
+module_param(freq_sample_ms, uint, 0644);
+MODULE_PARM_DESC(freq_sample_ms,
+		 "Cached cpu frequency sampling period in msec");
+
+/* per-cpu counter window behind the cached frequency */
+struct tegra_cpu_feedback {
+	struct timer_list timer;
+	uint32_t last_coreclk_cnt;
+	uint32_t last_refclk_cnt;
+	u64 last_ns;
+	unsigned int cur_khz;
+	bool valid;
+};
+
+static DEFINE_PER_CPU(struct tegra_cpu_feedback, cpu_feedback);
+
 static enum cluster get_cpu_cluster(uint8_t cpu)
 {
 	return MPIDR_AFFINITY_LEVEL(cpu_logical_map(cpu), 1);
@@ -228,9 +262,114 @@ err_out:
 	return (unsigned int) (rate_mhz * 1000); /* in KHz */
 }
 
+/*
+ * Close the current counter window of the local cpu and start a new one.
+ * With @update the frequency over the closed window becomes the cached
+ * value; windows long enough for the core counter to wrap are dropped.
+ * Called with interrupts disabled.
+ */
+static void tegra_sample_feedback(struct tegra_cpu_feedback *fb, bool update)
+{
+	uint64_t val = read_freq_feedback();
+	uint32_t refclk_cnt = (uint32_t)(val & 0xffffffff);
+	uint32_t coreclk_cnt = (uint32_t)(val >> 32);
+	uint32_t delta_ccnt, delta_refcnt;
+	u64 now = ktime_get_ns();
+
+	if (update && fb->valid &&
+	    now - fb->last_ns <= FREQ_SAMPLE_MAX_MS * NSEC_PER_MSEC) {
+		delta_ccnt = coreclk_cnt - fb->last_coreclk_cnt;
+		delta_refcnt = refclk_cnt - fb->last_refclk_cnt;
+		/* both counters stop while the core is power gated */
+		if (delta_ccnt && delta_refcnt)
+			WRITE_ONCE(fb->cur_khz, (unsigned int)
+				   ((u64)delta_ccnt * REF_CLK_MHZ * 1000 /
+				    delta_refcnt));
+	}
+
+	fb->last_coreclk_cnt = coreclk_cnt;
+	fb->last_refclk_cnt = refclk_cnt;
+	fb->last_ns = now;
+	fb->valid = true;
+}
+
+static unsigned long tegra_feedback_period(void)
+{
+	return msecs_to_jiffies(clamp_t(uint, freq_sample_ms, 1,
+					FREQ_SAMPLE_MAX_MS / 2));
+}
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 15, 0)
+static void tegra_feedback_timer_fn(unsigned long data)
+{
+	struct tegra_cpu_feedback *fb = (struct tegra_cpu_feedback *)data;
+#else /* LINUX_VERSION_CODE >= KERNEL_VERSION(4,15,0) */
+static void tegra_feedback_timer_fn(struct timer_list *t)
+{
+	struct tegra_cpu_feedback *fb = from_timer(fb, t, timer);
+#endif /* LINUX_VERSION_CODE < KERNEL_VERSION(4, 15, 0) */
+	unsigned long flags;
+
+	local_irq_save(flags);
+	tegra_sample_feedback(fb, true);
+	local_irq_restore(flags);
+
+	mod_timer(&fb->timer, jiffies + tegra_feedback_period());
+}
+
+static void tegra_feedback_init(void)
+{
+	struct tegra_cpu_feedback *fb;
+	uint32_t cpu;
+
+	for_each_possible_cpu(cpu) {
+		fb = &per_cpu(cpu_feedback, cpu);
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 15, 0)
+		__setup_timer(&fb->timer, tegra_feedback_timer_fn,
+			      (unsigned long)fb,
+			      TIMER_DEFERRABLE | TIMER_PINNED);
+#else /* LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0) */
+		timer_setup(&fb->timer, tegra_feedback_timer_fn,
+			    TIMER_DEFERRABLE | TIMER_PINNED);
+#endif /* LINUX_VERSION_CODE < KERNEL_VERSION(4, 15, 0) */
+	}
+}
+
+static void tegra_feedback_start(uint32_t cpu)
+{
+	struct tegra_cpu_feedback *fb = &per_cpu(cpu_feedback, cpu);
+
+	if (timer_pending(&fb->timer))
+		return;
+
+	fb->valid = false;
+	fb->timer.expires = jiffies + tegra_feedback_period();
+	add_timer_on(&fb->timer, cpu);
+}
+
+static void tegra_feedback_stop(uint32_t cpu)
+{
+	struct tegra_cpu_feedback *fb = &per_cpu(cpu_feedback, cpu);
+
+	del_timer_sync(&fb->timer);
+	fb->valid = false;
+	WRITE_ONCE(fb->cur_khz, 0);
+}
+
 static unsigned int tegra194_get_speed(uint32_t cpu)
 {
-	return tegra194_get_speed_common(cpu, tfreq_data.freq_compute_delay);
+	unsigned int rate_khz;
+
+	if (precise_freq_feedback)
+		return tegra194_get_speed_common(cpu,
+						 tfreq_data.freq_compute_delay);
+
+	/* fall back to a short measurement until the first sample */
+	rate_khz = READ_ONCE(per_cpu(cpu_feedback, cpu).cur_khz);
+	if (!rate_khz)
+		rate_khz = tegra194_get_speed_common(cpu, US_DELAY_MIN);
+
+	return rate_khz;
 }
 
 static unsigned int tegra194_fast_get_speed(uint32_t cpu)
@@ -269,6 +408,9 @@ static void write_ndiv_request(void *val)
 	} else {
 		asm volatile("msr s3_0_c15_c0_4, %0" : : "r" (regval));
 	}
+
+	/* restart the cached feedback window at the new frequency */
+	tegra_sample_feedback(this_cpu_ptr(&cpu_feedback), false);
 }
 
 #ifdef CONFIG_DEBUG_FS
@@ -856,6 +998,8 @@ static int tegra194_cpufreq_online(unsigned int cpu)
 			&& tgt_freq != CPUFREQ_TABLE_END)
 		tegra_update_cpu_speed(tgt_freq, cpu);
 
+	tegra_feedback_start(cpu);
+
 	return 0;
 }
 
@@ -864,6 +1008,8 @@ static int tegra194_cpufreq_offline(unsigned int cpu)
 	struct cpufreq_frequency_table *ftbl;
 	uint32_t tgt_freq;
 
+	tegra_feedback_stop(cpu);
+
 	ftbl = get_freqtable(cpu);
 
 	tgt_freq = ftbl[0].frequency;
@@ -1125,6 +1271,7 @@ static int __init tegra194_cpufreq_probe(struct platform_device *pdev)
 	mutex_init(&tfreq_data.mlock);
 	tfreq_data.freq_compute_delay = US_DELAY;
 	tegra_hypervisor_mode = is_tegra_hypervisor_mode();
+	tegra_feedback_init();
 
 	for_each_possible_cpu(cpu) {
 		cl = get_cpu_cluster(cpu);
@@ -1184,6 +1331,11 @@ static int __init tegra194_cpufreq_probe(struct platform_device *pdev)
 	hp_online = ret;
 	ret = 0;
 
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		tegra_feedback_start(cpu);
+	put_online_cpus();
+
 	pm_qos_register_notifier();
 
 	cpufreq_register_notifier(&tegra_boundaries_cpufreq_nb,
@@ -1199,6 +1351,8 @@ err_out:
 
 static int __exit tegra194_cpufreq_remove(struct platform_device *pdev)
 {
+	uint32_t cpu;
+
 	cpufreq_unregister_notifier(&tegra_boundaries_cpufreq_nb,
 					CPUFREQ_POLICY_NOTIFIER);
 
@@ -1206,6 +1360,11 @@ static int __exit tegra194_cpufreq_remove(struct platform_device *pdev)
 	tegra_cpufreq_debug_exit();
 #endif
 	cpuhp_remove_state_nocalls(hp_online);
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		tegra_feedback_stop(cpu);
+	put_online_cpus();
 	cpufreq_unregister_driver(&tegra_cpufreq_driver);
 	free_allocated_res_exit();
 	return 0;
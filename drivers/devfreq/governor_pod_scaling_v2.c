@@ -32,6 +32,7 @@
 #include <linux/slab.h>
 #include <linux/clk/tegra.h>
 #include <linux/module.h>
+#include <linux/math64.h>
 #include <linux/version.h>
 #define CREATE_TRACE_POINTS
 #include <trace/events/nvhost_podgov.h>
@@ -47,6 +48,9 @@
 
 #define GET_TARGET_FREQ_DONTSCALE	1
 
+/* load (in 1/1000) above which the real demand cannot be observed */
+#define PODGOV_SATURATED_LOAD		990
+
 #ifdef CONFIG_DEVFREQ_GOV_POD_SCALING_HISTORY_BUFFER_SIZE_MAX
 #define MAX_HISTORY_BUF_SIZE		\
 	CONFIG_DEVFREQ_GOV_POD_SCALING_HISTORY_BUFFER_SIZE_MAX
@@ -88,6 +92,16 @@ struct podgov_info_rec {
 	int			history_count;
 	unsigned long		recent_high;
 
+	/*
+	 * Monotonic deque of cycles_history_buf slots with decreasing
+	 * cycle counts; the head is the peak of the window.
+	 */
+	int			*peak_buf;
+	int			peak_head;
+	int			peak_count;
+
+	unsigned int		p_burst;
+
 	unsigned long		rt_load;
 
 	int			adjustment_type;
@@ -354,6 +368,44 @@ static void podgov_set_freq_request(struct devfreq *df, int freq_request)
  * clock immediately, 0 is returned.
  ******************************************************************************/
 
+/*******************************************************************************
+ * freq = scaling_burst_check(df)
+ *
+ * In burst mode an overloaded device is moved straight to the frequency at
+ * which the peak of the history window would run at the target load, or to
+ * the maximum if the load is saturated and the demand cannot be observed.
+ * Returns 0 if this is not above the current frequency.
+ ******************************************************************************/
+
+static unsigned long scaling_burst_check(struct devfreq *df)
+{
+	struct podgov_info_rec *pg = df->data;
+	unsigned long peak = pg->cycles_norm;
+	unsigned long res;
+
+	if (!pg->p_burst || pg->rt_load <= pg->p_load_max)
+		return 0;
+
+	if (pg->p_history_buf_size && pg->history_count)
+		peak = max(peak, pg->recent_high);
+
+	if (pg->rt_load >= PODGOV_SATURATED_LOAD)
+		res = ULONG_MAX;
+	else
+		res = div_u64((u64)peak * 1000, pg->p_load_target);
+
+	scaling_limit(df, &res);
+	if (res <= df->previous_freq)
+		return 0;
+
+	/* restart smoothing from the new level */
+	pg->freq_avg = res / 1000000;
+
+	trace_podgov_scaling_state_check(df->dev.parent,
+					 df->previous_freq, res);
+	return res;
+}
+
 static unsigned long scaling_state_check(struct devfreq *df, ktime_t time)
 {
 	struct podgov_info_rec *pg = df->data;
@@ -362,8 +414,16 @@ static unsigned long scaling_state_check(struct devfreq *df, ktime_t time)
 	long max_boost, damp, freq, boost, res;
 	unsigned long max_freq_hz = 0;
 
+	if (df->previous_freq == 0)
+		return 0;
+
+	/* bursts are not held back by the block window */
+	res = scaling_burst_check(df);
+	if (res)
+		return res;
+
 	dt = (unsigned long) ktime_us_delta(time, pg->last_scale);
-	if (dt < pg->p_block_window || df->previous_freq == 0)
+	if (dt < pg->p_block_window)
 		return 0;
 
 	/* convert to mhz to avoid overflow */
@@ -470,6 +530,7 @@ static void nvhost_scale_emc_debug_init(struct devfreq *df)
 	CREATE_PODGOV_FILE(bias);
 	CREATE_PODGOV_FILE(damp);
 	CREATE_PODGOV_FILE(smooth);
+	CREATE_PODGOV_FILE(burst);
 #undef CREATE_PODGOV_FILE
 }
 
@@ -591,6 +652,46 @@ static ssize_t freq_request_store(struct kobject *kobj,
 	return count;
 }
 
+/*******************************************************************************
+ * podgov_history_push(pg, cycles)
+ *
+ * Add a sample to the history window and update recent_high, the highest
+ * normalized cycle count in the window, in amortized constant time.
+ ******************************************************************************/
+
+static void podgov_history_push(struct podgov_info_rec *pg,
+				unsigned long cycles)
+{
+	int size = pg->p_history_buf_size;
+	int slot = pg->history_next;
+	int tail;
+
+	/* the sample leaving the window can only be the peak */
+	if (pg->history_count == size && pg->peak_count &&
+	    pg->peak_buf[pg->peak_head] == slot) {
+		pg->peak_head = (pg->peak_head + 1) % size;
+		pg->peak_count--;
+	}
+
+	pg->cycles_history_buf[slot] = cycles;
+
+	/* older samples not above the new one can never be the peak again */
+	while (pg->peak_count) {
+		tail = (pg->peak_head + pg->peak_count - 1) % size;
+		if (pg->cycles_history_buf[pg->peak_buf[tail]] > cycles)
+			break;
+		pg->peak_count--;
+	}
+	tail = (pg->peak_head + pg->peak_count) % size;
+	pg->peak_buf[tail] = slot;
+	pg->peak_count++;
+
+	pg->history_next = (slot + 1) % size;
+	if (pg->history_count < size)
+		pg->history_count++;
+	pg->recent_high = pg->cycles_history_buf[pg->peak_buf[pg->peak_head]];
+}
+
 /*******************************************************************************
  * nvhost_pod_estimate_freq(df, freq)
  *
@@ -611,10 +712,6 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 	struct podgov_info_rec *pg = df->data;
 	struct devfreq_dev_status *ds;
 	int err, i;
-	int buf_size = pg->p_history_buf_size;
-	int buf_next = pg->history_next;
-	int buf_count = pg->history_count;
-	unsigned long *cycles_buffer = pg->cycles_history_buf;
 	ktime_t now;
 	unsigned long long norm_load;
 
@@ -630,6 +727,8 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 		pg->history_count = 0;
 		pg->history_next = 0;
 		pg->recent_high = 0;
+		pg->peak_head = 0;
+		pg->peak_count = 0;
 		pg->freq_avg = 0;
 		return 0;
 	}
@@ -687,22 +786,8 @@ static int nvhost_pod_estimate_freq(struct devfreq *df,
 	pg->rt_load = 1000ULL * ds->busy_time / ds->total_time;
 
 	/* Update history of normalized cycle counts and recent highest count */
-	if (buf_size) {
-		if (buf_count == buf_size) {
-			pg->recent_high = 0;
-			i = (buf_next + 1) % buf_size;
-			for (; i != buf_next; i = (i + 1) % buf_size) {
-				if (cycles_buffer[i] > pg->recent_high)
-					pg->recent_high = cycles_buffer[i];
-			}
-		}
-		cycles_buffer[buf_next] = norm_load;
-		pg->history_next = (buf_next + 1) % buf_size;
-		if (buf_count < buf_size)
-			pg->history_count += 1;
-		if (norm_load > pg->recent_high)
-			pg->recent_high = norm_load;
-	}
+	if (pg->p_history_buf_size)
+		podgov_history_push(pg, norm_load);
 
 	*freq = scaling_state_check(df, now);
 
@@ -746,11 +831,18 @@ static int nvhost_pod_init(struct devfreq *df)
 	if (!podgov->cycles_history_buf)
 		goto err_alloc_history_buffer;
 
+	podgov->peak_buf = kzalloc(sizeof(int) * MAX_HISTORY_BUF_SIZE,
+				   GFP_KERNEL);
+	if (!podgov->peak_buf)
+		goto err_alloc_peak_buffer;
+
 	podgov->p_history_buf_size =
 		MAX_HISTORY_BUF_SIZE < 100 ? MAX_HISTORY_BUF_SIZE : 100;
 	podgov->history_count = 0;
 	podgov->history_next = 0;
 	podgov->recent_high = 0;
+	podgov->peak_head = 0;
+	podgov->peak_count = 0;
 
 	df->data = (void *)podgov;
 
@@ -764,6 +856,7 @@ static int nvhost_pod_init(struct devfreq *df)
 	podgov->p_smooth = 10;
 	podgov->p_damp = 7;
 	podgov->p_block_window = 50000;
+	podgov->p_burst = 0;
 
 	podgov->adjustment_type = ADJUSTMENT_DEVICE_REQ;
 	podgov->p_user = 0;
@@ -828,6 +921,8 @@ err_create_request_sysfs_entry:
 			  &podgov->enable_3d_scaling_attr.attr);
 err_create_enable_sysfs_entry:
 	dev_err(&d->dev, "failed to create sysfs attributes");
+	kfree(podgov->peak_buf);
+err_alloc_peak_buffer:
 	kfree(podgov->cycles_history_buf);
 err_alloc_history_buffer:
 	kfree(podgov);
@@ -854,6 +949,7 @@ static void nvhost_pod_exit(struct devfreq *df)
 			  &podgov->enable_3d_scaling_attr.attr);
 
 	nvhost_scale_emc_debug_deinit(df);
+	kfree(podgov->peak_buf);
 	kfree(podgov->cycles_history_buf);
 	kfree(podgov);
 }
@@ -21,6 +21,8 @@
 #include <linux/errno.h>
 #include <linux/kernel.h>
 #include <linux/init.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
@@ -47,6 +49,7 @@
 #include "vivid-vbi-out.h"
 #include "vivid-osd.h"
 #include "vivid-ctrls.h"
+#include "vivid-kthread-cap.h"
 
 #define VIVID_MODULE_NAME "tegra-vivid"
 
@@ -156,6 +159,22 @@ static bool no_error_inj;
 module_param(no_error_inj, bool, 0444);
 MODULE_PARM_DESC(no_error_inj, " if set disable the error injecting controls");
 
+static unsigned fill_threads[VIVID_MAX_DEVS] = { [0 ... (VIVID_MAX_DEVS - 1)] = 1 };
+module_param_array(fill_threads, uint, NULL, 0444);
+MODULE_PARM_DESC(fill_threads, " number of threads filling each capture frame in stripes,\n"
+			      "\t\t    default is 1, maximum is 8");
+
+static bool hrtimer_pacing[VIVID_MAX_DEVS];
+module_param_array(hrtimer_pacing, bool, NULL, 0444);
+MODULE_PARM_DESC(hrtimer_pacing, " pace video capture frames with an hrtimer at their nominal\n"
+				"\t\t    time instead of with jiffies, default is 0. Delivery statistics\n"
+				"\t\t    are in <debugfs>/<dev>/pace_stats");
+
+static unsigned tpg_bench;
+module_param(tpg_bench, uint, 0444);
+MODULE_PARM_DESC(tpg_bench, " if non-zero, time this many 4K frames per format at probe\n"
+			   "\t\t    and log the test pattern generator frame rate");
+
 static struct vivid_dev *vivid_devs[VIVID_MAX_DEVS];
 
 const struct v4l2_rect vivid_min_rect = {
@@ -643,6 +662,7 @@ static void vivid_dev_release(struct v4l2_device *v4l2_dev)
 
 	vivid_free_controls(dev);
 	v4l2_device_unregister(&dev->v4l2_dev);
+	vivid_fill_pool_free(dev);
 	vfree(dev->scaled_line);
 	vfree(dev->blended_line);
 	vfree(dev->edid);
@@ -885,6 +905,10 @@ static int vivid_create_instance(struct platform_device *pdev, int inst)
 	dev->blended_line = vzalloc(MAX_ZOOM * MAX_WIDTH);
 	if (!dev->blended_line)
 		goto free_dev;
+	dev->pace_hrtimer = hrtimer_pacing[inst];
+	ret = vivid_fill_pool_init(dev, fill_threads[inst]);
+	if (ret)
+		goto free_dev;
 
 	/* load the edid */
 	dev->edid = vmalloc(256 * 128);
@@ -1320,6 +1344,8 @@ static int vivid_create_instance(struct platform_device *pdev, int inst)
 					  video_device_node_name(vfd));
 	}
 
+	vivid_fill_debugfs_init(dev);
+
 	/* Now that everything is fine, let's add it to device list */
 	vivid_devs[inst] = dev;
 
@@ -1338,6 +1364,75 @@ free_dev:
 	return ret;
 }
 
+#define VIVID_TPG_BENCH_WIDTH	3840
+#define VIVID_TPG_BENCH_HEIGHT	2160
+
+/*
+ * Time the pattern generator on its own, without any vb2 or kthread
+ * overhead, so generator changes can be compared frame rate for frame
+ * rate. With NEON available each format is timed with and without it.
+ */
+static void vivid_tpg_benchmark(unsigned frames)
+{
+	static const u32 fourccs[] = {
+		V4L2_PIX_FMT_YUYV,
+		V4L2_PIX_FMT_NV12,
+		V4L2_PIX_FMT_RGB24,
+		V4L2_PIX_FMT_XRGB32,
+	};
+	const unsigned w = VIVID_TPG_BENCH_WIDTH;
+	const unsigned h = VIVID_TPG_BENCH_HEIGHT;
+#ifdef TPG_HAVE_NEON
+	const unsigned simd_modes = 2;
+#else
+	const unsigned simd_modes = 1;
+#endif
+	struct tpg_data *tpg;
+	unsigned simd;
+	unsigned i, f;
+	u8 *vbuf;
+
+	tpg = kzalloc(sizeof(*tpg), GFP_KERNEL);
+	vbuf = vmalloc(w * h * 4);
+	if (!tpg || !vbuf)
+		goto free;
+
+	tpg_init(tpg, w, h);
+	if (tpg_alloc(tpg, w))
+		goto free_tpg;
+
+	for (i = 0; i < ARRAY_SIZE(fourccs); i++) {
+		for (simd = 0; simd < simd_modes; simd++) {
+			u32 fourcc = fourccs[i];
+			ktime_t start;
+			u64 ns, fps;
+
+			tpg_s_fourcc(tpg, fourcc, 0);
+			tpg_reset_source(tpg, w, h, V4L2_FIELD_NONE);
+			tpg_s_simd(tpg, simd);
+			/* first frame pays for the colour and line precalc */
+			tpg_fillbuffer(tpg, 0, 0, vbuf);
+
+			start = ktime_get();
+			for (f = 0; f < frames; f++)
+				tpg_fillbuffer(tpg, 0, 0, vbuf);
+			ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+			fps = div64_u64((u64)frames * NSEC_PER_SEC * 100,
+					max_t(u64, ns, 1));
+			pr_info("vivid: tpg %.4s %ux%u%s: %llu.%02llu fps\n",
+				(char *)&fourcc, w, h, simd ? " neon" : "",
+				fps / 100, fps % 100);
+		}
+	}
+
+free_tpg:
+	tpg_free(tpg);
+free:
+	vfree(vbuf);
+	kfree(tpg);
+}
+
 /* This routine allocates from 1 to n_devs virtual drivers.
 
    The real maximum number of virtual drivers will depend on how many drivers
@@ -1356,6 +1451,9 @@ static int vivid_probe(struct platform_device *pdev)
 
 	tpg_set_font(font->data);
 
+	if (tpg_bench)
+		vivid_tpg_benchmark(tpg_bench);
+
 	n_devs = clamp_t(unsigned, n_devs, 1, VIVID_MAX_DEVS);
 
 	for (i = 0; i < n_devs; i++) {
@@ -1431,6 +1529,7 @@ static int vivid_remove(struct platform_device *pdev)
 			unregister_framebuffer(&dev->fb_info);
 			vivid_fb_release_buffers(dev);
 		}
+		debugfs_remove_recursive(dev->debugfs_dir);
 		v4l2_device_put(&dev->v4l2_dev);
 		vivid_devs[i] = NULL;
 	}
@@ -21,6 +21,7 @@
 #define _VIVID_CORE_H_
 
 #include <linux/fb.h>
+#include <linux/workqueue.h>
 #include <linux/version.h>
 #include <media/videobuf2-v4l2.h>
 #include <media/v4l2-device.h>
@@ -77,6 +78,7 @@
 /* used by the threads to know when to resync internal counters */
 #define JIFFIES_PER_DAY (3600U * 24U * HZ)
 #define JIFFIES_RESYNC (JIFFIES_PER_DAY * (0xf0000000U / JIFFIES_PER_DAY))
+#define KTIME_RESYNC_NS (3600ULL * 24ULL * NSEC_PER_SEC)
 
 extern const struct v4l2_rect vivid_min_rect;
 extern const struct v4l2_rect vivid_max_rect;
@@ -140,6 +142,49 @@ enum vivid_colorspace {
 #define VIVID_INVALID_SIGNAL(mode) \
 	((mode) == NO_SIGNAL || (mode) == NO_LOCK || (mode) == OUT_OF_RANGE)
 
+/* The maximum number of threads filling one capture frame */
+#define VIVID_MAX_FILL_THREADS 8
+/* Don't split a plane into stripes of fewer lines than this */
+#define VIVID_FILL_MIN_ROWS 64
+
+enum vivid_fill_stage {
+	VIVID_FILL_PATTERN,
+	VIVID_FILL_LOOP,
+	VIVID_FILL_TEXT,
+	VIVID_FILL_OVERLAY,
+	VIVID_FILL_TOTAL,
+	VIVID_FILL_STAGES,
+};
+
+struct vivid_fill_time {
+	u64				count;
+	u64				total_ns;
+	u64				max_ns;
+};
+
+/* log2 buckets of the delivery delay in microseconds, the last one is open */
+#define VIVID_PACE_BUCKETS 16
+
+/* capture pacing statistics, reset at the start of every stream */
+struct vivid_pace_stats {
+	u64				generated;
+	u64				dropped;
+	u64				late;
+	u64				total_ns;
+	u64				max_ns;
+	u64				hist[VIVID_PACE_BUCKETS];
+};
+
+struct vivid_fill_job;
+
+/* one stripe worker of the frame fill pool, index 0 is the capture thread */
+struct vivid_fill_stripe {
+	struct work_struct		work;
+	struct vivid_fill_job		*job;
+	unsigned			index;
+	u8				*scaled_line;
+};
+
 struct vivid_dev {
 	unsigned			inst;
 	struct v4l2_device		v4l2_dev;
@@ -361,7 +406,6 @@ struct vivid_dev {
 	bool				dvi_d_out;
 	u8				*scaled_line;
 	u8				*blended_line;
-	unsigned			cur_scaled_line;
 
 	/* Output Overlay */
 	void				*fb_vbase_out;
@@ -395,6 +439,18 @@ struct vivid_dev {
 
 	/* thread for generating video capture stream */
 	struct task_struct		*kthread_vid_cap;
+	/* pool splitting each frame fill into horizontal stripes */
+	unsigned			fill_threads;
+	struct workqueue_struct		*fill_wq;
+	struct vivid_fill_stripe	fill_stripes[VIVID_MAX_FILL_THREADS];
+	struct vivid_fill_time		fill_time[VIVID_FILL_STAGES];
+	struct dentry			*debugfs_dir;
+	/* pace the capture thread with an hrtimer instead of jiffies */
+	bool				pace_hrtimer;
+	struct vivid_pace_stats		pace_stats;
+	u64				ktime_vid_cap;
+	u64				cap_frame_ns;
+	u64				cap_frame_period_ns;
 	unsigned long			jiffies_vid_cap;
 	unsigned long			next_jiffies_vid_cap;
 	u32				cap_seq_offset;
@@ -28,6 +28,12 @@
 #include <linux/videodev2.h>
 #include <linux/kthread.h>
 #include <linux/freezer.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+#include <linux/hrtimer.h>
+#include <linux/math64.h>
 #include <linux/random.h>
 #include <linux/v4l2-dv-timings.h>
 #include <asm/div64.h>
@@ -252,10 +258,44 @@ static void *plane_vaddr(struct tpg_data *tpg, struct vivid_buffer *buf,
 	return vbuf;
 }
 
+/*
+ * Everything vivid_copy_lines() needs to render any range of capture
+ * lines of a looped plane. Filled in once per plane by vivid_copy_buffer().
+ */
+struct vivid_copy_ctx {
+	unsigned p;
+	u8 *vcapbuf;
+	u8 *voutbuf;
+	u8 *vosdbuf;
+	unsigned vdiv;
+	unsigned twopixsize;
+	unsigned img_width;
+	unsigned img_height;
+	unsigned stride_cap;
+	unsigned stride_out;
+	unsigned stride_osd;
+	unsigned hmax;
+	bool blank;
+	bool blend;
+	/* quick is true if no video scaling is needed */
+	bool quick;
+	/* Coarse scaling with Bresenham */
+	unsigned vid_out_int_part;
+	unsigned vid_out_fract_part;
+	unsigned vid_overlay_int_part;
+	unsigned vid_overlay_fract_part;
+	unsigned vid_cap_left;
+	unsigned vid_cap_right;
+};
+
+/*
+ * Set up the copy of plane p from the video output buffer. Returns
+ * -ENODATA if there is no output buffer, 0 if the plane is complete and
+ * 1 if the lines still have to be rendered with vivid_copy_lines().
+ */
 static int vivid_copy_buffer(struct vivid_dev *dev, unsigned p, u8 *vcapbuf,
-		struct vivid_buffer *vid_cap_buf)
+		struct vivid_buffer *vid_cap_buf, struct vivid_copy_ctx *ctx)
 {
-	bool blank = dev->must_blank[vid_cap_buf->vb.vb2_buf.index];
 	struct tpg_data *tpg = &dev->tpg;
 	struct vivid_buffer *vid_out_buf = NULL;
 	unsigned vdiv = dev->fmt_out->vdownsampling[p];
@@ -264,27 +304,9 @@ static int vivid_copy_buffer(struct vivid_dev *dev, unsigned p, u8 *vcapbuf,
 	unsigned img_height = dev->compose_cap.height;
 	unsigned stride_cap = tpg->bytesperline[p];
 	unsigned stride_out = dev->bytesperline_out[p];
-	unsigned stride_osd = dev->display_byte_stride;
 	unsigned hmax = (img_height * tpg->perc_fill) / 100;
 	u8 *voutbuf;
-	u8 *vosdbuf = NULL;
 	unsigned y;
-	bool blend = dev->bitmap_out || dev->clipcount_out || dev->fbuf_out_flags;
-	/* Coarse scaling with Bresenham */
-	unsigned vid_out_int_part;
-	unsigned vid_out_fract_part;
-	unsigned vid_out_y = 0;
-	unsigned vid_out_error = 0;
-	unsigned vid_overlay_int_part = 0;
-	unsigned vid_overlay_fract_part = 0;
-	unsigned vid_overlay_y = 0;
-	unsigned vid_overlay_error = 0;
-	unsigned vid_cap_left = tpg_hdiv(tpg, p, dev->loop_vid_cap.left);
-	unsigned vid_cap_right;
-	bool quick;
-
-	vid_out_int_part = dev->loop_vid_out.height / dev->loop_vid_cap.height;
-	vid_out_fract_part = dev->loop_vid_out.height % dev->loop_vid_cap.height;
 
 	if (!list_empty(&dev->vid_out_active))
 		vid_out_buf = list_entry(dev->vid_out_active.next,
@@ -329,26 +351,86 @@ static int vivid_copy_buffer(struct vivid_dev *dev, unsigned p, u8 *vcapbuf,
 		return 0;
 	}
 
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->p = p;
+	ctx->vcapbuf = vcapbuf;
+	ctx->voutbuf = voutbuf;
+	ctx->vdiv = vdiv;
+	ctx->twopixsize = twopixsize;
+	ctx->img_width = img_width;
+	ctx->img_height = img_height;
+	ctx->stride_cap = stride_cap;
+	ctx->stride_out = stride_out;
+	ctx->stride_osd = dev->display_byte_stride;
+	ctx->hmax = hmax;
+	ctx->blank = dev->must_blank[vid_cap_buf->vb.vb2_buf.index];
+	ctx->blend = dev->bitmap_out || dev->clipcount_out || dev->fbuf_out_flags;
+	ctx->vid_out_int_part = dev->loop_vid_out.height / dev->loop_vid_cap.height;
+	ctx->vid_out_fract_part = dev->loop_vid_out.height % dev->loop_vid_cap.height;
+
 	if (dev->overlay_out_enabled &&
 	    dev->loop_vid_overlay.width && dev->loop_vid_overlay.height) {
-		vosdbuf = dev->video_vbase;
-		vosdbuf += (dev->loop_fb_copy.left * twopixsize) / 2 +
-			   dev->loop_fb_copy.top * stride_osd;
-		vid_overlay_int_part = dev->loop_vid_overlay.height /
+		ctx->vosdbuf = dev->video_vbase;
+		ctx->vosdbuf += (dev->loop_fb_copy.left * twopixsize) / 2 +
+			   dev->loop_fb_copy.top * ctx->stride_osd;
+		ctx->vid_overlay_int_part = dev->loop_vid_overlay.height /
 				       dev->loop_vid_overlay_cap.height;
-		vid_overlay_fract_part = dev->loop_vid_overlay.height %
+		ctx->vid_overlay_fract_part = dev->loop_vid_overlay.height %
 					 dev->loop_vid_overlay_cap.height;
 	}
 
-	vid_cap_right = tpg_hdiv(tpg, p, dev->loop_vid_cap.left + dev->loop_vid_cap.width);
-	/* quick is true if no video scaling is needed */
-	quick = dev->loop_vid_out.width == dev->loop_vid_cap.width;
+	ctx->vid_cap_left = tpg_hdiv(tpg, p, dev->loop_vid_cap.left);
+	ctx->vid_cap_right = tpg_hdiv(tpg, p, dev->loop_vid_cap.left + dev->loop_vid_cap.width);
+	ctx->quick = dev->loop_vid_out.width == dev->loop_vid_cap.width;
+	return 1;
+}
+
+static inline unsigned vivid_copy_rows(const struct vivid_copy_ctx *ctx)
+{
+	return DIV_ROUND_UP(ctx->img_height, ctx->vdiv);
+}
+
+/*
+ * Render capture rows [row_start, row_end) of a looped plane. Each call
+ * replays the Bresenham state up to row_start and uses its own
+ * scaled_line, so disjoint row ranges can be rendered concurrently as
+ * long as no output overlay has to be blended (blended_line is shared).
+ */
+static void vivid_copy_lines(struct vivid_dev *dev,
+		const struct vivid_copy_ctx *ctx,
+		unsigned row_start, unsigned row_end, u8 *scaled_line)
+{
+	struct tpg_data *tpg = &dev->tpg;
+	unsigned p = ctx->p;
+	unsigned vdiv = ctx->vdiv;
+	unsigned twopixsize = ctx->twopixsize;
+	unsigned img_width = ctx->img_width;
+	unsigned stride_cap = ctx->stride_cap;
+	unsigned stride_out = ctx->stride_out;
+	unsigned stride_osd = ctx->stride_osd;
+	unsigned vid_cap_left = ctx->vid_cap_left;
+	unsigned vid_cap_right = ctx->vid_cap_right;
+	unsigned cur_scaled_line = dev->loop_vid_out.height;
+	unsigned vid_out_y = 0;
+	unsigned vid_out_error = 0;
+	unsigned vid_overlay_y = 0;
+	unsigned vid_overlay_error = 0;
+	u8 *vcapbuf;
+	unsigned y;
 
-	dev->cur_scaled_line = dev->loop_vid_out.height;
-	for (y = 0; y < hmax; y += vdiv, vcapbuf += stride_cap) {
+	for (y = 0; y < row_end * vdiv; y += vdiv) {
 		/* osdline is true if this line requires overlay blending */
-		bool osdline = vosdbuf && y >= dev->loop_vid_overlay_cap.top &&
+		bool osdline = ctx->vosdbuf && y >= dev->loop_vid_overlay_cap.top &&
 			  y < dev->loop_vid_overlay_cap.top + dev->loop_vid_overlay_cap.height;
+		bool render = y >= row_start * vdiv;
+
+		vcapbuf = ctx->vcapbuf + (y / vdiv) * stride_cap;
+
+		if (y >= ctx->hmax) {
+			if (render && ctx->blank)
+				memcpy(vcapbuf, tpg->contrast_line[p], img_width);
+			continue;
+		}
 
 		/*
 		 * If this line of the capture buffer doesn't get any video, then
@@ -356,10 +438,14 @@ static int vivid_copy_buffer(struct vivid_dev *dev, unsigned p, u8 *vcapbuf,
 		 */
 		if (y < dev->loop_vid_cap.top ||
 		    y >= dev->loop_vid_cap.top + dev->loop_vid_cap.height) {
-			memcpy(vcapbuf, tpg->black_line[p], img_width);
+			if (render)
+				memcpy(vcapbuf, tpg->black_line[p], img_width);
 			continue;
 		}
 
+		if (!render)
+			goto update_vid_out_y;
+
 		/* fill the left border with black */
 		if (dev->loop_vid_cap.left)
 			memcpy(vcapbuf, tpg->black_line[p], vid_cap_left);
@@ -369,19 +455,19 @@ static int vivid_copy_buffer(struct vivid_dev *dev, unsigned p, u8 *vcapbuf,
 			memcpy(vcapbuf + vid_cap_right, tpg->black_line[p],
 				img_width - vid_cap_right);
 
-		if (quick && !osdline) {
+		if (ctx->quick && !osdline) {
 			memcpy(vcapbuf + vid_cap_left,
-			       voutbuf + vid_out_y * stride_out,
+			       ctx->voutbuf + vid_out_y * stride_out,
 			       tpg_hdiv(tpg, p, dev->loop_vid_cap.width));
 			goto update_vid_out_y;
 		}
-		if (dev->cur_scaled_line == vid_out_y) {
-			memcpy(vcapbuf + vid_cap_left, dev->scaled_line,
+		if (cur_scaled_line == vid_out_y) {
+			memcpy(vcapbuf + vid_cap_left, scaled_line,
 			       tpg_hdiv(tpg, p, dev->loop_vid_cap.width));
 			goto update_vid_out_y;
 		}
 		if (!osdline) {
-			scale_line(voutbuf + vid_out_y * stride_out, dev->scaled_line,
+			scale_line(ctx->voutbuf + vid_out_y * stride_out, scaled_line,
 				tpg_hdiv(tpg, p, dev->loop_vid_out.width),
 				tpg_hdiv(tpg, p, dev->loop_vid_cap.width),
 				tpg_g_twopixelsize(tpg, p), tpg_g_packedpixels(tpg, p));
@@ -393,12 +479,12 @@ static int vivid_copy_buffer(struct vivid_dev *dev, unsigned p, u8 *vcapbuf,
 			unsigned offset =
 				((dev->loop_vid_overlay.left - dev->loop_vid_copy.left) *
 				 twopixsize) / 2;
-			u8 *osd = vosdbuf + vid_overlay_y * stride_osd;
+			u8 *osd = ctx->vosdbuf + vid_overlay_y * stride_osd;
 
-			scale_line(voutbuf + vid_out_y * stride_out, dev->blended_line,
+			scale_line(ctx->voutbuf + vid_out_y * stride_out, dev->blended_line,
 				dev->loop_vid_out.width, dev->loop_vid_copy.width,
 				tpg_g_twopixelsize(tpg, p), tpg_g_packedpixels(tpg, p));
-			if (blend)
+			if (ctx->blend)
 				blend_line(dev, vid_overlay_y + dev->loop_vid_overlay.top,
 					   dev->loop_vid_overlay.left,
 					   dev->blended_line + offset, osd,
@@ -406,39 +492,154 @@ static int vivid_copy_buffer(struct vivid_dev *dev, unsigned p, u8 *vcapbuf,
 			else
 				memcpy(dev->blended_line + offset,
 				       osd, (dev->loop_vid_overlay.width * twopixsize) / 2);
-			scale_line(dev->blended_line, dev->scaled_line,
+			scale_line(dev->blended_line, scaled_line,
 					dev->loop_vid_copy.width, dev->loop_vid_cap.width,
 					tpg_g_twopixelsize(tpg, p), tpg_g_packedpixels(tpg, p));
 		}
-		dev->cur_scaled_line = vid_out_y;
-		memcpy(vcapbuf + vid_cap_left, dev->scaled_line,
+		cur_scaled_line = vid_out_y;
+		memcpy(vcapbuf + vid_cap_left, scaled_line,
 		       tpg_hdiv(tpg, p, dev->loop_vid_cap.width));
 
 update_vid_out_y:
 		if (osdline) {
-			vid_overlay_y += vid_overlay_int_part;
-			vid_overlay_error += vid_overlay_fract_part;
+			vid_overlay_y += ctx->vid_overlay_int_part;
+			vid_overlay_error += ctx->vid_overlay_fract_part;
 			if (vid_overlay_error >= dev->loop_vid_overlay_cap.height) {
 				vid_overlay_error -= dev->loop_vid_overlay_cap.height;
 				vid_overlay_y++;
 			}
 		}
-		vid_out_y += vid_out_int_part;
-		vid_out_error += vid_out_fract_part;
+		vid_out_y += ctx->vid_out_int_part;
+		vid_out_error += ctx->vid_out_fract_part;
 		if (vid_out_error >= dev->loop_vid_cap.height / vdiv) {
 			vid_out_error -= dev->loop_vid_cap.height / vdiv;
 			vid_out_y++;
 		}
 	}
+}
 
-	if (!blank)
+/*
+ * A frame fill job is split into horizontal stripes: stripe 0 runs on
+ * the capture thread, the others on the device's fill workqueue.
+ */
+enum vivid_fill_job_type {
+	VIVID_FILL_JOB_PATTERN,
+	VIVID_FILL_JOB_LOOP,
+};
+
+struct vivid_fill_job {
+	enum vivid_fill_job_type type;
+	struct vivid_dev *dev;
+	unsigned stripes;
+	unsigned rows;
+	/* VIVID_FILL_JOB_PATTERN */
+	v4l2_std_id std;
+	unsigned p;
+	u8 *vbuf;
+	/* VIVID_FILL_JOB_LOOP */
+	const struct vivid_copy_ctx *ctx;
+};
+
+static void vivid_fill_stripe_run(struct vivid_fill_job *job, unsigned i,
+				  u8 *scaled_line)
+{
+	unsigned start = job->rows * i / job->stripes;
+	unsigned end = job->rows * (i + 1) / job->stripes;
+
+	switch (job->type) {
+	case VIVID_FILL_JOB_PATTERN:
+		tpg_fill_plane_lines(&job->dev->tpg, job->std, job->p,
+				     job->vbuf, start, end);
+		break;
+	case VIVID_FILL_JOB_LOOP:
+		vivid_copy_lines(job->dev, job->ctx, start, end, scaled_line);
+		break;
+	}
+}
+
+static void vivid_fill_stripe_work(struct work_struct *work)
+{
+	struct vivid_fill_stripe *stripe =
+		container_of(work, struct vivid_fill_stripe, work);
+
+	vivid_fill_stripe_run(stripe->job, stripe->index, stripe->scaled_line);
+}
+
+static void vivid_fill_run(struct vivid_dev *dev, struct vivid_fill_job *job)
+{
+	unsigned i;
+
+	job->dev = dev;
+	job->stripes = 1;
+	if (dev->fill_wq)
+		job->stripes = clamp_t(unsigned, job->rows / VIVID_FILL_MIN_ROWS,
+				       1, dev->fill_threads);
+
+	for (i = 1; i < job->stripes; i++) {
+		dev->fill_stripes[i].job = job;
+		queue_work(dev->fill_wq, &dev->fill_stripes[i].work);
+	}
+	vivid_fill_stripe_run(job, 0, dev->scaled_line);
+	for (i = 1; i < job->stripes; i++)
+		flush_work(&dev->fill_stripes[i].work);
+}
+
+static void vivid_fill_time_add(struct vivid_dev *dev,
+				enum vivid_fill_stage stage, u64 ns)
+{
+	struct vivid_fill_time *t = &dev->fill_time[stage];
+
+	t->count++;
+	t->total_ns += ns;
+	if (ns > t->max_ns)
+		t->max_ns = ns;
+}
+
+int vivid_fill_pool_init(struct vivid_dev *dev, unsigned threads)
+{
+	unsigned i;
+
+	dev->fill_threads = clamp_t(unsigned, threads, 1, VIVID_MAX_FILL_THREADS);
+	if (dev->fill_threads == 1)
 		return 0;
-	for (; y < img_height; y += vdiv, vcapbuf += stride_cap)
-		memcpy(vcapbuf, tpg->contrast_line[p], img_width);
+
+	for (i = 1; i < dev->fill_threads; i++) {
+		struct vivid_fill_stripe *stripe = &dev->fill_stripes[i];
+
+		INIT_WORK(&stripe->work, vivid_fill_stripe_work);
+		stripe->index = i;
+		stripe->scaled_line = vzalloc(MAX_ZOOM * MAX_WIDTH);
+		if (!stripe->scaled_line)
+			goto free;
+	}
+
+	dev->fill_wq = alloc_workqueue("%s-fill", WQ_UNBOUND | WQ_HIGHPRI,
+				       dev->fill_threads - 1,
+				       dev->v4l2_dev.name);
+	if (!dev->fill_wq)
+		goto free;
 	return 0;
+
+free:
+	vivid_fill_pool_free(dev);
+	return -ENOMEM;
+}
+
+void vivid_fill_pool_free(struct vivid_dev *dev)
+{
+	unsigned i;
+
+	if (dev->fill_wq)
+		destroy_workqueue(dev->fill_wq);
+	dev->fill_wq = NULL;
+	for (i = 1; i < VIVID_MAX_FILL_THREADS; i++) {
+		vfree(dev->fill_stripes[i].scaled_line);
+		dev->fill_stripes[i].scaled_line = NULL;
+	}
 }
 
-static void vivid_fillbuff(struct vivid_dev *dev, struct vivid_buffer *buf)
+static void vivid_fillbuff(struct vivid_dev *dev, struct vivid_buffer *buf,
+			   u64 stage_ns[VIVID_FILL_STAGES])
 {
 	struct tpg_data *tpg = &dev->tpg;
 	unsigned factor = V4L2_FIELD_HAS_T_OR_B(dev->field_cap) ? 2 : 1;
@@ -452,6 +653,9 @@ static void vivid_fillbuff(struct vivid_dev *dev, struct vivid_buffer *buf)
 	char str[100];
 	s32 gain;
 	bool is_loop = false;
+	struct vivid_copy_ctx ctx;
+	u64 start;
+	int ret;
 
 	if (dev->loop_video && dev->can_loop_video &&
 		((vivid_is_svid_cap(dev) &&
@@ -510,18 +714,47 @@ static void vivid_fillbuff(struct vivid_dev *dev, struct vivid_buffer *buf)
 		 */
 
 		tpg_calc_text_basep(tpg, basep, p, vbuf);
-		if (!is_loop || vivid_copy_buffer(dev, p, vbuf, buf)) {
-			if (!dev->fmt_cap->is_metadata[p]) {
-				tpg_fill_plane_buffer(tpg, vivid_get_std_cap(dev),
-					p, vbuf);
-				vivid_trace_single_msg(dev->v4l2_dev.name,
-					"fillbuf-cap-noloop",
-					buf->vb.vb2_buf.index);
-			}
+		start = ktime_get_ns();
+		ret = is_loop ? vivid_copy_buffer(dev, p, vbuf, buf, &ctx) : -ENODATA;
+		if (ret > 0) {
+			struct vivid_fill_job job = {
+				.type = VIVID_FILL_JOB_LOOP,
+				.rows = vivid_copy_rows(&ctx),
+				.ctx = &ctx,
+			};
+
+			/* the output overlay blends through dev->blended_line */
+			if (ctx.vosdbuf)
+				vivid_copy_lines(dev, &ctx, 0, job.rows,
+						 dev->scaled_line);
+			else
+				vivid_fill_run(dev, &job);
 		}
+		if (ret >= 0) {
+			stage_ns[VIVID_FILL_LOOP] += ktime_get_ns() - start;
+			continue;
+		}
+		if (!dev->fmt_cap->is_metadata[p]) {
+			struct vivid_fill_job job = {
+				.type = VIVID_FILL_JOB_PATTERN,
+				.rows = tpg->compose.height,
+				.std = vivid_get_std_cap(dev),
+				.p = p,
+				.vbuf = vbuf,
+			};
+
+			tpg_fill_prepare(tpg);
+			vivid_fill_run(dev, &job);
+			vivid_trace_single_msg(dev->v4l2_dev.name,
+				"fillbuf-cap-noloop",
+				buf->vb.vb2_buf.index);
+		}
+		stage_ns[VIVID_FILL_PATTERN] += ktime_get_ns() - start;
 	}
 	dev->must_blank[buf->vb.vb2_buf.index] = false;
 
+	start = ktime_get_ns();
+
 	/* Write text to plane 0 instead of the last plane */
 	tpg_calc_text_basep(tpg, basep, 0,
 		plane_vaddr(tpg, buf, 0, tpg->bytesperline, tpg->buf_height[0]));
@@ -597,6 +830,7 @@ static void vivid_fillbuff(struct vivid_dev *dev, struct vivid_buffer *buf)
 	 * If "End of Frame" is specified at the timestamp source, then take
 	 * the timestamp now.
 	 */
+	stage_ns[VIVID_FILL_TEXT] += ktime_get_ns() - start;
 	if (!dev->tstamp_src_is_soe)
 		vivid_get_timestamp(&buf->vb);
 	vivid_wrap_time_offset(&buf->vb, dev->time_wrap_offset);
@@ -705,6 +939,36 @@ static void vivid_overlay(struct vivid_dev *dev, struct vivid_buffer *buf)
 	}
 }
 
+static void vivid_pace_drop(struct vivid_dev *dev, unsigned frames)
+{
+	if (dev->vid_cap_streaming)
+		dev->pace_stats.dropped += frames;
+}
+
+/*
+ * Account a delivered capture buffer against the nominal start of its
+ * frame period. Buffers delivered more than one period late count as late.
+ */
+static void vivid_pace_done(struct vivid_dev *dev, u64 now)
+{
+	struct vivid_pace_stats *ps = &dev->pace_stats;
+	u64 delay;
+
+	if (now >= dev->cap_frame_ns)
+		delay = now - dev->cap_frame_ns;
+	else
+		delay = dev->cap_frame_ns - now;
+
+	ps->generated++;
+	ps->total_ns += delay;
+	if (delay > ps->max_ns)
+		ps->max_ns = delay;
+	if (now > dev->cap_frame_ns + dev->cap_frame_period_ns)
+		ps->late++;
+	ps->hist[min_t(unsigned, fls64(div_u64(delay, NSEC_PER_USEC)),
+		       VIVID_PACE_BUCKETS - 1)]++;
+}
+
 static void vivid_thread_vid_cap_tick(struct vivid_dev *dev, int dropped_bufs)
 {
 	struct vivid_buffer *vid_cap_buf = NULL;
@@ -712,6 +976,8 @@ static void vivid_thread_vid_cap_tick(struct vivid_dev *dev, int dropped_bufs)
 
 	dprintk(dev, 1, "Video Capture Thread Tick\n");
 
+	if (dropped_bufs > 1)
+		vivid_pace_drop(dev, dropped_bufs - 1);
 	while (dropped_bufs-- > 1)
 		tpg_update_mv_count(&dev->tpg,
 				dev->field_cap == V4L2_FIELD_NONE ||
@@ -719,8 +985,10 @@ static void vivid_thread_vid_cap_tick(struct vivid_dev *dev, int dropped_bufs)
 
 	/* Drop a certain percentage of buffers. */
 	if (dev->perc_dropped_buffers &&
-	    prandom_u32_max(100) < dev->perc_dropped_buffers)
+	    prandom_u32_max(100) < dev->perc_dropped_buffers) {
+		vivid_pace_drop(dev, 1);
 		goto update_mv;
+	}
 
 	spin_lock(&dev->slock);
 	if (!list_empty(&dev->vid_cap_active)) {
@@ -737,20 +1005,38 @@ static void vivid_thread_vid_cap_tick(struct vivid_dev *dev, int dropped_bufs)
 	}
 	spin_unlock(&dev->slock);
 
+	/* No buffer queued by the consumer in time for this frame */
+	if (!vid_cap_buf)
+		vivid_pace_drop(dev, 1);
+
 	if (!vid_cap_buf && !vbi_cap_buf)
 		goto update_mv;
 
 	if (vid_cap_buf) {
+		u64 stage_ns[VIVID_FILL_STAGES] = { 0 };
+		u64 start = ktime_get_ns();
+		u64 overlay_start;
+		int i;
+
 		/* Fill buffer */
-		vivid_fillbuff(dev, vid_cap_buf);
+		vivid_fillbuff(dev, vid_cap_buf, stage_ns);
 		dprintk(dev, 1, "filled buffer %d\n",
 			vid_cap_buf->vb.vb2_buf.index);
 
 		/* Handle overlay */
+		overlay_start = ktime_get_ns();
 		if (dev->overlay_cap_owner && dev->fb_cap.base &&
-			dev->fb_cap.fmt.pixelformat == dev->fmt_cap->fourcc)
+			dev->fb_cap.fmt.pixelformat == dev->fmt_cap->fourcc) {
 			vivid_overlay(dev, vid_cap_buf);
+			stage_ns[VIVID_FILL_OVERLAY] =
+				ktime_get_ns() - overlay_start;
+		}
+		stage_ns[VIVID_FILL_TOTAL] = ktime_get_ns() - start;
+		for (i = 0; i < VIVID_FILL_STAGES; i++)
+			if (stage_ns[i])
+				vivid_fill_time_add(dev, i, stage_ns[i]);
 
+		vivid_pace_done(dev, ktime_get_ns());
 		vb2_buffer_done(&vid_cap_buf->vb.vb2_buf, dev->dqbuf_error ?
 				VB2_BUF_STATE_ERROR : VB2_BUF_STATE_DONE);
 		dprintk(dev, 2, "vid_cap buffer %d done\n",
@@ -784,10 +1070,15 @@ static int vivid_thread_vid_cap(void *data)
 	unsigned long jiffies_since_start;
 	unsigned long cur_jiffies;
 	unsigned wait_jiffies;
+	u64 ns_since_start;
+	u64 next_ns_since_start;
+	u64 cur_ns;
+	ktime_t expires;
 	unsigned numerator;
 	unsigned denominator;
 	int dropped_bufs;
 	bool is_loop = false;
+	bool pace_hrtimer;
 
 	dprintk(dev, 1, "Video Capture Thread Start\n");
 
@@ -802,10 +1093,14 @@ static int vivid_thread_vid_cap(void *data)
 		dev->cap_seq_offset = 0;
 		dev->jiffies_vid_cap = jiffies;
 	}
+	dev->ktime_vid_cap = ktime_get_ns() -
+		jiffies_to_nsecs(jiffies - dev->jiffies_vid_cap);
 	dev->cap_seq_count = 0;
 	dev->cap_seq_resync = false;
 	dev->next_jiffies_vid_cap = dev->jiffies_vid_cap;
 	dev->cap_thread_active = true;
+	/* The pacing mode is latched for the lifetime of the stream */
+	pace_hrtimer = dev->pace_hrtimer;
 	mutex_unlock(&dev->mutex);
 
 	for (;;) {
@@ -815,8 +1110,10 @@ static int vivid_thread_vid_cap(void *data)
 
 		mutex_lock(&dev->mutex);
 		cur_jiffies = jiffies;
+		cur_ns = ktime_get_ns();
 		if (dev->cap_seq_resync) {
 			dev->jiffies_vid_cap = cur_jiffies;
+			dev->ktime_vid_cap = cur_ns;
 			dev->cap_seq_offset = dev->cap_seq_count + 1;
 			dev->cap_seq_count = 0;
 			dev->cap_seq_resync = false;
@@ -833,24 +1130,52 @@ static int vivid_thread_vid_cap(void *data)
 		if (dev->field_cap == V4L2_FIELD_ALTERNATE)
 			denominator *= 2;
 
-		/* Calculate the number of jiffies since we started streaming */
-		jiffies_since_start = cur_jiffies - dev->jiffies_vid_cap;
-		/* Get the number of buffers streamed since the start */
-		buffers_since_start = (u64)jiffies_since_start * denominator +
-				      (HZ * numerator) / 2;
-		do_div(buffers_since_start, HZ * numerator);
+		if (pace_hrtimer) {
+			/*
+			 * Same as below, but counted in nanoseconds so every
+			 * frame starts on its nominal time instead of on the
+			 * next jiffy. Resync once a day to keep the products
+			 * below within 64 bits.
+			 */
+			ns_since_start = cur_ns - dev->ktime_vid_cap;
+			buffers_since_start = div64_u64(ns_since_start * denominator +
+					NSEC_PER_SEC / 2 * numerator,
+					NSEC_PER_SEC * numerator);
+			if (ns_since_start > KTIME_RESYNC_NS) {
+				dev->jiffies_vid_cap = cur_jiffies;
+				dev->ktime_vid_cap = cur_ns;
+				dev->cap_seq_offset = buffers_since_start;
+				buffers_since_start = 0;
+			}
+		} else {
+			/* Calculate the number of jiffies since we started streaming */
+			jiffies_since_start = cur_jiffies - dev->jiffies_vid_cap;
+			/* Get the number of buffers streamed since the start */
+			buffers_since_start = (u64)jiffies_since_start * denominator +
+					      (HZ * numerator) / 2;
+			do_div(buffers_since_start, HZ * numerator);
 
-		/*
-		 * After more than 0xf0000000 (rounded down to a multiple of
-		 * 'jiffies-per-day' to ease jiffies_to_msecs calculation)
-		 * jiffies have passed since we started streaming reset the
-		 * counters and keep track of the sequence offset.
-		 */
-		if (jiffies_since_start > JIFFIES_RESYNC) {
-			dev->jiffies_vid_cap = cur_jiffies;
-			dev->cap_seq_offset = buffers_since_start;
-			buffers_since_start = 0;
+			/*
+			 * After more than 0xf0000000 (rounded down to a multiple of
+			 * 'jiffies-per-day' to ease jiffies_to_msecs calculation)
+			 * jiffies have passed since we started streaming reset the
+			 * counters and keep track of the sequence offset.
+			 */
+			if (jiffies_since_start > JIFFIES_RESYNC) {
+				dev->jiffies_vid_cap = cur_jiffies;
+				dev->ktime_vid_cap = cur_ns;
+				dev->cap_seq_offset = buffers_since_start;
+				buffers_since_start = 0;
+			}
 		}
+
+		/* Nominal start of this frame, for the pacing statistics */
+		dev->cap_frame_period_ns = mul_u64_u32_div(numerator,
+					NSEC_PER_SEC, denominator);
+		dev->cap_frame_ns = dev->ktime_vid_cap +
+			mul_u64_u32_div(buffers_since_start * numerator,
+					NSEC_PER_SEC, denominator);
+
 		dropped_bufs = buffers_since_start + dev->cap_seq_offset - dev->cap_seq_count;
 		dev->cap_seq_count = buffers_since_start + dev->cap_seq_offset;
 		dev->vid_cap_seq_count = dev->cap_seq_count - dev->vid_cap_seq_start;
@@ -870,6 +1195,23 @@ static int vivid_thread_vid_cap(void *data)
 		 */
 		numerators_since_start = ++buffers_since_start * numerator;
 
+		if (pace_hrtimer) {
+			/* Sleep until the absolute start of the next frame */
+			next_ns_since_start = mul_u64_u32_div(numerators_since_start,
+						NSEC_PER_SEC, denominator);
+			expires = ns_to_ktime(dev->ktime_vid_cap +
+					      next_ns_since_start);
+			mutex_unlock(&dev->mutex);
+
+			set_current_state(TASK_INTERRUPTIBLE);
+			schedule_hrtimeout(&expires, HRTIMER_MODE_ABS);
+			/* Running behind returns at once, still let others in */
+			cond_resched();
+			vivid_trace_double_index(dev->v4l2_dev.name, "capture",
+				0, buffers_since_start);
+			continue;
+		}
+
 		/* And the number of jiffies since we started */
 		jiffies_since_start = jiffies - dev->jiffies_vid_cap;
 
@@ -920,6 +1262,8 @@ int vivid_start_generating_vid_cap(struct vivid_dev *dev, bool *pstreaming)
 
 	/* Resets frame counters */
 	tpg_init_mv_count(&dev->tpg);
+	memset(dev->fill_time, 0, sizeof(dev->fill_time));
+	memset(&dev->pace_stats, 0, sizeof(dev->pace_stats));
 
 	dev->vid_cap_seq_start = dev->seq_wrap * 128;
 	dev->vbi_cap_seq_start = dev->seq_wrap * 128;
@@ -984,3 +1328,99 @@ void vivid_stop_generating_vid_cap(struct vivid_dev *dev, bool *pstreaming)
 	dev->cap_thread_active = false;
 	mutex_lock(&dev->mutex);
 }
+
+static int vivid_fill_stats_show(struct seq_file *s, void *data)
+{
+	static const char * const stage_names[VIVID_FILL_STAGES] = {
+		[VIVID_FILL_PATTERN] = "pattern",
+		[VIVID_FILL_LOOP] = "loop",
+		[VIVID_FILL_TEXT] = "text",
+		[VIVID_FILL_OVERLAY] = "overlay",
+		[VIVID_FILL_TOTAL] = "total",
+	};
+	struct vivid_dev *dev = s->private;
+	int i;
+
+	seq_printf(s, "threads %u\n", dev->fill_wq ? dev->fill_threads : 1);
+	seq_printf(s, "%-8s %10s %10s %10s\n",
+		   "stage", "frames", "avg_us", "max_us");
+	for (i = 0; i < VIVID_FILL_STAGES; i++) {
+		const struct vivid_fill_time *t = &dev->fill_time[i];
+		u64 avg = t->count ? div64_u64(t->total_ns, t->count) : 0;
+
+		seq_printf(s, "%-8s %10llu %10llu %10llu\n", stage_names[i],
+			   t->count, div_u64(avg, NSEC_PER_USEC),
+			   div_u64(t->max_ns, NSEC_PER_USEC));
+	}
+	return 0;
+}
+
+static int vivid_fill_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vivid_fill_stats_show, inode->i_private);
+}
+
+static const struct file_operations vivid_fill_stats_fops = {
+	.open		= vivid_fill_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int vivid_pace_stats_show(struct seq_file *s, void *data)
+{
+	struct vivid_dev *dev = s->private;
+	const struct vivid_pace_stats *ps = &dev->pace_stats;
+	u64 avg = ps->generated ? div64_u64(ps->total_ns, ps->generated) : 0;
+	int i;
+
+	seq_printf(s, "pacing %s\n", dev->pace_hrtimer ? "hrtimer" : "jiffies");
+	seq_printf(s, "period_us %llu\n",
+		   div_u64(dev->cap_frame_period_ns, NSEC_PER_USEC));
+	seq_printf(s, "generated %llu\n", ps->generated);
+	seq_printf(s, "dropped %llu\n", ps->dropped);
+	seq_printf(s, "late %llu\n", ps->late);
+	seq_printf(s, "avg_delay_us %llu\n", div_u64(avg, NSEC_PER_USEC));
+	seq_printf(s, "max_delay_us %llu\n", div_u64(ps->max_ns, NSEC_PER_USEC));
+	seq_printf(s, "%-16s %10s\n", "delay_us", "frames");
+	for (i = 0; i < VIVID_PACE_BUCKETS; i++) {
+		char range[24];
+
+		if (i == 0)
+			snprintf(range, sizeof(range), "0");
+		else if (i == VIVID_PACE_BUCKETS - 1)
+			snprintf(range, sizeof(range), ">= %u", 1U << (i - 1));
+		else
+			snprintf(range, sizeof(range), "%u-%u",
+				 1U << (i - 1), (1U << i) - 1);
+		seq_printf(s, "%-16s %10llu\n", range, ps->hist[i]);
+	}
+	return 0;
+}
+
+static int vivid_pace_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vivid_pace_stats_show, inode->i_private);
+}
+
+static const struct file_operations vivid_pace_stats_fops = {
+	.open		= vivid_pace_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+void vivid_fill_debugfs_init(struct vivid_dev *dev)
+{
+	dev->debugfs_dir = debugfs_create_dir(dev->v4l2_dev.name, NULL);
+	if (IS_ERR_OR_NULL(dev->debugfs_dir)) {
+		dev->debugfs_dir = NULL;
+		return;
+	}
+	debugfs_create_file("fill_stats", 0444, dev->debugfs_dir, dev,
+			    &vivid_fill_stats_fops);
+	debugfs_create_file("pace_stats", 0444, dev->debugfs_dir, dev,
+			    &vivid_pace_stats_fops);
+	debugfs_create_bool("hrtimer_pacing", 0644, dev->debugfs_dir,
+			    &dev->pace_hrtimer);
+}
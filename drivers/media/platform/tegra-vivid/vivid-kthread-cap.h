@@ -22,5 +22,8 @@
 
 int vivid_start_generating_vid_cap(struct vivid_dev *dev, bool *pstreaming);
 void vivid_stop_generating_vid_cap(struct vivid_dev *dev, bool *pstreaming);
+int vivid_fill_pool_init(struct vivid_dev *dev, unsigned threads);
+void vivid_fill_pool_free(struct vivid_dev *dev);
+void vivid_fill_debugfs_init(struct vivid_dev *dev);
 
 #endif
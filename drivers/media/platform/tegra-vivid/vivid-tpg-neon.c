@@ -0,0 +1,55 @@
+/*
+ * vivid-tpg-neon.c - NEON line writers for the Test Pattern Generator
+ *
+ * Copyright (c) 2026, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you may redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; version 2 of the License.
+ *
+ * Callers must hold kernel_neon_begin(); see tpg_copy_line() and
+ * tpg_fill_run() in vivid-tpg.c.
+ */
+
+#include <asm/neon-intrinsics.h>
+
+#include "vivid-tpg.h"
+
+/*
+ * Copy one precalculated pattern line into the capture buffer, 64 bytes
+ * per iteration. The caller passes the bulk length; the tail is left to
+ * memcpy().
+ */
+void tpg_neon_copy_line(u8 *dst, const u8 *src, unsigned len)
+{
+	for (; len >= 64; len -= 64, src += 64, dst += 64) {
+		uint8x16_t a = vld1q_u8(src);
+		uint8x16_t b = vld1q_u8(src + 16);
+		uint8x16_t c = vld1q_u8(src + 32);
+		uint8x16_t d = vld1q_u8(src + 48);
+
+		vst1q_u8(dst, a);
+		vst1q_u8(dst + 16, b);
+		vst1q_u8(dst + 32, c);
+		vst1q_u8(dst + 48, d);
+	}
+}
+
+/*
+ * Replicate a TPG_RUN_PERIOD byte pattern over @len bytes. The period is
+ * a multiple of every two-pixel size used by YUYV, NV12, RGB24 and XRGB32,
+ * so the pattern is already phase-aligned at each store.
+ */
+void tpg_neon_fill_run(u8 *dst, const u8 *pattern, unsigned len)
+{
+	uint8x16_t a = vld1q_u8(pattern);
+	uint8x16_t b = vld1q_u8(pattern + 16);
+	uint8x16_t c = vld1q_u8(pattern + 32);
+
+	for (; len >= TPG_RUN_PERIOD; len -= TPG_RUN_PERIOD,
+	     dst += TPG_RUN_PERIOD) {
+		vst1q_u8(dst, a);
+		vst1q_u8(dst + 16, b);
+		vst1q_u8(dst + 32, c);
+	}
+}
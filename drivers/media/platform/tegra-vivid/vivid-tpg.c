@@ -22,6 +22,14 @@
 
 #include "vivid-tpg.h"
 
+#ifdef TPG_HAVE_NEON
+#include <asm/neon.h>
+#include <asm/simd.h>
+
+/* below this the FP/SIMD context switch costs more than it saves */
+#define TPG_NEON_MIN_LEN 512
+#endif
+
 /* Must remain in sync with enum tpg_pattern */
 const char * const tpg_pattern_strings[] = {
 	"75% Colorbar",
@@ -113,6 +121,7 @@ void tpg_init(struct tpg_data *tpg, unsigned w, unsigned h)
 	tpg_s_fourcc(tpg, V4L2_PIX_FMT_RGB24, 0);
 	tpg->colorspace = V4L2_COLORSPACE_SRGB;
 	tpg->perc_fill = 100;
+	tpg->simd = true;
 }
 
 int tpg_alloc(struct tpg_data *tpg, unsigned max_w)
@@ -1468,6 +1477,90 @@ static void tpg_calculate_square_border(struct tpg_data *tpg)
 	}
 }
 
+/*
+ * Copy a precalculated line into the destination buffer. This is where
+ * the bulk of the per-frame time goes for the static patterns.
+ */
+static void tpg_copy_line(const struct tpg_data *tpg, u8 *dst,
+			  const u8 *src, unsigned len)
+{
+#ifdef TPG_HAVE_NEON
+	if (tpg->simd && len >= TPG_NEON_MIN_LEN && may_use_simd()) {
+		unsigned bulk = len & ~63U;
+
+		kernel_neon_begin();
+		tpg_neon_copy_line(dst, src, bulk);
+		kernel_neon_end();
+		memcpy(dst + bulk, src + bulk, len - bulk);
+		return;
+	}
+#endif
+	memcpy(dst, src, len);
+}
+
+/*
+ * Replicate a run of @count identical pixel units of @unit bytes starting
+ * at @dst. Used to build the pattern lines one colour bar at a time
+ * instead of one pixel pair at a time.
+ */
+static void tpg_fill_run(const struct tpg_data *tpg, u8 *dst,
+			 const u8 *pix, unsigned unit, unsigned count)
+{
+	unsigned len = unit * count;
+	unsigned filled;
+
+	if (!len)
+		return;
+
+#ifdef TPG_HAVE_NEON
+	if (tpg->simd && len >= TPG_NEON_MIN_LEN &&
+	    TPG_RUN_PERIOD % unit == 0 && may_use_simd()) {
+		u8 pattern[TPG_RUN_PERIOD];
+		unsigned bulk = len - len % TPG_RUN_PERIOD;
+		unsigned i;
+
+		for (i = 0; i < TPG_RUN_PERIOD; i += unit)
+			memcpy(pattern + i, pix, unit);
+		kernel_neon_begin();
+		tpg_neon_fill_run(dst, pattern, bulk);
+		kernel_neon_end();
+		memcpy(dst + bulk, pattern, len - bulk);
+		return;
+	}
+#endif
+	/* seed one unit, then keep doubling what is already in place */
+	memcpy(dst, pix, unit);
+	for (filled = unit; filled < len; filled *= 2)
+		memcpy(dst + filled, dst, min(filled, len - filled));
+}
+
+/*
+ * Write @count pixel pairs starting at pair position @x of pattern line
+ * @pat. Planes whose pairs are byte contiguous are filled as one run,
+ * packed formats fall back to placing each pair.
+ */
+static void tpg_fill_pat_run(struct tpg_data *tpg, u8 pix[TPG_MAX_PLANES][8],
+			     unsigned pat, unsigned x, unsigned count)
+{
+	unsigned p;
+	unsigned i;
+
+	for (p = 0; p < tpg->planes; p++) {
+		unsigned twopixsize = tpg->twopixelsize[p];
+		unsigned hdiv = tpg->hdownsampling[p];
+		unsigned unit = twopixsize / hdiv;
+		u8 *line = tpg->lines[pat][p];
+
+		if (tpg->packedpixels[p] == 1 && tpg_hdiv(tpg, p, 2) == unit) {
+			tpg_fill_run(tpg, line + tpg_hdiv(tpg, p, x), pix[p],
+				     unit, count);
+			continue;
+		}
+		for (i = 0; i < count; i++)
+			memcpy(line + tpg_hdiv(tpg, p, x + 2 * i), pix[p], unit);
+	}
+}
+
 static void tpg_precalculate_line(struct tpg_data *tpg)
 {
 	enum tpg_color contrast;
@@ -1494,6 +1587,15 @@ static void tpg_precalculate_line(struct tpg_data *tpg)
 		unsigned fract_part = tpg->src_width % tpg->scaled_width;
 		unsigned src_x = 0;
 		unsigned error = 0;
+		/*
+		 * Consecutive pixel pairs nearly always share their colours,
+		 * so only run gen_twopix() and its colour conversion when the
+		 * pair changes and emit everything in between as one run.
+		 */
+		enum tpg_color run_color1 = TPG_COLOR_MAX;
+		enum tpg_color run_color2 = TPG_COLOR_MAX;
+		unsigned run_x = 0;
+		unsigned run_len = 0;
 
 		for (x = 0; x < tpg->scaled_width * 2; x += 2) {
 			unsigned real_x = src_x;
@@ -1520,16 +1622,22 @@ static void tpg_precalculate_line(struct tpg_data *tpg)
 				src_x++;
 			}
 
-			gen_twopix(tpg, pix, tpg->hflip ? color2 : color1, 0);
-			gen_twopix(tpg, pix, tpg->hflip ? color1 : color2, 1);
-			for (p = 0; p < tpg->planes; p++) {
-				unsigned twopixsize = tpg->twopixelsize[p];
-				unsigned hdiv = tpg->hdownsampling[p];
-				u8 *pos = tpg->lines[pat][p] + tpg_hdiv(tpg, p, x);
-
-				memcpy(pos, pix[p], twopixsize / hdiv);
+			if (tpg->hflip)
+				swap(color1, color2);
+			if (color1 == run_color1 && color2 == run_color2) {
+				run_len++;
+				continue;
 			}
+
+			tpg_fill_pat_run(tpg, pix, pat, run_x, run_len);
+			gen_twopix(tpg, pix, color1, 0);
+			gen_twopix(tpg, pix, color2, 1);
+			run_color1 = color1;
+			run_color2 = color2;
+			run_x = x;
+			run_len = 1;
 		}
+		tpg_fill_pat_run(tpg, pix, pat, run_x, run_len);
 	}
 
 	if (tpg->vdownsampling[tpg->planes - 1] > 1) {
@@ -1552,23 +1660,15 @@ static void tpg_precalculate_line(struct tpg_data *tpg)
 
 	gen_twopix(tpg, pix, contrast, 0);
 	gen_twopix(tpg, pix, contrast, 1);
-	for (p = 0; p < tpg->planes; p++) {
-		unsigned twopixsize = tpg->twopixelsize[p];
-		u8 *pos = tpg->contrast_line[p];
-
-		for (x = 0; x < tpg->scaled_width; x += 2, pos += twopixsize)
-			memcpy(pos, pix[p], twopixsize);
-	}
+	for (p = 0; p < tpg->planes; p++)
+		tpg_fill_run(tpg, tpg->contrast_line[p], pix[p],
+			     tpg->twopixelsize[p], tpg->scaled_width / 2);
 
 	gen_twopix(tpg, pix, TPG_COLOR_100_BLACK, 0);
 	gen_twopix(tpg, pix, TPG_COLOR_100_BLACK, 1);
-	for (p = 0; p < tpg->planes; p++) {
-		unsigned twopixsize = tpg->twopixelsize[p];
-		u8 *pos = tpg->black_line[p];
-
-		for (x = 0; x < tpg->scaled_width; x += 2, pos += twopixsize)
-			memcpy(pos, pix[p], twopixsize);
-	}
+	for (p = 0; p < tpg->planes; p++)
+		tpg_fill_run(tpg, tpg->black_line[p], pix[p],
+			     tpg->twopixelsize[p], tpg->scaled_width / 2);
 
 	for (x = 0; x < tpg->scaled_width * 2; x += 2) {
 		gen_twopix(tpg, pix, TPG_COLOR_RANDOM, 0);
@@ -2189,31 +2289,46 @@ static void tpg_fill_plane_pattern(const struct tpg_data *tpg,
 	case V4L2_FIELD_SEQ_TB:
 	case V4L2_FIELD_SEQ_BT:
 		if (even)
-			memcpy(vbuf, linestart_top, img_width);
+			tpg_copy_line(tpg, vbuf, linestart_top, img_width);
 		else
-			memcpy(vbuf, linestart_bottom, img_width);
+			tpg_copy_line(tpg, vbuf, linestart_bottom, img_width);
 		break;
 	case V4L2_FIELD_INTERLACED_BT:
 		if (even)
-			memcpy(vbuf, linestart_bottom, img_width);
+			tpg_copy_line(tpg, vbuf, linestart_bottom, img_width);
 		else
-			memcpy(vbuf, linestart_top, img_width);
+			tpg_copy_line(tpg, vbuf, linestart_top, img_width);
 		break;
 	case V4L2_FIELD_TOP:
-		memcpy(vbuf, linestart_top, img_width);
+		tpg_copy_line(tpg, vbuf, linestart_top, img_width);
 		break;
 	case V4L2_FIELD_BOTTOM:
-		memcpy(vbuf, linestart_bottom, img_width);
+		tpg_copy_line(tpg, vbuf, linestart_bottom, img_width);
 		break;
 	case V4L2_FIELD_NONE:
 	default:
-		memcpy(vbuf, linestart_older, img_width);
+		tpg_copy_line(tpg, vbuf, linestart_older, img_width);
 		break;
 	}
 }
 
-void tpg_fill_plane_buffer(struct tpg_data *tpg, v4l2_std_id std,
-			   unsigned p, u8 *vbuf)
+/*
+ * Refresh the precalculated colours and lines. This must be done once,
+ * single threaded, before tpg_fill_plane_lines() is called for any stripe
+ * of a frame.
+ */
+void tpg_fill_prepare(struct tpg_data *tpg)
+{
+	tpg_recalc(tpg);
+}
+
+/*
+ * Render compose lines [h_start, h_end) of plane p. The lines a call
+ * writes do not overlap with any other range, so the stripes of a frame
+ * can be rendered concurrently once tpg_fill_prepare() has run.
+ */
+void tpg_fill_plane_lines(const struct tpg_data *tpg, v4l2_std_id std,
+			  unsigned p, u8 *vbuf, unsigned h_start, unsigned h_end)
 {
 	struct tpg_draw_params params;
 	unsigned factor = V4L2_FIELD_HAS_T_OR_B(tpg->field) ? 2 : 1;
@@ -2225,8 +2340,6 @@ void tpg_fill_plane_buffer(struct tpg_data *tpg, v4l2_std_id std,
 	unsigned error = 0;
 	unsigned h;
 
-	tpg_recalc(tpg);
-
 	params.is_tv = std;
 	params.is_60hz = std & V4L2_STD_525_60;
 	params.twopixsize = tpg->twopixelsize[p];
@@ -2239,7 +2352,17 @@ void tpg_fill_plane_buffer(struct tpg_data *tpg, v4l2_std_id std,
 
 	vbuf += tpg_hdiv(tpg, p, tpg->compose.left);
 
-	for (h = 0; h < tpg->compose.height; h++) {
+	/* replay the Bresenham steps of the lines before this stripe */
+	for (h = 0; h < h_start; h++) {
+		src_y += int_part;
+		error += fract_part;
+		if (error >= tpg->compose.height) {
+			error -= tpg->compose.height;
+			src_y++;
+		}
+	}
+
+	for (h = h_start; h < h_end; h++) {
 		unsigned buf_line;
 
 		params.frame_line = tpg_calc_frameline(tpg, src_y, tpg->field);
@@ -2295,6 +2418,13 @@ void tpg_fill_plane_buffer(struct tpg_data *tpg, v4l2_std_id std,
 	}
 }
 
+void tpg_fill_plane_buffer(struct tpg_data *tpg, v4l2_std_id std,
+			   unsigned p, u8 *vbuf)
+{
+	tpg_fill_prepare(tpg);
+	tpg_fill_plane_lines(tpg, std, p, vbuf, 0, tpg->compose.height);
+}
+
 void tpg_fillbuffer(struct tpg_data *tpg, v4l2_std_id std, unsigned p, u8 *vbuf)
 {
 	unsigned offset = 0;
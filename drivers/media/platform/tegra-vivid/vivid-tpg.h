@@ -92,6 +92,14 @@ extern const char * const tpg_aspect_strings[];
 
 #define TPG_MAX_PLANES 3
 #define TPG_MAX_PAT_LINES 8
+/* least common multiple of the 2, 4, 6 and 8 byte two-pixel sizes */
+#define TPG_RUN_PERIOD 48
+
+#if defined(CONFIG_ARM64) && defined(CONFIG_KERNEL_MODE_NEON)
+#define TPG_HAVE_NEON
+void tpg_neon_copy_line(u8 *dst, const u8 *src, unsigned len);
+void tpg_neon_fill_run(u8 *dst, const u8 *pattern, unsigned len);
+#endif
 
 struct tpg_data {
 	/* Source frame size */
@@ -185,6 +193,9 @@ struct tpg_data {
 	bool				recalc_lines;
 	bool				recalc_square_border;
 
+	/* use the NEON line writers when the CPU and kernel support them */
+	bool				simd;
+
 	/* Used to store TPG_MAX_PAT_LINES lines, each with up to two planes */
 	unsigned			max_line_width;
 	u8				*lines[TPG_MAX_PAT_LINES][TPG_MAX_PLANES];
@@ -207,6 +218,9 @@ void tpg_gen_text(const struct tpg_data *tpg,
 void tpg_calc_text_basep(struct tpg_data *tpg,
 		u8 *basep[TPG_MAX_PLANES][2], unsigned p, u8 *vbuf);
 unsigned tpg_g_interleaved_plane(const struct tpg_data *tpg, unsigned buf_line);
+void tpg_fill_prepare(struct tpg_data *tpg);
+void tpg_fill_plane_lines(const struct tpg_data *tpg, v4l2_std_id std,
+			  unsigned p, u8 *vbuf, unsigned h_start, unsigned h_end);
 void tpg_fill_plane_buffer(struct tpg_data *tpg, v4l2_std_id std,
 			   unsigned p, u8 *vbuf);
 void tpg_fillbuffer(struct tpg_data *tpg, v4l2_std_id std,
@@ -603,6 +617,11 @@ static inline bool tpg_g_vflip(const struct tpg_data *tpg)
 	return tpg->vflip;
 }
 
+static inline void tpg_s_simd(struct tpg_data *tpg, bool simd)
+{
+	tpg->simd = simd;
+}
+
 static inline bool tpg_pattern_is_static(const struct tpg_data *tpg)
 {
 	return tpg->pattern != TPG_PAT_NOISE &&
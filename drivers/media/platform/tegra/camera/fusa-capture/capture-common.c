@@ -25,6 +25,7 @@
 #include <linux/slab.h>
 #include <linux/hashtable.h>
 #include <linux/atomic.h>
+#include <linux/rcupdate.h>
 #include <media/mc_common.h>
 
 #include <media/fusa-capture/capture-common.h>
@@ -36,7 +37,8 @@
 struct capture_buffer_table {
 	struct device *dev; /**< Originating device (VI or ISP) */
 	struct kmem_cache *cache; /**< SLAB allocator cache */
-	rwlock_t hlock; /**< Reader/writer lock on table contents */
+	spinlock_t hlock; /**< Writer lock on table contents (RCU readers) */
+	struct mutex req_lock; /**< Serializes buffer add/remove requests */
 	DECLARE_HASHTABLE(hhead, 4U); /**< Buffer hashtable head */
 };
 
@@ -66,6 +68,8 @@ struct capture_mapping {
 		/**< dma_buf attachment (VI or ISP device) */
 	struct sg_table *sgt; /**< Scatterlist to dma_buf attachment */
 	unsigned int flag; /**< Bitmask access flag */
+	struct kmem_cache *cache; /**< SLAB cache the mapping belongs to */
+	struct rcu_head rcu; /**< Deferred free after RCU lookups */
 };
 
 /**
@@ -189,6 +193,8 @@ static inline void set_mapping_preservation(
  * with @a buf, and @a flag bits set in the capture mapping.
  *
  * On success, the capture mapping is incremented by one if it is non-zero.
+ * The lookup is lockless (RCU); a mapping whose refcnt already dropped to
+ * zero is being torn down and is skipped.
  *
  * @param[in]	tab	The capture buffer management table
  * @param[in]	buf	The mapping dma_buf pointer to match
@@ -204,22 +210,23 @@ static struct capture_mapping *find_mapping(
 	struct capture_mapping *pin;
 	bool success;
 
-	read_lock(&tab->hlock);
+	rcu_read_lock();
 
-	hash_for_each_possible(tab->hhead, pin, hnode, (unsigned long)buf) {
+	hash_for_each_possible_rcu(tab->hhead, pin, hnode,
+			(unsigned long)buf) {
 		if (
 			(pin->buf == buf) &&
-			flag_compatible(pin->flag, flag)
+			flag_compatible(READ_ONCE(pin->flag), flag)
 		) {
 			success =  atomic_inc_not_zero(&pin->refcnt);
 			if (success) {
-				read_unlock(&tab->hlock);
+				rcu_read_unlock();
 				return pin;
 			}
 		}
 	}
 
-	read_unlock(&tab->hlock);
+	rcu_read_unlock();
 
 	return NULL;
 }
@@ -281,12 +288,13 @@ static struct capture_mapping *get_mapping(
 
 	pin->flag = flag;
 	pin->buf = buf;
+	pin->cache = tab->cache;
 	atomic_set(&pin->refcnt, 1U);
 	INIT_HLIST_NODE(&pin->hnode);
 
-	write_lock(&tab->hlock);
-	hash_add(tab->hhead, &pin->hnode, (unsigned long)pin->buf);
-	write_unlock(&tab->hlock);
+	spin_lock(&tab->hlock);
+	hash_add_rcu(tab->hhead, &pin->hnode, (unsigned long)pin->buf);
+	spin_unlock(&tab->hlock);
 
 	return pin;
 err2:
@@ -313,7 +321,8 @@ struct capture_buffer_table *create_buffer_table(
 		if (likely(tab->cache != NULL)) {
 			tab->dev = dev;
 			hash_init(tab->hhead);
-			rwlock_init(&tab->hlock);
+			spin_lock_init(&tab->hlock);
+			mutex_init(&tab->req_lock);
 		} else {
 			kfree(tab);
 			tab = NULL;
@@ -333,10 +342,10 @@ void destroy_buffer_table(
 	if (unlikely(tab == NULL))
 		return;
 
-	write_lock(&tab->hlock);
+	spin_lock(&tab->hlock);
 
 	hash_for_each_safe(tab->hhead, bkt, next, pin, hnode) {
-		hash_del(&pin->hnode);
+		hash_del_rcu(&pin->hnode);
 		dma_buf_unmap_attachment(
 			pin->atch, pin->sgt, flag_dma_direction(pin->flag));
 		dma_buf_detach(pin->buf, pin->atch);
@@ -344,14 +353,16 @@ void destroy_buffer_table(
 		kmem_cache_free(tab->cache, pin);
 	}
 
-	write_unlock(&tab->hlock);
+	spin_unlock(&tab->hlock);
 
+	/* Wait for mappings released through put_mapping() */
+	rcu_barrier();
+
+	mutex_destroy(&tab->req_lock);
 	kmem_cache_destroy(tab->cache);
 	kfree(tab);
 }
 
-static DEFINE_MUTEX(req_lock);
-
 int capture_buffer_request(
 	struct capture_buffer_table *tab,
 	uint32_t memfd,
@@ -367,7 +378,7 @@ int capture_buffer_request(
 		return -EINVAL;
 	}
 
-	mutex_lock(&req_lock);
+	mutex_lock(&tab->req_lock);
 
 	if (add) {
 		pin = get_mapping(tab, memfd, flag_access_mode(flag));
@@ -409,7 +420,7 @@ int capture_buffer_request(
 	put_mapping(tab, pin);
 
 end:
-	mutex_unlock(&req_lock);
+	mutex_unlock(&tab->req_lock);
 	return err;
 }
 
@@ -420,6 +431,20 @@ int capture_buffer_add(
 	return capture_buffer_request(t, fd, BUFFER_ADD | BUFFER_RDWR);
 }
 
+/**
+ * @brief RCU callback freeing a capture mapping once no lookup can see it.
+ *
+ * @param[in]	head	The @ref rcu_head embedded in the capture_mapping
+ */
+static void free_mapping_rcu(
+	struct rcu_head *head)
+{
+	struct capture_mapping *pin =
+		container_of(head, struct capture_mapping, rcu);
+
+	kmem_cache_free(pin->cache, pin);
+}
+
 void put_mapping(
 	struct capture_buffer_table *t,
 	struct capture_mapping *pin)
@@ -435,15 +460,15 @@ void put_mapping(
 			return;
 		}
 
-		write_lock(&t->hlock);
-		hash_del(&pin->hnode);
-		write_unlock(&t->hlock);
+		spin_lock(&t->hlock);
+		hash_del_rcu(&pin->hnode);
+		spin_unlock(&t->hlock);
 
 		dma_buf_unmap_attachment(
 			pin->atch, pin->sgt, flag_dma_direction(pin->flag));
 		dma_buf_detach(pin->buf, pin->atch);
 		dma_buf_put(pin->buf);
-		kmem_cache_free(t->cache, pin);
+		call_rcu(&pin->rcu, free_mapping_rcu);
 	}
 }
 
@@ -178,6 +178,21 @@
 #define VI_CAPTURE_BUFFER_REQUEST \
 	_IOW('I', 10, struct vi_buffer_req)
 
+/**
+ * @brief Enqueue a batch of capture requests to RCE in one call. Every request
+ * is pinned and patched as for @ref VI_CAPTURE_REQUEST, then all of them are
+ * sent under a single hold of the channel and capture IVC locks.
+ *
+ * On return num_done holds the number of requests submitted; requests after
+ * the first failure are not submitted and stay unpinned.
+ *
+ * @param[in,out]	ptr	Pointer to a struct @ref vi_capture_req_batch
+ *
+ * @returns	0 (success), neg. errno (failure)
+ */
+#define VI_CAPTURE_REQUEST_BATCH \
+	_IOWR('I', 11, struct vi_capture_req_batch)
+
 /** @} */
 
 void vi_capture_request_unpin(
@@ -382,6 +397,58 @@ fail:
 	return err;
 }
 
+/**
+ * Validate a capture request and pin the buffers of its descriptor.
+ * On failure the descriptor is left unpinned.
+ */
+static int vi_capture_request_pin(struct tegra_vi_channel *chan,
+		struct vi_capture_req *req)
+{
+	struct vi_capture *capture = chan->capture_data;
+	struct capture_common_unpins *request_unpins;
+	int err;
+
+	if (req->num_relocs == 0) {
+		dev_err(chan->dev, "request must have non-zero relocs\n");
+		return -EINVAL;
+	}
+
+	if (req->buffer_index >= capture->queue_depth) {
+		dev_err(chan->dev, "buffer index is out of bound\n");
+		return -EINVAL;
+	}
+
+	/* Don't let to speculate with invalid buffer_index value */
+	spec_bar();
+
+	if (capture->unpins_list == NULL) {
+		dev_err(chan->dev, "Channel setup incomplete\n");
+		return -EINVAL;
+	}
+
+	mutex_lock(&capture->unpins_list_lock);
+
+	request_unpins = &capture->unpins_list[req->buffer_index];
+
+	if (request_unpins->num_unpins != 0U) {
+		dev_err(chan->dev, "Descriptor is still in use by rtcpu\n");
+		mutex_unlock(&capture->unpins_list_lock);
+		return -EBUSY;
+	}
+	err = pin_vi_capture_request_buffers_locked(chan, req,
+			request_unpins);
+
+	mutex_unlock(&capture->unpins_list_lock);
+
+	if (err < 0) {
+		dev_err(chan->dev,
+			"pin request failed\n");
+		vi_capture_request_unpin(chan, req->buffer_index);
+	}
+
+	return err;
+}
+
 /**
  * @brief Process an IOCTL call on a VI channel character device.
  *
@@ -546,57 +613,76 @@ static long vi_channel_ioctl(
 
 	case _IOC_NR(VI_CAPTURE_REQUEST): {
 		struct vi_capture_req req;
-		struct capture_common_unpins *request_unpins;
 
 		if (copy_from_user(&req, ptr, sizeof(req)))
 			break;
 
-		if (req.num_relocs == 0) {
-			dev_err(chan->dev, "request must have non-zero relocs\n");
-			return -EINVAL;
-		}
+		err = vi_capture_request_pin(chan, &req);
+		if (err < 0)
+			break;
 
-		if (req.buffer_index >= capture->queue_depth) {
-			dev_err(chan->dev, "buffer index is out of bound\n");
-			return -EINVAL;
+		err = vi_capture_request(chan, &req);
+		if (err < 0) {
+			dev_err(chan->dev,
+				"vi capture request submit failed\n");
+			vi_capture_request_unpin(chan, req.buffer_index);
 		}
 
-		/* Don't let to speculate with invalid buffer_index value */
-		spec_bar();
-
-		if (capture->unpins_list == NULL) {
-			dev_err(chan->dev, "Channel setup incomplete\n");
-			return -EINVAL;
-		}
+		break;
+	}
 
-		mutex_lock(&capture->unpins_list_lock);
+	case _IOC_NR(VI_CAPTURE_REQUEST_BATCH): {
+		struct vi_capture_req_batch batch;
+		struct vi_capture_req *reqs;
+		uint32_t i, pinned;
+		int sent = 0;
 
-		request_unpins = &capture->unpins_list[req.buffer_index];
+		if (copy_from_user(&batch, ptr, sizeof(batch)))
+			break;
 
-		if (request_unpins->num_unpins != 0U) {
-			dev_err(chan->dev, "Descriptor is still in use by rtcpu\n");
-			mutex_unlock(&capture->unpins_list_lock);
-			return -EBUSY;
+		if ((batch.num_reqs == 0U) ||
+				(batch.num_reqs > capture->queue_depth)) {
+			dev_err(chan->dev, "invalid batch size %u\n",
+				batch.num_reqs);
+			return -EINVAL;
 		}
-		err = pin_vi_capture_request_buffers_locked(chan, &req,
-				request_unpins);
 
-		mutex_unlock(&capture->unpins_list_lock);
+		reqs = kcalloc(batch.num_reqs, sizeof(*reqs), GFP_KERNEL);
+		if (reqs == NULL)
+			return -ENOMEM;
 
-		if (err < 0) {
-			dev_err(chan->dev,
-				"pin request failed\n");
-			vi_capture_request_unpin(chan, req.buffer_index);
+		if (copy_from_user(reqs, u64_to_user_ptr(batch.reqs),
+				batch.num_reqs * sizeof(*reqs))) {
+			kfree(reqs);
 			break;
 		}
 
-		err = vi_capture_request(chan, &req);
-		if (err < 0) {
-			dev_err(chan->dev,
-				"vi capture request submit failed\n");
-			vi_capture_request_unpin(chan, req.buffer_index);
+		for (pinned = 0U; pinned < batch.num_reqs; pinned++) {
+			err = vi_capture_request_pin(chan, &reqs[pinned]);
+			if (err < 0)
+				break;
+		}
+
+		if (pinned > 0U) {
+			sent = vi_capture_request_batch(chan, reqs, pinned);
+			if (sent < 0) {
+				dev_err(chan->dev,
+					"vi capture request submit failed\n");
+				err = sent;
+				sent = 0;
+			} else if ((uint32_t)sent < pinned) {
+				err = -EIO;
+			}
+
+			for (i = (uint32_t)sent; i < pinned; i++)
+				vi_capture_request_unpin(chan,
+					reqs[i].buffer_index);
 		}
+		kfree(reqs);
 
+		batch.num_done = (uint32_t)sent;
+		if (copy_to_user(ptr, &batch, sizeof(batch)))
+			err = -EFAULT;
 		break;
 	}
 
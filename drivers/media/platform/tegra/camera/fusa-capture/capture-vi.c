@@ -1469,6 +1469,78 @@ int vi_capture_request(
 	return 0;
 }
 
+int vi_capture_request_batch(
+	struct tegra_vi_channel *chan,
+	const struct vi_capture_req *reqs,
+	uint32_t num)
+{
+	struct vi_capture *capture = chan->capture_data;
+	struct CAPTURE_MSG *capture_desc;
+	uint64_t ts;
+	uint32_t i;
+	int err = 0;
+
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 4, 0)
+	ts = arch_counter_get_cntvct();
+#else
+	ts = __arch_counter_get_cntvct();
+#endif
+
+	if (capture == NULL) {
+		dev_err(chan->dev,
+			"%s: vi capture uninitialized\n", __func__);
+		return -ENODEV;
+	}
+
+	if (capture->channel_id == CAPTURE_CHANNEL_INVALID_ID) {
+		dev_err(chan->dev,
+			"%s: setup channel first\n", __func__);
+		return -ENODEV;
+	}
+
+	if (reqs == NULL || num == 0U) {
+		dev_err(chan->dev,
+			"%s: Invalid req\n", __func__);
+		return -EINVAL;
+	}
+
+	capture_desc = kcalloc(num, sizeof(*capture_desc), GFP_KERNEL);
+	if (capture_desc == NULL)
+		return -ENOMEM;
+
+	mutex_lock(&capture->reset_lock);
+
+	for (i = 0U; i < num; i++) {
+		nv_camera_log(chan->ndev, ts,
+			NVHOST_CAMERA_VI_CAPTURE_REQUEST);
+
+		capture_desc[i].header.msg_id = CAPTURE_REQUEST_REQ;
+		capture_desc[i].header.channel_id = capture->channel_id;
+		capture_desc[i].capture_request_req.buffer_index =
+			reqs[i].buffer_index;
+
+		nv_camera_log_submit(
+				chan->ndev,
+				capture->progress_sp.id,
+				capture->progress_sp.threshold,
+				capture_desc[i].header.channel_id,
+				ts);
+	}
+
+	dev_dbg(chan->dev, "%s: sending chan_id %u msg_id %u bufs:%u\n",
+			__func__, capture->channel_id,
+			CAPTURE_REQUEST_REQ, num);
+	err = tegra_capture_ivc_capture_submit_batch(capture_desc,
+			sizeof(*capture_desc), num);
+	if (err < 0)
+		dev_err(chan->dev, "IVC capture batch submit failed\n");
+
+	mutex_unlock(&capture->reset_lock);
+	kfree(capture_desc);
+
+	return err;
+}
+
 int vi_capture_status(
 	struct tegra_vi_channel *chan,
 	int32_t timeout_ms)
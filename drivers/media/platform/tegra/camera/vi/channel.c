@@ -647,21 +647,39 @@ done:
 	return buf;
 }
 
-struct tegra_channel_buffer *dequeue_dequeue_buffer(struct tegra_channel *chan)
+/*
+ * The dequeue ring is only ever written by the enqueue kthread and only ever
+ * read by the dequeue kthread, so no lock is taken on either side. The
+ * release/acquire pair on the indices orders the slot store before the
+ * consumer sees it and the slot load before the producer may reuse it.
+ */
+bool enqueue_dequeue_buffer(struct tegra_channel *chan,
+	struct tegra_channel_buffer *buf)
 {
-	struct tegra_channel_buffer *buf = NULL;
+	unsigned int head = chan->dequeue_head;
+	unsigned int tail = smp_load_acquire(&chan->dequeue_tail);
 
-	spin_lock(&chan->dequeue_lock);
+	if (head - tail >= CAPTURE_DEQUEUE_RING_SIZE)
+		return false;
 
-	if (list_empty(&chan->dequeue))
-		goto done;
+	chan->dequeue_ring[head & (CAPTURE_DEQUEUE_RING_SIZE - 1)] = buf;
+	smp_store_release(&chan->dequeue_head, head + 1);
 
-	buf = list_entry(chan->dequeue.next, struct tegra_channel_buffer,
-		queue);
-	list_del_init(&buf->queue);
+	return true;
+}
+
+struct tegra_channel_buffer *dequeue_dequeue_buffer(struct tegra_channel *chan)
+{
+	struct tegra_channel_buffer *buf;
+	unsigned int tail = chan->dequeue_tail;
+	unsigned int head = smp_load_acquire(&chan->dequeue_head);
+
+	if (head == tail)
+		return NULL;
+
+	buf = chan->dequeue_ring[tail & (CAPTURE_DEQUEUE_RING_SIZE - 1)];
+	smp_store_release(&chan->dequeue_tail, tail + 1);
 
-done:
-	spin_unlock(&chan->dequeue_lock);
 	return buf;
 }
 
@@ -820,13 +838,9 @@ static void tegra_channel_queued_buf_done_single_thread(
 	}
 	spin_unlock(&chan->start_lock);
 
-	/* delete dequeue list */
-	spin_lock(&chan->dequeue_lock);
-	list_for_each_entry_safe(buf, nbuf, &chan->dequeue, queue) {
+	/* drain dequeue ring, both kthreads are stopped at this point */
+	while ((buf = dequeue_dequeue_buffer(chan)) != NULL)
 		vb2_buffer_done(&buf->buf.vb2_buf, state);
-		list_del(&buf->queue);
-	}
-	spin_unlock(&chan->dequeue_lock);
 }
 
 static void tegra_channel_queued_buf_done_multi_thread(
@@ -2527,9 +2541,9 @@ int tegra_channel_init(struct tegra_channel *chan)
 	chan->capture_version = 0;
 	spin_lock_init(&chan->start_lock);
 	spin_lock_init(&chan->release_lock);
-	INIT_LIST_HEAD(&chan->dequeue);
+	chan->dequeue_head = 0;
+	chan->dequeue_tail = 0;
 	init_waitqueue_head(&chan->dequeue_wait);
-	spin_lock_init(&chan->dequeue_lock);
 	mutex_init(&chan->stop_kthread_lock);
 	init_rwsem(&chan->reset_lock);
 	atomic_set(&chan->is_streaming, DISABLE);
@@ -14,6 +14,8 @@
 #include <linux/fs.h>
 #include <linux/freezer.h>
 #include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/module.h>
 #include <linux/nvhost.h>
 #include <linux/errno.h>
 #include <linux/semaphore.h>
@@ -25,6 +27,9 @@
 #include <media/fusa-capture/capture-vi.h>
 #include <soc/tegra/camrtc-capture.h>
 #include <uapi/linux/nvhost_ioctl.h>
+#include <uapi/linux/nvhost_events.h>
+#include <asm/arch_timer.h>
+#include <camera/nvcamera_log.h>
 #include "nvhost_acm.h"
 #include "vi5_formats.h"
 #include "vi5_fops.h"
@@ -41,6 +46,18 @@
 
 #define CAPTURE_TIMEOUT_MS	2500
 
+/*
+ * Optionally bind the capture kthreads of every channel to a fixed CPU so
+ * the enqueue/dequeue handoff stays cache-local; -1 leaves them floating.
+ */
+static int enqueue_kthread_cpu = -1;
+module_param(enqueue_kthread_cpu, int, 0644);
+MODULE_PARM_DESC(enqueue_kthread_cpu, "CPU to bind the vi5 enqueue kthreads to");
+
+static int dequeue_kthread_cpu = -1;
+module_param(dequeue_kthread_cpu, int, 0644);
+MODULE_PARM_DESC(dequeue_kthread_cpu, "CPU to bind the vi5 dequeue kthreads to");
+
 static const struct vi_capture_setup default_setup = {
 	.channel_flags = 0
 	| CAPTURE_CHANNEL_FLAG_VIDEO
@@ -420,6 +437,37 @@ static void vi5_setup_surface(struct tegra_channel *chan,
 	chan->capture_descr_sequence += 1;
 }
 
+static inline u64 vi5_frame_log_now(void)
+{
+#if LINUX_VERSION_CODE < KERNEL_VERSION(5, 4, 0)
+	return arch_counter_get_cntvct();
+#else
+	return __arch_counter_get_cntvct();
+#endif
+}
+
+/*
+ * Frame latency trace: enqueue -> SOF -> EOF -> vb2_buffer_done. RCE
+ * reports SOF/EOF in nanoseconds of the TSC, which also drives the CPU
+ * system counter, so scale them to counter ticks for eventlib.
+ */
+static void vi5_frame_log(struct tegra_channel *chan, u64 ts, u32 type)
+{
+	struct tegra_vi_channel *vi_chan = chan->tegra_vi_channel[0];
+
+	if (vi_chan == NULL)
+		return;
+
+	nv_camera_log(vi_chan->ndev, ts, type);
+}
+
+static void vi5_frame_log_ns(struct tegra_channel *chan, u64 ns, u32 type)
+{
+	vi5_frame_log(chan,
+		mul_u64_u32_div(ns, arch_timer_get_cntfrq(), NSEC_PER_SEC),
+		type);
+}
+
 static void vi5_release_buffer(struct tegra_channel *chan,
 	struct tegra_channel_buffer *buf)
 {
@@ -430,6 +478,7 @@ static void vi5_release_buffer(struct tegra_channel *chan,
 	vb2_set_plane_payload(&vbuf->vb2_buf, 0, chan->format.sizeimage);
 
 	vb2_buffer_done(&vbuf->vb2_buf, buf->vb2_state);
+	vi5_frame_log(chan, vi5_frame_log_now(), NVHOST_CAMERA_VI_FRAME_DONE);
 }
 
 static void vi5_capture_enqueue(struct tegra_channel *chan,
@@ -467,11 +516,24 @@ static void vi5_capture_enqueue(struct tegra_channel *chan,
 	chan->capture_descr_index = ((chan->capture_descr_index + 1)
 					% (chan->capture_queue_depth));
 
-	spin_lock(&chan->dequeue_lock);
-	list_add_tail(&buf->queue, &chan->dequeue);
-	spin_unlock(&chan->dequeue_lock);
+	vi5_frame_log(chan, vi5_frame_log_now(),
+		NVHOST_CAMERA_VI_FRAME_ENQUEUE);
 
-	wake_up_interruptible(&chan->dequeue_wait);
+	/*
+	 * The ring is sized for CAPTURE_MAX_BUFFERS and the enqueue thread
+	 * never has more than capture_queue_depth requests in flight, so a
+	 * full ring means the bookkeeping is broken; treat it as fatal.
+	 */
+	if (!enqueue_dequeue_buffer(chan, buf)) {
+		dev_err(vi->dev, "uncorr_err: dequeue ring overflow\n");
+		buf->vb2_state = VB2_BUF_STATE_ERROR;
+		vi5_release_buffer(chan, buf);
+		goto uncorr_err;
+	}
+
+	/* wq_has_sleeper() pairs with the barrier in prepare_to_wait() */
+	if (wq_has_sleeper(&chan->dequeue_wait))
+		wake_up_interruptible(&chan->dequeue_wait);
 
 	return;
 
@@ -547,7 +609,8 @@ static void vi5_capture_dequeue(struct tegra_channel *chan,
 		spin_unlock_irqrestore(&chan->capture_state_lock, flags);
 	}
 
-	wake_up_interruptible(&chan->start_wait);
+	if (wq_has_sleeper(&chan->start_wait))
+		wake_up_interruptible(&chan->start_wait);
 	/* Read SOF from capture descriptor */
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5, 4, 0)
 	ts = ns_to_timespec((s64)descr->status.sof_timestamp);
@@ -560,6 +623,8 @@ static void vi5_capture_dequeue(struct tegra_channel *chan,
 	trace_tegra_channel_capture_frame("sof", &ts);
 #endif
 	vb->vb2_buf.timestamp = descr->status.sof_timestamp;
+	vi5_frame_log_ns(chan, descr->status.sof_timestamp,
+		NVHOST_CAMERA_VI_FRAME_SOF);
 
 	if (frame_err)
 #if LINUX_VERSION_CODE < KERNEL_VERSION(5, 4, 0)
@@ -580,6 +645,8 @@ static void vi5_capture_dequeue(struct tegra_channel *chan,
 #else
 	trace_tegra_channel_capture_frame("eof", &ts);
 #endif
+	vi5_frame_log_ns(chan, descr->status.eof_timestamp,
+		NVHOST_CAMERA_VI_FRAME_EOF);
 
 	goto rel_buf;
 
@@ -618,10 +685,7 @@ static int vi5_channel_error_recover(struct tegra_channel *chan,
 			break;
 		vb2_buffer_done(&buf->buf.vb2_buf, VB2_BUF_STATE_ERROR);
 	}
-	while (!list_empty(&chan->dequeue)) {
-		buf = dequeue_dequeue_buffer(chan);
-		if (!buf)
-			break;
+	while ((buf = dequeue_dequeue_buffer(chan)) != NULL) {
 		buf->vb2_state = VB2_BUF_STATE_ERROR;
 		vi5_capture_dequeue(chan, buf);
 	}
@@ -720,10 +784,10 @@ static int tegra_channel_kthread_capture_dequeue(void *data)
 
 		wait_event_interruptible(chan->dequeue_wait,
 			(kthread_should_stop()
-				|| !list_empty(&chan->dequeue)
+				|| !tegra_channel_dequeue_empty(chan)
 				|| (chan->capture_state == CAPTURE_ERROR)));
 
-		while (!(kthread_should_stop() || list_empty(&chan->dequeue)
+		while (!(kthread_should_stop()
 				|| (chan->capture_state == CAPTURE_ERROR))) {
 
 			buf = dequeue_dequeue_buffer(chan);
@@ -753,6 +817,29 @@ static int tegra_channel_kthread_capture_dequeue(void *data)
 	return 0;
 }
 
+static struct task_struct *vi5_channel_run_kthread(
+	struct tegra_channel *chan, int (*threadfn)(void *data), int cpu)
+{
+	struct task_struct *task;
+
+	task = kthread_create(threadfn, chan, chan->video->name);
+	if (IS_ERR(task))
+		return task;
+
+	if (cpu >= 0) {
+		if (cpu < nr_cpu_ids && cpu_online(cpu))
+			kthread_bind(task, cpu);
+		else
+			dev_warn(chan->vi->dev,
+				"cpu %d not online, kthread left unbound\n",
+				cpu);
+	}
+
+	wake_up_process(task);
+
+	return task;
+}
+
 static int vi5_channel_start_kthreads(struct tegra_channel *chan)
 {
 	int err = 0;
@@ -763,8 +850,9 @@ static int vi5_channel_start_kthreads(struct tegra_channel *chan)
 		err = -1;
 		goto done;
 	}
-	chan->kthread_capture_start = kthread_run(
-		tegra_channel_kthread_capture_enqueue, chan, chan->video->name);
+	chan->kthread_capture_start = vi5_channel_run_kthread(chan,
+		tegra_channel_kthread_capture_enqueue,
+		READ_ONCE(enqueue_kthread_cpu));
 	if (IS_ERR(chan->kthread_capture_start)) {
 		dev_err(&chan->video->dev,
 			"failed to run kthread for capture enqueue\n");
@@ -778,8 +866,9 @@ static int vi5_channel_start_kthreads(struct tegra_channel *chan)
 		err = -1;
 		goto done;
 	}
-	chan->kthread_capture_dequeue = kthread_run(
-		tegra_channel_kthread_capture_dequeue, chan, chan->video->name);
+	chan->kthread_capture_dequeue = vi5_channel_run_kthread(chan,
+		tegra_channel_kthread_capture_dequeue,
+		READ_ONCE(dequeue_kthread_cpu));
 	if (IS_ERR(chan->kthread_capture_dequeue)) {
 		dev_err(&chan->video->dev,
 			"failed to run kthread for capture dequeue\n");
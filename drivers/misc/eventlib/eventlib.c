@@ -24,6 +24,13 @@
 #include <linux/mm.h>
 #include <linux/fs.h>
 #include <linux/crc32.h>
+#include <linux/rculist.h>
+#include <linux/kthread.h>
+#include <linux/cpu.h>
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
 
 #include <linux/keventlib.h>
 
@@ -37,12 +44,17 @@
 #define EVENTLIB_SYSFS_TEST_FILE_NAME	"test"
 #define EVENTLIB_SYSFS_EVENTS_FILE_NAME	"events"
 #define EVENTLIB_SYSFS_SCHEMA_FILE_NAME	"schema"
+#define EVENTLIB_SYSFS_BENCH_FILE_NAME	"bench"
 
 #define EVENTLIB_TEST_SHM_SIZE		(PAGE_SIZE)
 
 #define EVENTLIB_MAX_PROVIDERS		256
 #define EVENTLIB_TEST_DATA_SIZE		0x10
 
+#define EVENTLIB_BENCH_SHM_SIZE		(256 * 1024)
+#define EVENTLIB_BENCH_NR_EVENTS	100000
+#define EVENTLIB_BENCH_DATA_SIZE	32
+
 struct eventlib_provider_info {
 	struct kobject *kobj;
 
@@ -54,6 +66,12 @@ struct eventlib_provider_info {
 
 	struct eventlib_ctx el_ctx;
 
+	/* Each trace buffer has a single writer at a time. With one buffer per
+	 * CPU the writers are exclusive already and no locking is needed.
+	 */
+	raw_spinlock_t buf_lock[EVENTLIB_TBUFS_MAX];
+	bool buf_shared;
+
 	void *w2r;
 	size_t w2r_size;
 
@@ -89,9 +107,10 @@ struct eventlib_test_sample {
 
 static int is_initialized;
 
-static int keventlib_init(struct eventlib_provider_info *info)
+static int
+keventlib_init(struct eventlib_provider_info *info, uint32_t num_buffers)
 {
-	int ret;
+	int ret, i;
 	struct eventlib_ctx *el_ctx = &info->el_ctx;
 
 	info->w2r = info->data;
@@ -107,11 +126,17 @@ static int keventlib_init(struct eventlib_provider_info *info)
 	el_ctx->r2w_shm = NULL;
 	el_ctx->r2w_shm_size = 0;
 	el_ctx->flags = 0;
+	el_ctx->num_buffers = num_buffers;
 
 	ret = eventlib_init(el_ctx);
 	if (ret)
 		return ret;
 
+	for (i = 0; i < EVENTLIB_TBUFS_MAX; i++)
+		raw_spin_lock_init(&info->buf_lock[i]);
+
+	info->buf_shared = el_ctx->num_buffers < nr_cpu_ids;
+
 	return 0;
 }
 
@@ -255,7 +280,8 @@ static int get_free_id(void)
 static int
 provider_init(struct eventlib_provider_info *info,
 	      size_t size, const char *name,
-	      const char *schema, size_t schema_size)
+	      const char *schema, size_t schema_size,
+	      uint32_t num_buffers)
 {
 	int ret = 0, id;
 
@@ -292,7 +318,7 @@ provider_init(struct eventlib_provider_info *info,
 	if (ret < 0)
 		goto err_free;
 
-	ret = keventlib_init(info);
+	ret = keventlib_init(info, num_buffers);
 	if (ret < 0)
 		goto err_sysfs;
 
@@ -309,7 +335,7 @@ provider_init(struct eventlib_provider_info *info,
 
 	info->id = id;
 
-	list_add_tail(&info->list, &ctx.providers);
+	list_add_tail_rcu(&info->list, &ctx.providers);
 	atomic_inc(&ctx.nr_providers);
 
 	spin_unlock(&ctx.lock);
@@ -339,7 +365,7 @@ find_provider_info(int id)
 {
 	struct eventlib_provider_info *info;
 
-	list_for_each_entry(info, &ctx.providers, list) {
+	list_for_each_entry_rcu(info, &ctx.providers, list) {
 		if (id == info->id)
 			return info;
 	}
@@ -355,6 +381,14 @@ __free_provider(struct work_struct *work)
 
 	struct eventlib_provider_info *info = wd->provider;
 
+	/* Wait for writers that may still use the provider */
+	synchronize_rcu();
+
+	eventlib_close(&info->el_ctx);
+
+	free_pages((unsigned long)info->data,
+		   get_order(info->data_size));
+
 	remove_sysfs_entry(info);
 
 	if (info->schema)
@@ -371,12 +405,7 @@ static void free_provider(struct eventlib_provider_info *info)
 {
 	struct eventlib_work_data *wd;
 
-	eventlib_close(&info->el_ctx);
-
-	free_pages((unsigned long)info->data,
-		   get_order(info->data_size));
-
-	list_del(&info->list);
+	list_del_rcu(&info->list);
 
 	wd = kmalloc(sizeof(*wd), GFP_ATOMIC);
 	if (!wd)
@@ -397,6 +426,30 @@ static void unregister_all_providers(void)
 	spin_unlock(&ctx.lock);
 }
 
+static void
+provider_write(struct eventlib_provider_info *info,
+	       void *data, size_t size, uint32_t type, uint64_t ts)
+{
+	uint32_t idx = 0;
+	unsigned long flags;
+	uint32_t num_buffers = info->el_ctx.num_buffers;
+
+	local_irq_save(flags);
+
+	if (num_buffers > 1)
+		idx = smp_processor_id() % num_buffers;
+
+	if (info->buf_shared)
+		raw_spin_lock(&info->buf_lock[idx]);
+
+	eventlib_write(&info->el_ctx, idx, type, ts, data, size);
+
+	if (info->buf_shared)
+		raw_spin_unlock(&info->buf_lock[idx]);
+
+	local_irq_restore(flags);
+}
+
 int keventlib_write(int id, void *data, size_t size, uint32_t type, uint64_t ts)
 {
 	int err = 0;
@@ -404,7 +457,7 @@ int keventlib_write(int id, void *data, size_t size, uint32_t type, uint64_t ts)
 
 	pr_debug("%s: size: %#zx\n", __func__, size);
 
-	spin_lock(&ctx.lock);
+	rcu_read_lock();
 
 	info = find_provider_info(id);
 	if (!info) {
@@ -417,16 +470,18 @@ int keventlib_write(int id, void *data, size_t size, uint32_t type, uint64_t ts)
 		goto err_out;
 	}
 
-	eventlib_write(&info->el_ctx, 0, type, ts, data, size);
+	provider_write(info, data, size, type, ts);
 
 err_out:
-	spin_unlock(&ctx.lock);
+	rcu_read_unlock();
 	return err;
 }
 EXPORT_SYMBOL(keventlib_write);
 
-int keventlib_register(size_t size, const char *name,
-		       const char *schema, size_t schema_size)
+static int
+__keventlib_register(size_t size, const char *name,
+		     const char *schema, size_t schema_size,
+		     uint32_t num_buffers)
 {
 	int ret;
 	struct eventlib_provider_info *info;
@@ -440,7 +495,8 @@ int keventlib_register(size_t size, const char *name,
 	if (!info)
 		return -ENOMEM;
 
-	ret = provider_init(info, size, name, schema, schema_size);
+	ret = provider_init(info, size, name, schema, schema_size,
+			    num_buffers);
 	if (ret < 0) {
 		kfree(info);
 		return ret;
@@ -448,8 +504,27 @@ int keventlib_register(size_t size, const char *name,
 
 	return info->id;
 }
+
+int keventlib_register(size_t size, const char *name,
+		       const char *schema, size_t schema_size)
+{
+	return __keventlib_register(size, name, schema, schema_size, 1);
+}
 EXPORT_SYMBOL(keventlib_register);
 
+static uint32_t keventlib_nr_writer_buffers(void)
+{
+	return min_t(uint32_t, nr_cpu_ids, EVENTLIB_TBUFS_MAX);
+}
+
+int keventlib_register_multi_writer(size_t size, const char *name,
+				    const char *schema, size_t schema_size)
+{
+	return __keventlib_register(size, name, schema, schema_size,
+				    keventlib_nr_writer_buffers());
+}
+EXPORT_SYMBOL(keventlib_register_multi_writer);
+
 void keventlib_unregister(int id)
 {
 	struct eventlib_provider_info *info;
@@ -498,6 +573,164 @@ static void put_test_data(int id)
 	}
 }
 
+struct eventlib_bench {
+	struct eventlib_provider_info *info;
+
+	struct completion start;
+	struct completion done;
+	atomic_t nr_running;
+};
+
+static int eventlib_bench_thread(void *data)
+{
+	int i;
+	struct eventlib_bench *bench = data;
+	uint8_t payload[EVENTLIB_BENCH_DATA_SIZE];
+
+	memset(payload, 0xa5, sizeof(payload));
+
+	wait_for_completion(&bench->start);
+
+	for (i = 0; i < EVENTLIB_BENCH_NR_EVENTS; i++)
+		provider_write(bench->info, payload, sizeof(payload), 0, i);
+
+	if (atomic_dec_and_test(&bench->nr_running))
+		complete(&bench->done);
+
+	return 0;
+}
+
+/* Returns the aggregate write rate in events per second */
+static u64
+eventlib_bench_run(struct eventlib_provider_info *info,
+		   unsigned int nr_writers)
+{
+	u64 ts_start, ts_delta;
+	unsigned int cpu, nr_started = 0;
+	struct task_struct *task;
+	struct eventlib_bench bench;
+
+	bench.info = info;
+	init_completion(&bench.start);
+	init_completion(&bench.done);
+	atomic_set(&bench.nr_running, 0);
+
+	cpus_read_lock();
+	for_each_online_cpu(cpu) {
+		if (nr_started == nr_writers)
+			break;
+
+		task = kthread_create_on_cpu(eventlib_bench_thread, &bench,
+					     cpu, "eventlib_bench/%u");
+		if (IS_ERR(task))
+			break;
+
+		atomic_inc(&bench.nr_running);
+		wake_up_process(task);
+		nr_started++;
+	}
+	cpus_read_unlock();
+
+	ts_start = ktime_get_ns();
+	complete_all(&bench.start);
+
+	if (nr_started == 0)
+		return 0;
+
+	wait_for_completion(&bench.done);
+	ts_delta = ktime_get_ns() - ts_start;
+
+	return div64_u64((u64)nr_started * EVENTLIB_BENCH_NR_EVENTS *
+			 NSEC_PER_SEC, max_t(u64, ts_delta, 1));
+}
+
+static struct eventlib_provider_info *
+eventlib_bench_provider_alloc(uint32_t num_buffers)
+{
+	int ret;
+	struct eventlib_provider_info *info;
+
+	info = kzalloc(sizeof(*info), GFP_KERNEL);
+	if (!info)
+		return NULL;
+
+	info->data = (void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO,
+				get_order(EVENTLIB_BENCH_SHM_SIZE));
+	if (!info->data) {
+		kfree(info);
+		return NULL;
+	}
+
+	info->data_size = EVENTLIB_BENCH_SHM_SIZE;
+
+	ret = keventlib_init(info, num_buffers);
+	if (ret < 0) {
+		free_pages((unsigned long)info->data,
+			   get_order(EVENTLIB_BENCH_SHM_SIZE));
+		kfree(info);
+		return NULL;
+	}
+
+	return info;
+}
+
+static void eventlib_bench_provider_free(struct eventlib_provider_info *info)
+{
+	if (!info)
+		return;
+
+	eventlib_close(&info->el_ctx);
+	free_pages((unsigned long)info->data,
+		   get_order(EVENTLIB_BENCH_SHM_SIZE));
+	kfree(info);
+}
+
+/*
+ * Compares the write throughput of a single shared trace buffer with
+ * per-CPU trace buffers while the number of concurrent writers grows.
+ */
+static ssize_t
+bench_show(struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+	ssize_t len = 0;
+	unsigned int nr_writers, max_writers = num_online_cpus();
+	struct eventlib_provider_info *single, *percpu;
+	static DEFINE_MUTEX(bench_lock);
+
+	if (!mutex_trylock(&bench_lock))
+		return -EBUSY;
+
+	single = eventlib_bench_provider_alloc(1);
+	percpu = eventlib_bench_provider_alloc(keventlib_nr_writer_buffers());
+	if (!single || !percpu) {
+		len = -ENOMEM;
+		goto out;
+	}
+
+	len += scnprintf(buf + len, PAGE_SIZE - len,
+			 "%-8s %-16s %-16s\n",
+			 "writers", "single (ev/s)", "per-cpu (ev/s)");
+
+	for (nr_writers = 1; ; nr_writers = min(nr_writers * 2, max_writers)) {
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%-8u %-16llu %-16llu\n", nr_writers,
+				 eventlib_bench_run(single, nr_writers),
+				 eventlib_bench_run(percpu, nr_writers));
+
+		if (nr_writers == max_writers)
+			break;
+	}
+
+out:
+	eventlib_bench_provider_free(single);
+	eventlib_bench_provider_free(percpu);
+	mutex_unlock(&bench_lock);
+
+	return len;
+}
+
+static struct kobj_attribute bench_attr = __ATTR_RO_MODE(bench, 0400);
+
 static int __init
 eventlib_module_init(void)
 {
@@ -519,6 +752,11 @@ eventlib_module_init(void)
 		return -ENOMEM;
 	}
 
+	ret = sysfs_create_file(ctx.kobj_root, &bench_attr.attr);
+	if (ret)
+		pr_warn("Unable to create sysfs file: %s\n",
+			EVENTLIB_SYSFS_BENCH_FILE_NAME);
+
 	is_initialized = 1;
 
 	ret = keventlib_register(EVENTLIB_TEST_SHM_SIZE,
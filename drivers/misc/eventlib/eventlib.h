@@ -30,6 +30,9 @@
 /* Possible init flags */
 #define EVENTLIB_FLAG_INIT_FILTERING (1 << 0)
 
+/* Maximum number of trace buffers */
+#define EVENTLIB_TBUFS_MAX 12
+
 /* These are used to ensure binary compatibility between library and caller
  * If eventlib_ctx is ever changed in incompatible way, EVENTLIB_CTX_VERSION
  * must be increased.
@@ -94,7 +97,7 @@ struct eventlib_ctx {
 	/* Filtering parameters */
 	uint16_t flt_num_bits[EVENTLIB_FILTER_DOMAIN_MAX];
 
-	/* Number of trace buffers
+	/* Number of trace buffers, up to EVENTLIB_TBUFS_MAX
 	 * Below value will be adjusted to one if set as zero.
 	 * Reader context value is ignored
 	 */
@@ -154,6 +157,8 @@ void eventlib_close(struct eventlib_ctx *ctx);
  *
  * This operation never fails.
  * Data may be truncated if too large. Old events may get overwritten.
+ * Each trace buffer has a single writer: writes to the same idx must be
+ * serialized by the caller, writes to different idx may run concurrently.
  */
 
 void eventlib_write(struct eventlib_ctx *ctx, uint32_t idx,
@@ -193,6 +198,15 @@ struct record {
 int eventlib_read(struct eventlib_ctx *ctx, void *buffer, uint32_t *size,
 	uint64_t *lost);
 
+/* Same as eventlib_read(), but events from all trace buffers are merged into
+ * a single stream ordered by timestamp, newest events first. To be used when
+ * the writer spreads one event stream over several trace buffers (e.g. one
+ * buffer per CPU), so timestamps must come from a common time base.
+ */
+
+int eventlib_read_merged(struct eventlib_ctx *ctx, void *buffer,
+	uint32_t *size, uint64_t *lost);
+
 /* ========================================
  * Filtering feature
  * ========================================
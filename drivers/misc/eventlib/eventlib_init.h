@@ -60,8 +60,6 @@
 #define EVENTLIB_SUBSYS_FILTERING 1
 #define EVENTLIB_SUBSYS_MAX       2
 
-#define EVENTLIB_TBUFS_MAX        12
-
 #define EVENTLIB_MAGIC_W2R 0x52574c45 /* 'ELWR' in little endian */
 #define EVENTLIB_MAGIC_R2W 0x57524c45 /* 'ELRW' in little endian */
 
@@ -335,3 +335,193 @@ int eventlib_read(struct eventlib_ctx *ctx, void *buffer, uint32_t *size,
 
 	return ret;
 }
+
+/* Per-buffer state used when merging several trace buffers */
+struct tbuf_cursor {
+	struct pullstate state;
+	struct record rec;
+	uint64_t seqid;
+	uint64_t min;
+	uint64_t max;
+	bool valid;
+};
+
+/* Fetch header of the next event without advancing the cursor */
+static int tbuf_cursor_peek(struct eventlib_tbuf_ctx *tbuf,
+	struct tbuf_cursor *cur)
+{
+	struct pullstate state = cur->state;
+	struct tracehdr hdr;
+	unsigned int i;
+	uint32_t length;
+	int ret = -EPROTO;
+
+	for (i = 0; i < PULL_COUNT_MAX; i++) {
+		length = 0;
+
+		ret = tracebuf_pull(&tbuf->tbuf_ctx, &state,
+			&hdr, NULL, &length);
+
+		if (ret != -EAGAIN)
+			break;
+	}
+
+	cur->valid = false;
+
+	if (ret == -ENOBUFS)
+		return 0;
+
+	if (ret != 0)
+		return ret;
+
+	/* Older events have already been delivered */
+	if (hdr.seqid <= tbuf->seqid_ack)
+		return 0;
+
+	cur->rec.size = hdr.length < tbuf->tbuf_ctx.maxsize ?
+		hdr.length : tbuf->tbuf_ctx.maxsize;
+	cur->rec.type = (uint32_t)hdr.reserved;
+	cur->rec.ts = hdr.params;
+	cur->seqid = hdr.seqid;
+	cur->valid = true;
+
+	return 0;
+}
+
+static int tbuf_pull_merged(struct eventlib_ctx *ctx,
+	struct tbuf_cursor *cursors, uint32_t num, void *buffer,
+	uint32_t *size)
+{
+	struct eventlib_tbuf_ctx *tbuf;
+	struct tbuf_cursor *cur;
+	uint64_t seqid = 0ULL;
+	uintptr_t current;
+	uint32_t length;
+	uint32_t avail;
+	uint32_t idx, best;
+	int ret;
+
+	for (idx = 0; idx < num; idx++) {
+		cur = &cursors[idx];
+		tbuf = &ctx->priv->tbuf[idx];
+
+		cur->min = SEQUENCE_ID_MAX;
+		cur->max = SEQUENCE_ID_MIN;
+
+		pull_init(&tbuf->tbuf_ctx, &cur->state);
+
+		ret = tbuf_cursor_peek(tbuf, cur);
+		if (ret != 0)
+			return ret;
+	}
+
+	current = (uintptr_t)buffer;
+	avail = *size;
+
+	while (avail >= sizeof(struct record)) {
+		/* Pick the newest pending event among all trace buffers */
+		best = num;
+		for (idx = 0; idx < num; idx++) {
+			if (!cursors[idx].valid)
+				continue;
+
+			if (best == num ||
+			    cursors[idx].rec.ts > cursors[best].rec.ts)
+				best = idx;
+		}
+
+		if (best == num)
+			break;
+
+		cur = &cursors[best];
+		tbuf = &ctx->priv->tbuf[best];
+
+		length = avail - (uint32_t)sizeof(struct record);
+
+		ret = tbuf_pull_single(tbuf, &cur->state, &seqid,
+			(struct record *)current,
+			(void *)(current + sizeof(struct record)),
+			&length);
+
+		if (ret == -ENOBUFS) {
+			cur->valid = false;
+			continue;
+		}
+
+		if (ret != 0)
+			return ret;
+
+		/* The event has been overwritten since it was peeked */
+		if (seqid != cur->seqid)
+			return -EINTR;
+
+		if (seqid > cur->max)
+			cur->max = seqid;
+
+		if (seqid < cur->min)
+			cur->min = seqid;
+
+		if (avail < (uint32_t)sizeof(struct record) + length)
+			return -EIO;
+
+		avail -= (uint32_t)sizeof(struct record) + length;
+		current += (uint32_t)sizeof(struct record) + length;
+
+		ret = tbuf_cursor_peek(tbuf, cur);
+		if (ret != 0)
+			return ret;
+	}
+
+	*size = *size - avail;
+
+	return 0;
+}
+
+int eventlib_read_merged(struct eventlib_ctx *ctx, void *buffer,
+	uint32_t *size, uint64_t *lost)
+{
+	struct tbuf_cursor cursors[EVENTLIB_TBUFS_MAX];
+	struct eventlib_tbuf_ctx *tbuf;
+	uint32_t num, idx;
+	uint32_t avail;
+	unsigned int i;
+	int ret = -EPROTO;
+
+	if (lost)
+		*lost = 0;
+
+	if (ctx->direction != EVENTLIB_DIRECTION_READER)
+		return -EPROTO;
+
+	num = ctx->priv->w2r_copy.num_buffers;
+	avail = *size;
+
+	for (i = 0; i < INIT_COUNT_MAX; i++) {
+		*size = avail;
+
+		ret = tbuf_pull_merged(ctx, cursors, num, buffer, size);
+		if (ret != -EINTR)
+			break;
+	}
+
+	if (ret != 0) {
+		*size = 0;
+		return ret;
+	}
+
+	for (idx = 0; idx < num; idx++) {
+		tbuf = &ctx->priv->tbuf[idx];
+
+		/* Nothing has been delivered from this trace buffer */
+		if (cursors[idx].max == SEQUENCE_ID_MIN)
+			continue;
+
+		/* Lost events are seq IDs in range (seqid_ack, min) */
+		if (lost && cursors[idx].min > tbuf->seqid_ack + 1)
+			*lost += cursors[idx].min - tbuf->seqid_ack - 1;
+
+		tbuf->seqid_ack = cursors[idx].max;
+	}
+
+	return 0;
+}
@@ -27,6 +27,7 @@
 #include "eh_unwind.h"
 #include "dwarf_unwind.h"
 #include "hrt.h"
+#include "comm.h"
 #include "tegra.h"
 
 static inline bool
@@ -86,6 +87,28 @@ put_unw_type(u32 *p, int bt_idx, unsigned int type)
 	*(p + word_idx) |= (type & 0x0f) << shift;
 }
 
+static int
+callchain_store_in_place(struct quadd_callchain *cc,
+			 unsigned long ip, unsigned int type)
+{
+	u32 ip_32 = ip;
+	u64 ip_64 = ip;
+	size_t ip_size = cc->cs_64 ? sizeof(ip_64) : sizeof(ip_32);
+	struct quadd_rb_span *span = cc->span;
+
+	/* Keep the room for the rest of the sample */
+	if (quadd_rb_span_room(span) < ip_size + cc->span_tail) {
+		cc->urc_fp = QUADD_URC_LEVEL_TOO_DEEP;
+		return 0;
+	}
+
+	quadd_rb_span_write(span, cc->cs_64 ? (void *)&ip_64 : (void *)&ip_32,
+			    ip_size);
+	put_unw_type(cc->types, cc->nr++, type);
+
+	return 1;
+}
+
 int
 quadd_callchain_store(struct quadd_callchain *cc,
 		      unsigned long ip, unsigned int type)
@@ -102,6 +125,9 @@ quadd_callchain_store(struct quadd_callchain *cc,
 		return 0;
 	}
 
+	if (cc->span)
+		return callchain_store_in_place(cc, ip, type);
+
 	put_unw_type(cc->types, cc->nr, type);
 
 	if (cc->cs_64)
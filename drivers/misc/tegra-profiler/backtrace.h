@@ -30,6 +30,7 @@
 	DIV_ROUND_UP(QUADD_MAX_STACK_DEPTH * 4, sizeof(u32) * BITS_PER_BYTE)
 
 struct quadd_hrt_ctx;
+struct quadd_rb_span;
 
 struct quadd_unw_methods {
 	unsigned int
@@ -51,6 +52,10 @@ struct quadd_callchain {
 
 	unsigned int cs_64:1;
 
+	/* if set, the addresses are stored directly into the ring buffer */
+	struct quadd_rb_span *span;
+	size_t span_tail;
+
 	struct quadd_unw_methods um;
 
 	unsigned int urc_fp;
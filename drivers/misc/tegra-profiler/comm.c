@@ -44,6 +44,8 @@ struct quadd_ring_buffer {
 	struct quadd_mmap_area *mmap;
 
 	raw_spinlock_t lock;
+	/* cpu writing a reserved span, -1 if none; under lock */
+	int owner;
 };
 
 struct quadd_comm_ctx {
@@ -68,70 +70,128 @@ struct comm_cpu_context {
 static struct quadd_comm_ctx comm_ctx;
 static DEFINE_PER_CPU(struct comm_cpu_context, cpu_ctx);
 
-static void
-rb_write(struct quadd_ring_buffer_hdr *rb_hdr,
-	 char *buf, const void *data, size_t length)
+/*
+ * Wait until the span reserved in @rb, if any, is committed. Called and
+ * returns with rb->lock held. A writer nested in the owner of the span on
+ * the same cpu cannot wait for it and gets -EBUSY.
+ */
+static int rb_wait_span(struct quadd_ring_buffer *rb, unsigned long *flags)
 {
-	size_t len, head = rb_hdr->pos_write;
-	const char *s = data;
-
-	if (length == 0)
-		return;
-
-	len = min_t(size_t, rb_hdr->size - head, length);
-
-	memcpy(buf + head, s, len);
-	head = (head + len) & (rb_hdr->size - 1);
-
-	if (length > len) {
-		s += len;
-		len = length - len;
+	while (rb->owner >= 0) {
+		if (rb->owner == raw_smp_processor_id())
+			return -EBUSY;
 
-		memcpy(buf + head, s, len);
-		head += len;
+		raw_spin_unlock_irqrestore(&rb->lock, *flags);
+		cpu_relax();
+		raw_spin_lock_irqsave(&rb->lock, *flags);
 	}
 
-	rb_hdr->pos_write = head;
+	return 0;
 }
 
-static ssize_t
-write_sample(struct quadd_ring_buffer *rb,
-	     struct quadd_record_data *sample,
-	     const struct quadd_iovec *vec, int vec_count)
+/*
+ * The ring buffer is only locked while the span is being claimed, so the
+ * caller may fill it, e.g. by unwinding straight into it, without holding
+ * the lock or keeping interrupts off. Other writers wait for the commit.
+ */
+static int
+rb_reserve(struct quadd_rb_span *span, size_t min_len,
+	   size_t max_len, int cpu_id)
 {
-	int i;
-	size_t len = 0, c;
-	struct quadd_ring_buffer_hdr hdr, *rb_hdr = rb->rb_hdr;
+	int err;
+	size_t space;
+	unsigned long flags;
+	struct comm_cpu_context *cc;
+	struct quadd_ring_buffer *rb;
+	struct quadd_ring_buffer_hdr *rb_hdr;
 
-	if (!rb_hdr)
+	if (!atomic_read(&comm_ctx.active))
 		return -EIO;
 
-	if (vec) {
-		for (i = 0; i < vec_count; i++)
-			len += vec[i].len;
+	cc = cpu_id < 0 ? this_cpu_ptr(&cpu_ctx) :
+		&per_cpu(cpu_ctx, cpu_id);
+
+	rb = &cc->rb;
+
+	raw_spin_lock_irqsave(&rb->lock, flags);
+
+	err = rb_wait_span(rb, &flags);
+	if (err < 0) {
+		rb->nr_skipped_samples++;
+		if (rb->rb_hdr)
+			rb->rb_hdr->skipped_samples++;
+
+		raw_spin_unlock_irqrestore(&rb->lock, flags);
+		return err;
 	}
 
-	sample->extra_size = len;
-	len += sizeof(*sample);
+	rb_hdr = rb->rb_hdr;
+	if (!rb_hdr) {
+		rb->nr_skipped_samples++;
+		raw_spin_unlock_irqrestore(&rb->lock, flags);
+		return -EIO;
+	}
 
-	hdr.size = rb_hdr->size;
-	hdr.pos_write = rb_hdr->pos_write;
-	hdr.pos_read = READ_ONCE(rb_hdr->pos_read);
+	min_len += sizeof(struct quadd_record_data);
+	max_len += sizeof(struct quadd_record_data);
 
-	c = CIRC_SPACE(hdr.pos_write, hdr.pos_read, hdr.size);
-	if (len > c) {
+	space = CIRC_SPACE(rb_hdr->pos_write,
+			   READ_ONCE(rb_hdr->pos_read), rb_hdr->size);
+	if (min_len > space) {
 		pr_info_once("[cpu:%d] buffer overflow\n", smp_processor_id());
+
+		rb->nr_skipped_samples++;
+		rb_hdr->skipped_samples++;
+
+		raw_spin_unlock_irqrestore(&rb->lock, flags);
 		return -ENOSPC;
 	}
 
-	rb_write(&hdr, rb->buf, sample, sizeof(*sample));
+	span->rb = rb;
+	span->buf = rb->buf;
+	span->size = rb_hdr->size;
+	span->start = rb_hdr->pos_write;
+	span->len = min_t(size_t, space, max_len);
+	span->pos = sizeof(struct quadd_record_data);
+	span->err = 0;
 
-	if (vec) {
-		for (i = 0; i < vec_count; i++)
-			rb_write(&hdr, rb->buf, vec[i].base, vec[i].len);
+	rb->owner = raw_smp_processor_id();
+
+	raw_spin_unlock_irqrestore(&rb->lock, flags);
+
+	return 0;
+}
+
+static ssize_t
+rb_commit(struct quadd_rb_span *span, struct quadd_record_data *data)
+{
+	size_t c, pos_write;
+	unsigned long flags;
+	struct quadd_ring_buffer *rb = span->rb;
+	struct quadd_ring_buffer_hdr *rb_hdr = rb->rb_hdr;
+
+	if (!span->err) {
+		data->extra_size = span->pos - sizeof(*data);
+		quadd_rb_span_write_at(span, 0, data, sizeof(*data));
+	}
+
+	raw_spin_lock_irqsave(&rb->lock, flags);
+
+	rb->owner = -1;
+
+	if (span->err) {
+		pr_info_once("[cpu:%d] record overflow\n", smp_processor_id());
+
+		rb->nr_skipped_samples++;
+		rb_hdr->skipped_samples++;
+
+		raw_spin_unlock_irqrestore(&rb->lock, flags);
+		return span->err;
 	}
 
-	c = CIRC_CNT(hdr.pos_write, hdr.pos_read, hdr.size);
+	pos_write = (span->start + span->pos) & (span->size - 1);
+
+	c = CIRC_CNT(pos_write, READ_ONCE(rb_hdr->pos_read), span->size);
 	if (c > rb->max_fill_count) {
 		rb->max_fill_count = c;
 		rb_hdr->max_fill_count = c;
@@ -140,9 +200,21 @@ write_sample(struct quadd_ring_buffer *rb,
 	/* Use smp_store_release() to update circle buffer write pointers to
 	 * ensure the data is stored before we update write pointer.
 	 */
-	smp_store_release(&rb_hdr->pos_write, hdr.pos_write);
+	smp_store_release(&rb_hdr->pos_write, pos_write);
 
-	return len;
+	raw_spin_unlock_irqrestore(&rb->lock, flags);
+
+	return span->pos;
+}
+
+static void rb_cancel(struct quadd_rb_span *span)
+{
+	unsigned long flags;
+	struct quadd_ring_buffer *rb = span->rb;
+
+	raw_spin_lock_irqsave(&rb->lock, flags);
+	rb->owner = -1;
+	raw_spin_unlock_irqrestore(&rb->lock, flags);
 }
 
 static size_t get_data_size(void)
@@ -179,33 +251,33 @@ put_sample(struct quadd_record_data *data,
 	   struct quadd_iovec *vec,
 	   int vec_count, int cpu_id)
 {
-	ssize_t err = 0;
+	int i;
+	ssize_t err;
+	size_t len = 0;
 	unsigned long flags;
-	struct comm_cpu_context *cc;
-	struct quadd_ring_buffer *rb;
-	struct quadd_ring_buffer_hdr *rb_hdr;
-
-	if (!atomic_read(&comm_ctx.active))
-		return -EIO;
-
-	cc = cpu_id < 0 ? this_cpu_ptr(&cpu_ctx) :
-		&per_cpu(cpu_ctx, cpu_id);
+	struct quadd_rb_span span;
 
-	rb = &cc->rb;
+	if (vec) {
+		for (i = 0; i < vec_count; i++)
+			len += vec[i].len;
+	}
 
-	raw_spin_lock_irqsave(&rb->lock, flags);
+	/* keep a local interrupt from finding the span claimed */
+	local_irq_save(flags);
 
-	err = write_sample(rb, data, vec, vec_count);
-	if (err < 0) {
-		rb->nr_skipped_samples++;
+	err = rb_reserve(&span, len, len, cpu_id);
+	if (err < 0)
+		goto out;
 
-		rb_hdr = rb->rb_hdr;
-		if (rb_hdr)
-			rb_hdr->skipped_samples++;
+	/* a failed write is reported by rb_commit() */
+	if (vec) {
+		for (i = 0; i < vec_count; i++)
+			quadd_rb_span_write(&span, vec[i].base, vec[i].len);
 	}
 
-	raw_spin_unlock_irqrestore(&rb->lock, flags);
-
+	err = rb_commit(&span, data);
+out:
+	local_irq_restore(flags);
 	return err;
 }
 
@@ -221,6 +293,9 @@ static int is_active(void)
 
 static struct quadd_comm_data_interface comm_data = {
 	.put_sample = put_sample,
+	.reserve = rb_reserve,
+	.commit = rb_commit,
+	.cancel = rb_cancel,
 	.reset = comm_reset,
 	.is_active = is_active,
 };
@@ -316,6 +391,7 @@ init_mmap_hdr(struct quadd_mmap_rb_info *mmap_rb,
 	size -= PAGE_SIZE;
 
 	raw_spin_lock_irqsave(&rb->lock, flags);
+	WARN_ON_ONCE(rb_wait_span(rb, &flags));
 
 	mmap->rb = rb;
 
@@ -385,6 +461,7 @@ static void rb_reset(struct quadd_ring_buffer *rb)
 		return;
 
 	raw_spin_lock_irqsave(&rb->lock, flags);
+	WARN_ON_ONCE(rb_wait_span(rb, &flags));
 
 	rb->mmap = NULL;
 	rb->buf = NULL;
@@ -393,6 +470,27 @@ static void rb_reset(struct quadd_ring_buffer *rb)
 	raw_spin_unlock_irqrestore(&rb->lock, flags);
 }
 
+int quadd_comm_get_rb_stats(int cpuid, struct quadd_comm_rb_stats *stats)
+{
+	unsigned long flags;
+	struct quadd_ring_buffer *rb;
+
+	if (!cpu_possible(cpuid))
+		return -EINVAL;
+
+	rb = &per_cpu(cpu_ctx, cpuid).rb;
+
+	raw_spin_lock_irqsave(&rb->lock, flags);
+
+	stats->size = rb->rb_hdr ? rb->rb_hdr->size : 0;
+	stats->max_fill_count = rb->max_fill_count;
+	stats->nr_skipped_samples = rb->nr_skipped_samples;
+
+	raw_spin_unlock_irqrestore(&rb->lock, flags);
+
+	return 0;
+}
+
 static int
 ready_to_profile(void)
 {
@@ -979,6 +1077,7 @@ static int comm_init(void)
 		rb->nr_skipped_samples = 0;
 
 		raw_spin_lock_init(&rb->lock);
+		rb->owner = -1;
 	}
 
 	reset_params_ok_flag();
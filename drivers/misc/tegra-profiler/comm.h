@@ -18,6 +18,9 @@
 #define __QUADD_COMM_H__
 
 #include <linux/types.h>
+#include <linux/string.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
 #include "eh_unwind.h"
 
 struct quadd_ctx;
@@ -35,6 +38,57 @@ struct quadd_iovec {
 	size_t len;
 };
 
+/*
+ * In-place reservation in a per-cpu ring buffer. The span is claimed by
+ * the reserving cpu until commit()/cancel(), without the ring buffer
+ * lock held; the record header is written by commit(). A write past the
+ * reserved length is dropped and makes commit() discard the record with
+ * -ENOSPC.
+ */
+struct quadd_rb_span {
+	struct quadd_ring_buffer *rb;
+	char *buf;
+	size_t size;
+
+	size_t start;
+	size_t len;
+	size_t pos;
+	int err;
+};
+
+static inline size_t quadd_rb_span_room(const struct quadd_rb_span *span)
+{
+	return span->len - span->pos;
+}
+
+static inline void
+quadd_rb_span_write_at(struct quadd_rb_span *span, size_t offset,
+		       const void *data, size_t length)
+{
+	size_t len, head = (span->start + offset) & (span->size - 1);
+
+	len = min_t(size_t, span->size - head, length);
+	memcpy(span->buf + head, data, len);
+
+	if (length > len)
+		memcpy(span->buf, (const char *)data + len, length - len);
+}
+
+static inline int
+quadd_rb_span_write(struct quadd_rb_span *span,
+		    const void *data, size_t length)
+{
+	if (length > quadd_rb_span_room(span)) {
+		span->err = -ENOSPC;
+		return -ENOSPC;
+	}
+
+	quadd_rb_span_write_at(span, span->pos, data, length);
+	span->pos += length;
+
+	return 0;
+}
+
 enum {
 	QUADD_MMAP_TYPE_NONE = 1,
 	QUADD_MMAP_TYPE_EXTABS,
@@ -84,13 +138,26 @@ struct quadd_comm_data_interface {
 	ssize_t (*put_sample)(struct quadd_record_data *data,
 			      struct quadd_iovec *vec,
 			      int vec_count, int cpu_id);
+	int (*reserve)(struct quadd_rb_span *span, size_t min_len,
+		       size_t max_len, int cpu_id);
+	ssize_t (*commit)(struct quadd_rb_span *span,
+			  struct quadd_record_data *data);
+	void (*cancel)(struct quadd_rb_span *span);
 	void (*reset)(void);
 	int (*is_active)(void);
 };
 
+struct quadd_comm_rb_stats {
+	size_t size;
+	size_t max_fill_count;
+	size_t nr_skipped_samples;
+};
+
 struct quadd_comm_data_interface *
 quadd_comm_init(struct quadd_ctx *ctx,
 		struct quadd_comm_control_interface *control);
 void quadd_comm_exit(void);
 
+int quadd_comm_get_rb_stats(int cpuid, struct quadd_comm_rb_stats *stats);
+
 #endif	/* __QUADD_COMM_H__ */
@@ -25,6 +25,10 @@
 #include <linux/err.h>
 #include <linux/rculist.h>
 #include <linux/random.h>
+#include <linux/hashtable.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
+#include <linux/vmalloc.h>
 #include <linux/version.h>
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(4, 10, 0))
 #include <linux/sched/task_stack.h>
@@ -50,21 +54,39 @@ static struct quadd_hrt_ctx hrt = {
 	.mmap_active = ATOMIC_INIT(0),
 };
 
+struct quadd_pid_filter_cache {
+	pid_t tgid;
+	int gen;
+	bool match;
+};
+
+/* The last delta-encoded callchain, the outermost frame first */
+struct quadd_cc_ref {
+	int nr;
+	pid_t tgid;
+	unsigned int cs_64:1;
+	u64 ip[QUADD_MAX_STACK_DEPTH];
+};
+
 struct quadd_cpu_context {
 	struct hrtimer hrtimer;
 
 	struct quadd_callchain cc;
+	struct quadd_cc_ref cc_ref;
+	struct quadd_cc_stats cc_stats;
 	char mmap_filename[PATH_MAX];
 
 	struct quadd_thread_data active_thread;
 	bool is_sampling_enabled;
 	bool is_tracing_enabled;
 
+	struct quadd_pid_filter_cache pid_cache;
+
 	struct quadd_event_data events[QUADD_MAX_COUNTERS];
 };
 
 struct hrt_pid_node {
-	struct list_head list;
+	struct hlist_node node;
 	struct rcu_head rcu;
 	pid_t pid;
 };
@@ -76,6 +98,15 @@ static void pid_free_rcu(struct rcu_head *head)
 	kfree(entry);
 }
 
+/*
+ * Every change of the pid table bumps pid_list_gen, so the per-cpu filter
+ * caches (see pid_filter_match) never return a stale decision.
+ */
+static inline void pid_list_changed(void)
+{
+	atomic_inc(&hrt.pid_list_gen);
+}
+
 static int pid_list_add(pid_t pid)
 {
 	struct hrt_pid_node *entry;
@@ -85,10 +116,10 @@ static int pid_list_add(pid_t pid)
 		return -ENOMEM;
 
 	entry->pid = pid;
-	INIT_LIST_HEAD(&entry->list);
 
 	raw_spin_lock(&hrt.pid_list_lock);
-	list_add_tail_rcu(&entry->list, &hrt.pid_list);
+	hash_add_rcu(hrt.pid_hash, &entry->node, pid);
+	pid_list_changed();
 	raw_spin_unlock(&hrt.pid_list_lock);
 
 	return 0;
@@ -99,10 +130,11 @@ static void pid_list_del(pid_t pid)
 	struct hrt_pid_node *entry;
 
 	raw_spin_lock(&hrt.pid_list_lock);
-	list_for_each_entry(entry, &hrt.pid_list, list) {
+	hash_for_each_possible(hrt.pid_hash, entry, node, pid) {
 		if (entry->pid == pid) {
-			list_del_rcu(&entry->list);
+			hash_del_rcu(&entry->node);
 			call_rcu(&entry->rcu, pid_free_rcu);
+			pid_list_changed();
 			break;
 		}
 	}
@@ -111,13 +143,16 @@ static void pid_list_del(pid_t pid)
 
 static void pid_list_clear(void)
 {
-	struct hrt_pid_node *entry, *next;
+	int bkt;
+	struct hlist_node *tmp;
+	struct hrt_pid_node *entry;
 
 	raw_spin_lock(&hrt.pid_list_lock);
-	list_for_each_entry_safe(entry, next, &hrt.pid_list, list) {
-		list_del_rcu(&entry->list);
+	hash_for_each_safe(hrt.pid_hash, bkt, tmp, entry, node) {
+		hash_del_rcu(&entry->node);
 		call_rcu(&entry->rcu, pid_free_rcu);
 	}
+	pid_list_changed();
 	raw_spin_unlock(&hrt.pid_list_lock);
 }
 
@@ -127,7 +162,7 @@ static int pid_list_search(pid_t pid)
 
 	/* The possible PID wrapping around: should we somehow handle this? */
 	rcu_read_lock();
-	list_for_each_entry_rcu(entry, &hrt.pid_list, list) {
+	hash_for_each_possible_rcu(hrt.pid_hash, entry, node, pid) {
 		if (entry->pid == pid) {
 			rcu_read_unlock();
 			return 1;
@@ -138,6 +173,42 @@ static int pid_list_search(pid_t pid)
 	return 0;
 }
 
+/*
+ * Consecutive lookups on a cpu are usually done for the same thread group
+ * (sched in, mmap and comm events of one process), so remember the last
+ * decision until the pid table changes.
+ */
+static bool pid_filter_match(pid_t tgid)
+{
+	bool match;
+	int gen = atomic_read(&hrt.pid_list_gen);
+	struct quadd_cpu_context *cpu_ctx = get_cpu_ptr(hrt.cpu_ctx);
+	struct quadd_pid_filter_cache *pc = &cpu_ctx->pid_cache;
+
+	if (pc->tgid == tgid && pc->gen == gen) {
+		match = pc->match;
+	} else {
+		match = pid_list_search(tgid);
+
+		pc->tgid = tgid;
+		pc->gen = gen;
+		pc->match = match;
+	}
+
+	put_cpu_ptr(hrt.cpu_ctx);
+
+	return match;
+}
+
+static void reset_pid_filter_cache(struct quadd_cpu_context *cpu_ctx)
+{
+	struct quadd_pid_filter_cache *pc = &cpu_ctx->pid_cache;
+
+	pc->tgid = -1;
+	pc->gen = 0;
+	pc->match = false;
+}
+
 static inline bool hrt_is_active(struct quadd_cpu_context *cpu_ctx)
 {
 	return cpu_ctx->is_sampling_enabled || cpu_ctx->is_tracing_enabled;
@@ -210,6 +281,40 @@ quadd_put_sample(struct quadd_record_data *data,
 	__put_sample(data, vec, vec_count, 0);
 }
 
+static int
+reserve_sample_this_cpu(struct quadd_rb_span *span,
+			size_t min_len, size_t max_len)
+{
+	int err;
+	struct quadd_comm_data_interface *comm = hrt.quadd_ctx->comm;
+
+	err = comm->reserve(span, min_len, max_len, -1);
+	if (err < 0) {
+		/* keep the gap visible in the sequence ids */
+		atomic_inc(&hrt.seqid);
+		atomic64_inc(&hrt.skipped_samples);
+		atomic64_inc(&hrt.counter_samples);
+	}
+
+	return err;
+}
+
+static int
+commit_sample(struct quadd_record_data *data, struct quadd_rb_span *span)
+{
+	ssize_t err;
+	struct quadd_comm_data_interface *comm = hrt.quadd_ctx->comm;
+
+	data->seqid = atomic_inc_return(&hrt.seqid);
+	err = comm->commit(span, data);
+	if (err < 0)
+		atomic64_inc(&hrt.skipped_samples);
+
+	atomic64_inc(&hrt.counter_samples);
+
+	return err < 0 ? err : 0;
+}
+
 static int
 get_current_events(int cpuid, struct quadd_event_source *pmu,
 		   struct source_info *src_info, struct quadd_event *events,
@@ -281,6 +386,9 @@ static void put_header(int cpuid, bool is_uncore)
 	if (hrt.get_stack_offset)
 		hdr->flags |= QUADD_HDR_FLAG_STACK_OFFSET;
 
+	if (param->backtrace && hrt.cc_delta)
+		hdr->flags |= QUADD_HDR_FLAG_CC_DELTA;
+
 	hdr->flags |= QUADD_HDR_FLAG_HAS_CPUID;
 
 	if (quadd_mode_is_sampling(ctx))
@@ -452,36 +560,126 @@ static int get_sample_data(struct quadd_sample_data *s,
 	return 0;
 }
 
+static inline u64 callchain_ip(struct quadd_callchain *cc, int idx)
+{
+	return cc->cs_64 ? cc->ip_64[idx] : cc->ip_32[idx];
+}
+
+static inline size_t callchain_ip_size(struct quadd_callchain *cc)
+{
+	return cc->cs_64 ? sizeof(cc->ip_64[0]) : sizeof(cc->ip_32[0]);
+}
+
+static void put_varint(struct quadd_rb_span *span, u64 value)
+{
+	u8 buf[10];
+	size_t n = 0;
+
+	do {
+		buf[n] = value & 0x7f;
+		value >>= 7;
+		if (value)
+			buf[n] |= 0x80;
+		n++;
+	} while (value);
+
+	quadd_rb_span_write(span, buf, n);
+}
+
+/* See QUADD_SAMPLE_FLAG_CC_DELTA for the format */
+static size_t cc_delta_max_size(int nr)
+{
+	return ALIGN(1 + nr * 10, QUADD_CC_DELTA_ALIGN);
+}
+
+static int
+put_callchain_delta(struct quadd_sample_data *s,
+		    struct quadd_cpu_context *cpu_ctx,
+		    struct quadd_rb_span *span)
+{
+	u8 nr_common = 0;
+	int i, nr_new;
+	u64 ip, prev_ip;
+	size_t start = span->pos, len;
+	static const u8 zero_pad[QUADD_CC_DELTA_ALIGN];
+	struct quadd_callchain *cc = &cpu_ctx->cc;
+	struct quadd_cc_ref *ref = &cpu_ctx->cc_ref;
+	struct quadd_cc_stats *stats = &cpu_ctx->cc_stats;
+
+	if (ref->tgid == s->tgid && ref->cs_64 == cc->cs_64) {
+		while (nr_common < cc->nr && nr_common < ref->nr &&
+		       ref->ip[nr_common] ==
+		       callchain_ip(cc, cc->nr - 1 - nr_common))
+			nr_common++;
+	}
+
+	nr_new = cc->nr - nr_common;
+
+	quadd_rb_span_write(span, &nr_common, sizeof(nr_common));
+
+	prev_ip = s->ip;
+	for (i = 0; i < nr_new; i++) {
+		s64 delta;
+
+		ip = callchain_ip(cc, i);
+		delta = (s64)(ip - prev_ip);
+		put_varint(span, ((u64)delta << 1) ^ (u64)(delta >> 63));
+		prev_ip = ip;
+	}
+
+	len = span->pos - start;
+	quadd_rb_span_write(span, zero_pad,
+			    ALIGN(len, QUADD_CC_DELTA_ALIGN) - len);
+
+	s->flags |= QUADD_SAMPLE_FLAG_CC_DELTA;
+
+	stats->nr_frames_written += nr_new;
+	stats->written_bytes += span->pos - start;
+
+	return nr_common;
+}
+
+/* Called after the sample is committed, only the new frames are copied */
 static void
-get_backtrace_data(struct quadd_sample_data *s,
-		   struct quadd_event_context *event_ctx,
-		   struct quadd_callchain *cc,
-		   struct quadd_iovec *vec,
-		   unsigned int *vec_idx)
+update_cc_ref(struct quadd_cpu_context *cpu_ctx, pid_t tgid, int nr_common)
 {
-	int bt_size = 0;
-	u32 urcs = 0;
-	struct quadd_ctx *ctx = hrt.quadd_ctx;
-	unsigned int idx = *vec_idx;
+	int i;
+	struct quadd_callchain *cc = &cpu_ctx->cc;
+	struct quadd_cc_ref *ref = &cpu_ctx->cc_ref;
 
-	cc->um = hrt.um;
+	for (i = nr_common; i < cc->nr; i++)
+		ref->ip[i] = callchain_ip(cc, cc->nr - 1 - i);
 
-	bt_size = quadd_get_user_callchain(event_ctx, cc, ctx);
-	if (bt_size > 0) {
-		int ip_size = cc->cs_64 ? sizeof(u64) : sizeof(u32);
-		int nr_types = DIV_ROUND_UP(bt_size, 8);
+	ref->nr = cc->nr;
+	ref->tgid = tgid;
+	ref->cs_64 = cc->cs_64;
+}
 
-		vec[idx].base = cc->cs_64 ?
-			(void *)cc->ip_64 : (void *)cc->ip_32;
-		vec[idx].len = bt_size * ip_size;
-		idx++;
+static void
+put_unw_data(struct quadd_sample_data *s,
+	     struct quadd_cpu_context *cpu_ctx,
+	     struct quadd_rb_span *span)
+{
+	u32 urcs = 0;
+	struct quadd_callchain *cc = &cpu_ctx->cc;
+	struct quadd_cc_stats *stats = &cpu_ctx->cc_stats;
+	size_t ip_size = callchain_ip_size(cc);
 
-		vec[idx].base = cc->types;
-		vec[idx].len = nr_types * sizeof(cc->types[0]);
-		idx++;
+	if (cc->nr > 0) {
+		quadd_rb_span_write(span, cc->types,
+				    DIV_ROUND_UP(cc->nr, 8) *
+				    sizeof(cc->types[0]));
 
 		if (cc->cs_64)
 			s->flags |= QUADD_SAMPLE_FLAG_IP64;
+
+		stats->nr_frames += cc->nr;
+		stats->raw_bytes += cc->nr * ip_size;
+
+		if (!(s->flags & QUADD_SAMPLE_FLAG_CC_DELTA)) {
+			stats->nr_frames_written += cc->nr;
+			stats->written_bytes += cc->nr * ip_size;
+		}
 	}
 
 	urcs |= (cc->urc_fp & QUADD_SAMPLE_URC_MASK) <<
@@ -491,14 +689,10 @@ get_backtrace_data(struct quadd_sample_data *s,
 	urcs |= (cc->urc_dwarf & QUADD_SAMPLE_URC_MASK) <<
 		QUADD_SAMPLE_URC_SHIFT_DWARF;
 
-	vec[idx].base = &urcs;
-	vec[idx].len = sizeof(urcs);
-	idx++;
+	quadd_rb_span_write(span, &urcs, sizeof(urcs));
 
 	s->flags |= QUADD_SAMPLE_FLAG_URCS;
-	s->callchain_nr = bt_size;
-
-	*vec_idx = idx;
+	s->callchain_nr = cc->nr;
 }
 
 static long
@@ -526,15 +720,16 @@ get_stack_offset(struct task_struct *task,
 static void
 read_all_sources(struct pt_regs *regs, struct task_struct *task, u64 ts)
 {
+	int err, nr_common = 0;
 	u32 vpid, vtgid;
 	u32 state, extra_data = 0, ts_delta;
 	u64 ts_start, ts_end;
 	int i, nr_events = 0, nr_positive_events = 0;
-	unsigned int vec_idx = 0;
+	size_t extra_offset, tail_len, min_len, max_len;
 	struct pt_regs *user_regs;
-	struct quadd_iovec vec[9];
 	u32 events_extra[QUADD_MAX_COUNTERS];
 	struct quadd_event_context event_ctx;
+	struct quadd_rb_span span;
 
 	struct quadd_record_data record_data;
 	struct quadd_sample_data *s = &record_data.sample;
@@ -542,6 +737,7 @@ read_all_sources(struct pt_regs *regs, struct task_struct *task, u64 ts)
 	struct quadd_ctx *ctx = hrt.quadd_ctx;
 	struct quadd_cpu_context *cpu_ctx = this_cpu_ptr(hrt.cpu_ctx);
 	struct quadd_callchain *cc = &cpu_ctx->cc;
+	bool cc_delta = ctx->param.backtrace && hrt.cc_delta;
 
 	if (!hrt_is_active(cpu_ctx))
 		return;
@@ -559,6 +755,19 @@ read_all_sources(struct pt_regs *regs, struct task_struct *task, u64 ts)
 	if (!nr_events)
 		return;
 
+	s->events_flags = 0;
+	for (i = 0; i < nr_events; i++) {
+		u32 value = (u32)cpu_ctx->events[i].delta;
+
+		if (value > 0) {
+			s->events_flags |= 1U << i;
+			events_extra[nr_positive_events++] = value;
+		}
+	}
+
+	if (nr_positive_events == 0)
+		return;
+
 	if (user_mode(regs))
 		user_regs = regs;
 	else
@@ -567,21 +776,73 @@ read_all_sources(struct pt_regs *regs, struct task_struct *task, u64 ts)
 	if (get_sample_data(s, regs, task))
 		return;
 
-	vec[vec_idx].base = &extra_data;
-	vec[vec_idx].len = sizeof(extra_data);
-	vec_idx++;
-
 	cc->nr = 0;
+	cc->span = NULL;
 
 	event_ctx.regs = user_regs;
 	event_ctx.task = task;
 	event_ctx.user_mode = user_mode(regs);
 	event_ctx.is_sched = !in_interrupt();
 
-	if (ctx->param.backtrace)
-		get_backtrace_data(s, &event_ctx, cc, vec, &vec_idx);
-	else
+	state = get_task_state(task);
+	if (state)
+		s->flags |= QUADD_SAMPLE_FLAG_STATE;
+
+	vpid = task_pid_vnr(task);
+	vtgid = task_tgid_vnr(task);
+
+	if (s->pid != vpid || s->tgid != vtgid)
+		s->flags |= QUADD_SAMPLE_FLAG_IS_VPID;
+
+	/* Upper bound of everything that follows the callchain addresses */
+	tail_len = QUADD_UNW_TYPES_SIZE * sizeof(u32) + sizeof(u32) +
+		nr_positive_events * sizeof(events_extra[0]) +
+		sizeof(state) + sizeof(ts_delta) + sizeof(vpid) + sizeof(vtgid);
+
+	min_len = sizeof(extra_data) + tail_len;
+	max_len = min_len;
+
+	if (cc_delta) {
+		/* The delta is taken against the previous callchain, so the
+		 * addresses have to be unwound into the per-cpu buffer first.
+		 */
+		cc->um = hrt.um;
+		quadd_get_user_callchain(&event_ctx, cc, ctx);
+
+		min_len += cc_delta_max_size(cc->nr);
+		max_len = min_len;
+	} else if (ctx->param.backtrace) {
+		max_len += QUADD_MAX_STACK_DEPTH * sizeof(u64);
+	}
+
+	record_data.record_type = QUADD_RECORD_TYPE_SAMPLE;
+
+	err = reserve_sample_this_cpu(&span, min_len, max_len);
+	if (err < 0)
+		return;
+
+	extra_offset = span.pos;
+	quadd_rb_span_write(&span, &extra_data, sizeof(extra_data));
+
+	if (cc_delta) {
+		if (cc->nr > 0)
+			nr_common = put_callchain_delta(s, cpu_ctx, &span);
+		put_unw_data(s, cpu_ctx, &span);
+	} else if (ctx->param.backtrace) {
+		/* Unwinders write the addresses directly into the ring, the
+		 * span is claimed without the ring buffer lock held.
+		 */
+		cc->span = &span;
+		cc->span_tail = tail_len;
+		cc->um = hrt.um;
+
+		quadd_get_user_callchain(&event_ctx, cc, ctx);
+
+		cc->span = NULL;
+		put_unw_data(s, cpu_ctx, &span);
+	} else {
 		s->callchain_nr = 0;
+	}
 
 	if (hrt.get_stack_offset) {
 		long offset = get_stack_offset(task, user_regs, cc);
@@ -591,59 +852,35 @@ read_all_sources(struct pt_regs *regs, struct task_struct *task, u64 ts)
 
 			off = min_t(u32, off, 0xffff);
 			extra_data |= off << QUADD_SED_STACK_OFFSET_SHIFT;
-		}
-	}
 
-	record_data.record_type = QUADD_RECORD_TYPE_SAMPLE;
-
-	s->events_flags = 0;
-	for (i = 0; i < nr_events; i++) {
-		u32 value = (u32)cpu_ctx->events[i].delta;
-
-		if (value > 0) {
-			s->events_flags |= 1U << i;
-			events_extra[nr_positive_events++] = value;
+			quadd_rb_span_write_at(&span, extra_offset,
+					       &extra_data,
+					       sizeof(extra_data));
 		}
 	}
 
-	if (nr_positive_events == 0)
-		return;
+	quadd_rb_span_write(&span, events_extra,
+			    nr_positive_events * sizeof(events_extra[0]));
 
-	vec[vec_idx].base = events_extra;
-	vec[vec_idx].len = nr_positive_events * sizeof(events_extra[0]);
-	vec_idx++;
-
-	state = get_task_state(task);
-	if (state) {
-		s->flags |= QUADD_SAMPLE_FLAG_STATE;
-		vec[vec_idx].base = &state;
-		vec[vec_idx].len = sizeof(state);
-		vec_idx++;
-	}
+	if (state)
+		quadd_rb_span_write(&span, &state, sizeof(state));
 
 	ts_end = quadd_get_time();
 	ts_delta = (u32)(ts_end - ts_start);
 
-	vec[vec_idx].base = &ts_delta;
-	vec[vec_idx].len = sizeof(ts_delta);
-	vec_idx++;
-
-	vpid = task_pid_vnr(task);
-	vtgid = task_tgid_vnr(task);
-
-	if (s->pid != vpid || s->tgid != vtgid) {
-		vec[vec_idx].base = &vpid;
-		vec[vec_idx].len = sizeof(vpid);
-		vec_idx++;
+	quadd_rb_span_write(&span, &ts_delta, sizeof(ts_delta));
 
-		vec[vec_idx].base = &vtgid;
-		vec[vec_idx].len = sizeof(vtgid);
-		vec_idx++;
-
-		s->flags |= QUADD_SAMPLE_FLAG_IS_VPID;
+	if (s->flags & QUADD_SAMPLE_FLAG_IS_VPID) {
+		quadd_rb_span_write(&span, &vpid, sizeof(vpid));
+		quadd_rb_span_write(&span, &vtgid, sizeof(vtgid));
 	}
 
-	quadd_put_sample_this_cpu(&record_data, vec, vec_idx);
+	err = commit_sample(&record_data, &span);
+	if (err < 0)
+		return;
+
+	if (s->flags & QUADD_SAMPLE_FLAG_CC_DELTA)
+		update_cc_ref(cpu_ctx, s->tgid, nr_common);
 }
 
 static enum hrtimer_restart hrtimer_handler(struct hrtimer *hrtimer)
@@ -704,7 +941,7 @@ __is_profile_process(struct task_struct *task, bool is_trace, bool is_sample)
 
 	if ((is_trace && quadd_mode_is_trace_tree(ctx)) ||
 	    (is_sample && quadd_mode_is_sample_tree(ctx)))
-		return pid_list_search(task_tgid_nr(task));
+		return pid_filter_match(task_tgid_nr(task));
 
 	return false;
 }
@@ -965,6 +1202,12 @@ static void reset_cpu_ctx(void)
 
 		t_data->pid = -1;
 		t_data->tgid = -1;
+
+		reset_pid_filter_cache(cpu_ctx);
+
+		cpu_ctx->cc_ref.nr = 0;
+		cpu_ctx->cc_ref.tgid = -1;
+		memset(&cpu_ctx->cc_stats, 0, sizeof(cpu_ctx->cc_stats));
 	}
 }
 
@@ -1064,6 +1307,7 @@ int quadd_hrt_start(void)
 
 	hrt.get_stack_offset =
 		(extra & QUADD_PARAM_EXTRA_STACK_OFFSET) ? 1 : 0;
+	hrt.cc_delta = (extra & QUADD_PARAM_EXTRA_CC_DELTA) ? 1 : 0;
 
 	for_each_possible_cpu(cpuid) {
 		if (ctx->pmu && ctx->pmu->get_arch(cpuid))
@@ -1120,6 +1364,184 @@ void quadd_hrt_get_state(struct quadd_module_state *state)
 	state->nr_skipped_samples = atomic64_read(&hrt.skipped_samples);
 }
 
+void quadd_hrt_get_cc_stats(int cpuid, struct quadd_cc_stats *stats)
+{
+	struct quadd_cpu_context *cpu_ctx = per_cpu_ptr(hrt.cpu_ctx, cpuid);
+
+	*stats = cpu_ctx->cc_stats;
+}
+
+#define QUADD_FILTER_BENCH_LOOPS	10000
+#define QUADD_FILTER_BENCH_MAX_PIDS	1024
+
+/*
+ * The benchmark runs on private tables, so it never touches the filter of a
+ * session that is being started or is running concurrently.
+ */
+struct filter_bench_node {
+	struct hlist_node hnode;
+	struct list_head lnode;
+	pid_t pid;
+};
+
+struct filter_bench {
+	DECLARE_HASHTABLE(pid_hash, QUADD_HRT_PID_HASH_BITS);
+	/* the former linked-list filter */
+	struct list_head pid_list;
+	struct quadd_pid_filter_cache cache;
+	atomic_t gen;
+	struct filter_bench_node nodes[QUADD_FILTER_BENCH_MAX_PIDS];
+};
+
+/* Nodes are reused in place: the lookups are done before each refill */
+static void filter_bench_fill(struct filter_bench *b, unsigned int nr_pids)
+{
+	unsigned int i;
+	struct filter_bench_node *entry;
+
+	hash_init(b->pid_hash);
+	INIT_LIST_HEAD(&b->pid_list);
+
+	for (i = 0; i < nr_pids; i++) {
+		entry = &b->nodes[i];
+		entry->pid = PID_MAX_LIMIT + 1 + i;
+
+		hash_add_rcu(b->pid_hash, &entry->hnode, entry->pid);
+		list_add_tail_rcu(&entry->lnode, &b->pid_list);
+	}
+
+	b->cache.tgid = -1;
+	b->cache.gen = 0;
+	b->cache.match = false;
+	atomic_inc(&b->gen);
+}
+
+static bool filter_bench_search(struct filter_bench *b, pid_t pid)
+{
+	struct filter_bench_node *entry;
+
+	rcu_read_lock();
+	hash_for_each_possible_rcu(b->pid_hash, entry, hnode, pid) {
+		if (entry->pid == pid) {
+			rcu_read_unlock();
+			return true;
+		}
+	}
+	rcu_read_unlock();
+
+	return false;
+}
+
+/* Same steps as pid_filter_match(), on the private table */
+static bool filter_bench_match(struct filter_bench *b, pid_t pid)
+{
+	bool match;
+	int gen = atomic_read(&b->gen);
+	struct quadd_pid_filter_cache *pc = &b->cache;
+
+	preempt_disable();
+
+	if (pc->tgid == pid && pc->gen == gen) {
+		match = pc->match;
+	} else {
+		match = filter_bench_search(b, pid);
+
+		pc->tgid = pid;
+		pc->gen = gen;
+		pc->match = match;
+	}
+
+	preempt_enable();
+
+	return match;
+}
+
+static u64 filter_bench_walk(struct filter_bench *b, pid_t pid)
+{
+	u64 ts_start;
+	unsigned int i;
+	struct filter_bench_node *entry;
+
+	ts_start = ktime_get_ns();
+
+	for (i = 0; i < QUADD_FILTER_BENCH_LOOPS; i++) {
+		rcu_read_lock();
+		list_for_each_entry_rcu(entry, &b->pid_list, lnode) {
+			if (READ_ONCE(entry->pid) == pid)
+				break;
+		}
+		rcu_read_unlock();
+	}
+
+	return div_u64(ktime_get_ns() - ts_start,
+		       QUADD_FILTER_BENCH_LOOPS);
+}
+
+static u64 filter_bench_hash(struct filter_bench *b, pid_t pid)
+{
+	u64 ts_start;
+	unsigned int i;
+
+	ts_start = ktime_get_ns();
+
+	for (i = 0; i < QUADD_FILTER_BENCH_LOOPS; i++)
+		filter_bench_search(b, pid);
+
+	return div_u64(ktime_get_ns() - ts_start,
+		       QUADD_FILTER_BENCH_LOOPS);
+}
+
+static u64 filter_bench_cached(struct filter_bench *b, pid_t pid)
+{
+	u64 ts_start;
+	unsigned int i;
+
+	ts_start = ktime_get_ns();
+
+	for (i = 0; i < QUADD_FILTER_BENCH_LOOPS; i++)
+		filter_bench_match(b, pid);
+
+	return div_u64(ktime_get_ns() - ts_start,
+		       QUADD_FILTER_BENCH_LOOPS);
+}
+
+/*
+ * Measures the per-sample cost of the process filter for several table
+ * sizes: a scan of the former pid list, the hash lookup and the cached path.
+ * The last added pid is looked up, which is the worst case for the list.
+ */
+int quadd_hrt_filter_bench(struct seq_file *f)
+{
+	unsigned int i;
+	pid_t last;
+	struct filter_bench *b;
+	static const unsigned int sizes[] = {
+		1, 16, 256, QUADD_FILTER_BENCH_MAX_PIDS
+	};
+
+	b = vzalloc(sizeof(*b));
+	if (!b)
+		return -ENOMEM;
+
+	atomic_set(&b->gen, 0);
+
+	seq_printf(f, "%-8s %-12s %-12s %-12s\n",
+		   "pids", "walk (ns)", "hash (ns)", "cached (ns)");
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		filter_bench_fill(b, sizes[i]);
+		last = PID_MAX_LIMIT + sizes[i];
+
+		seq_printf(f, "%-8u %-12llu %-12llu %-12llu\n", sizes[i],
+			   filter_bench_walk(b, last),
+			   filter_bench_hash(b, last),
+			   filter_bench_cached(b, last));
+	}
+
+	vfree(b);
+	return 0;
+}
+
 static void init_arch_timer(void)
 {
 	struct arch_timer_kvm_info *info;
@@ -1151,8 +1573,9 @@ struct quadd_hrt_ctx *quadd_hrt_init(struct quadd_ctx *ctx)
 	hrt.sample_period = period;
 	hrt.root_pid = 0;
 
-	INIT_LIST_HEAD(&hrt.pid_list);
+	hash_init(hrt.pid_hash);
 	raw_spin_lock_init(&hrt.pid_list_lock);
+	atomic_set(&hrt.pid_list_gen, 0);
 
 	if (ctx->param.ma_freq > 0)
 		hrt.ma_period = MSEC_PER_SEC / ctx->param.ma_freq;
@@ -1178,7 +1601,13 @@ struct quadd_hrt_ctx *quadd_hrt_init(struct quadd_ctx *ctx)
 		cpu_ctx->active_thread.pid = -1;
 		cpu_ctx->active_thread.tgid = -1;
 
+		reset_pid_filter_cache(cpu_ctx);
+
+		cpu_ctx->cc_ref.nr = 0;
+		cpu_ctx->cc_ref.tgid = -1;
+
 		cpu_ctx->cc.hrt = &hrt;
+		cpu_ctx->cc.span = NULL;
 
 		init_hrtimer(cpu_ctx);
 	}
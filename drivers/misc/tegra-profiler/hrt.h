@@ -22,6 +22,7 @@
 #include <linux/types.h>
 #include <linux/hrtimer.h>
 #include <linux/limits.h>
+#include <linux/hashtable.h>
 
 #include "backtrace.h"
 
@@ -32,6 +33,8 @@ struct quadd_thread_data {
 
 struct timecounter;
 
+#define QUADD_HRT_PID_HASH_BITS	8
+
 struct quadd_hrt_ctx {
 	struct quadd_cpu_context __percpu *cpu_ctx;
 
@@ -54,8 +57,9 @@ struct quadd_hrt_ctx {
 	unsigned long rss_size_prev;
 
 	pid_t root_pid;
-	struct list_head pid_list;
+	DECLARE_HASHTABLE(pid_hash, QUADD_HRT_PID_HASH_BITS);
 	raw_spinlock_t pid_list_lock;
+	atomic_t pid_list_gen;
 
 	struct timecounter *tc;
 	unsigned int use_arch_timer:1;
@@ -63,6 +67,14 @@ struct quadd_hrt_ctx {
 
 	struct quadd_unw_methods um;
 	unsigned int get_stack_offset:1;
+	unsigned int cc_delta:1;
+};
+
+struct quadd_cc_stats {
+	u64 nr_frames;
+	u64 nr_frames_written;
+	u64 raw_bytes;
+	u64 written_bytes;
 };
 
 struct task_struct;
@@ -81,6 +93,7 @@ struct quadd_event_context {
 struct quadd_record_data;
 struct quadd_module_state;
 struct quadd_iovec;
+struct seq_file;
 
 struct quadd_hrt_ctx *quadd_hrt_init(struct quadd_ctx *ctx);
 void quadd_hrt_deinit(void);
@@ -96,9 +109,12 @@ quadd_put_sample(struct quadd_record_data *data,
 		 struct quadd_iovec *vec, int vec_count);
 
 void quadd_hrt_get_state(struct quadd_module_state *state);
+void quadd_hrt_get_cc_stats(int cpuid, struct quadd_cc_stats *stats);
 u64 quadd_get_time(void);
 bool quadd_is_inherited(struct task_struct *task);
 
+int quadd_hrt_filter_bench(struct seq_file *f);
+
 #endif	/* __KERNEL__ */
 
 #endif	/* __QUADD_HRT_H */
@@ -19,6 +19,7 @@
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/version.h>
+#include <linux/math64.h>
 
 #include <linux/tegra_profiler.h>
 
@@ -26,6 +27,8 @@
 #include "version.h"
 #include "quadd_proc.h"
 #include "arm_pmu.h"
+#include "hrt.h"
+#include "comm.h"
 
 #define YES_NO(x) ((x) ? "yes" : "no")
 
@@ -243,6 +246,84 @@ static const struct proc_ops status_proc_fops = {
 };
 #endif
 
+static int show_rb_stats(struct seq_file *f, void *offset)
+{
+	int cpuid;
+	u64 ratio;
+	struct quadd_cc_stats cc;
+	struct quadd_comm_rb_stats rb;
+
+	seq_printf(f, "%-4s %-10s %-10s %-10s %-12s %-12s %-8s\n",
+		   "cpu", "size", "max_fill", "overflows",
+		   "cc_frames", "cc_written", "cc_ratio");
+
+	for_each_possible_cpu(cpuid) {
+		if (quadd_comm_get_rb_stats(cpuid, &rb) < 0)
+			continue;
+
+		quadd_hrt_get_cc_stats(cpuid, &cc);
+
+		/* compression ratio of the callchain data, in percent */
+		ratio = cc.written_bytes ?
+			div64_u64(cc.raw_bytes * 100, cc.written_bytes) : 0;
+
+		seq_printf(f, "%-4d %-10zu %-10zu %-10zu %-12llu %-12llu %llu.%02llu\n",
+			   cpuid, rb.size, rb.max_fill_count,
+			   rb.nr_skipped_samples,
+			   cc.nr_frames, cc.nr_frames_written,
+			   div_u64(ratio, 100), ratio % 100);
+	}
+
+	return 0;
+}
+
+static int show_rb_stats_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_rb_stats, NULL);
+}
+
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(5, 6, 0))
+static const struct file_operations rb_stats_proc_fops = {
+	.open		= show_rb_stats_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#else
+static const struct proc_ops rb_stats_proc_fops = {
+	.proc_open	= show_rb_stats_proc_open,
+	.proc_read	= seq_read,
+	.proc_lseek	= seq_lseek,
+	.proc_release	= single_release,
+};
+#endif
+
+static int show_filter_bench(struct seq_file *f, void *offset)
+{
+	return quadd_hrt_filter_bench(f);
+}
+
+static int show_filter_bench_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_filter_bench, NULL);
+}
+
+#if (LINUX_VERSION_CODE < KERNEL_VERSION(5, 6, 0))
+static const struct file_operations filter_bench_proc_fops = {
+	.open		= show_filter_bench_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#else
+static const struct proc_ops filter_bench_proc_fops = {
+	.proc_open	= show_filter_bench_proc_open,
+	.proc_read	= seq_read,
+	.proc_lseek	= seq_lseek,
+	.proc_release	= single_release,
+};
+#endif
+
 void quadd_proc_init(struct quadd_ctx *context)
 {
 	ctx = context;
@@ -253,6 +334,9 @@ void quadd_proc_init(struct quadd_ctx *context)
 	proc_create(QUADD_PROC_DEV "/capabilities", 0, NULL,
 		    &capabilities_proc_fops);
 	proc_create(QUADD_PROC_DEV "/status", 0, NULL, &status_proc_fops);
+	proc_create(QUADD_PROC_DEV "/rb_stats", 0, NULL, &rb_stats_proc_fops);
+	proc_create(QUADD_PROC_DEV "/filter_bench", 0400, NULL,
+		    &filter_bench_proc_fops);
 }
 
 void quadd_proc_deinit(void)
@@ -260,6 +344,8 @@ void quadd_proc_deinit(void)
 	remove_proc_entry(QUADD_PROC_DEV "/version", NULL);
 	remove_proc_entry(QUADD_PROC_DEV "/capabilities", NULL);
 	remove_proc_entry(QUADD_PROC_DEV "/status", NULL);
+	remove_proc_entry(QUADD_PROC_DEV "/rb_stats", NULL);
+	remove_proc_entry(QUADD_PROC_DEV "/filter_bench", NULL);
 	remove_proc_entry(QUADD_PROC_DEV, NULL);
 }
 
@@ -566,9 +566,16 @@ int ttcan_tx_fifo_full(struct ttcan_controller *ttcan)
 
 static int process_rx_mesg(struct ttcan_controller *ttcan, u32 addr)
 {
-	struct ttcanfd_frame ttcanfd = {0};
-	ttcan_read_rx_msg_ram(ttcan, addr, &ttcanfd);
-	return add_msg_controller_list(ttcan, &ttcanfd, &ttcan->rx_b, BUFFER);
+	struct ttcanfd_frame *ttcanfd;
+
+	ttcanfd = ttcan_rx_ring_reserve(&ttcan->rx_b);
+	if (!ttcanfd)
+		return -ENOSPC;
+
+	memset(ttcanfd, 0, sizeof(*ttcanfd));
+	ttcan_read_rx_msg_ram(ttcan, addr, ttcanfd);
+	ttcan_rx_ring_commit(&ttcan->rx_b);
+	return 0;
 }
 
 int ttcan_read_rx_buffer(struct ttcan_controller *ttcan)
@@ -586,8 +593,10 @@ int ttcan_read_rx_buffer(struct ttcan_controller *ttcan)
 		if (ndat1) {
 			read_addr = ttcan->mram_cfg[MRAM_RXB].off + (bit_set1 *
 				ttcan->e_size.rx_buffer);
-			if (process_rx_mesg(ttcan, read_addr))
+			if (process_rx_mesg(ttcan, read_addr)) {
+				ttcan->rx_b.stalled = true;
 				return msgs_read;
+			}
 			ttcan_write32(ttcan, ADR_MTTCAN_NDAT1,
 				(1 << (bit_set1)));
 			msgs_read++;
@@ -596,8 +605,10 @@ int ttcan_read_rx_buffer(struct ttcan_controller *ttcan)
 		if (ndat2) {
 			read_addr = ttcan->mram_cfg[MRAM_RXB].off + (bit_set2 *
 				ttcan->e_size.rx_buffer);
-			if (process_rx_mesg(ttcan, read_addr))
+			if (process_rx_mesg(ttcan, read_addr)) {
+				ttcan->rx_b.stalled = true;
 				return msgs_read;
+			}
 			ttcan_write32(ttcan, ADR_MTTCAN_NDAT2,
 				(1 << (bit_set2)));
 			msgs_read++;
@@ -655,7 +666,7 @@ unsigned int ttcan_read_txevt_fifo(struct ttcan_controller *ttcan)
 unsigned int ttcan_read_rx_fifo0(struct ttcan_controller *ttcan)
 {
 	u32 rxf0s_reg;
-	struct ttcanfd_frame ttcanfd = {0};
+	struct ttcanfd_frame *ttcanfd;
 	u32 read_addr;
 	int q_read = 0;
 	unsigned int msgs_read = 0;
@@ -686,12 +697,16 @@ unsigned int ttcan_read_rx_fifo0(struct ttcan_controller *ttcan)
 		pr_debug("%s:fifo0: read_addr %x FOGI %x\n", __func__,
 			 read_addr, get_idx);
 
-		ttcan_read_rx_msg_ram(ttcan, read_addr, &ttcanfd);
-		if (add_msg_controller_list(ttcan, &ttcanfd,
-					    &ttcan->rx_q0, FIFO_0) < 0) {
-			pr_err("%s: failed to add to list\n", __func__);
+		/* Leave the frame in the FIFO until the ring drains */
+		ttcanfd = ttcan_rx_ring_reserve(&ttcan->rx_q0);
+		if (!ttcanfd) {
+			ttcan->rx_q0.stalled = true;
 			return msgs_read;
 		}
+
+		memset(ttcanfd, 0, sizeof(*ttcanfd));
+		ttcan_read_rx_msg_ram(ttcan, read_addr, ttcanfd);
+		ttcan_rx_ring_commit(&ttcan->rx_q0);
 		ttcan_write32(ttcan, ADR_MTTCAN_RXF0A, get_idx);
 		rxf0s_reg = ttcan_read32(ttcan, ADR_MTTCAN_RXF0S);
 		msgs_read++;
@@ -702,7 +717,7 @@ unsigned int ttcan_read_rx_fifo0(struct ttcan_controller *ttcan)
 unsigned int ttcan_read_rx_fifo1(struct ttcan_controller *ttcan)
 {
 	u32 rxf1s_reg;
-	struct ttcanfd_frame ttcanfd = {0};
+	struct ttcanfd_frame *ttcanfd;
 	u32 read_addr;
 	int q_read = 0;
 	int msgs_read = 0;
@@ -732,12 +747,16 @@ unsigned int ttcan_read_rx_fifo1(struct ttcan_controller *ttcan)
 		pr_debug("%s:fifo1: read_addr %x FOGI %x\n", __func__,
 			 read_addr, get_idx);
 
-		ttcan_read_rx_msg_ram(ttcan, read_addr, &ttcanfd);
-		if (add_msg_controller_list(ttcan, &ttcanfd,
-					    &ttcan->rx_q1, FIFO_1) < 0) {
-			pr_err("%s: failed to add to list\n", __func__);
+		/* Leave the frame in the FIFO until the ring drains */
+		ttcanfd = ttcan_rx_ring_reserve(&ttcan->rx_q1);
+		if (!ttcanfd) {
+			ttcan->rx_q1.stalled = true;
 			return msgs_read;
 		}
+
+		memset(ttcanfd, 0, sizeof(*ttcanfd));
+		ttcan_read_rx_msg_ram(ttcan, read_addr, ttcanfd);
+		ttcan_rx_ring_commit(&ttcan->rx_q1);
 		ttcan_write32(ttcan, ADR_MTTCAN_RXF1A, get_idx);
 		rxf1s_reg = ttcan_read32(ttcan, ADR_MTTCAN_RXF1S);
 		msgs_read++;
@@ -24,54 +24,58 @@ inline int is_msg_list_full(struct ttcan_controller *ttcan,
 	return ttcan->list_status & rxtype & 0xFF;
 }
 
-int add_msg_controller_list(struct ttcan_controller *ttcan,
-			    struct ttcanfd_frame *ttcanfd,
-			    struct list_head *rx_q,
-			    enum ttcan_rx_type rxtype)
+u32 ttcan_rx_ring_count(struct ttcan_rx_ring *ring)
 {
+	return READ_ONCE(ring->head) - READ_ONCE(ring->tail);
+}
 
-	struct ttcan_rx_msg_list *msg_list;
+/* Producer: returns the slot to fill, or NULL when the ring is full */
+struct ttcanfd_frame *ttcan_rx_ring_reserve(struct ttcan_rx_ring *ring)
+{
+	u32 head = ring->head;
 
-	msg_list = (struct ttcan_rx_msg_list *)
-		kzalloc(sizeof(struct ttcan_rx_msg_list), GFP_ATOMIC);
-	if (msg_list == NULL) {
-		pr_err("%s: memory allocation failed\n", __func__);
-		return -ENOMEM;
+	if (head - smp_load_acquire(&ring->tail) >= TTCAN_RX_RING_SIZE) {
+		ring->full++;
+		return NULL;
 	}
 
-	INIT_LIST_HEAD(&msg_list->recv_list);
+	return &ring->msg[head & (TTCAN_RX_RING_SIZE - 1)];
+}
 
-	memcpy(&msg_list->msg, ttcanfd, sizeof(struct ttcanfd_frame));
+/* Producer: publish the slot returned by ttcan_rx_ring_reserve() */
+void ttcan_rx_ring_commit(struct ttcan_rx_ring *ring)
+{
+	u32 head = ring->head + 1;
+	u32 used = head - READ_ONCE(ring->tail);
 
-	spin_lock(&ttcan->lock);
+	if (used > ring->hwm)
+		ring->hwm = used;
 
-	if (is_msg_list_full(ttcan, rxtype)) {
-		pr_err("%s: mesg list is full\n", __func__);
-		kfree(msg_list);
-		spin_unlock(&ttcan->lock);
-		return -ENOMEM;
-	}
+	smp_store_release(&ring->head, head);
+}
 
-	list_add_tail(&msg_list->recv_list, rx_q);
-
-	switch (rxtype) {
-	case BUFFER:
-		if (++ttcan->rxb_mem >= TTCAN_MAX_LIST_MEMBERS)
-			ttcan->list_status |= BUFFER;
-		break;
-	case FIFO_0:
-		if (++ttcan->rxq0_mem >= TTCAN_MAX_LIST_MEMBERS)
-			ttcan->list_status |= FIFO_0;
-		break;
-	case FIFO_1:
-		if (++ttcan->rxq1_mem >= TTCAN_MAX_LIST_MEMBERS)
-			ttcan->list_status |= FIFO_1;
-	default:
-		break;
-	}
-	spin_unlock(&ttcan->lock);
+/* Consumer: returns the oldest frame, or NULL when the ring is empty */
+struct ttcanfd_frame *ttcan_rx_ring_peek(struct ttcan_rx_ring *ring)
+{
+	u32 tail = ring->tail;
 
-	return 0;
+	if (smp_load_acquire(&ring->head) == tail)
+		return NULL;
+
+	return &ring->msg[tail & (TTCAN_RX_RING_SIZE - 1)];
+}
+
+/* Consumer: release the frame returned by ttcan_rx_ring_peek() */
+void ttcan_rx_ring_consume(struct ttcan_rx_ring *ring)
+{
+	smp_store_release(&ring->tail, ring->tail + 1);
+}
+
+/* Drop queued frames; only valid while both producer and consumer are idle */
+void ttcan_rx_ring_flush(struct ttcan_rx_ring *ring)
+{
+	ring->tail = ring->head;
+	ring->stalled = false;
 }
 
 int add_event_controller_list(struct ttcan_controller *ttcan,
@@ -103,6 +103,11 @@
 #define GFC_RRFS_REJECT		1U
 #define GFC_RRFE_REJECT		1U
 
+/* Filter Type */
+#define FT_RANGE		0U
+#define FT_DUAL			1U
+#define FT_CLASSIC		2U
+
 /* Filter Element Configuration */
 #define FEC_RXFIFO_0            1U
 #define FEC_RXFIFO_1            2U
@@ -276,9 +281,24 @@ struct ttcan_filter_config {
 	u32 xtd_fltr_size;
 };
 
-struct ttcan_rx_msg_list {
-	struct ttcanfd_frame msg;
-	struct list_head recv_list;
+/* Must be a power of two and cover the largest Rx FIFO/buffer set (64) */
+#define TTCAN_RX_RING_SIZE	64U
+
+/*
+ * Per-FIFO Rx ring. The ISR/NAPI producer reads message RAM straight into
+ * the slot at head and the consumer turns slots at tail into skbs, so no
+ * per-frame allocation is needed. head is written only by the producer and
+ * tail only by the consumer; frames the ring cannot hold are left in
+ * message RAM (not acknowledged) until the consumer catches up.
+ */
+struct ttcan_rx_ring {
+	struct ttcanfd_frame msg[TTCAN_RX_RING_SIZE];
+	u32 head;
+	u32 tail;
+	u32 hwm;	/* highest occupancy seen */
+	u64 full;	/* producer found the ring full */
+	u64 dropped;	/* frames discarded by the driver */
+	bool stalled;	/* frames left in message RAM on a full ring */
 };
 
 struct ttcan_txevt_msg_list {
@@ -294,9 +314,9 @@ struct ttcan_controller {
 	struct ttcan_rxbuff_config rx_config;
 	struct ttcan_filter_config fltr_config;
 	struct ttcan_mram_elem mram_cfg[MRAM_ELEMS];
-	struct list_head rx_q0;
-	struct list_head rx_q1;
-	struct list_head rx_b;
+	struct ttcan_rx_ring rx_q0;
+	struct ttcan_rx_ring rx_q1;
+	struct ttcan_rx_ring rx_b;
 	struct list_head tx_evt;
 	void __iomem *base;	/* controller regs space should be remapped. */
 	void __iomem *xbase;    /* extra registers are mapped */
@@ -314,9 +334,6 @@ struct ttcan_controller {
 	u32 tdc_offset;
 	unsigned long tx_object;
 	unsigned long tx_obj_cancelled;
-	int rxq0_mem;
-	int rxq1_mem;
-	int rxb_mem;
 	int evt_mem;
 	u16 list_status;	/* bit 0: 1=Full; */
 	u16 resv0;
@@ -562,9 +579,12 @@ int ttcan_set_tur_config(struct ttcan_controller *ttcan, u16 denominator,
 void ttcan_prog_trigger_mem(struct ttcan_controller *ttcan, void *tmc_shadow);
 
 /* list APIs */
-int add_msg_controller_list(struct ttcan_controller *ttcan,
-	struct ttcanfd_frame *ttcanfd, struct list_head *rx_q,
-	enum ttcan_rx_type rxtype);
+struct ttcanfd_frame *ttcan_rx_ring_reserve(struct ttcan_rx_ring *ring);
+void ttcan_rx_ring_commit(struct ttcan_rx_ring *ring);
+struct ttcanfd_frame *ttcan_rx_ring_peek(struct ttcan_rx_ring *ring);
+void ttcan_rx_ring_consume(struct ttcan_rx_ring *ring);
+u32 ttcan_rx_ring_count(struct ttcan_rx_ring *ring);
+void ttcan_rx_ring_flush(struct ttcan_rx_ring *ring);
 
 int add_event_controller_list(struct ttcan_controller *ttcan,
 				struct mttcan_tx_evt_element *txevt,
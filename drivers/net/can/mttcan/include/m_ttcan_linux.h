@@ -71,6 +71,35 @@
 #define TX_BLOCK_PERIOD		200
 #define TSC_REF_CLK_RATE	31250000
 
+#define MTTCAN_MAX_RX_FILTERS	128
+
+/*
+ * Union of the SocketCAN filters in use on this interface, compiled into
+ * the standard/extended filter element lists. When the lists cannot hold
+ * an exact image (too few elements, inverted or RTR sensitive filters) the
+ * hardware accepts a superset and sw_check rechecks each frame against f[].
+ */
+struct mttcan_rx_filters {
+	u32 gfc;
+	u32 std_elems;
+	u32 xtd_elems;
+	bool sw_check;
+	int num;
+	struct can_filter f[];
+};
+
+/*
+ * Filter elements and list sizes configured through DT or the std_filter/
+ * xtd_filter attributes, saved while the offload owns the filter RAM. GFC
+ * needs no copy: the offload leaves gfc_reg untouched.
+ */
+struct mttcan_fltr_backup {
+	void *std_shadow;
+	void *xtd_shadow;
+	u32 std_fltr_size;
+	u32 xtd_fltr_size;
+};
+
 #define MTTCAN_TSC_SIZE		16U
 #define MTTCAN_TSC_MASK		0xFFFFULL
 #define TSC_REF_CLK_SHIFT	9U
@@ -129,8 +158,14 @@ struct mttcan_priv {
 	bool poll;
 	bool hwts_rx_en;
 	u32 resp;
+	struct mttcan_rx_filters *rx_fltr;
+	struct mttcan_fltr_backup fltr_backup;
+	u64 rx_fltr_hw_passed;
+	u64 rx_fltr_sw_rejected;
 };
 
+int mttcan_set_rx_filters(struct mttcan_priv *priv,
+			  const struct can_filter *filters, int num);
 int mttcan_create_sys_files(struct device *dev);
 void mttcan_delete_sys_files(struct device *dev);
 #endif
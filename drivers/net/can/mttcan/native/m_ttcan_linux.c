@@ -194,6 +194,8 @@ static int mttcan_hw_reinit(const struct mttcan_priv *priv)
 		ttcan_prog_std_id_fltrs(ttcan, priv->std_shadow);
 	if (ttcan->mram_cfg[MRAM_XIDF].num)
 		ttcan_prog_xtd_id_fltrs(ttcan, priv->xtd_shadow);
+	if (priv->rx_fltr)
+		ttcan_set_gfc(ttcan, priv->rx_fltr->gfc);
 	if (ttcan->mram_cfg[MRAM_TMC].num)
 		ttcan_prog_trigger_mem(ttcan, priv->tmc_shadow);
 
@@ -295,6 +297,289 @@ static void mttcan_handle_lost_frame(struct net_device *dev, int fifo_num)
 	netif_receive_skb(skb);
 }
 
+/*
+ * Fold the list into at most slots classic id/mask elements. The pair
+ * whose merged mask keeps the most significant bits is combined first, so
+ * the hardware superset stays as tight as possible.
+ */
+static void mttcan_fltr_reduce(struct can_filter *f, int *num, int slots)
+{
+	if (slots <= 0) {
+		*num = 0;
+		return;
+	}
+
+	while (*num > slots) {
+		int i, j, bi = 0, bj = 1, best = -1;
+		u32 best_mask = 0;
+
+		for (i = 0; i < *num; i++) {
+			for (j = i + 1; j < *num; j++) {
+				u32 m = f[i].can_mask & f[j].can_mask &
+					~(f[i].can_id ^ f[j].can_id);
+				int w = hweight32(m);
+
+				if (w > best) {
+					best = w;
+					best_mask = m;
+					bi = i;
+					bj = j;
+				}
+			}
+		}
+
+		f[bi].can_mask = best_mask;
+		f[bi].can_id &= best_mask;
+		f[bj] = f[--(*num)];
+	}
+}
+
+static int mttcan_fltr_save(struct mttcan_priv *priv)
+{
+	struct ttcan_controller *ttcan = priv->ttcan;
+	struct mttcan_fltr_backup *bk = &priv->fltr_backup;
+
+	if (priv->std_shadow) {
+		bk->std_shadow = kmemdup(priv->std_shadow,
+			ttcan->mram_cfg[MRAM_SIDF].num * SIDF_ELEM_SIZE,
+			GFP_KERNEL);
+		if (!bk->std_shadow)
+			return -ENOMEM;
+	}
+	if (priv->xtd_shadow) {
+		bk->xtd_shadow = kmemdup(priv->xtd_shadow,
+			ttcan->mram_cfg[MRAM_XIDF].num * XIDF_ELEM_SIZE,
+			GFP_KERNEL);
+		if (!bk->xtd_shadow) {
+			kfree(bk->std_shadow);
+			bk->std_shadow = NULL;
+			return -ENOMEM;
+		}
+	}
+	bk->std_fltr_size = ttcan->fltr_config.std_fltr_size;
+	bk->xtd_fltr_size = ttcan->fltr_config.xtd_fltr_size;
+
+	return 0;
+}
+
+static void mttcan_fltr_restore(struct mttcan_priv *priv)
+{
+	struct ttcan_controller *ttcan = priv->ttcan;
+	struct mttcan_fltr_backup *bk = &priv->fltr_backup;
+
+	if (bk->std_shadow) {
+		memcpy(priv->std_shadow, bk->std_shadow,
+		       ttcan->mram_cfg[MRAM_SIDF].num * SIDF_ELEM_SIZE);
+		ttcan_prog_std_id_fltrs(ttcan, priv->std_shadow);
+	}
+	if (bk->xtd_shadow) {
+		memcpy(priv->xtd_shadow, bk->xtd_shadow,
+		       ttcan->mram_cfg[MRAM_XIDF].num * XIDF_ELEM_SIZE);
+		ttcan_prog_xtd_id_fltrs(ttcan, priv->xtd_shadow);
+	}
+	ttcan->fltr_config.std_fltr_size = bk->std_fltr_size;
+	ttcan->fltr_config.xtd_fltr_size = bk->xtd_fltr_size;
+
+	kfree(bk->std_shadow);
+	kfree(bk->xtd_shadow);
+	bk->std_shadow = NULL;
+	bk->xtd_shadow = NULL;
+}
+
+/*
+ * Program the filter RAM from a SocketCAN filter list. The elements and GFC
+ * configured beforehand are saved when the offload is enabled and restored
+ * when it is turned off again with an empty list.
+ */
+int mttcan_set_rx_filters(struct mttcan_priv *priv,
+			  const struct can_filter *filters, int num)
+{
+	struct ttcan_controller *ttcan = priv->ttcan;
+	int std_slots = min_t(int, ttcan->mram_cfg[MRAM_SIDF].num, 128);
+	int xtd_slots = min_t(int, ttcan->mram_cfg[MRAM_XIDF].num, 64);
+	struct mttcan_rx_filters *set = NULL;
+	struct can_filter *std = NULL, *xtd = NULL;
+	bool std_all = false, xtd_all = false;
+	int nstd = 0, nxtd = 0, i;
+	u32 anf, fec, gfc;
+	int ret = 0;
+
+	ASSERT_RTNL();
+
+	if (num < 0 || num > MTTCAN_MAX_RX_FILTERS)
+		return -EINVAL;
+
+	if (!num) {
+		if (!priv->rx_fltr)
+			return 0;
+
+		mttcan_fltr_restore(priv);
+		ret = ttcan_set_gfc(ttcan, priv->gfc_reg);
+
+		/* NAPI is disabled while the interface is down */
+		kfree(priv->rx_fltr);
+		priv->rx_fltr = NULL;
+		priv->rx_fltr_hw_passed = 0;
+		priv->rx_fltr_sw_rejected = 0;
+		return ret;
+	}
+
+	if (ttcan->mram_cfg[MRAM_RXF0].num) {
+		anf = GFC_ANFS_RXFIFO_0;
+		fec = FEC_RXFIFO_0;
+	} else if (ttcan->mram_cfg[MRAM_RXF1].num) {
+		anf = GFC_ANFS_RXFIFO_1;
+		fec = FEC_RXFIFO_1;
+	} else {
+		dev_err(priv->device, "no Rx FIFO for filtered frames\n");
+		return -EINVAL;
+	}
+
+	if (!priv->rx_fltr) {
+		ret = mttcan_fltr_save(priv);
+		if (ret)
+			return ret;
+	}
+
+	set = kzalloc(struct_size(set, f, num), GFP_KERNEL);
+	std = kcalloc(num, sizeof(*std), GFP_KERNEL);
+	xtd = kcalloc(num, sizeof(*xtd), GFP_KERNEL);
+	if (!set || !std || !xtd) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	set->num = num;
+
+	for (i = 0; i < num; i++) {
+		u32 id = filters[i].can_id & ~CAN_INV_FILTER;
+		u32 mask = filters[i].can_mask;
+		bool inv = filters[i].can_id & CAN_INV_FILTER;
+
+		/* Same normalisation the CAN core applies to receivers */
+		if (id & CAN_EFF_FLAG)
+			mask &= CAN_EFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+		else
+			mask &= CAN_SFF_MASK | CAN_EFF_FLAG | CAN_RTR_FLAG;
+		id &= mask;
+
+		set->f[i].can_id = inv ? id | CAN_INV_FILTER : id;
+		set->f[i].can_mask = mask;
+
+		if (inv) {
+			std_all = true;
+			xtd_all = true;
+			set->sw_check = true;
+			continue;
+		}
+		if (mask & CAN_RTR_FLAG)
+			set->sw_check = true;
+
+		/* Standard frames carry no bits above CAN_SFF_MASK */
+		if ((!(mask & CAN_EFF_FLAG) || !(id & CAN_EFF_FLAG)) &&
+		    !(id & CAN_EFF_MASK & ~CAN_SFF_MASK)) {
+			std[nstd].can_id = id & CAN_SFF_MASK;
+			std[nstd].can_mask = mask & CAN_SFF_MASK;
+			nstd++;
+		}
+		if (!(mask & CAN_EFF_FLAG) || (id & CAN_EFF_FLAG)) {
+			xtd[nxtd].can_id = id & CAN_EFF_MASK;
+			xtd[nxtd].can_mask = mask & CAN_EFF_MASK;
+			nxtd++;
+		}
+	}
+
+	if (nstd > std_slots) {
+		std_all = !std_slots;
+		mttcan_fltr_reduce(std, &nstd, std_slots);
+		set->sw_check = true;
+	}
+	if (nxtd > xtd_slots) {
+		xtd_all = !xtd_slots;
+		mttcan_fltr_reduce(xtd, &nxtd, xtd_slots);
+		set->sw_check = true;
+	}
+	/* XIDAM masks extended IDs before filtering */
+	if (nxtd && priv->xidam_reg != DEF_MTTCAN_XIDAM)
+		set->sw_check = true;
+
+	for (i = 0; i < std_slots; i++) {
+		if (i < nstd)
+			ttcan_set_std_id_filter(ttcan, priv->std_shadow, i,
+				FT_CLASSIC, fec, std[i].can_id,
+				std[i].can_mask);
+		else
+			ttcan_set_std_id_filter(ttcan, priv->std_shadow, i,
+				0, 0, 0, 0);
+	}
+	for (i = 0; i < xtd_slots; i++) {
+		if (i < nxtd)
+			ttcan_set_xtd_id_filter(ttcan, priv->xtd_shadow, i,
+				FT_CLASSIC, fec, xtd[i].can_id,
+				xtd[i].can_mask);
+		else
+			ttcan_set_xtd_id_filter(ttcan, priv->xtd_shadow, i,
+				0, 0, 0, 0);
+	}
+	ttcan->fltr_config.std_fltr_size = nstd;
+	ttcan->fltr_config.xtd_fltr_size = nxtd;
+
+	gfc = priv->gfc_reg & (MTT_GFC_RRFS_MASK | MTT_GFC_RRFE_MASK);
+	gfc |= ((std_all ? anf : GFC_ANFS_REJECT) <<
+		MTT_GFC_ANFS_SHIFT) & MTT_GFC_ANFS_MASK;
+	gfc |= ((xtd_all ? anf : GFC_ANFE_REJECT) <<
+		MTT_GFC_ANFE_SHIFT) & MTT_GFC_ANFE_MASK;
+	set->gfc = gfc;
+	set->std_elems = nstd;
+	set->xtd_elems = nxtd;
+	ret = ttcan_set_gfc(ttcan, gfc);
+
+	/* NAPI is disabled while the interface is down */
+	swap(priv->rx_fltr, set);
+	priv->rx_fltr_hw_passed = 0;
+	priv->rx_fltr_sw_rejected = 0;
+out:
+	/* Nothing was programmed: drop the copy taken for this call */
+	if (!priv->rx_fltr) {
+		kfree(priv->fltr_backup.std_shadow);
+		kfree(priv->fltr_backup.xtd_shadow);
+		priv->fltr_backup.std_shadow = NULL;
+		priv->fltr_backup.xtd_shadow = NULL;
+	}
+	kfree(xtd);
+	kfree(std);
+	kfree(set);
+	return ret;
+}
+
+/* Returns false if the frame only passed a widened hardware filter */
+static bool mttcan_rx_filter_match(struct mttcan_priv *priv,
+				   const struct ttcanfd_frame *rx)
+{
+	const struct mttcan_rx_filters *set = priv->rx_fltr;
+	int i;
+
+	if (!set)
+		return true;
+
+	priv->rx_fltr_hw_passed++;
+	if (!set->sw_check)
+		return true;
+
+	for (i = 0; i < set->num; i++) {
+		u32 id = set->f[i].can_id;
+		bool hit = !((rx->can_id ^ id) & set->f[i].can_mask &
+			     ~CAN_INV_FILTER);
+
+		if (id & CAN_INV_FILTER)
+			hit = !hit;
+		if (hit)
+			return true;
+	}
+
+	priv->rx_fltr_sw_rejected++;
+	return false;
+}
+
 static void mttcan_rx_hwtstamp(struct mttcan_priv *priv,
 			       struct sk_buff *skb, struct ttcanfd_frame *msg)
 {
@@ -360,79 +645,58 @@ static int mttcan_hpm_do_receive(struct net_device *dev,
 }
 
 static int mttcan_read_rcv_list(struct net_device *dev,
-				struct list_head *rcv,
-				enum ttcan_rx_type rx_type,
-				int rec_msgs, int quota)
+				struct ttcan_rx_ring *ring, int quota)
 {
-	unsigned int pushed;
-	unsigned long flags;
+	int rec_msgs = 0;
 	struct mttcan_priv *priv = netdev_priv(dev);
-	struct ttcan_rx_msg_list *rx;
+	struct ttcanfd_frame *rx;
 	struct net_device_stats *stats = &dev->stats;
-	struct list_head *cur, *next, rx_q;
-
-	if (list_empty(rcv))
-		return 0;
-
-	INIT_LIST_HEAD(&rx_q);
 
-	spin_lock_irqsave(&priv->ttcan->lock, flags);
-	switch (rx_type) {
-	case BUFFER:
-		priv->ttcan->rxb_mem = 0;
-		priv->ttcan->list_status &= ~(BUFFER & 0xFF);
-		break;
-	case FIFO_0:
-		priv->ttcan->rxq0_mem = 0;
-		priv->ttcan->list_status &= ~(FIFO_0 & 0xFF);
-		break;
-	case FIFO_1:
-		priv->ttcan->rxq1_mem = 0;
-		priv->ttcan->list_status &= ~(FIFO_1 & 0xFF);
-	default:
-		break;
-	}
-	list_splice_init(rcv, &rx_q);
-	spin_unlock_irqrestore(&priv->ttcan->lock, flags);
-
-	pushed = rec_msgs;
-	list_for_each_safe(cur, next, &rx_q) {
+	while (rec_msgs < quota) {
 		struct sk_buff *skb;
 		struct canfd_frame *fd_frame;
 		struct can_frame *frame;
-		if (!quota--)
+
+		rx = ttcan_rx_ring_peek(ring);
+		if (!rx)
 			break;
-		list_del_init(cur);
 
-		rx = list_entry(cur, struct ttcan_rx_msg_list, recv_list);
-		if (rx->msg.flags & CAN_FD_FLAG) {
+		if (!mttcan_rx_filter_match(priv, rx)) {
+			ttcan_rx_ring_consume(ring);
+			rec_msgs++;
+			continue;
+		}
+
+		if (rx->flags & CAN_FD_FLAG)
 			skb = alloc_canfd_skb(dev, &fd_frame);
-			if (!skb) {
-				stats->rx_dropped += pushed;
-				return 0;
-			}
-			memcpy(fd_frame, &rx->msg, sizeof(struct canfd_frame));
+		else
+			skb = alloc_can_skb(dev, &frame);
+		if (!skb) {
+			ttcan_rx_ring_consume(ring);
+			ring->dropped++;
+			stats->rx_dropped++;
+			rec_msgs++;
+			continue;
+		}
+
+		if (rx->flags & CAN_FD_FLAG) {
+			memcpy(fd_frame, rx, sizeof(struct canfd_frame));
 			stats->rx_bytes += fd_frame->len;
 		} else {
-			skb = alloc_can_skb(dev, &frame);
-			if (!skb) {
-				stats->rx_dropped += pushed;
-				return 0;
-			}
-			frame->can_id =  rx->msg.can_id;
-			frame->can_dlc = rx->msg.d_len;
-			memcpy(frame->data, &rx->msg.data, frame->can_dlc);
+			frame->can_id =  rx->can_id;
+			frame->can_dlc = rx->d_len;
+			memcpy(frame->data, &rx->data, frame->can_dlc);
 			stats->rx_bytes += frame->can_dlc;
 		}
 
 		if (priv->hwts_rx_en)
-			mttcan_rx_hwtstamp(priv, skb, &rx->msg);
-		kfree(rx);
+			mttcan_rx_hwtstamp(priv, skb, rx);
+		ttcan_rx_ring_consume(ring);
 		netif_receive_skb(skb);
 		stats->rx_packets++;
-		pushed--;
+		rec_msgs++;
 	}
-	return rec_msgs - pushed;
+	return rec_msgs;
 }
 
 static int mttcan_state_change(struct net_device *dev,
@@ -676,10 +940,45 @@ static void mttcan_tx_cancelled(struct net_device *dev)
 	spin_unlock(&priv->tx_lock);
 }
 
+static int mttcan_drain_rx_rings(struct net_device *dev, int quota)
+{
+	struct mttcan_priv *priv = netdev_priv(dev);
+	int rec_msgs;
+
+	rec_msgs = mttcan_read_rcv_list(dev, &priv->ttcan->rx_b, quota);
+	rec_msgs += mttcan_read_rcv_list(dev, &priv->ttcan->rx_q1,
+					 quota - rec_msgs);
+	rec_msgs += mttcan_read_rcv_list(dev, &priv->ttcan->rx_q0,
+					 quota - rec_msgs);
+	return rec_msgs;
+}
+
+static bool mttcan_rx_stalled(struct ttcan_controller *ttcan)
+{
+	return ttcan->rx_b.stalled || ttcan->rx_q0.stalled ||
+		ttcan->rx_q1.stalled;
+}
+
+/* Re-read the sources whose frames did not fit in their ring */
+static void mttcan_rx_refill(struct ttcan_controller *ttcan)
+{
+	if (ttcan->rx_b.stalled) {
+		ttcan->rx_b.stalled = false;
+		ttcan_read_rx_buffer(ttcan);
+	}
+	if (ttcan->rx_q1.stalled) {
+		ttcan->rx_q1.stalled = false;
+		ttcan_read_rx_fifo1(ttcan);
+	}
+	if (ttcan->rx_q0.stalled) {
+		ttcan->rx_q0.stalled = false;
+		ttcan_read_rx_fifo0(ttcan);
+	}
+}
+
 static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 {
 	int work_done = 0;
-	int rec_msgs = 0;
 	struct net_device *dev = napi->dev;
 	struct mttcan_priv *priv = netdev_priv(dev);
 	u32 ir, ack, ttir, ttack, psr;
@@ -784,10 +1083,9 @@ static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 		if (ir & MTT_IR_DRX_MASK) {
 			ack = MTT_IR_DRX_MASK;
 			ttcan_ir_write(priv->ttcan, ack);
-			rec_msgs = ttcan_read_rx_buffer(priv->ttcan);
+			ttcan_read_rx_buffer(priv->ttcan);
 			work_done +=
 			    mttcan_read_rcv_list(dev, &priv->ttcan->rx_b,
-						 BUFFER, rec_msgs,
 						 quota - work_done);
 			pr_debug("%s: buffer mesg received\n", __func__);
 
@@ -819,11 +1117,10 @@ static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 					MTT_IR_RF1N_MASK);
 				ttcan_ir_write(priv->ttcan, ack);
 
-				rec_msgs = ttcan_read_rx_fifo1(priv->ttcan);
+				ttcan_read_rx_fifo1(priv->ttcan);
 				work_done +=
 				    mttcan_read_rcv_list(dev,
 							 &priv->ttcan->rx_q1,
-							 FIFO_1, rec_msgs,
 							 quota - work_done);
 				pr_debug("%s: msg received in Q1\n", __func__);
 			}
@@ -833,11 +1130,10 @@ static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 					MTT_IR_RF0W_MASK |
 					MTT_IR_RF0N_MASK);
 				ttcan_ir_write(priv->ttcan, ack);
-				rec_msgs = ttcan_read_rx_fifo0(priv->ttcan);
+				ttcan_read_rx_fifo0(priv->ttcan);
 				work_done +=
 				    mttcan_read_rcv_list(dev,
 							 &priv->ttcan->rx_q0,
-							 FIFO_0, rec_msgs,
 							 quota - work_done);
 				pr_debug("%s: msg received in Q0\n", __func__);
 			}
@@ -948,6 +1244,24 @@ static int mttcan_poll_ir(struct napi_struct *napi, int quota)
 		ttcan_ttir_write(priv->ttcan, ttack);
 	}
 end:
+	/*
+	 * Frames left over from an earlier quota break are still in the
+	 * rings; keep NAPI scheduled until they are delivered.
+	 */
+	work_done += mttcan_drain_rx_rings(dev, quota - work_done);
+
+	/*
+	 * Frames left in message RAM on a full ring had their new message
+	 * interrupt acked already; pull them in as the rings drain.
+	 */
+	while (work_done < quota && mttcan_rx_stalled(priv->ttcan)) {
+		mttcan_rx_refill(priv->ttcan);
+		work_done += mttcan_drain_rx_rings(dev, quota - work_done);
+	}
+
+	if (mttcan_rx_stalled(priv->ttcan))
+		work_done = quota;
+
 	if (work_done < quota) {
 		napi_complete(napi);
 
@@ -1345,6 +1659,9 @@ static int mttcan_close(struct net_device *dev)
 	 */
 	priv->ttcan->tx_object = 0;
 	priv->hwts_rx_en = false;
+	ttcan_rx_ring_flush(&priv->ttcan->rx_b);
+	ttcan_rx_ring_flush(&priv->ttcan->rx_q0);
+	ttcan_rx_ring_flush(&priv->ttcan->rx_q1);
 
 	close_candev(dev);
 	mttcan_power_down(dev);
@@ -1839,9 +2156,6 @@ static int mttcan_probe(struct platform_device *pdev)
 	priv->ttcan->mram_size = mesg_ram->end - mesg_ram->start + 1;
 	priv->ttcan->id = priv->instance;
 	priv->ttcan->mram_vbase = mram_addr;
-	INIT_LIST_HEAD(&priv->ttcan->rx_q0);
-	INIT_LIST_HEAD(&priv->ttcan->rx_q1);
-	INIT_LIST_HEAD(&priv->ttcan->rx_b);
 	INIT_LIST_HEAD(&priv->ttcan->tx_evt);
 
 	platform_set_drvdata(pdev, dev);
@@ -1911,6 +2225,9 @@ static int mttcan_remove(struct platform_device *pdev)
 	mttcan_delete_sys_files(&dev->dev);
 	unregister_mttcan_dev(dev);
 	mttcan_unprepare_clock(priv);
+	kfree(priv->rx_fltr);
+	kfree(priv->fltr_backup.std_shadow);
+	kfree(priv->fltr_backup.xtd_shadow);
 	platform_set_drvdata(pdev, NULL);
 	free_mttcan_dev(dev);
 
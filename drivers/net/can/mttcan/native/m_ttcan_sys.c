@@ -15,6 +15,7 @@
  */
 
 #include "m_ttcan.h"
+#include <linux/rtnetlink.h>
 
 static int mttcan_check_fec_validity(struct mttcan_priv *priv,
 				     unsigned int fec);
@@ -102,6 +103,10 @@ static ssize_t store_gfc_fltr(struct device *dev,
 		dev_err(dev, "GFC cannot be configured as device is running\n");
 		return -EBUSY;
 	}
+	if (priv->rx_fltr) {
+		dev_err(dev, "rx_filters offload owns the GFC\n");
+		return -EBUSY;
+	}
 
 	ret = sscanf(buf, "anfs=%u anfe=%u rrfs=%u rrfe=%u", &anfs,
 			&anfe, &rrfs, &rrfe);
@@ -220,6 +225,10 @@ static ssize_t store_std_fltr(struct device *dev,
 		dev_err(dev, "device is running\n");
 		return -EBUSY;
 	}
+	if (priv->rx_fltr) {
+		dev_err(dev, "rx_filters offload owns the filter RAM\n");
+		return -EBUSY;
+	}
 	/* usage: sft="0/1/2/3" sfec=1...7 sfid1="ID1" sfid2="ID2" idx=%u
 	*/
 	ret = sscanf(buf, "sft=%u sfec=%u sfid1=%X sfid2=%X idx=%u", &sft,
@@ -285,6 +294,10 @@ static ssize_t store_xtd_fltr(struct device *dev,
 		dev_err(dev, "device is running\n");
 		return -EBUSY;
 	}
+	if (priv->rx_fltr) {
+		dev_err(dev, "rx_filters offload owns the filter RAM\n");
+		return -EBUSY;
+	}
 	/* usage: eft="0/1/2/3" efec=1...7 efid1="ID1h" efid2="ID2h" idx=%u
 	*/
 	ret = sscanf(buf, "eft=%u efec=%u efid1=%X efid2=%X idx=%u", &eft,
@@ -695,6 +708,112 @@ static ssize_t store_tdc_offset(struct device *dev,
 	return count;
 }
 
+static ssize_t show_rx_filters(struct device *dev,
+	struct device_attribute *devattr, char *buf)
+{
+	struct mttcan_priv *priv = netdev_priv(to_net_dev(dev));
+	const struct mttcan_rx_filters *set;
+	ssize_t total = 0;
+	int i;
+
+	rtnl_lock();
+	set = priv->rx_fltr;
+	if (!set) {
+		total = sprintf(buf, "none\n");
+		goto out;
+	}
+
+	total += sprintf(buf + total,
+		"std_elems=%u xtd_elems=%u gfc=0x%x sw_check=%d\n",
+		set->std_elems, set->xtd_elems, set->gfc, set->sw_check);
+	total += sprintf(buf + total, "hw_passed=%llu sw_rejected=%llu\n",
+		priv->rx_fltr_hw_passed, priv->rx_fltr_sw_rejected);
+	for (i = 0; i < set->num; i++)
+		total += scnprintf(buf + total, PAGE_SIZE - total,
+			"%08x:%08x\n", set->f[i].can_id, set->f[i].can_mask);
+out:
+	rtnl_unlock();
+	return total;
+}
+
+static ssize_t store_rx_filters(struct device *dev,
+	struct device_attribute *devattr,
+	const char *buf, size_t count)
+{
+	struct net_device *ndev = to_net_dev(dev);
+	struct mttcan_priv *priv = netdev_priv(ndev);
+	struct can_filter *filters;
+	char *str, *tok, *cur;
+	int num = 0;
+	int ret;
+
+	/* usage: "<can_id>:<can_mask> ..." as passed to CAN_RAW_FILTER,
+	 * or "none" to stop offloading
+	 */
+	filters = kcalloc(MTTCAN_MAX_RX_FILTERS, sizeof(*filters),
+			  GFP_KERNEL);
+	str = kstrndup(buf, count, GFP_KERNEL);
+	if (!filters || !str) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	cur = strim(str);
+	if (strcmp(cur, "none")) {
+		while ((tok = strsep(&cur, " ,\n")) != NULL) {
+			if (!*tok)
+				continue;
+			if (num == MTTCAN_MAX_RX_FILTERS) {
+				dev_err(dev, "too many filters\n");
+				ret = -ENOSPC;
+				goto out;
+			}
+			if (sscanf(tok, "%x:%x", &filters[num].can_id,
+				   &filters[num].can_mask) != 2) {
+				dev_err(dev, "Invalid rx filter\n");
+				pr_err("usage: ID:MASK ... | none\n");
+				ret = -EINVAL;
+				goto out;
+			}
+			num++;
+		}
+	}
+
+	rtnl_lock();
+	if (ndev->flags & IFF_UP) {
+		dev_err(dev, "device is running\n");
+		ret = -EBUSY;
+	} else {
+		ret = mttcan_set_rx_filters(priv, filters, num);
+	}
+	rtnl_unlock();
+out:
+	kfree(str);
+	kfree(filters);
+	return ret ? ret : count;
+}
+
+static ssize_t show_rx_ring_stats(struct device *dev,
+				  struct device_attribute *devattr, char *buf)
+{
+	struct mttcan_priv *priv = netdev_priv(to_net_dev(dev));
+	struct ttcan_rx_ring *ring[] = {
+		&priv->ttcan->rx_q0, &priv->ttcan->rx_q1, &priv->ttcan->rx_b,
+	};
+	const char *name[] = { "rxq0", "rxq1", "rxb" };
+	ssize_t ret = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ring); i++)
+		ret += sprintf(buf + ret,
+			"%s: count=%u hwm=%u size=%u full=%llu dropped=%llu\n",
+			name[i], ttcan_rx_ring_count(ring[i]),
+			READ_ONCE(ring[i]->hwm), TTCAN_RX_RING_SIZE,
+			READ_ONCE(ring[i]->full), READ_ONCE(ring[i]->dropped));
+
+	return ret;
+}
+
 static DEVICE_ATTR(std_filter, S_IRUGO | S_IWUSR, show_std_fltr,
 	store_std_fltr);
 static DEVICE_ATTR(xtd_filter, S_IRUGO | S_IWUSR, show_xtd_fltr,
@@ -715,6 +834,9 @@ static DEVICE_ATTR(trigger_mem, S_IRUGO | S_IWUSR, show_trigger_mem,
 		store_trigger_mem);
 static DEVICE_ATTR(tdc_offset, S_IRUGO | S_IWUSR, show_tdc_offset,
 		store_tdc_offset);
+static DEVICE_ATTR(rx_ring_stats, S_IRUGO, show_rx_ring_stats, NULL);
+static DEVICE_ATTR(rx_filters, S_IRUGO | S_IWUSR, show_rx_filters,
+		store_rx_filters);
 
 static struct attribute *mttcan_attr[] = {
 	&dev_attr_std_filter.attr,
@@ -730,6 +852,8 @@ static struct attribute *mttcan_attr[] = {
 	&dev_attr_cccr_init_txbar.attr,
 	&dev_attr_trigger_mem.attr,
 	&dev_attr_tdc_offset.attr,
+	&dev_attr_rx_ring_stats.attr,
+	&dev_attr_rx_filters.attr,
 	NULL
 };
 
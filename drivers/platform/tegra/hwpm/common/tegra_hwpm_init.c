@@ -238,6 +238,8 @@ void tegra_hwpm_release_sw_setup(struct tegra_soc_hwpm *hwpm)
 
 	tegra_hwpm_fn(hwpm, " ");
 
+	tegra_hwpm_regops_index_release(hwpm);
+
 	err = tegra_hwpm_func_all_ip(hwpm, NULL,
 		TEGRA_HWPM_RELEASE_IP_STRUCTURES);
 	if (err != 0) {
@@ -19,6 +19,8 @@
 #include <linux/string.h>
 #include <linux/of_address.h>
 #include <linux/dma-buf.h>
+#include <linux/eventfd.h>
+#include <linux/jiffies.h>
 #include <soc/tegra/fuse.h>
 #include <uapi/linux/tegra-soc-hwpm-uapi.h>
 
@@ -137,6 +139,273 @@ static int tegra_hwpm_reset_stream_buf(struct tegra_soc_hwpm *hwpm)
 	return 0;
 }
 
+/*
+ * Sample MEM_HEAD and overflow status and update stream accounting.
+ * Returns true if readiness changed and waiters should be notified.
+ * Called with stream->lock held.
+ */
+static bool tegra_hwpm_stream_sample(struct tegra_soc_hwpm *hwpm)
+{
+	struct tegra_hwpm_stream *stream = &hwpm->stream;
+	u64 head = 0ULL;
+	u64 delta = 0ULL;
+	bool overflowed = false;
+	bool above = false;
+	bool notify = false;
+	ktime_t now;
+
+	if ((stream->buf_size == 0ULL) || (hwpm->stream_sgt == NULL)) {
+		return false;
+	}
+
+	head = hwpm->active_chip->get_mem_bytes_put_ptr(hwpm) %
+		stream->buf_size;
+	delta = (tegra_hwpm_safe_add_u64(head, stream->buf_size) -
+		stream->mem_head) % stream->buf_size;
+	stream->bytes_streamed = tegra_hwpm_safe_add_u64(
+		stream->bytes_streamed, delta);
+	stream->mem_head = head;
+
+	now = ktime_get();
+	overflowed = hwpm->active_chip->membuf_overflow_status(hwpm);
+	if (overflowed && !stream->overflowed) {
+		/* PMA drops records until space is released */
+		stream->overflow_count++;
+		stream->overflow_start = now;
+		notify = true;
+		tegra_hwpm_dbg(hwpm, hwpm_dbg_update_get_put,
+			"stream overflow %llu", stream->overflow_count);
+	} else if (stream->overflowed) {
+		stream->overflow_ns = tegra_hwpm_safe_add_u64(
+			stream->overflow_ns, (u64)ktime_to_ns(
+				ktime_sub(now, stream->overflow_start)));
+		stream->overflow_start = now;
+	}
+	stream->overflowed = overflowed;
+
+	if (overflowed) {
+		stream->bytes_available = stream->buf_size;
+	} else {
+		stream->bytes_available = (tegra_hwpm_safe_add_u64(head,
+			stream->buf_size) - stream->mem_get) %
+			stream->buf_size;
+	}
+
+	above = (stream->watermark != 0ULL) &&
+		(stream->bytes_available >= stream->watermark);
+	if (above && !stream->above_watermark) {
+		notify = true;
+	}
+	stream->above_watermark = above;
+
+	if (notify) {
+		stream->notify_count++;
+	}
+	return notify;
+}
+
+static void tegra_hwpm_stream_wake(struct tegra_soc_hwpm *hwpm)
+{
+	struct tegra_hwpm_stream *stream = &hwpm->stream;
+
+	wake_up_interruptible(&stream->wq);
+	if (stream->eventfd != NULL) {
+		eventfd_signal(stream->eventfd, 1);
+	}
+}
+
+static void tegra_hwpm_stream_monitor(struct work_struct *work)
+{
+	struct tegra_hwpm_stream *stream = container_of(
+		to_delayed_work(work), struct tegra_hwpm_stream, monitor);
+	struct tegra_soc_hwpm *hwpm = container_of(
+		stream, struct tegra_soc_hwpm, stream);
+
+	mutex_lock(&stream->lock);
+	if (tegra_hwpm_stream_sample(hwpm)) {
+		tegra_hwpm_stream_wake(hwpm);
+	}
+	if (stream->period_us != 0U) {
+		schedule_delayed_work(&stream->monitor,
+			usecs_to_jiffies(stream->period_us));
+	}
+	mutex_unlock(&stream->lock);
+}
+
+void tegra_hwpm_stream_init(struct tegra_soc_hwpm *hwpm)
+{
+	struct tegra_hwpm_stream *stream = &hwpm->stream;
+
+	mutex_init(&stream->lock);
+	init_waitqueue_head(&stream->wq);
+	INIT_DELAYED_WORK(&stream->monitor, tegra_hwpm_stream_monitor);
+}
+
+/* Start stream accounting for a newly mapped stream buffer */
+static void tegra_hwpm_stream_reset(struct tegra_soc_hwpm *hwpm,
+	u64 buf_size)
+{
+	struct tegra_hwpm_stream *stream = &hwpm->stream;
+
+	mutex_lock(&stream->lock);
+	stream->buf_size = buf_size;
+	stream->watermark = 0ULL;
+	stream->mem_get = 0ULL;
+	stream->mem_head = 0ULL;
+	stream->bytes_available = 0ULL;
+	stream->bytes_streamed = 0ULL;
+	stream->bytes_consumed = 0ULL;
+	stream->notify_count = 0ULL;
+	stream->overflow_count = 0ULL;
+	stream->overflow_ns = 0ULL;
+	stream->above_watermark = false;
+	stream->overflowed = false;
+	mutex_unlock(&stream->lock);
+}
+
+static void tegra_hwpm_stream_disarm(struct tegra_soc_hwpm *hwpm)
+{
+	struct tegra_hwpm_stream *stream = &hwpm->stream;
+
+	mutex_lock(&stream->lock);
+	stream->period_us = 0U;
+	mutex_unlock(&stream->lock);
+
+	/* Monitor can't requeue itself once period_us is 0 */
+	cancel_delayed_work_sync(&stream->monitor);
+
+	mutex_lock(&stream->lock);
+	if (stream->eventfd != NULL) {
+		eventfd_ctx_put(stream->eventfd);
+		stream->eventfd = NULL;
+	}
+	stream->watermark = 0ULL;
+	stream->above_watermark = false;
+	mutex_unlock(&stream->lock);
+}
+
+/*
+ * Stop stream monitoring, drop the eventfd and wake up pollers. Called
+ * before the buffer is unmapped and on release, where the pipeline may not
+ * get cleared if releasing the resources fails.
+ */
+void tegra_hwpm_stream_stop(struct tegra_soc_hwpm *hwpm)
+{
+	struct tegra_hwpm_stream *stream = &hwpm->stream;
+
+	tegra_hwpm_stream_disarm(hwpm);
+
+	mutex_lock(&stream->lock);
+	stream->buf_size = 0ULL;
+	stream->bytes_available = 0ULL;
+	mutex_unlock(&stream->lock);
+
+	wake_up_interruptible(&stream->wq);
+}
+
+int tegra_hwpm_stream_notify(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_stream_notify *stream_notify)
+{
+	struct tegra_hwpm_stream *stream = &hwpm->stream;
+	struct eventfd_ctx *eventfd = NULL;
+	u64 watermark = stream_notify->watermark_bytes;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	if (hwpm->stream_sgt == NULL) {
+		tegra_hwpm_err(hwpm, "PMA stream buffer not allocated");
+		return -ENXIO;
+	}
+
+	if ((stream_notify->flags & ~TEGRA_SOC_HWPM_STREAM_NOTIFY_EVENTFD) ||
+		(stream_notify->reserved != 0U)) {
+		tegra_hwpm_err(hwpm, "Invalid flags 0x%x",
+			stream_notify->flags);
+		return -EINVAL;
+	}
+
+	/* Drop previous configuration */
+	tegra_hwpm_stream_disarm(hwpm);
+
+	if (stream_notify->period_us == 0U) {
+		tegra_hwpm_dbg(hwpm, hwpm_dbg_update_get_put,
+			"stream notification disarmed");
+		return 0;
+	}
+
+	if (stream_notify->flags & TEGRA_SOC_HWPM_STREAM_NOTIFY_EVENTFD) {
+		eventfd = eventfd_ctx_fdget(stream_notify->eventfd);
+		if (IS_ERR(eventfd)) {
+			tegra_hwpm_err(hwpm, "Invalid eventfd %d",
+				stream_notify->eventfd);
+			return PTR_ERR(eventfd);
+		}
+	}
+
+	mutex_lock(&stream->lock);
+	if (watermark == 0ULL) {
+		/* Double buffering: notify when one half is filled */
+		watermark = stream->buf_size / 2ULL;
+	}
+	if ((watermark == 0ULL) || (watermark > stream->buf_size)) {
+		tegra_hwpm_err(hwpm, "Invalid watermark 0x%llx, size 0x%llx",
+			watermark, stream->buf_size);
+		mutex_unlock(&stream->lock);
+		if (eventfd != NULL) {
+			eventfd_ctx_put(eventfd);
+		}
+		return -EINVAL;
+	}
+
+	stream->eventfd = eventfd;
+	stream->watermark = watermark;
+	stream->period_us = stream_notify->period_us;
+	schedule_delayed_work(&stream->monitor, 0);
+	mutex_unlock(&stream->lock);
+
+	tegra_hwpm_dbg(hwpm, hwpm_dbg_update_get_put,
+		"stream notify: watermark 0x%llx period %u us eventfd %d",
+		watermark, stream_notify->period_us,
+		(eventfd != NULL) ? stream_notify->eventfd : -1);
+
+	return 0;
+}
+
+int tegra_hwpm_stream_status(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_stream_status *stream_status)
+{
+	struct tegra_hwpm_stream *stream = &hwpm->stream;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	mutex_lock(&stream->lock);
+	if (tegra_hwpm_stream_sample(hwpm)) {
+		tegra_hwpm_stream_wake(hwpm);
+	}
+	stream_status->mem_head = stream->mem_head;
+	stream_status->mem_get = stream->mem_get;
+	stream_status->bytes_available = stream->bytes_available;
+	stream_status->bytes_streamed = stream->bytes_streamed;
+	stream_status->bytes_consumed = stream->bytes_consumed;
+	stream_status->notify_count = stream->notify_count;
+	stream_status->overflow_count = stream->overflow_count;
+	stream_status->overflow_ns = stream->overflow_ns;
+	mutex_unlock(&stream->lock);
+
+	return 0;
+}
+
+void tegra_hwpm_stream_readiness(struct tegra_soc_hwpm *hwpm,
+	bool *ready, bool *overflowed)
+{
+	struct tegra_hwpm_stream *stream = &hwpm->stream;
+
+	mutex_lock(&stream->lock);
+	*ready = stream->above_watermark;
+	*overflowed = stream->overflowed;
+	mutex_unlock(&stream->lock);
+}
+
 int tegra_hwpm_map_stream_buffer(struct tegra_soc_hwpm *hwpm,
 	struct tegra_soc_hwpm_alloc_pma_stream *alloc_pma_stream)
 {
@@ -176,6 +445,8 @@ int tegra_hwpm_map_stream_buffer(struct tegra_soc_hwpm *hwpm,
 		goto fail;
 	}
 
+	tegra_hwpm_stream_reset(hwpm, alloc_pma_stream->stream_buf_size);
+
 	return 0;
 
 fail:
@@ -208,6 +479,8 @@ int tegra_hwpm_clear_mem_pipeline(struct tegra_soc_hwpm *hwpm)
 
 	tegra_hwpm_fn(hwpm, " ");
 
+	tegra_hwpm_stream_stop(hwpm);
+
 	/* Stream MEM_BYTES to clear pipeline */
 	if (hwpm->mem_bytes_kernel) {
 		s32 timeout_msecs = 1000;
@@ -272,6 +545,21 @@ int tegra_hwpm_update_mem_bytes(struct tegra_soc_hwpm *hwpm,
 		return -EINVAL;
 	}
 
+	mutex_lock(&hwpm->stream.lock);
+	if ((update_get_put->mem_bump != 0ULL) &&
+		(hwpm->stream.buf_size != 0ULL)) {
+		hwpm->stream.mem_get = tegra_hwpm_safe_add_u64(
+			hwpm->stream.mem_get, update_get_put->mem_bump) %
+			hwpm->stream.buf_size;
+		hwpm->stream.bytes_consumed = tegra_hwpm_safe_add_u64(
+			hwpm->stream.bytes_consumed, update_get_put->mem_bump);
+		/* Re-arm watermark edge for the released region */
+		if (tegra_hwpm_stream_sample(hwpm)) {
+			tegra_hwpm_stream_wake(hwpm);
+		}
+	}
+	mutex_unlock(&hwpm->stream.lock);
+
 	/* Stream MEM_BYTES value to MEM_BYTES buffer */
 	if (update_get_put->b_stream_mem_bytes) {
 		ret = hwpm->active_chip->stream_mem_bytes(hwpm);
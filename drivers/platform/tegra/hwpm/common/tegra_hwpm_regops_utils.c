@@ -11,6 +11,10 @@
  * more details.
  */
 
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/bitmap.h>
+#include <linux/ktime.h>
 #include <soc/tegra/fuse.h>
 
 #include <uapi/linux/tegra-soc-hwpm-uapi.h>
@@ -21,42 +25,389 @@
 #include <tegra_hwpm_common.h>
 #include <tegra_hwpm_static_analysis.h>
 
-static int tegra_hwpm_exec_reg_ops(struct tegra_soc_hwpm *hwpm,
-	struct tegra_soc_hwpm_reg_op *reg_op)
+/*
+ * Allowlist bitmaps are only built for apertures up to 256KB, larger
+ * apertures fall back to the check_alist() HAL.
+ */
+#define TEGRA_HWPM_ALIST_MAP_MAX_BITS	65536U
+
+/* Number of address lookups done by the regops index benchmark */
+#define TEGRA_HWPM_REGOPS_BENCH_OPS	100000U
+
+static int tegra_hwpm_addr_range_cmp(const void *a, const void *b)
+{
+	const struct tegra_hwpm_addr_range *ra = a;
+	const struct tegra_hwpm_addr_range *rb = b;
+
+	if (ra->start_abs_pa < rb->start_abs_pa) {
+		return -1;
+	}
+	if (ra->start_abs_pa > rb->start_abs_pa) {
+		return 1;
+	}
+	return 0;
+}
+
+static unsigned long *tegra_hwpm_alloc_alist_map(struct tegra_soc_hwpm *hwpm,
+	struct hwpm_ip_aperture *element)
+{
+	u64 aperture_size = 0ULL;
+	u64 reg_offset = 0ULL;
+	u32 num_bits = 0U;
+	u64 alist_idx;
+	unsigned long *alist_map = NULL;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	if (element->alist == NULL) {
+		return NULL;
+	}
+
+	aperture_size = tegra_hwpm_safe_add_u64(tegra_hwpm_safe_sub_u64(
+		element->end_abs_pa, element->start_abs_pa), 1ULL);
+	if ((aperture_size / sizeof(u32)) > TEGRA_HWPM_ALIST_MAP_MAX_BITS) {
+		tegra_hwpm_dbg(hwpm, hwpm_dbg_bind,
+			"Aperture 0x%llx size 0x%llx: no alist map",
+			element->start_abs_pa, aperture_size);
+		return NULL;
+	}
+	num_bits = tegra_hwpm_safe_cast_u64_to_u32(
+		aperture_size / sizeof(u32));
+
+	alist_map = bitmap_zalloc(num_bits, GFP_KERNEL);
+	if (alist_map == NULL) {
+		return NULL;
+	}
+
+	for (alist_idx = 0ULL; alist_idx < element->alist_size; alist_idx++) {
+		reg_offset = element->alist[alist_idx].reg_offset;
+		if (((reg_offset % sizeof(u32)) != 0ULL) ||
+			((reg_offset / sizeof(u32)) >= num_bits)) {
+			/* Offset can't be represented, use check_alist() */
+			tegra_hwpm_dbg(hwpm, hwpm_dbg_bind,
+				"Aperture 0x%llx alist offset 0x%llx unmapped",
+				element->start_abs_pa, reg_offset);
+			bitmap_free(alist_map);
+			return NULL;
+		}
+		set_bit(reg_offset / sizeof(u32), alist_map);
+	}
+
+	return alist_map;
+}
+
+/*
+ * Walk reserved IPs and collect apertures which tegra_hwpm_aperture_for_address
+ * would accept. If index->ranges is NULL, apertures are only counted.
+ */
+static void tegra_hwpm_regops_index_collect(struct tegra_soc_hwpm *hwpm,
+	struct tegra_hwpm_regops_index *index)
+{
+	struct tegra_soc_hwpm_chip *active_chip = hwpm->active_chip;
+	struct hwpm_ip *chip_ip = NULL;
+	struct hwpm_ip_inst_per_aperture_info *inst_a_info = NULL;
+	struct hwpm_ip_inst *ip_inst = NULL;
+	struct hwpm_ip_element_info *e_info = NULL;
+	struct hwpm_ip_aperture *element = NULL;
+	struct tegra_hwpm_addr_range *range = NULL;
+	u32 ip_idx, a_type, inst_idx, element_idx;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	for (ip_idx = 0U; ip_idx < active_chip->get_ip_max_idx(hwpm);
+		ip_idx++) {
+		chip_ip = active_chip->chip_ips[ip_idx];
+		if ((chip_ip == NULL) || !chip_ip->reserved ||
+			chip_ip->override_enable) {
+			continue;
+		}
+
+		for (a_type = 0U; a_type < TEGRA_HWPM_APERTURE_TYPE_MAX;
+			a_type++) {
+			inst_a_info = &chip_ip->inst_aperture_info[a_type];
+			if (inst_a_info->inst_arr == NULL) {
+				continue;
+			}
+
+			for (inst_idx = 0U; inst_idx < inst_a_info->inst_slots;
+				inst_idx++) {
+				ip_inst = inst_a_info->inst_arr[inst_idx];
+				if ((ip_inst == NULL) ||
+					((chip_ip->inst_fs_mask &
+					ip_inst->hw_inst_mask) == 0U)) {
+					continue;
+				}
+
+				e_info = &ip_inst->element_info[a_type];
+				if (e_info->element_arr == NULL) {
+					continue;
+				}
+
+				for (element_idx = 0U;
+					element_idx < e_info->element_slots;
+					element_idx++) {
+					element = e_info->element_arr[
+						element_idx];
+					if ((element == NULL) ||
+						((element->element_index_mask &
+						ip_inst->element_fs_mask) ==
+						0U)) {
+						continue;
+					}
+
+					if (index->ranges != NULL) {
+						range = &index->ranges[
+							index->num_ranges];
+						range->start_abs_pa =
+							element->start_abs_pa;
+						range->end_abs_pa =
+							element->end_abs_pa;
+						range->ip_idx = ip_idx;
+						range->chip_ip = chip_ip;
+						range->ip_inst = ip_inst;
+						range->element = element;
+					}
+					index->num_ranges++;
+				}
+			}
+		}
+	}
+}
+
+static void tegra_hwpm_regops_index_free(struct tegra_soc_hwpm *hwpm,
+	struct tegra_hwpm_regops_index *index)
+{
+	u32 idx;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	if (index == NULL) {
+		return;
+	}
+
+	if (index->ranges != NULL) {
+		for (idx = 0U; idx < index->num_ranges; idx++) {
+			bitmap_free(index->ranges[idx].alist_map);
+		}
+		kfree(index->ranges);
+	}
+	kfree(index);
+}
+
+/*
+ * Build the regops address index from the bound apertures.
+ * The index is an optimization: on failure regops keep using the IP
+ * structure walk.
+ */
+int tegra_hwpm_regops_index_build(struct tegra_soc_hwpm *hwpm)
+{
+	struct tegra_hwpm_regops_index *index = NULL;
+	struct tegra_hwpm_addr_range *range = NULL;
+	u32 num_ranges = 0U;
+	u32 idx;
+	int err = 0;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	index = kzalloc(sizeof(struct tegra_hwpm_regops_index), GFP_KERNEL);
+	if (index == NULL) {
+		tegra_hwpm_err(hwpm, "regops index alloc failed");
+		return -ENOMEM;
+	}
+
+	tegra_hwpm_regops_index_collect(hwpm, index);
+	num_ranges = index->num_ranges;
+	if (num_ranges == 0U) {
+		tegra_hwpm_dbg(hwpm, hwpm_dbg_bind, "No apertures to index");
+		goto publish;
+	}
+
+	index->ranges = kcalloc(num_ranges,
+		sizeof(struct tegra_hwpm_addr_range), GFP_KERNEL);
+	if (index->ranges == NULL) {
+		tegra_hwpm_err(hwpm, "regops index ranges alloc failed");
+		err = -ENOMEM;
+		goto fail;
+	}
+
+	index->num_ranges = 0U;
+	tegra_hwpm_regops_index_collect(hwpm, index);
+	if (index->num_ranges != num_ranges) {
+		tegra_hwpm_err(hwpm, "Aperture count changed %d != %d",
+			index->num_ranges, num_ranges);
+		err = -EINVAL;
+		goto fail;
+	}
+
+	sort(index->ranges, num_ranges, sizeof(struct tegra_hwpm_addr_range),
+		tegra_hwpm_addr_range_cmp, NULL);
+
+	for (idx = 0U; idx < num_ranges; idx++) {
+		range = &index->ranges[idx];
+
+		if ((idx > 0U) && (range->start_abs_pa <=
+			index->ranges[idx - 1U].end_abs_pa)) {
+			/* Binary search requires disjoint apertures */
+			tegra_hwpm_err(hwpm,
+				"Aperture 0x%llx overlaps aperture 0x%llx",
+				range->start_abs_pa,
+				index->ranges[idx - 1U].start_abs_pa);
+			err = -EINVAL;
+			goto fail;
+		}
+
+		range->alist_map = tegra_hwpm_alloc_alist_map(hwpm,
+			range->element);
+	}
+
+publish:
+	tegra_hwpm_dbg(hwpm, hwpm_dbg_bind,
+		"regops index: %d apertures", index->num_ranges);
+
+	mutex_lock(&hwpm->regops_index_lock);
+	tegra_hwpm_regops_index_free(hwpm, hwpm->regops_index);
+	hwpm->regops_index = index;
+	mutex_unlock(&hwpm->regops_index_lock);
+
+	return 0;
+fail:
+	tegra_hwpm_regops_index_free(hwpm, index);
+	return err;
+}
+
+void tegra_hwpm_regops_index_release(struct tegra_soc_hwpm *hwpm)
+{
+	tegra_hwpm_fn(hwpm, " ");
+
+	mutex_lock(&hwpm->regops_index_lock);
+	tegra_hwpm_regops_index_free(hwpm, hwpm->regops_index);
+	hwpm->regops_index = NULL;
+	mutex_unlock(&hwpm->regops_index_lock);
+}
+
+static struct tegra_hwpm_addr_range *tegra_hwpm_regops_index_search(
+	struct tegra_hwpm_regops_index *index, u64 find_addr, u32 *hint)
+{
+	struct tegra_hwpm_addr_range *range = NULL;
+	u32 lo = 0U, hi = index->num_ranges, mid;
+
+	/* Consecutive regops mostly target the same aperture */
+	if ((hint != NULL) && (*hint < index->num_ranges)) {
+		range = &index->ranges[*hint];
+		if ((find_addr >= range->start_abs_pa) &&
+			(find_addr <= range->end_abs_pa)) {
+			index->hint_hits++;
+			return range;
+		}
+	}
+
+	/* Find the last aperture starting at or below find_addr */
+	while (lo < hi) {
+		mid = lo + ((hi - lo) / 2U);
+		if (index->ranges[mid].start_abs_pa <= find_addr) {
+			lo = mid + 1U;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (lo == 0U) {
+		return NULL;
+	}
+
+	range = &index->ranges[lo - 1U];
+	if (find_addr > range->end_abs_pa) {
+		return NULL;
+	}
+
+	if (hint != NULL) {
+		*hint = lo - 1U;
+	}
+	return range;
+}
+
+/*
+ * Index lookup with the same checks as tegra_hwpm_aperture_for_address.
+ * Availability is re-checked since IPs can unregister after bind.
+ * Returns -ENOENT if the index can't answer and the caller should walk IPs.
+ */
+static int tegra_hwpm_regops_index_lookup(struct tegra_soc_hwpm *hwpm,
+	struct tegra_hwpm_regops_index *index, u64 find_addr, u32 *hint,
+	struct hwpm_ip_inst **ip_inst, struct hwpm_ip_aperture **element)
+{
+	struct tegra_hwpm_addr_range *range = NULL;
+	u64 reg_offset = 0ULL;
+	bool allowed = false;
+
+	index->lookups++;
+
+	range = tegra_hwpm_regops_index_search(index, find_addr, hint);
+	if (range == NULL) {
+		/* Aperture may have been registered after bind */
+		index->fallbacks++;
+		return -ENOENT;
+	}
+
+	if (!range->chip_ip->reserved ||
+		((range->chip_ip->inst_fs_mask &
+		range->ip_inst->hw_inst_mask) == 0U) ||
+		((range->element->element_index_mask &
+		range->ip_inst->element_fs_mask) == 0U)) {
+		tegra_hwpm_dbg(hwpm, hwpm_dbg_regops,
+			"IP %d addr 0x%llx: aperture not available",
+			range->ip_idx, find_addr);
+		return -EINVAL;
+	}
+
+	if (range->alist_map != NULL) {
+		reg_offset = tegra_hwpm_safe_sub_u64(find_addr,
+			range->start_abs_pa);
+		allowed = ((reg_offset % sizeof(u32)) == 0ULL) &&
+			test_bit(reg_offset / sizeof(u32), range->alist_map);
+	} else {
+		allowed = hwpm->active_chip->check_alist(hwpm,
+			range->element, find_addr);
+	}
+
+	if (!allowed) {
+		tegra_hwpm_dbg(hwpm, hwpm_dbg_regops,
+			"IP %d addr 0x%llx address not in alist",
+			range->ip_idx, find_addr);
+		return -EINVAL;
+	}
+
+	*ip_inst = range->ip_inst;
+	*element = range->element;
+	return 0;
+}
+
+static int tegra_hwpm_regops_walk_lookup(struct tegra_soc_hwpm *hwpm,
+	u64 find_addr, struct hwpm_ip_inst **ip_inst,
+	struct hwpm_ip_aperture **element)
 {
 	bool found = false;
 	u32 ip_idx = TEGRA_SOC_HWPM_IP_INACTIVE;
 	u32 inst_idx = 0U, element_idx = 0U;
 	u32 a_type = 0U;
-	u32 reg_val = 0U;
-	u64 addr_hi = 0ULL;
-	int err = 0;
 	enum tegra_hwpm_element_type element_type = HWPM_ELEMENT_INVALID;
 	struct tegra_soc_hwpm_chip *active_chip = hwpm->active_chip;
 	struct hwpm_ip *chip_ip = NULL;
 	struct hwpm_ip_inst_per_aperture_info *inst_a_info = NULL;
-	struct hwpm_ip_inst *ip_inst = NULL;
 	struct hwpm_ip_element_info *e_info = NULL;
-	struct hwpm_ip_aperture *element = NULL;
 
 	tegra_hwpm_fn(hwpm, " ");
 
 	/* Find IP aperture containing phys_addr in allowlist */
 	found = tegra_hwpm_aperture_for_address(hwpm,
-		TEGRA_HWPM_FIND_GIVEN_ADDRESS, reg_op->phys_addr,
+		TEGRA_HWPM_FIND_GIVEN_ADDRESS, find_addr,
 		&ip_idx, &inst_idx, &element_idx, &element_type);
 	if (!found) {
-		/* Silent failure as regops can continue on error */
-		tegra_hwpm_dbg(hwpm, hwpm_dbg_regops,
-			"Phys addr 0x%llx not available in any IP",
-			reg_op->phys_addr);
-		reg_op->status = TEGRA_SOC_HWPM_REG_OP_STATUS_INVALID_ADDR;
 		return -EINVAL;
 	}
 
 	tegra_hwpm_dbg(hwpm, hwpm_dbg_regops,
 		"Found addr 0x%llx IP %d inst_idx %d element_idx %d e_type %d",
-		reg_op->phys_addr, ip_idx, inst_idx, element_idx, element_type);
+		find_addr, ip_idx, inst_idx, element_idx, element_type);
 
 	switch (element_type) {
 	case HWPM_ELEMENT_PERFMON:
@@ -77,9 +428,40 @@ static int tegra_hwpm_exec_reg_ops(struct tegra_soc_hwpm *hwpm,
 
 	chip_ip = active_chip->chip_ips[ip_idx];
 	inst_a_info = &chip_ip->inst_aperture_info[a_type];
-	ip_inst = inst_a_info->inst_arr[inst_idx];
-	e_info = &ip_inst->element_info[a_type];
-	element = e_info->element_arr[element_idx];
+	*ip_inst = inst_a_info->inst_arr[inst_idx];
+	e_info = &(*ip_inst)->element_info[a_type];
+	*element = e_info->element_arr[element_idx];
+
+	return 0;
+}
+
+static int tegra_hwpm_exec_reg_ops(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_reg_op *reg_op, u32 *hint)
+{
+	u32 reg_val = 0U;
+	u64 addr_hi = 0ULL;
+	int err = -ENOENT;
+	struct hwpm_ip_inst *ip_inst = NULL;
+	struct hwpm_ip_aperture *element = NULL;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	if (hwpm->regops_index != NULL) {
+		err = tegra_hwpm_regops_index_lookup(hwpm, hwpm->regops_index,
+			reg_op->phys_addr, hint, &ip_inst, &element);
+	}
+	if (err == -ENOENT) {
+		err = tegra_hwpm_regops_walk_lookup(hwpm, reg_op->phys_addr,
+			&ip_inst, &element);
+	}
+	if (err != 0) {
+		/* Silent failure as regops can continue on error */
+		tegra_hwpm_dbg(hwpm, hwpm_dbg_regops,
+			"Phys addr 0x%llx not available in any IP",
+			reg_op->phys_addr);
+		reg_op->status = TEGRA_SOC_HWPM_REG_OP_STATUS_INVALID_ADDR;
+		return -EINVAL;
+	}
 
 	switch (reg_op->cmd) {
 	case TEGRA_SOC_HWPM_REG_OP_CMD_RD32:
@@ -181,6 +563,7 @@ int tegra_hwpm_exec_regops(struct tegra_soc_hwpm *hwpm,
 {
 	int op_idx = 0;
 	int ret = 0;
+	u32 hint = 0U;
 	struct tegra_soc_hwpm_reg_op *reg_op = NULL;
 
 	tegra_hwpm_fn(hwpm, " ");
@@ -208,22 +591,122 @@ int tegra_hwpm_exec_regops(struct tegra_soc_hwpm *hwpm,
 	 */
 	exec_reg_ops->b_all_reg_ops_passed = true;
 
+	/* Index stays valid for the whole batch */
+	mutex_lock(&hwpm->regops_index_lock);
+
 	for (op_idx = 0; op_idx < exec_reg_ops->op_count; op_idx++) {
 		reg_op = &(exec_reg_ops->ops[op_idx]);
 		tegra_hwpm_dbg(hwpm, hwpm_dbg_regops,
 			"reg op: idx(%d), phys(0x%llx), cmd(%u)",
 			op_idx, reg_op->phys_addr, reg_op->cmd);
 
-		ret = tegra_hwpm_exec_reg_ops(hwpm, reg_op);
+		ret = tegra_hwpm_exec_reg_ops(hwpm, reg_op, &hint);
 		if (ret < 0) {
 			tegra_hwpm_err(hwpm, "exec_reg_ops %d failed", op_idx);
 			exec_reg_ops->b_all_reg_ops_passed = false;
 			if (exec_reg_ops->mode ==
 				TEGRA_SOC_HWPM_REG_OP_MODE_FAIL_ON_FIRST) {
-				return -EINVAL;
+				ret = -EINVAL;
+				goto unlock;
 			}
 		}
 	}
+	ret = 0;
 
-	return 0;
+unlock:
+	mutex_unlock(&hwpm->regops_index_lock);
+	return ret;
+}
+
+/*
+ * Compare address lookup cost of the IP structure walk and the regops
+ * index. Only lookups are timed, no register is accessed.
+ * - walk: tegra_hwpm_aperture_for_address for each op
+ * - index: binary search, ops spread across apertures
+ * - index_batch: ops grouped by aperture as profilers issue them
+ */
+int tegra_hwpm_regops_index_bench(struct tegra_soc_hwpm *hwpm,
+	struct tegra_hwpm_regops_bench *bench)
+{
+	struct tegra_hwpm_regops_index *index = NULL;
+	struct tegra_hwpm_regops_index stats;
+	struct tegra_hwpm_addr_range *range = NULL;
+	struct hwpm_ip_inst *ip_inst = NULL;
+	struct hwpm_ip_aperture *element = NULL;
+	u64 *addrs = NULL;
+	u32 op_idx, range_idx, hint = 0U;
+	u32 ip_idx = 0U, inst_idx = 0U, element_idx = 0U;
+	enum tegra_hwpm_element_type element_type = HWPM_ELEMENT_INVALID;
+	ktime_t start;
+	int err = 0;
+
+	tegra_hwpm_fn(hwpm, " ");
+
+	mutex_lock(&hwpm->regops_index_lock);
+
+	index = hwpm->regops_index;
+	if ((index == NULL) || (index->num_ranges == 0U)) {
+		tegra_hwpm_err(hwpm, "regops index not built, BIND first");
+		err = -ENODEV;
+		goto unlock;
+	}
+
+	addrs = kcalloc(index->num_ranges, sizeof(u64), GFP_KERNEL);
+	if (addrs == NULL) {
+		err = -ENOMEM;
+		goto unlock;
+	}
+
+	/* First allowed register of each aperture */
+	for (range_idx = 0U; range_idx < index->num_ranges; range_idx++) {
+		range = &index->ranges[range_idx];
+		if ((range->element->alist == NULL) ||
+			(range->element->alist_size == 0ULL)) {
+			addrs[range_idx] = range->start_abs_pa;
+			continue;
+		}
+		addrs[range_idx] = tegra_hwpm_safe_add_u64(
+			range->start_abs_pa,
+			range->element->alist[0].reg_offset);
+	}
+
+	bench->num_ranges = index->num_ranges;
+	bench->num_ops = TEGRA_HWPM_REGOPS_BENCH_OPS;
+	stats = *index;
+
+	start = ktime_get();
+	for (op_idx = 0U; op_idx < TEGRA_HWPM_REGOPS_BENCH_OPS; op_idx++) {
+		(void) tegra_hwpm_aperture_for_address(hwpm,
+			TEGRA_HWPM_FIND_GIVEN_ADDRESS,
+			addrs[op_idx % index->num_ranges],
+			&ip_idx, &inst_idx, &element_idx, &element_type);
+	}
+	bench->walk_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	start = ktime_get();
+	for (op_idx = 0U; op_idx < TEGRA_HWPM_REGOPS_BENCH_OPS; op_idx++) {
+		(void) tegra_hwpm_regops_index_lookup(hwpm, index,
+			addrs[op_idx % index->num_ranges], NULL,
+			&ip_inst, &element);
+	}
+	bench->index_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	start = ktime_get();
+	for (op_idx = 0U; op_idx < TEGRA_HWPM_REGOPS_BENCH_OPS; op_idx++) {
+		range_idx = (u32)(((u64)op_idx * index->num_ranges) /
+			TEGRA_HWPM_REGOPS_BENCH_OPS);
+		(void) tegra_hwpm_regops_index_lookup(hwpm, index,
+			addrs[range_idx], &hint, &ip_inst, &element);
+	}
+	bench->index_batch_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	/* Keep lookup statistics about real regops only */
+	index->lookups = stats.lookups;
+	index->hint_hits = stats.hint_hits;
+	index->fallbacks = stats.fallbacks;
+
+	kfree(addrs);
+unlock:
+	mutex_unlock(&hwpm->regops_index_lock);
+	return err;
 }
@@ -96,6 +96,11 @@ int tegra_hwpm_bind_resources(struct tegra_soc_hwpm *hwpm)
 		return err;
 	}
 
+	/* Regops fall back to IP structure walk without the index */
+	if (tegra_hwpm_regops_index_build(hwpm) != 0) {
+		tegra_hwpm_err(hwpm, "failed to build regops index");
+	}
+
 	return err;
 }
 
@@ -105,6 +110,8 @@ int tegra_hwpm_release_resources(struct tegra_soc_hwpm *hwpm)
 
 	tegra_hwpm_fn(hwpm, " ");
 
+	tegra_hwpm_regops_index_release(hwpm);
+
 	ret = tegra_hwpm_func_all_ip(hwpm, NULL, TEGRA_HWPM_RELEASE_RESOURCES);
 	if (ret != 0) {
 		tegra_hwpm_err(hwpm, "failed to release resources");
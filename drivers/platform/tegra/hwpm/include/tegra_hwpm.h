@@ -18,6 +18,10 @@
 #include <linux/device.h>
 #include <linux/cdev.h>
 #include <linux/delay.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+#include <linux/ktime.h>
 #include <soc/tegra/fuse.h>
 
 #include <uapi/linux/tegra-soc-hwpm-uapi.h>
@@ -336,6 +340,82 @@ struct hwpm_ip {
 	bool reserved;
 };
 
+/*
+ * Regops address index entry: one per reserved and available aperture.
+ * Entries are sorted by start address so that regops can find the aperture
+ * of an address with a binary search instead of walking IP structures.
+ */
+struct tegra_hwpm_addr_range {
+	u64 start_abs_pa;
+	u64 end_abs_pa;
+
+	/* Aperture and its instance, as found by the IP structure walk */
+	u32 ip_idx;
+	struct hwpm_ip *chip_ip;
+	struct hwpm_ip_inst *ip_inst;
+	struct hwpm_ip_aperture *element;
+
+	/*
+	 * Allowlist bitmap, one bit per 32-bit register of the aperture.
+	 * NULL if the aperture is too large or its allowlist cannot be
+	 * represented, check_alist() HAL is used in that case.
+	 */
+	unsigned long *alist_map;
+};
+
+struct tegra_hwpm_regops_index {
+	/* Sorted, non overlapping aperture ranges */
+	u32 num_ranges;
+	struct tegra_hwpm_addr_range *ranges;
+
+	/* Lookup statistics */
+	u64 lookups;
+	u64 hint_hits;
+	u64 fallbacks;
+};
+
+struct tegra_hwpm_regops_bench {
+	u32 num_ranges;
+	u32 num_ops;
+	/* Total time to look up num_ops addresses */
+	u64 walk_ns;
+	u64 index_ns;
+	u64 index_batch_ns;
+};
+
+/*
+ * PMA stream drain state. MEM_HEAD is sampled periodically by the monitor
+ * work and on UPDATE_GET_PUT, readiness is reported by poll() and eventfd.
+ */
+struct tegra_hwpm_stream {
+	/* Protects all fields below */
+	struct mutex lock;
+	wait_queue_head_t wq;
+	struct delayed_work monitor;
+	struct eventfd_ctx *eventfd;
+
+	/* Configuration */
+	u64 buf_size;
+	u64 watermark;
+	u32 period_us;
+
+	/* Offsets in stream buffer */
+	u64 mem_get;
+	u64 mem_head;
+	u64 bytes_available;
+
+	/* Accounting */
+	u64 bytes_streamed;
+	u64 bytes_consumed;
+	u64 notify_count;
+	u64 overflow_count;
+	u64 overflow_ns;
+	ktime_t overflow_start;
+
+	bool above_watermark;
+	bool overflowed;
+};
+
 struct tegra_soc_hwpm;
 
 struct tegra_soc_hwpm_chip {
@@ -434,12 +514,17 @@ struct tegra_soc_hwpm {
 	struct dma_buf_attachment *mem_bytes_attach;
 	struct sg_table *mem_bytes_sgt;
 	void *mem_bytes_kernel;
+	struct tegra_hwpm_stream stream;
 
 	/* SW State */
 	bool bind_completed;
 	bool device_opened;
 	u64 full_alist_size;
 
+	/* Address index of bound apertures, built by the BIND IOCTL */
+	struct mutex regops_index_lock;
+	struct tegra_hwpm_regops_index *regops_index;
+
 	atomic_t hwpm_in_use;
 
 	u32 dbg_mask;
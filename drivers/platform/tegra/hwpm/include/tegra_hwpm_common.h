@@ -24,10 +24,13 @@ struct tegra_soc_hwpm_ip_floorsweep_info;
 struct tegra_soc_hwpm_resource_info;
 struct tegra_soc_hwpm_alloc_pma_stream;
 struct tegra_soc_hwpm_update_get_put;
+struct tegra_soc_hwpm_stream_notify;
+struct tegra_soc_hwpm_stream_status;
 struct hwpm_ip;
 struct tegra_soc_hwpm_ip_ops;
 struct hwpm_ip_inst;
 struct hwpm_ip_aperture;
+struct tegra_hwpm_regops_bench;
 
 int tegra_hwpm_init_sw_components(struct tegra_soc_hwpm *hwpm);
 void tegra_hwpm_release_sw_components(struct tegra_soc_hwpm *hwpm);
@@ -68,6 +71,10 @@ int tegra_hwpm_update_allowlist(struct tegra_soc_hwpm *hwpm,
 	void *ioctl_struct);
 int tegra_hwpm_exec_regops(struct tegra_soc_hwpm *hwpm,
 	struct tegra_soc_hwpm_exec_reg_ops *exec_reg_ops);
+int tegra_hwpm_regops_index_build(struct tegra_soc_hwpm *hwpm);
+void tegra_hwpm_regops_index_release(struct tegra_soc_hwpm *hwpm);
+int tegra_hwpm_regops_index_bench(struct tegra_soc_hwpm *hwpm,
+	struct tegra_hwpm_regops_bench *bench);
 
 int tegra_hwpm_setup_hw(struct tegra_soc_hwpm *hwpm);
 int tegra_hwpm_setup_sw(struct tegra_soc_hwpm *hwpm);
@@ -86,4 +93,13 @@ int tegra_hwpm_clear_mem_pipeline(struct tegra_soc_hwpm *hwpm);
 int tegra_hwpm_update_mem_bytes(struct tegra_soc_hwpm *hwpm,
 	struct tegra_soc_hwpm_update_get_put *update_get_put);
 
+void tegra_hwpm_stream_init(struct tegra_soc_hwpm *hwpm);
+void tegra_hwpm_stream_stop(struct tegra_soc_hwpm *hwpm);
+int tegra_hwpm_stream_notify(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_stream_notify *stream_notify);
+int tegra_hwpm_stream_status(struct tegra_soc_hwpm *hwpm,
+	struct tegra_soc_hwpm_stream_status *stream_status);
+void tegra_hwpm_stream_readiness(struct tegra_soc_hwpm *hwpm,
+	bool *ready, bool *overflowed);
+
 #endif /* TEGRA_HWPM_COMMON_H */
@@ -13,12 +13,71 @@
 
 #include <stddef.h>
 #include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/math64.h>
 
 #include <tegra_hwpm_log.h>
 #include <tegra_hwpm_io.h>
 #include <tegra_hwpm.h>
+#include <tegra_hwpm_common.h>
 #include <tegra_hwpm_debugfs.h>
 
+static int tegra_hwpm_regops_index_show(struct seq_file *s, void *unused)
+{
+	struct tegra_soc_hwpm *hwpm = s->private;
+	struct tegra_hwpm_regops_index *index = NULL;
+	u32 idx, mapped = 0U;
+
+	mutex_lock(&hwpm->regops_index_lock);
+	index = hwpm->regops_index;
+	if (index == NULL) {
+		seq_puts(s, "regops index not built\n");
+		goto unlock;
+	}
+
+	for (idx = 0U; idx < index->num_ranges; idx++) {
+		if (index->ranges[idx].alist_map != NULL) {
+			mapped++;
+		}
+	}
+
+	seq_printf(s, "apertures:   %u\n", index->num_ranges);
+	seq_printf(s, "alist maps:  %u\n", mapped);
+	seq_printf(s, "lookups:     %llu\n", index->lookups);
+	seq_printf(s, "hint hits:   %llu\n", index->hint_hits);
+	seq_printf(s, "fallbacks:   %llu\n", index->fallbacks);
+unlock:
+	mutex_unlock(&hwpm->regops_index_lock);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(tegra_hwpm_regops_index);
+
+static int tegra_hwpm_regops_bench_show(struct seq_file *s, void *unused)
+{
+	struct tegra_soc_hwpm *hwpm = s->private;
+	struct tegra_hwpm_regops_bench bench;
+	int err;
+
+	memset(&bench, 0, sizeof(bench));
+	err = tegra_hwpm_regops_index_bench(hwpm, &bench);
+	if (err != 0) {
+		return err;
+	}
+
+	seq_printf(s, "apertures: %u ops: %u\n",
+		bench.num_ranges, bench.num_ops);
+	seq_printf(s, "%-12s %12s %10s\n", "lookup", "total_ns", "ns/op");
+	seq_printf(s, "%-12s %12llu %10llu\n", "walk", bench.walk_ns,
+		div_u64(bench.walk_ns, bench.num_ops));
+	seq_printf(s, "%-12s %12llu %10llu\n", "index", bench.index_ns,
+		div_u64(bench.index_ns, bench.num_ops));
+	seq_printf(s, "%-12s %12llu %10llu\n", "index_batch",
+		bench.index_batch_ns,
+		div_u64(bench.index_batch_ns, bench.num_ops));
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(tegra_hwpm_regops_bench);
+
 /* FIXME: This is a placeholder for now. We can add debugfs nodes as needed. */
 void tegra_hwpm_debugfs_init(struct tegra_soc_hwpm *hwpm)
 {
@@ -38,6 +97,12 @@ void tegra_hwpm_debugfs_init(struct tegra_soc_hwpm *hwpm)
 	debugfs_create_u32("log_mask", S_IRUGO|S_IWUSR, hwpm->debugfs_root,
 		&hwpm->dbg_mask);
 
+	/* Regops address index */
+	debugfs_create_file("regops_index", S_IRUSR, hwpm->debugfs_root,
+		hwpm, &tegra_hwpm_regops_index_fops);
+	debugfs_create_file("regops_bench", S_IRUSR, hwpm->debugfs_root,
+		hwpm, &tegra_hwpm_regops_bench_fops);
+
 	return;
 
 fail:
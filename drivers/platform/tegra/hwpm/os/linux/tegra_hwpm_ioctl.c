@@ -22,6 +22,7 @@
 #include <linux/string.h>
 #include <linux/of_address.h>
 #include <linux/dma-buf.h>
+#include <linux/poll.h>
 #include <soc/tegra/fuse.h>
 #include <uapi/linux/tegra-soc-hwpm-uapi.h>
 
@@ -56,6 +57,10 @@ static int exec_reg_ops_ioctl(struct tegra_soc_hwpm *hwpm,
 			      void *ioctl_struct);
 static int update_get_put_ioctl(struct tegra_soc_hwpm *hwpm,
 				void *ioctl_struct);
+static int stream_notify_ioctl(struct tegra_soc_hwpm *hwpm,
+				void *ioctl_struct);
+static int stream_status_ioctl(struct tegra_soc_hwpm *hwpm,
+				void *ioctl_struct);
 
 static const struct tegra_soc_hwpm_ioctl ioctls[] = {
 	[TEGRA_SOC_HWPM_IOCTL_DEVICE_INFO] = {
@@ -103,6 +108,16 @@ static const struct tegra_soc_hwpm_ioctl ioctls[] = {
 		.struct_size		= sizeof(struct tegra_soc_hwpm_update_get_put),
 		.handler		= update_get_put_ioctl,
 	},
+	[TEGRA_SOC_HWPM_IOCTL_STREAM_NOTIFY] = {
+		.name			= "stream_notify",
+		.struct_size		= sizeof(struct tegra_soc_hwpm_stream_notify),
+		.handler		= stream_notify_ioctl,
+	},
+	[TEGRA_SOC_HWPM_IOCTL_STREAM_STATUS] = {
+		.name			= "stream_status",
+		.struct_size		= sizeof(struct tegra_soc_hwpm_stream_status),
+		.handler		= stream_status_ioctl,
+	},
 };
 
 static int device_info_ioctl(struct tegra_soc_hwpm *hwpm,
@@ -325,6 +340,38 @@ static int update_get_put_ioctl(struct tegra_soc_hwpm *hwpm,
 	return tegra_hwpm_update_mem_bytes(hwpm, update_get_put);
 }
 
+static int stream_notify_ioctl(struct tegra_soc_hwpm *hwpm,
+				void *ioctl_struct)
+{
+	tegra_hwpm_fn(hwpm, " ");
+
+	if (!hwpm->bind_completed) {
+		tegra_hwpm_err(hwpm,
+			"The STREAM_NOTIFY IOCTL can only be called"
+			" after the BIND IOCTL.");
+		return -EPERM;
+	}
+
+	return tegra_hwpm_stream_notify(hwpm,
+		(struct tegra_soc_hwpm_stream_notify *)ioctl_struct);
+}
+
+static int stream_status_ioctl(struct tegra_soc_hwpm *hwpm,
+				void *ioctl_struct)
+{
+	tegra_hwpm_fn(hwpm, " ");
+
+	if (!hwpm->bind_completed) {
+		tegra_hwpm_err(hwpm,
+			"The STREAM_STATUS IOCTL can only be called"
+			" after the BIND IOCTL.");
+		return -EPERM;
+	}
+
+	return tegra_hwpm_stream_status(hwpm,
+		(struct tegra_soc_hwpm_stream_status *)ioctl_struct);
+}
+
 static long tegra_hwpm_ioctl(struct file *file,
 				 unsigned int cmd,
 				 unsigned long arg)
@@ -537,6 +584,34 @@ static ssize_t tegra_hwpm_read(struct file *file,
 	return 0;
 }
 
+/*
+ * POLLIN: at least the armed watermark of stream data is available
+ * POLLPRI: stream buffer overflowed, PMA is dropping records
+ */
+static __poll_t tegra_hwpm_poll(struct file *filp, poll_table *wait)
+{
+	struct tegra_soc_hwpm *hwpm = filp->private_data;
+	bool ready = false, overflowed = false;
+	__poll_t mask = 0;
+
+	if (!hwpm) {
+		tegra_hwpm_err(hwpm, "Invalid hwpm struct");
+		return EPOLLERR;
+	}
+
+	poll_wait(filp, &hwpm->stream.wq, wait);
+
+	tegra_hwpm_stream_readiness(hwpm, &ready, &overflowed);
+	if (ready) {
+		mask |= EPOLLIN | EPOLLRDNORM;
+	}
+	if (overflowed) {
+		mask |= EPOLLPRI;
+	}
+
+	return mask;
+}
+
 /* FIXME: Fix double release bug */
 static int tegra_hwpm_release(struct inode *inode, struct file *filp)
 {
@@ -565,6 +640,9 @@ static int tegra_hwpm_release(struct inode *inode, struct file *filp)
 		return 0;
 	}
 
+	/* Monitor work and eventfd must not outlive the file on any path */
+	tegra_hwpm_stream_stop(hwpm);
+
 	ret = tegra_hwpm_disable_triggers(hwpm);
 	if (ret < 0) {
 		tegra_hwpm_err(hwpm, "Failed to disable PMA triggers");
@@ -625,6 +703,7 @@ const struct file_operations tegra_soc_hwpm_ops = {
 	.owner = THIS_MODULE,
 	.open = tegra_hwpm_open,
 	.read = tegra_hwpm_read,
+	.poll = tegra_hwpm_poll,
 	.release = tegra_hwpm_release,
 	.unlocked_ioctl = tegra_hwpm_ioctl,
 #ifdef CONFIG_COMPAT
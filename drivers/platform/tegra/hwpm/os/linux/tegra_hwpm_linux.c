@@ -89,6 +89,8 @@ static int tegra_hwpm_probe(struct platform_device *pdev)
 	hwpm->np = pdev->dev.of_node;
 	hwpm->class.owner = THIS_MODULE;
 	hwpm->class.name = TEGRA_SOC_HWPM_MODULE_NAME;
+	mutex_init(&hwpm->regops_index_lock);
+	tegra_hwpm_stream_init(hwpm);
 
 	/* Create device node */
 	ret = class_register(&hwpm->class);
@@ -24,6 +24,9 @@
 #include <linux/hardirq.h>
 #include <linux/interrupt.h>
 #include <linux/iopoll.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
 
 #include "tegra_virt_alt_ivc.h"
 #include "tegra_virt_alt_ivc_common.h"
@@ -94,19 +97,194 @@ fail:
 }
 EXPORT_SYMBOL_GPL(nvaudio_ivc_send);
 
-int nvaudio_ivc_send_receive(struct nvaudio_ivc_ctxt *ictxt,
-			struct nvaudio_ivc_msg *rx_msg, int size)
+/*
+ * Replies owed to timed out requests are only dropped for one more
+ * timeout period, and not at all once the channel has been reset:
+ * a reply the server never sends must not swallow later ones.
+ * Called with ivck_rx_lock held.
+ */
+static void nvaudio_ivc_expire_orphans(struct nvaudio_ivc_ctxt *ictxt,
+		bool reset)
 {
+	if (ictxt->orphans &&
+	    (reset || ktime_after(ktime_get(), ictxt->orphans_expiry)))
+		ictxt->orphans = 0;
+}
 
-	int len = 0;
-	unsigned long flags = 0, flags1 = 0;
-	int err = 0;
+/*
+ * Hand every reply in the rx queue to the oldest pending request.
+ * Called with ivck_rx_lock held, from the IVC interrupt or by a caller
+ * polling for its own reply.
+ */
+static void nvaudio_ivc_rx_drain(struct nvaudio_ivc_ctxt *ictxt)
+{
+	struct nvaudio_ivc_msg scratch;
+	struct nvaudio_ivc_req *req;
+	int len;
+
+	nvaudio_ivc_expire_orphans(ictxt, false);
+
+	while (tegra_hv_ivc_can_read(ictxt->ivck)) {
+		req = list_first_entry_or_null(&ictxt->pending,
+				struct nvaudio_ivc_req, node);
+		if (!req || ictxt->orphans) {
+			/* late reply to a timed out request, or unsolicited */
+			tegra_hv_ivc_read(ictxt->ivck, &scratch, sizeof(scratch));
+			if (ictxt->orphans)
+				ictxt->orphans--;
+			else
+				ictxt->stats.unexpected++;
+			continue;
+		}
+
+		memset(req->msg, 0, sizeof(struct nvaudio_ivc_msg));
+		len = tegra_hv_ivc_read(ictxt->ivck, req->msg,
+				sizeof(struct nvaudio_ivc_msg));
+		if (len != sizeof(struct nvaudio_ivc_msg)) {
+			dev_err(ictxt->dev, "IVC read failure (msg size error)\n");
+			req->err = -1;
+		} else {
+			req->err = len;
+		}
+
+		list_del_init(&req->node);
+		ictxt->stats.replies++;
+		complete(&req->done);
+	}
+}
+
+static irqreturn_t nvaudio_ivc_irq(int irq, void *data)
+{
+	struct nvaudio_ivc_ctxt *ictxt = data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ictxt->ivck_rx_lock, flags);
+	if (tegra_hv_ivc_channel_notified(ictxt->ivck) == 0)
+		nvaudio_ivc_rx_drain(ictxt);
+	else
+		nvaudio_ivc_expire_orphans(ictxt, true);
+	spin_unlock_irqrestore(&ictxt->ivck_rx_lock, flags);
+
+	return IRQ_HANDLED;
+}
+
+/*
+ * Queue @count requests and write them back to back, without waiting for
+ * replies in between. Returns how many were written, or a negative error
+ * when none could be.
+ */
+static int nvaudio_ivc_submit(struct nvaudio_ivc_ctxt *ictxt,
+		struct nvaudio_ivc_req *reqs, struct nvaudio_ivc_msg *msgs,
+		int count)
+{
+	unsigned long flags;
+	int i, len, err = 0;
+
+	spin_lock_irqsave(&ictxt->ivck_rx_lock, flags);
+	spin_lock(&ictxt->ivck_tx_lock);
+	for (i = 0; i < count; i++) {
+		struct nvaudio_ivc_req *req = &reqs[i];
+
+		if (!tegra_hv_ivc_can_write(ictxt->ivck)) {
+			err = -EBUSY;
+			break;
+		}
+
+		req->msg = &msgs[i];
+		req->tag = ictxt->next_tag++;
+		req->err = -ETIMEDOUT;
+		req->start = ktime_get();
+		init_completion(&req->done);
+		/* queue first: the reply may arrive before the write returns */
+		list_add_tail(&req->node, &ictxt->pending);
+
+		len = tegra_hv_ivc_write(ictxt->ivck, req->msg,
+				sizeof(struct nvaudio_ivc_msg));
+		if (len != sizeof(struct nvaudio_ivc_msg)) {
+			pr_err("%s: write Error\n", __func__);
+			list_del_init(&req->node);
+			err = -EIO;
+			break;
+		}
+		ictxt->stats.requests++;
+	}
+	spin_unlock(&ictxt->ivck_tx_lock);
+	spin_unlock_irqrestore(&ictxt->ivck_rx_lock, flags);
+
+	return i ? i : err;
+}
+
+/*
+ * Collect the reply of @req. Callers in atomic context pass @atomic and
+ * busy-poll; everyone else sleeps, on the completion when the interrupt
+ * is available and between polls otherwise.
+ */
+static int nvaudio_ivc_wait(struct nvaudio_ivc_ctxt *ictxt,
+		struct nvaudio_ivc_req *req, bool atomic)
+{
+	bool poll = atomic || !ictxt->irq_ready;
+	unsigned long flags;
+	ktime_t deadline;
+	u64 lat;
+
+	if (!poll) {
+		wait_for_completion_timeout(&req->done,
+			usecs_to_jiffies(NVAUDIO_IVC_WAIT_TIMEOUT));
+	} else {
+		deadline = ktime_add_us(req->start, NVAUDIO_IVC_WAIT_TIMEOUT);
+		while (!completion_done(&req->done) &&
+		       ktime_before(ktime_get(), deadline)) {
+			spin_lock_irqsave(&ictxt->ivck_rx_lock, flags);
+			nvaudio_ivc_rx_drain(ictxt);
+			spin_unlock_irqrestore(&ictxt->ivck_rx_lock, flags);
+			if (completion_done(&req->done))
+				break;
+			if (atomic)
+				udelay(NVAUDIO_IVC_POLL_DELAY);
+			else
+				usleep_range(NVAUDIO_IVC_POLL_DELAY,
+					     2 * NVAUDIO_IVC_POLL_DELAY);
+		}
+	}
+
+	spin_lock_irqsave(&ictxt->ivck_rx_lock, flags);
+	if (!list_empty(&req->node)) {
+		/* still queued: the server owes us a reply we will drop */
+		list_del_init(&req->node);
+		ictxt->orphans++;
+		ictxt->orphans_expiry = ktime_add_us(ktime_get(),
+				NVAUDIO_IVC_WAIT_TIMEOUT);
+		ictxt->stats.timeouts++;
+		req->err = -ETIMEDOUT;
+	} else {
+		lat = ktime_to_ns(ktime_sub(ktime_get(), req->start));
+		ictxt->stats.latency_total_ns += lat;
+		if (lat > ictxt->stats.latency_max_ns)
+			ictxt->stats.latency_max_ns = lat;
+	}
+	if (poll)
+		ictxt->stats.polled++;
+	spin_unlock_irqrestore(&ictxt->ivck_rx_lock, flags);
+
+	if (req->err == -ETIMEDOUT)
+		pr_err("%s: Waited too long for msg reply (tag %u)\n",
+			__func__, req->tag);
+
+	return req->err;
+}
+
+static int nvaudio_ivc_wait_channel(struct nvaudio_ivc_ctxt *ictxt)
+{
+	unsigned long flags;
 	int dcnt = 50;
-	int status = -1;
-	struct nvaudio_ivc_msg *msg = rx_msg;
 
-	if (!ictxt || !ictxt->ivck || !msg || !size)
-		return -EINVAL;
+	if (tegra_hv_ivc_channel_notified(ictxt->ivck) == 0)
+		return 0;
+
+	/* the peer reset the channel: nothing sent before is answered */
+	spin_lock_irqsave(&ictxt->ivck_rx_lock, flags);
+	nvaudio_ivc_expire_orphans(ictxt, true);
+	spin_unlock_irqrestore(&ictxt->ivck_rx_lock, flags);
 
 	while (tegra_hv_ivc_channel_notified(ictxt->ivck) != 0) {
 		dev_err(ictxt->dev, "channel notified returns non zero\n");
@@ -115,52 +293,139 @@ int nvaudio_ivc_send_receive(struct nvaudio_ivc_ctxt *ictxt,
 		if (!dcnt)
 			return -EIO;
 	}
+	return 0;
+}
 
-	spin_lock_irqsave(&ictxt->ivck_rx_lock, flags);
-	spin_lock_irqsave(&ictxt->ivck_tx_lock, flags1);
+static int __nvaudio_ivc_send_receive(struct nvaudio_ivc_ctxt *ictxt,
+			struct nvaudio_ivc_msg *rx_msg, int size, bool atomic)
+{
+	struct nvaudio_ivc_req req;
+	int err;
 
-	if (!tegra_hv_ivc_can_write(ictxt->ivck)) {
-		err = -EBUSY;
-		spin_unlock_irqrestore(&ictxt->ivck_tx_lock, flags1);
-		goto fail;
-	}
+	if (!ictxt || !ictxt->ivck || !rx_msg || !size)
+		return -EINVAL;
 
-	len = tegra_hv_ivc_write(ictxt->ivck, msg, size);
-	if (len != size) {
-		pr_err("%s: write Error\n", __func__);
-		err = -EIO;
-		spin_unlock_irqrestore(&ictxt->ivck_tx_lock, flags1);
-		goto fail;
-	}
-	spin_unlock_irqrestore(&ictxt->ivck_tx_lock, flags1);
+	err = nvaudio_ivc_wait_channel(ictxt);
+	if (err)
+		return err;
 
-	err = readx_poll_timeout_atomic(tegra_hv_ivc_can_read, ictxt->ivck,
-			status, status, 10, NVAUDIO_IVC_WAIT_TIMEOUT);
+	err = nvaudio_ivc_submit(ictxt, &req, rx_msg, 1);
+	if (err < 0)
+		return err;
 
-	if (err == -ETIMEDOUT) {
-		pr_err("%s: Waited too long for msg reply\n", __func__);
-		goto fail;
-	}
+	return nvaudio_ivc_wait(ictxt, &req, atomic);
+}
 
-	/* Message available */
-	memset(rx_msg, 0, sizeof(struct nvaudio_ivc_msg));
-	len = tegra_hv_ivc_read(ictxt->ivck,
-				rx_msg,
-				sizeof(struct nvaudio_ivc_msg));
-	if (len != sizeof(struct nvaudio_ivc_msg)) {
-		dev_err(ictxt->dev, "IVC read failure (msg size error)\n");
-		err = -1;
-		goto fail;
+/* Send @rx_msg and sleep until its reply is written back into it. */
+int nvaudio_ivc_send_receive(struct nvaudio_ivc_ctxt *ictxt,
+			struct nvaudio_ivc_msg *rx_msg, int size)
+{
+	might_sleep();
+
+	return __nvaudio_ivc_send_receive(ictxt, rx_msg, size, false);
+}
+EXPORT_SYMBOL_GPL(nvaudio_ivc_send_receive);
+
+/*
+ * As nvaudio_ivc_send_receive(), but busy-polls for the reply. For callers
+ * that cannot sleep, such as PCM trigger callbacks.
+ */
+int nvaudio_ivc_send_receive_atomic(struct nvaudio_ivc_ctxt *ictxt,
+			struct nvaudio_ivc_msg *rx_msg, int size)
+{
+	return __nvaudio_ivc_send_receive(ictxt, rx_msg, size, true);
+}
+EXPORT_SYMBOL_GPL(nvaudio_ivc_send_receive_atomic);
+
+/*
+ * Send @count requests and collect all replies, each written back into its
+ * msgs[] slot. Requests are pipelined: as many as fit in the queue go out
+ * before the first reply is awaited. Must be called from process context.
+ * Returns @count, or the first error.
+ */
+int nvaudio_ivc_send_receive_batch(struct nvaudio_ivc_ctxt *ictxt,
+			struct nvaudio_ivc_msg *msgs, int count)
+{
+	struct nvaudio_ivc_req *reqs;
+	int sent = 0, done = 0;
+	int err = 0, ret;
+
+	if (!ictxt || !ictxt->ivck || !msgs || count <= 0)
+		return -EINVAL;
+
+	might_sleep();
+
+	err = nvaudio_ivc_wait_channel(ictxt);
+	if (err)
+		return err;
+
+	reqs = kcalloc(count, sizeof(*reqs), GFP_KERNEL);
+	if (!reqs)
+		return -ENOMEM;
+
+	while (done < count) {
+		if (sent < count) {
+			ret = nvaudio_ivc_submit(ictxt, &reqs[sent],
+					&msgs[sent], count - sent);
+			if (ret > 0)
+				sent += ret;
+			else if (sent == done) {
+				err = ret;
+				break;
+			}
+		}
+
+		/* free queue space by retiring the oldest request */
+		ret = nvaudio_ivc_wait(ictxt, &reqs[done++], false);
+		if (ret < 0 && !err)
+			err = ret;
 	}
-	err = len;
 
-fail:
+	/* on error, still retire what was sent so no reply is misrouted */
+	while (done < sent)
+		nvaudio_ivc_wait(ictxt, &reqs[done++], false);
+
+	kfree(reqs);
+	return err ? err : count;
+}
+EXPORT_SYMBOL_GPL(nvaudio_ivc_send_receive_batch);
+
+static int nvaudio_ivc_stats_show(struct seq_file *s, void *data)
+{
+	struct nvaudio_ivc_ctxt *ictxt = s->private;
+	struct nvaudio_ivc_stats st;
+	unsigned long flags;
+	u64 done;
+
+	spin_lock_irqsave(&ictxt->ivck_rx_lock, flags);
+	st = ictxt->stats;
 	spin_unlock_irqrestore(&ictxt->ivck_rx_lock, flags);
 
-	return err;
+	done = st.replies;
+	seq_printf(s, "irq %s\n", ictxt->irq_ready ? "yes" : "no");
+	seq_printf(s, "requests %llu\n", st.requests);
+	seq_printf(s, "replies %llu\n", st.replies);
+	seq_printf(s, "timeouts %llu\n", st.timeouts);
+	seq_printf(s, "polled %llu\n", st.polled);
+	seq_printf(s, "unexpected %llu\n", st.unexpected);
+	seq_printf(s, "latency_avg_us %llu\n", done ?
+		div64_u64(st.latency_total_ns, done) / NSEC_PER_USEC : 0);
+	seq_printf(s, "latency_max_us %llu\n",
+		div_u64(st.latency_max_ns, NSEC_PER_USEC));
+	return 0;
+}
 
+static int nvaudio_ivc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, nvaudio_ivc_stats_show, inode->i_private);
 }
-EXPORT_SYMBOL_GPL(nvaudio_ivc_send_receive);
+
+static const struct file_operations nvaudio_ivc_stats_fops = {
+	.open		= nvaudio_ivc_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
 
 /* Every communication with the server is identified
  * with this ivc context.
@@ -191,6 +456,20 @@ struct nvaudio_ivc_ctxt *nvaudio_ivc_alloc_ctxt(struct device *dev)
 
 	spin_lock_init(&ictxt->ivck_rx_lock);
 	spin_lock_init(&ictxt->ivck_tx_lock);
+	INIT_LIST_HEAD(&ictxt->pending);
+
+	/* Without the interrupt, every caller polls for its reply */
+	if (devm_request_irq(dev, ictxt->ivck->irq, nvaudio_ivc_irq, 0,
+			"nvaudio_ivc", ictxt))
+		dev_warn(dev, "failed to request ivc irq %d, polling\n",
+			ictxt->ivck->irq);
+	else
+		ictxt->irq_ready = true;
+
+	ictxt->debugfs = debugfs_create_dir("nvaudio_ivc", NULL);
+	if (!IS_ERR_OR_NULL(ictxt->debugfs))
+		debugfs_create_file("stats", 0444, ictxt->debugfs, ictxt,
+				&nvaudio_ivc_stats_fops);
 
 	tegra_hv_ivc_channel_reset(ictxt->ivck);
 
@@ -224,7 +503,16 @@ EXPORT_SYMBOL_GPL(nvaudio_ivc_free_ctxt);
 
 static void nvaudio_ivc_deinit(struct nvaudio_ivc_ctxt *ictxt)
 {
-	if (ictxt)
+	if (!ictxt)
+		return;
+
+	debugfs_remove_recursive(ictxt->debugfs);
+	ictxt->debugfs = NULL;
+	if (ictxt->irq_ready) {
+		devm_free_irq(ictxt->dev, ictxt->ivck->irq, ictxt);
+		ictxt->irq_ready = false;
+	}
+	if (ictxt->ivck)
 		tegra_hv_ivc_unreserve(ictxt->ivck);
 }
 
@@ -17,11 +17,42 @@
 #ifndef __TEGRA_VIRT_ALT_IVC_H__
 #define __TEGRA_VIRT_ALT_IVC_H__
 
+#include <linux/completion.h>
+#include <linux/ktime.h>
+#include <linux/list.h>
+
 #include "tegra_virt_alt_ivc_common.h"
 
 #define NVAUDIO_IVC_WAIT_TIMEOUT	1000000
+/* poll interval for callers waiting without the interrupt, in us */
+#define NVAUDIO_IVC_POLL_DELAY		10
+
 struct nvaudio_ivc_dev;
 
+/*
+ * One request waiting for its reply. The wire format carries no tag and
+ * the server answers in order, so replies are matched to the oldest
+ * pending request; the tag only identifies it locally.
+ */
+struct nvaudio_ivc_req {
+	struct list_head		node;
+	struct nvaudio_ivc_msg		*msg;
+	struct completion		done;
+	u32				tag;
+	int				err;
+	ktime_t				start;
+};
+
+struct nvaudio_ivc_stats {
+	u64				requests;
+	u64				replies;
+	u64				timeouts;
+	u64				polled;
+	u64				unexpected;
+	u64				latency_total_ns;
+	u64				latency_max_ns;
+};
+
 struct nvaudio_ivc_ctxt {
 	struct tegra_hv_ivc_cookie	*ivck;
 	struct device			*dev;
@@ -33,6 +64,15 @@ struct nvaudio_ivc_ctxt {
 	spinlock_t			ivck_rx_lock;
 	spinlock_t			ivck_tx_lock;
 	spinlock_t			lock;
+	/* requests awaiting a reply, oldest first, under ivck_rx_lock */
+	struct list_head		pending;
+	/* replies still owed to requests that timed out, until orphans_expiry */
+	u32				orphans;
+	ktime_t				orphans_expiry;
+	u32				next_tag;
+	bool				irq_ready;
+	struct nvaudio_ivc_stats	stats;
+	struct dentry			*debugfs;
 };
 
 void nvaudio_ivc_rx(struct tegra_hv_ivc_cookie *ivck);
@@ -53,6 +93,14 @@ int nvaudio_ivc_send_receive(struct nvaudio_ivc_ctxt *ictxt,
 				struct nvaudio_ivc_msg *msg,
 				int size);
 
+int nvaudio_ivc_send_receive_atomic(struct nvaudio_ivc_ctxt *ictxt,
+				struct nvaudio_ivc_msg *msg,
+				int size);
+
+int nvaudio_ivc_send_receive_batch(struct nvaudio_ivc_ctxt *ictxt,
+				struct nvaudio_ivc_msg *msgs,
+				int count);
+
 int tegra124_virt_xbar_set_ivc(struct nvaudio_ivc_ctxt *ictxt,
 					int rx_idx,
 					int tx_idx);
@@ -79,6 +79,50 @@ int tegra_capture_ivc_capture_submit(const void *capture_desc, size_t len)
 }
 EXPORT_SYMBOL(tegra_capture_ivc_capture_submit);
 
+int tegra_capture_ivc_capture_submit_batch(const void *capture_descs,
+		size_t len, unsigned int count)
+{
+	struct tegra_capture_ivc *civc = __scivc_capture;
+	struct tegra_ivc_channel *chan;
+	const u8 *desc = capture_descs;
+	unsigned int sent = 0;
+	int ret;
+
+	if (WARN_ON(civc == NULL))
+		return -ENODEV;
+
+	chan = civc->chan;
+	if (WARN_ON(!chan->is_ready))
+		return -EIO;
+
+	ret = mutex_lock_interruptible(&civc->ivc_wr_lock);
+	if (unlikely(ret == -EINTR))
+		return -ERESTARTSYS;
+	if (unlikely(ret))
+		return ret;
+
+	/* Hold the writer lock so the batch lands back to back */
+	while (sent < count) {
+		ret = wait_event_interruptible(civc->write_q,
+					tegra_ivc_can_write(&chan->ivc));
+		if (likely(ret == 0))
+			ret = tegra_ivc_write(&chan->ivc, desc, len);
+		if (unlikely(ret < 0))
+			break;
+		desc += len;
+		sent++;
+	}
+
+	mutex_unlock(&civc->ivc_wr_lock);
+
+	if (unlikely(ret < 0))
+		dev_err(&chan->dev, "tegra_ivc_write: error %d after %u\n",
+			ret, sent);
+
+	return (sent > 0) ? (int)sent : ret;
+}
+EXPORT_SYMBOL(tegra_capture_ivc_capture_submit_batch);
+
 int tegra_capture_ivc_register_control_cb(
 		tegra_capture_ivc_cb_func control_resp_cb,
 		uint32_t *trans_id, const void *priv_context)
@@ -11,6 +11,7 @@
 
 #include <linux/tegra-ivc.h>
 #include <linux/tegra-ivc-instance.h>
+#include <linux/tegra-ivc-bulk.h>
 #include <linux/module.h>
 #include <linux/uaccess.h>
 #include <linux/err.h>
@@ -198,6 +199,22 @@ static inline void ivc_advance_rx(struct ivc *ivc)
 		ivc->r_pos++;
 }
 
+static inline void ivc_advance_tx_n(struct ivc *ivc, uint32_t n)
+{
+	WRITE_ONCE(ivc->tx_channel->w_count,
+			(READ_ONCE(ivc->tx_channel->w_count) + n));
+
+	ivc->w_pos = (ivc->w_pos + n) % ivc->nframes;
+}
+
+static inline void ivc_advance_rx_n(struct ivc *ivc, uint32_t n)
+{
+	WRITE_ONCE(ivc->rx_channel->r_count,
+			(READ_ONCE(ivc->rx_channel->r_count) + n));
+
+	ivc->r_pos = (ivc->r_pos + n) % ivc->nframes;
+}
+
 static inline int ivc_check_read(struct ivc *ivc)
 {
 	/*
@@ -606,6 +623,212 @@ int tegra_ivc_write_advance(struct ivc *ivc)
 }
 EXPORT_SYMBOL(tegra_ivc_write_advance);
 
+static enum hrtimer_restart ivc_doorbell_timer(struct hrtimer *timer)
+{
+	struct tegra_ivc_doorbell *db =
+		container_of(timer, struct tegra_ivc_doorbell, timer);
+
+	if (atomic_xchg(&db->pending, 0)) {
+		db->ivc->notify(db->ivc);
+		atomic64_inc(&db->notifications);
+		atomic64_inc(&db->deferred);
+	}
+
+	return HRTIMER_NORESTART;
+}
+
+void tegra_ivc_doorbell_init(struct tegra_ivc_doorbell *db, struct ivc *ivc,
+		unsigned window_us)
+{
+	db->ivc = ivc;
+	db->window = ns_to_ktime((u64)min(window_us,
+			TEGRA_IVC_DOORBELL_MAX_WINDOW_US) * NSEC_PER_USEC);
+	atomic_set(&db->pending, 0);
+	atomic64_set(&db->frames, 0);
+	atomic64_set(&db->notifications, 0);
+	atomic64_set(&db->deferred, 0);
+	hrtimer_init(&db->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	db->timer.function = ivc_doorbell_timer;
+}
+EXPORT_SYMBOL(tegra_ivc_doorbell_init);
+
+/* ring the peer now if a notification is pending */
+void tegra_ivc_doorbell_flush(struct tegra_ivc_doorbell *db)
+{
+	if (atomic_xchg(&db->pending, 0)) {
+		db->ivc->notify(db->ivc);
+		atomic64_inc(&db->notifications);
+	}
+}
+EXPORT_SYMBOL(tegra_ivc_doorbell_flush);
+
+void tegra_ivc_doorbell_stop(struct tegra_ivc_doorbell *db)
+{
+	hrtimer_cancel(&db->timer);
+	tegra_ivc_doorbell_flush(db);
+}
+EXPORT_SYMBOL(tegra_ivc_doorbell_stop);
+
+void tegra_ivc_doorbell_get_stats(struct tegra_ivc_doorbell *db,
+		struct tegra_ivc_doorbell_stats *stats)
+{
+	stats->frames = atomic64_read(&db->frames);
+	stats->notifications = atomic64_read(&db->notifications);
+	stats->deferred = atomic64_read(&db->deferred);
+}
+EXPORT_SYMBOL(tegra_ivc_doorbell_get_stats);
+
+static void ivc_bulk_notify(struct ivc *ivc, struct tegra_ivc_doorbell *db,
+		uint32_t frames, bool needed)
+{
+	if (!db) {
+		if (needed)
+			ivc->notify(ivc);
+		return;
+	}
+
+	atomic64_add(frames, &db->frames);
+	if (!needed)
+		return;
+
+	atomic_set(&db->pending, 1);
+	if (!ktime_to_ns(db->window))
+		tegra_ivc_doorbell_flush(db);
+	else if (!hrtimer_is_queued(&db->timer))
+		hrtimer_start(&db->timer, db->window, HRTIMER_MODE_REL);
+}
+
+int tegra_ivc_write_bulk(struct ivc *ivc, const void *buf, size_t size,
+		unsigned count, struct tegra_ivc_doorbell *db)
+{
+	uint32_t used, pos, i;
+	int result;
+
+	if (size > ivc->frame_size)
+		return -E2BIG;
+
+	if (!count)
+		return 0;
+
+	result = ivc_check_write(ivc);
+	if (result)
+		return result;
+
+	/*
+	 * Unlike ivc_check_write(), always refresh r_count so the batch can
+	 * use every frame the peer has released so far.
+	 */
+	ivc_invalidate_counter(ivc, ivc->tx_handle +
+			offsetof(struct ivc_channel_header, r_count));
+	used = ivc_channel_avail_count(ivc, ivc->tx_channel);
+	if (used >= ivc->nframes)
+		return -ENOMEM;
+	count = min_t(uint32_t, count, ivc->nframes - used);
+
+	for (i = 0, pos = ivc->w_pos; i < count; i++) {
+		void *p = ivc_frame_pointer(ivc, ivc->tx_channel, pos);
+
+		memcpy(p, buf + i * size, size);
+		memset(p + size, 0, ivc->frame_size - size);
+		ivc_flush_frame(ivc, ivc->tx_handle, pos, 0, size);
+		pos = (pos == ivc->nframes - 1) ? 0 : pos + 1;
+	}
+
+	/*
+	 * Ensure that all frames of the batch are visible before the w_pos
+	 * counter indicates that they are ready.
+	 */
+	ivc_wmb();
+
+	ivc_advance_tx_n(ivc, count);
+	ivc_flush_counter(ivc, ivc->tx_handle +
+			offsetof(struct ivc_channel_header, w_count));
+
+	/*
+	 * Ensure our write to w_pos occurs before our read from r_pos.
+	 */
+	ivc_mb();
+
+	/*
+	 * Notify only upon transition from empty to non-empty. The peer may
+	 * have observed the queue empty before this update only if no more
+	 * than the batch is pending now.
+	 */
+	ivc_invalidate_counter(ivc, ivc->tx_handle +
+		offsetof(struct ivc_channel_header, r_count));
+
+	ivc_bulk_notify(ivc, db, count,
+		ivc_channel_avail_count(ivc, ivc->tx_channel) <= count);
+
+	return (int)count;
+}
+EXPORT_SYMBOL(tegra_ivc_write_bulk);
+
+int tegra_ivc_read_bulk(struct ivc *ivc, void *buf, size_t max_read,
+		unsigned count, struct tegra_ivc_doorbell *db)
+{
+	uint32_t avail, pos, i;
+	int result;
+
+	if (max_read > ivc->frame_size)
+		return -E2BIG;
+
+	if (!count)
+		return 0;
+
+	result = ivc_check_read(ivc);
+	if (result)
+		return result;
+
+	/*
+	 * Refresh w_count so the batch picks up every frame posted so far.
+	 * An over-full queue is a misbehaving peer; see ivc_channel_empty().
+	 */
+	ivc_invalidate_counter(ivc, ivc->rx_handle +
+			offsetof(struct ivc_channel_header, w_count));
+	avail = ivc_channel_avail_count(ivc, ivc->rx_channel);
+	if (!avail || avail > ivc->nframes)
+		return -ENOMEM;
+	count = min_t(uint32_t, count, avail);
+
+	/*
+	 * Order observation of w_pos potentially indicating new data before
+	 * data read.
+	 */
+	ivc_rmb();
+
+	for (i = 0, pos = ivc->r_pos; i < count; i++) {
+		ivc_invalidate_frame(ivc, ivc->rx_handle, pos, 0, max_read);
+		memcpy(buf + i * max_read,
+			ivc_frame_pointer(ivc, ivc->rx_channel, pos), max_read);
+		pos = (pos == ivc->nframes - 1) ? 0 : pos + 1;
+	}
+
+	ivc_advance_rx_n(ivc, count);
+	ivc_flush_counter(ivc, ivc->rx_handle +
+			offsetof(struct ivc_channel_header, r_count));
+
+	/*
+	 * Ensure our write to r_pos occurs before our read from w_pos.
+	 */
+	ivc_mb();
+
+	/*
+	 * Notify only upon transition from full to non-full. The peer may
+	 * have observed the queue full before this update only if at most
+	 * the batch has been freed since.
+	 */
+	ivc_invalidate_counter(ivc, ivc->rx_handle +
+		offsetof(struct ivc_channel_header, w_count));
+
+	ivc_bulk_notify(ivc, db, count,
+		ivc_channel_avail_count(ivc, ivc->rx_channel) >=
+			ivc->nframes - count);
+
+	return (int)count;
+}
+EXPORT_SYMBOL(tegra_ivc_read_bulk);
+
 void tegra_ivc_channel_reset(struct ivc *ivc)
 {
 	ivc->tx_channel->state = ivc_state_sync;
@@ -30,6 +30,11 @@
 #endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(4, 14, 0) */
 #include <linux/compat.h>
 #include <linux/uio.h>
+#include <linux/mm.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/virtio.h>
 #include <linux/virtio_ids.h>
@@ -61,6 +66,46 @@
 					     compat_uptr_t)
 #endif
 
+/*
+ * Send a message referencing a user buffer instead of carrying it. The
+ * optional inline part (msg, msg_len) is copied into the message after
+ * the page list. With TIPC_MEMREF_F_WRITE the secure side may also write
+ * the buffer, so a large reply can land in it directly. The layout is the
+ * same for 32-bit and 64-bit callers.
+ */
+struct tipc_memref_req {
+	__u64 buf;
+	__u32 len;
+	__u32 flags;
+	__u64 msg;
+	__u32 msg_len;
+	__u32 reserved;
+};
+
+#define TIPC_IOC_SEND_MEMREF		_IOW(TIPC_IOC_MAGIC, 0x81, \
+					     struct tipc_memref_req)
+
+#define TIPC_MEMREF_F_WRITE		0x1
+
+/* virtio feature bit: the secure side accepts memref messages */
+#define TIPC_F_MEMREF			1
+
+/* tipc_msg_hdr flags */
+#define TIPC_MSG_FLAG_MEMREF		0x1
+
+/* memref benchmark sweep, from one page up to this size */
+#define TIPC_MEMREF_BENCH_MAX		(1024 * 1024)
+#define TIPC_MEMREF_BENCH_LOOPS		32
+
+/*
+ * Writes of at least this many bytes from a single user segment are sent
+ * as a memref when the device supports it. 0 disables the memref path.
+ */
+static uint memref_threshold = 2048;
+module_param(memref_threshold, uint, 0644);
+MODULE_PARM_DESC(memref_threshold,
+		 "Smallest write in bytes sent by reference (0 = never)");
+
 struct tipc_virtio_dev;
 
 struct tipc_dev_config {
@@ -78,6 +123,30 @@ struct tipc_msg_hdr {
 	u8 data[0];
 } __packed;
 
+/*
+ * Body of a message with TIPC_MSG_FLAG_MEMREF set: size bytes starting at
+ * offset into the first of page_cnt pages, followed by the inline part of
+ * the message. The pages stay pinned until the secure side hands the tx
+ * buffer carrying this descriptor back, so it must not release the buffer
+ * while the receiving service may still access them.
+ */
+struct tipc_memref_hdr {
+	u32 size;
+	u32 offset;
+	u32 page_cnt;
+	u32 flags;
+	struct ns_mem_page_info pages[0];
+} __packed;
+
+/* pinned pages of one memref message */
+struct tipc_memref {
+	struct kref refcount;
+	struct completion done;
+	bool writable;
+	unsigned int page_cnt;
+	struct page *pages[0];
+};
+
 enum tipc_ctrl_msg_types {
 	TIPC_CTRL_MSGTYPE_GO_ONLINE = 1,
 	TIPC_CTRL_MSGTYPE_GO_OFFLINE,
@@ -108,6 +177,15 @@ struct tipc_disc_req_body {
 	u32 target;
 } __packed;
 
+struct tipc_xfer_stats {
+	atomic64_t copy_msgs;
+	atomic64_t copy_bytes;
+	atomic64_t memref_msgs;
+	atomic64_t memref_bytes;
+	atomic64_t memref_pages;
+	atomic64_t memref_fallbacks;
+};
+
 struct tipc_cdev_node {
 	struct cdev cdev;
 	struct device *dev;
@@ -136,6 +214,9 @@ struct tipc_virtio_dev {
 	enum tipc_device_state state;
 	struct tipc_cdev_node cdev_node;
 	char   cdev_name[MAX_DEV_NAME_LEN];
+	bool memref;
+	struct tipc_xfer_stats stats;
+	struct dentry *debugfs;
 };
 
 enum tipc_chan_state {
@@ -161,6 +242,7 @@ struct tipc_chan {
 
 static struct class *tipc_class;
 static unsigned int tipc_major;
+static struct dentry *tipc_debugfs_root;
 
 struct virtio_device *default_vdev;
 
@@ -210,8 +292,43 @@ err_alloc:
 	return NULL;
 }
 
+static void _free_memref(struct kref *kref)
+{
+	kfree(container_of(kref, struct tipc_memref, refcount));
+}
+
+static void _memref_unpin(struct tipc_memref *mr)
+{
+	unsigned int i;
+
+	for (i = 0; i < mr->page_cnt; i++) {
+		if (mr->writable)
+			set_page_dirty_lock(mr->pages[i]);
+		put_page(mr->pages[i]);
+	}
+	mr->page_cnt = 0;
+}
+
+/*
+ * Called once the secure side has handed a buffer back, or when the buffer
+ * is discarded: unpin the pages it referenced and wake up the sender.
+ */
+static void _memref_detach(struct tipc_msg_buf *mb)
+{
+	struct tipc_memref *mr = mb->memref;
+
+	if (!mr)
+		return;
+
+	mb->memref = NULL;
+	_memref_unpin(mr);
+	complete(&mr->done);
+	kref_put(&mr->refcount, _free_memref);
+}
+
 static void _free_msg_buf(struct tipc_msg_buf *mb)
 {
+	_memref_detach(mb);
 	_free_shareable_mem(mb->buf_sz, mb->buf_va, mb->buf_pa);
 	kfree(mb);
 }
@@ -266,6 +383,7 @@ static void vds_free_msg_buf(struct tipc_virtio_dev *vds,
 static bool _put_txbuf_locked(struct tipc_virtio_dev *vds,
 			      struct tipc_msg_buf *mb)
 {
+	_memref_detach(mb);
 	list_add_tail(&mb->node, &vds->free_buf_list);
 	return vds->free_msg_buf_cnt++ == 0;
 }
@@ -482,7 +600,7 @@ static void fill_msg_hdr(struct tipc_msg_buf *mb, u32 src, u32 dst)
 	hdr->src = src;
 	hdr->dst = dst;
 	hdr->len = mb_avail_data(mb);
-	hdr->flags = 0;
+	hdr->flags = mb->memref ? TIPC_MSG_FLAG_MEMREF : 0;
 	hdr->reserved = 0;
 }
 
@@ -952,6 +1070,165 @@ static int dn_connect_ioctl(struct tipc_dn_chan *dn, char __user *usr_name)
 	return dn_wait_for_reply(dn, REPLY_TIMEOUT);
 }
 
+/*
+ * Pin the pages under a single user segment. The secure side gets write
+ * access to them when the iterator is a read destination.
+ */
+static struct tipc_memref *_memref_pin(struct iov_iter *iter,
+				       unsigned int max_pages, size_t *offset)
+{
+	ssize_t n;
+	size_t start;
+	size_t len = iov_iter_count(iter);
+	unsigned int npages = iov_iter_npages(iter, INT_MAX);
+	struct tipc_memref *mr;
+
+	if (npages > max_pages)
+		return ERR_PTR(-EMSGSIZE);
+
+	mr = kzalloc(sizeof(*mr) + npages * sizeof(mr->pages[0]), GFP_KERNEL);
+	if (!mr)
+		return ERR_PTR(-ENOMEM);
+
+	kref_init(&mr->refcount);
+	init_completion(&mr->done);
+	mr->writable = iov_iter_rw(iter) == READ;
+
+	while (len) {
+		n = iov_iter_get_pages(iter, mr->pages + mr->page_cnt, len,
+				       npages - mr->page_cnt, &start);
+		if (n <= 0) {
+			_memref_unpin(mr);
+			kref_put(&mr->refcount, _free_memref);
+			return ERR_PTR(n ? n : -EFAULT);
+		}
+
+		if (!mr->page_cnt)
+			*offset = start;
+		mr->page_cnt += DIV_ROUND_UP(start + n, PAGE_SIZE);
+		iov_iter_advance(iter, n);
+		len -= n;
+	}
+
+	return mr;
+}
+
+/*
+ * Send the data under iter by reference, followed by msg_len bytes of
+ * inline message. Returns once the secure side has handed the buffer
+ * back and the pages are unpinned, so the caller may reuse its buffer.
+ */
+static ssize_t dn_send_memref(struct tipc_dn_chan *dn, struct iov_iter *iter,
+			      const void __user *msg, size_t msg_len,
+			      long timeout)
+{
+	ssize_t ret;
+	size_t offset = 0;
+	size_t len = iov_iter_count(iter);
+	unsigned int i, page_cnt, max_pages;
+	struct tipc_memref *mr;
+	struct tipc_memref_hdr *hdr;
+	struct tipc_msg_buf *txbuf;
+	struct tipc_xfer_stats *stats = &dn->chan->vds->stats;
+
+	txbuf = tipc_chan_get_txbuf_timeout(dn->chan, timeout);
+	if (IS_ERR(txbuf))
+		return PTR_ERR(txbuf);
+
+	if (mb_avail_space(txbuf) < sizeof(*hdr) + msg_len) {
+		ret = -EMSGSIZE;
+		goto err_put_txbuf;
+	}
+	max_pages = (mb_avail_space(txbuf) - sizeof(*hdr) - msg_len) /
+		    sizeof(hdr->pages[0]);
+
+	mr = _memref_pin(iter, max_pages, &offset);
+	if (IS_ERR(mr)) {
+		ret = PTR_ERR(mr);
+		goto err_put_txbuf;
+	}
+	page_cnt = mr->page_cnt;
+
+	hdr = mb_put_data(txbuf, sizeof(*hdr) +
+			  page_cnt * sizeof(hdr->pages[0]));
+	hdr->size = len;
+	hdr->offset = offset;
+	hdr->page_cnt = page_cnt;
+	hdr->flags = mr->writable ? TIPC_MEMREF_F_WRITE : 0;
+
+	for (i = 0; i < page_cnt; i++) {
+		ret = trusty_encode_page_info(&hdr->pages[i], mr->pages[i],
+					      PAGE_KERNEL);
+		if (ret)
+			goto err_unpin;
+	}
+
+	if (msg_len &&
+	    copy_from_user(mb_put_data(txbuf, msg_len), msg, msg_len)) {
+		ret = -EFAULT;
+		goto err_unpin;
+	}
+
+	/* the buffer holds a reference until it is handed back */
+	kref_get(&mr->refcount);
+	txbuf->memref = mr;
+
+	ret = tipc_chan_queue_msg(dn->chan, txbuf);
+	if (ret) {
+		tipc_chan_put_txbuf(dn->chan, txbuf);
+		kref_put(&mr->refcount, _free_memref);
+		return ret;
+	}
+
+	atomic64_inc(&stats->memref_msgs);
+	atomic64_add(len, &stats->memref_bytes);
+	atomic64_add(page_cnt, &stats->memref_pages);
+
+	if (wait_for_completion_killable(&mr->done))
+		ret = -EINTR;
+	else
+		ret = len;
+
+	kref_put(&mr->refcount, _free_memref);
+	return ret;
+
+err_unpin:
+	_memref_unpin(mr);
+	kref_put(&mr->refcount, _free_memref);
+err_put_txbuf:
+	tipc_chan_put_txbuf(dn->chan, txbuf);
+	return ret;
+}
+
+static int dn_memref_ioctl(struct tipc_dn_chan *dn,
+			   struct tipc_memref_req __user *usr_req)
+{
+	int ret;
+	ssize_t len;
+	struct iovec iov;
+	struct iov_iter iter;
+	struct tipc_memref_req req;
+
+	if (copy_from_user(&req, usr_req, sizeof(req)))
+		return -EFAULT;
+
+	if (!req.len || (req.flags & ~TIPC_MEMREF_F_WRITE) || req.reserved)
+		return -EINVAL;
+
+	if (!dn->chan->vds->memref)
+		return -EOPNOTSUPP;
+
+	ret = import_single_range(req.flags & TIPC_MEMREF_F_WRITE ?
+				  READ : WRITE, u64_to_user_ptr(req.buf),
+				  req.len, &iov, &iter);
+	if (ret)
+		return ret;
+
+	len = dn_send_memref(dn, &iter, u64_to_user_ptr(req.msg),
+			     req.msg_len, TXBUF_TIMEOUT);
+	return len < 0 ? len : 0;
+}
+
 static long tipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 {
 	int ret;
@@ -964,6 +1241,10 @@ static long tipc_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	case TIPC_IOC_CONNECT:
 		ret = dn_connect_ioctl(dn, (char __user *)arg);
 		break;
+	case TIPC_IOC_SEND_MEMREF:
+		ret = dn_memref_ioctl(dn,
+				(struct tipc_memref_req __user *)arg);
+		break;
 	default:
 		pr_warn("%s: Unhandled ioctl cmd: 0x%x\n",
 			__func__, cmd);
@@ -987,6 +1268,9 @@ static long tipc_compat_ioctl(struct file *filp,
 	case TIPC_IOC_CONNECT_COMPAT:
 		ret = dn_connect_ioctl(dn, user_req);
 		break;
+	case TIPC_IOC_SEND_MEMREF:
+		ret = dn_memref_ioctl(dn, user_req);
+		break;
 	default:
 		pr_warn("%s: Unhandled ioctl cmd: 0x%x\n",
 			__func__, cmd);
@@ -1063,6 +1347,18 @@ out:
 	return ret;
 }
 
+static bool dn_use_memref(struct tipc_dn_chan *dn, struct iov_iter *iter)
+{
+	size_t len = iov_iter_count(iter);
+
+	if (!dn->chan->vds->memref || !memref_threshold ||
+	    len < memref_threshold || len > dn->chan->max_msg_size)
+		return false;
+
+	/* a single page list describes one contiguous user range */
+	return iter_is_iovec(iter) && iov_iter_single_seg_count(iter) == len;
+}
+
 static ssize_t tipc_write_iter(struct kiocb *iocb, struct iov_iter *iter)
 {
 	ssize_t ret;
@@ -1071,10 +1367,24 @@ static ssize_t tipc_write_iter(struct kiocb *iocb, struct iov_iter *iter)
 	struct tipc_msg_buf *txbuf = NULL;
 	struct file *filp = iocb->ki_filp;
 	struct tipc_dn_chan *dn = filp->private_data;
+	struct tipc_xfer_stats *stats = &dn->chan->vds->stats;
 
 	if (filp->f_flags & O_NONBLOCK)
 		timeout = 0;
 
+	/*
+	 * Large writes are sent by reference. O_NONBLOCK only applies to
+	 * getting a tx buffer: the write still waits for the secure side
+	 * to release the pages.
+	 */
+	if (dn_use_memref(dn, iter)) {
+		ret = dn_send_memref(dn, iter, NULL, 0, timeout);
+		if (ret != -EMSGSIZE)
+			return ret;
+		/* too many pages for one descriptor, try to copy it */
+		atomic64_inc(&stats->memref_fallbacks);
+	}
+
 	txbuf = tipc_chan_get_txbuf_timeout(dn->chan, timeout);
 	if (IS_ERR(txbuf))
 		return PTR_ERR(txbuf);
@@ -1101,6 +1411,8 @@ static ssize_t tipc_write_iter(struct kiocb *iocb, struct iov_iter *iter)
 	if (ret)
 		goto err_out;
 
+	atomic64_inc(&stats->copy_msgs);
+	atomic64_add(len, &stats->copy_bytes);
 	return len;
 
 err_out:
@@ -1537,6 +1849,151 @@ static void _txvq_cb(struct virtqueue *txvq)
 	}
 }
 
+static int tipc_stats_show(struct seq_file *s, void *data)
+{
+	struct tipc_virtio_dev *vds = s->private;
+	struct tipc_xfer_stats *stats = &vds->stats;
+
+	seq_printf(s, "memref:           %s\n",
+		   vds->memref ? "supported" : "unsupported");
+	seq_printf(s, "copy msgs:        %lld\n",
+		   (long long)atomic64_read(&stats->copy_msgs));
+	seq_printf(s, "copy bytes:       %lld\n",
+		   (long long)atomic64_read(&stats->copy_bytes));
+	seq_printf(s, "memref msgs:      %lld\n",
+		   (long long)atomic64_read(&stats->memref_msgs));
+	seq_printf(s, "memref bytes:     %lld\n",
+		   (long long)atomic64_read(&stats->memref_bytes));
+	seq_printf(s, "memref pages:     %lld\n",
+		   (long long)atomic64_read(&stats->memref_pages));
+	seq_printf(s, "memref fallbacks: %lld\n",
+		   (long long)atomic64_read(&stats->memref_fallbacks));
+	return 0;
+}
+
+static int tipc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tipc_stats_show, inode->i_private);
+}
+
+static const struct file_operations tipc_stats_fops = {
+	.open		= tipc_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static u64 _bench_mbps(size_t size, u64 ns)
+{
+	return div64_u64((u64)size * TIPC_MEMREF_BENCH_LOOPS * 1000,
+			 max_t(u64, ns, 1));
+}
+
+/*
+ * Compare the non-secure side cost of both write paths for payloads of
+ * one page up to TIPC_MEMREF_BENCH_MAX: splitting the payload and copying
+ * it into message buffers, against taking a reference on every page and
+ * encoding its descriptor into a single message. Page references stand in
+ * for pinning user memory; the secure side is not involved.
+ */
+static int tipc_memref_bench_show(struct seq_file *s, void *data)
+{
+	int ret = 0;
+	void *src;
+	ktime_t start;
+	u64 copy_ns, memref_ns;
+	size_t size, off, chunk;
+	size_t payload = DEFAULT_MSG_BUF_SIZE - sizeof(struct tipc_msg_hdr);
+	unsigned int i, loop, npages;
+	struct page **pages;
+	struct tipc_msg_buf *mb;
+	struct tipc_memref_hdr *hdr;
+
+	src = vzalloc(TIPC_MEMREF_BENCH_MAX);
+	pages = kcalloc(TIPC_MEMREF_BENCH_MAX >> PAGE_SHIFT, sizeof(*pages),
+			GFP_KERNEL);
+	mb = _alloc_msg_buf(DEFAULT_MSG_BUF_SIZE);
+	if (!src || !pages || !mb) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < TIPC_MEMREF_BENCH_MAX >> PAGE_SHIFT; i++)
+		pages[i] = vmalloc_to_page(src + i * PAGE_SIZE);
+
+	seq_printf(s, "%8s %6s %6s %12s %12s\n", "size", "msgs", "pages",
+		   "copy MB/s", "memref MB/s");
+
+	for (size = PAGE_SIZE; size <= TIPC_MEMREF_BENCH_MAX; size <<= 1) {
+		npages = size >> PAGE_SHIFT;
+
+		start = ktime_get();
+		for (loop = 0; loop < TIPC_MEMREF_BENCH_LOOPS; loop++) {
+			for (off = 0; off < size; off += chunk) {
+				chunk = min(size - off, payload);
+				mb_reset(mb);
+				mb_put_data(mb, sizeof(struct tipc_msg_hdr));
+				memcpy(mb_put_data(mb, chunk), src + off,
+				       chunk);
+				fill_msg_hdr(mb, TIPC_MIN_LOCAL_ADDR,
+					     TIPC_MIN_LOCAL_ADDR);
+			}
+		}
+		copy_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		start = ktime_get();
+		for (loop = 0; loop < TIPC_MEMREF_BENCH_LOOPS; loop++) {
+			mb_reset(mb);
+			mb_put_data(mb, sizeof(struct tipc_msg_hdr));
+			hdr = mb_put_data(mb, sizeof(*hdr) +
+					  npages * sizeof(hdr->pages[0]));
+			hdr->size = size;
+			hdr->offset = 0;
+			hdr->page_cnt = npages;
+			hdr->flags = 0;
+
+			for (i = 0; i < npages; i++)
+				get_page(pages[i]);
+			for (i = 0; i < npages && !ret; i++)
+				ret = trusty_encode_page_info(&hdr->pages[i],
+							      pages[i],
+							      PAGE_KERNEL);
+			fill_msg_hdr(mb, TIPC_MIN_LOCAL_ADDR,
+				     TIPC_MIN_LOCAL_ADDR);
+			for (i = 0; i < npages; i++)
+				put_page(pages[i]);
+			if (ret)
+				goto out;
+		}
+		memref_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		seq_printf(s, "%8zu %6zu %6u %12llu %12llu\n", size,
+			   DIV_ROUND_UP(size, payload), npages,
+			   _bench_mbps(size, copy_ns),
+			   _bench_mbps(size, memref_ns));
+		cond_resched();
+	}
+
+out:
+	if (mb)
+		_free_msg_buf(mb);
+	kfree(pages);
+	vfree(src);
+	return ret;
+}
+
+static int tipc_memref_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tipc_memref_bench_show, inode->i_private);
+}
+
+static const struct file_operations tipc_memref_bench_fops = {
+	.open		= tipc_memref_bench_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int tipc_virtio_probe(struct virtio_device *vdev)
 {
 	int err, i;
@@ -1608,9 +2065,18 @@ static int tipc_virtio_probe(struct virtio_device *vdev)
 		WARN_ON(err); /* sanity check; this can't really happen */
 	}
 
+	vds->memref = virtio_has_feature(vdev, TIPC_F_MEMREF);
+
 	vdev->priv = vds;
 	vds->state = VDS_OFFLINE;
 
+	if (tipc_debugfs_root) {
+		vds->debugfs = debugfs_create_dir(dev_name(&vdev->dev),
+						  tipc_debugfs_root);
+		debugfs_create_file("stats", 0444, vds->debugfs, vds,
+				    &tipc_stats_fops);
+	}
+
 	dev_dbg(&vdev->dev, "%s: done\n", __func__);
 	return 0;
 
@@ -1627,6 +2093,8 @@ static void tipc_virtio_remove(struct virtio_device *vdev)
 
 	_go_offline(vds);
 
+	debugfs_remove_recursive(vds->debugfs);
+
 	mutex_lock(&vds->lock);
 	vds->state = VDS_DEAD;
 	mutex_unlock(&vds->lock);
@@ -1655,6 +2123,7 @@ static struct virtio_device_id tipc_virtio_id_table[] = {
 
 static unsigned int features[] = {
 	0,
+	TIPC_F_MEMREF,
 };
 
 static struct virtio_driver virtio_tipc_driver = {
@@ -1686,6 +2155,13 @@ static int __init tipc_init(void)
 		goto err_class_create;
 	}
 
+	tipc_debugfs_root = debugfs_create_dir(KBUILD_MODNAME, NULL);
+	if (IS_ERR_OR_NULL(tipc_debugfs_root))
+		tipc_debugfs_root = NULL;
+	else
+		debugfs_create_file("memref_bench", 0444, tipc_debugfs_root,
+				    NULL, &tipc_memref_bench_fops);
+
 	ret = register_virtio_driver(&virtio_tipc_driver);
 	if (ret) {
 		pr_err("failed to register virtio driver: %d\n", ret);
@@ -1695,6 +2171,7 @@ static int __init tipc_init(void)
 	return 0;
 
 err_register_virtio_drv:
+	debugfs_remove_recursive(tipc_debugfs_root);
 	class_destroy(tipc_class);
 
 err_class_create:
@@ -1705,6 +2182,7 @@ err_class_create:
 static void __exit tipc_exit(void)
 {
 	unregister_virtio_driver(&virtio_tipc_driver);
+	debugfs_remove_recursive(tipc_debugfs_root);
 	class_destroy(tipc_class);
 	unregister_chrdev_region(MKDEV(tipc_major, 0), MAX_DEVICES);
 }
@@ -29,6 +29,8 @@
 
 #define TEGRA_DC_FLIP_BUF_CAPACITY 1024 /* in units of number of elements */
 #define TEGRA_DC_CRC_BUF_CAPACITY 1024 /* in units of number of elements */
+/* Power of two; twice the CRC buffer so that one flip per frame never aliases */
+#define TEGRA_DC_CRC_IDX_CAPACITY 2048
 #define CRC_COMPLETE_TIMEOUT msecs_to_jiffies(1000)
 
 static inline size_t _get_bytes_per_ele(struct tegra_dc_ring_buf *buf)
@@ -189,6 +191,9 @@ void tegra_dc_crc_deinit(struct tegra_dc *dc)
 
 	kfree(dc->flip_buf.data);
 	kfree(dc->crc_buf.data);
+	kfree(dc->crc_idx.data);
+	dc->crc_idx.data = NULL;
+	dc->crc_idx.last_id = 0;
 
 	dc->flip_buf.size = 0;
 	dc->flip_buf.head = 0;
@@ -234,6 +239,13 @@ static long tegra_dc_crc_init(struct tegra_dc *dc)
 	if (!dc->crc_buf.data)
 		return -ENOMEM;
 
+	dc->crc_idx.data = kcalloc(TEGRA_DC_CRC_IDX_CAPACITY,
+				   sizeof(struct tegra_dc_crc_idx_ele),
+				   GFP_KERNEL);
+	if (!dc->crc_idx.data)
+		return -ENOMEM;
+	dc->crc_idx.last_id = 0;
+
 	mutex_init(&dc->flip_buf.lock);
 	mutex_init(&dc->crc_buf.lock);
 
@@ -503,10 +515,10 @@ static bool _is_flip_out_of_bounds(struct tegra_dc *dc, u64 flip_id)
 	return false;
 }
 
-/* Scan the CRC buffer from @start_idx (inclusive) to @end_idx (exclusive)
- * to find the element matched with @flip_id
+/* Scan @count elements of the CRC buffer backwards from @start_idx
+ * (inclusive) to find the element matched with @flip_id
  */
-static int _scan_crc_buf(struct tegra_dc *dc, u16 start_idx, u16 end_idx,
+static int _scan_crc_buf(struct tegra_dc *dc, u16 start_idx, u16 count,
 			 u64 flip_id, struct tegra_dc_crc_buf_ele *crc_ele)
 {
 	u16 peek_idx = start_idx;
@@ -514,7 +526,7 @@ static int _scan_crc_buf(struct tegra_dc *dc, u16 start_idx, u16 end_idx,
 	struct tegra_dc_crc_buf_ele *crc_iter = NULL;
 	int iter, ret;
 
-	while (peek_idx != end_idx) {
+	while (count--) {
 		ret = tegra_dc_ring_buf_peek(buf, peek_idx, (char **)&crc_iter);
 		if (ret)
 			return ret;
@@ -555,11 +567,87 @@ static int tegra_dc_crc_wait_till_frame_end(struct tegra_dc *dc)
 	return ret;
 }
 
+/* Look @flip_id up in the CRC index. Called with the CRC buffer lock held */
+static int _lookup_crc_idx(struct tegra_dc *dc, u64 flip_id,
+			   struct tegra_dc_crc_buf_ele *crc_ele)
+{
+	struct tegra_dc_crc_idx_ele *idx;
+	struct tegra_dc_crc_buf_ele *crc_iter = NULL;
+	int iter;
+
+	idx = &dc->crc_idx.data[flip_id & (TEGRA_DC_CRC_IDX_CAPACITY - 1)];
+	if (idx->id != flip_id)
+		return -ENOENT;
+
+	if (tegra_dc_ring_buf_peek(&dc->crc_buf, idx->slot,
+				   (char **)&crc_iter))
+		return -ENOENT;
+
+	/* The slot may have been recycled for a later frame */
+	for (iter = 0; iter < DC_N_WINDOWS; iter++) {
+		if (!crc_iter->matching_flips[iter].valid)
+			break;
+
+		if (crc_iter->matching_flips[iter].id == flip_id) {
+			memcpy(crc_ele, crc_iter, sizeof(*crc_iter));
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+/* Find the CRC element matched with @flip_id, which must already be at or
+ * below the most recently matched flip. The index is tried first; the scan
+ * only runs when a flip aliased with a later one in the index.
+ * Called with the CRC buffer lock held.
+ */
+static int _get_matched_crc(struct tegra_dc *dc, u64 flip_id,
+			    struct tegra_dc_crc_buf_ele *crc_ele)
+{
+	struct tegra_dc_ring_buf *buf = &dc->crc_buf;
+	int ret;
+
+	if (!_lookup_crc_idx(dc, flip_id, crc_ele))
+		return 0;
+
+	ret = _scan_crc_buf(dc, prev_idx(buf, buf->head), buf->size, flip_id,
+			    crc_ele);
+
+	/* Passed over without a frame of its own, e.g. a cursor flip */
+	return ret == -EAGAIN ? -ENODATA : ret;
+}
+
+/* Block until @flip_id has been matched with a frame, or passed over.
+ * Called with the CRC buffer lock held; the lock is dropped while waiting.
+ */
+static int _wait_for_match(struct tegra_dc *dc, u64 flip_id)
+{
+	struct tegra_dc_ring_buf *buf = &dc->crc_buf;
+	int ret;
+
+	while (flip_id > dc->crc_idx.last_id) {
+		/* Control reaching here implies the flip being requested is yet
+		 * to be matched at a certain frame end interrupt, hence wait on
+		 * the event
+		 */
+		mutex_unlock(&buf->lock);
+		reinit_completion(&dc->crc_complete);
+
+		ret = tegra_dc_crc_wait_till_frame_end(dc); /* Blocking call */
+
+		mutex_lock(&buf->lock);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
 static int _find_crc_in_buf(struct tegra_dc *dc, u64 flip_id,
 			    struct tegra_dc_crc_buf_ele *crc_ele)
 {
-	int ret = 0, ret_loop = -EAGAIN;
-	u16 start_idx, end_idx;
+	int ret = 0;
 	struct tegra_dc_ring_buf *buf = &dc->crc_buf;
 
 	if (flip_id == U64_MAX) {
@@ -579,35 +667,10 @@ static int _find_crc_in_buf(struct tegra_dc *dc, u64 flip_id,
 	/* At this point, we are committed to return a CRC value to the user,
 	 * even if one is yet to be generated in the imminent future
 	 */
-	end_idx = prev_idx(buf, buf->tail);
-	start_idx = prev_idx(buf, buf->head);
-
-	while (ret_loop == -EAGAIN) {
-		ret_loop = _scan_crc_buf(dc, start_idx, end_idx, flip_id,
-					 crc_ele);
-		if (!ret_loop || ret_loop != -EAGAIN) {
-			ret = ret_loop;
-			goto done;
-		}
+	ret = _wait_for_match(dc, flip_id);
+	if (!ret)
+		ret = _get_matched_crc(dc, flip_id, crc_ele);
 
-		/* Control reaching here implies the flip being requested is yet
-		 * to be matched at a certain frame end interrupt, hence wait on
-		 * the event
-		 */
-		mutex_unlock(&buf->lock);
-		reinit_completion(&dc->crc_complete);
-
-		ret = tegra_dc_crc_wait_till_frame_end(dc); /* Blocking call */
-		if (ret)
-			return ret;
-
-		mutex_lock(&buf->lock);
-
-		end_idx = prev_idx(buf, start_idx);
-		start_idx = prev_idx(buf, buf->head);
-	}
-
-done:
 	mutex_unlock(&buf->lock);
 	return ret;
 }
@@ -643,36 +706,23 @@ static int tegra_dc_crc_t21x_collect(struct tegra_dc *dc,
 	return valids ? 0 : -EINVAL;
 }
 
-long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg)
+static int tegra_dc_crc_fill_confs(struct tegra_dc_ext_crc_conf *conf,
+				   u8 num_conf,
+				   struct tegra_dc_crc_buf_ele *crc_ele)
 {
 	int ret = 0;
-	struct tegra_dc_ext_crc_conf *conf =
-				(struct tegra_dc_ext_crc_conf *)arg->conf;
-	struct tegra_dc_crc_buf_ele crc_ele;
 	u8 id, iter;
 
-	if (!dc->enabled)
-		return -ENODEV;
-
-	if (!dc->crc_initialized)
-		return -EPERM;
-
-	WARN_ON(dc->crc_ref_cnt.legacy);
-
-	ret = _find_crc_in_buf(dc, arg->flip_id, &crc_ele);
-	if (ret)
-		return ret;
-
-	for (iter = 0; iter < arg->num_conf; iter++) {
+	for (iter = 0; iter < num_conf; iter++) {
 		switch (conf[iter].type) {
 		case TEGRA_DC_EXT_CRC_TYPE_RG:
-			conf[iter].crc.valid = crc_ele.rg.valid;
-			conf[iter].crc.val = crc_ele.rg.crc;
+			conf[iter].crc.valid = crc_ele->rg.valid;
+			conf[iter].crc.val = crc_ele->rg.crc;
 			break;
 		case TEGRA_DC_EXT_CRC_TYPE_COMP:
 			if (tegra_dc_is_nvdisplay()) {
-				conf[iter].crc.valid = crc_ele.comp.valid;
-				conf[iter].crc.val = crc_ele.comp.crc;
+				conf[iter].crc.valid = crc_ele->comp.valid;
+				conf[iter].crc.val = crc_ele->comp.crc;
 			} else {
 				conf[iter].crc.valid = false;
 				conf[iter].crc.val = 0;
@@ -683,8 +733,8 @@ long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg)
 			if (tegra_dc_is_nvdisplay()) {
 				id = conf[iter].region.id;
 				conf[iter].crc.valid =
-						crc_ele.regional[id].valid;
-				conf[iter].crc.val = crc_ele.regional[id].crc;
+						crc_ele->regional[id].valid;
+				conf[iter].crc.val = crc_ele->regional[id].crc;
 			} else {
 				conf[iter].crc.valid = false;
 				conf[iter].crc.val = 0;
@@ -692,8 +742,8 @@ long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg)
 			}
 			break;
 		case TEGRA_DC_EXT_CRC_TYPE_OR:
-			conf[iter].crc.valid = crc_ele.sor.valid;
-			conf[iter].crc.val = crc_ele.sor.crc;
+			conf[iter].crc.valid = crc_ele->sor.valid;
+			conf[iter].crc.val = crc_ele->sor.crc;
 			break;
 		default:
 			ret = -ENOTSUPP;
@@ -703,6 +753,85 @@ long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg)
 	return ret;
 }
 
+long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg)
+{
+	int ret = 0;
+	struct tegra_dc_ext_crc_conf *conf =
+				(struct tegra_dc_ext_crc_conf *)arg->conf;
+	struct tegra_dc_crc_buf_ele crc_ele;
+
+	if (!dc->enabled)
+		return -ENODEV;
+
+	if (!dc->crc_initialized)
+		return -EPERM;
+
+	WARN_ON(dc->crc_ref_cnt.legacy);
+
+	ret = _find_crc_in_buf(dc, arg->flip_id, &crc_ele);
+	if (ret)
+		return ret;
+
+	return tegra_dc_crc_fill_confs(conf, arg->num_conf, &crc_ele);
+}
+
+long tegra_dc_crc_get_range(struct tegra_dc *dc,
+			    struct tegra_dc_ext_crc_range_arg *arg)
+{
+	struct tegra_dc_ext_crc_conf *conf =
+				(struct tegra_dc_ext_crc_conf *)arg->crc.conf;
+	struct tegra_dc_ring_buf *buf = &dc->crc_buf;
+	struct tegra_dc_crc_buf_ele crc_ele;
+	u64 first_id = arg->crc.flip_id;
+	u64 last_id = first_id + arg->num_flips - 1;
+	u8 num_conf = arg->crc.num_conf;
+	int ret = 0, fill_ret = 0;
+	u32 i, j;
+
+	if (!dc->enabled)
+		return -ENODEV;
+
+	if (!dc->crc_initialized)
+		return -EPERM;
+
+	WARN_ON(dc->crc_ref_cnt.legacy);
+
+	if (_is_flip_out_of_bounds(dc, first_id) ||
+	    _is_flip_out_of_bounds(dc, last_id))
+		return -ENODATA;
+
+	arg->num_matched = 0;
+
+	mutex_lock(&buf->lock);
+
+	ret = _wait_for_match(dc, last_id);
+	if (ret)
+		goto done;
+
+	for (i = 0; i < arg->num_flips; i++, conf += num_conf) {
+		ret = _get_matched_crc(dc, first_id + i, &crc_ele);
+		if (ret == -ENODATA) {
+			for (j = 0; j < num_conf; j++) {
+				conf[j].crc.valid = false;
+				conf[j].crc.val = 0;
+			}
+			continue;
+		} else if (ret) {
+			goto done;
+		}
+
+		arg->num_matched++;
+		ret = tegra_dc_crc_fill_confs(conf, num_conf, &crc_ele);
+		if (ret)
+			fill_ret = ret;
+	}
+
+	ret = fill_ret;
+done:
+	mutex_unlock(&buf->lock);
+	return ret;
+}
+
 int tegra_dc_crc_process(struct tegra_dc *dc)
 {
 	int ret = 0, matched = 0;
@@ -747,10 +876,26 @@ int tegra_dc_crc_process(struct tegra_dc *dc)
 					     (char **)&flip_ele);
 	}
 
-	/* Enqueue CRC element in the CRC ring buffer */
+	/* Enqueue CRC element in the CRC ring buffer and index its flips */
 	if (matched) {
+		struct tegra_dc_crc_idx_ele *idx;
+		u16 slot;
+		int iter;
+
 		mutex_lock(&dc->crc_buf.lock);
+		slot = dc->crc_buf.head;
 		tegra_dc_ring_buf_add(&dc->crc_buf, &crc_ele, NULL);
+
+		for (iter = 0; iter < matched; iter++) {
+			u64 id = crc_ele.matching_flips[iter].id;
+
+			idx = &dc->crc_idx.data[id &
+						(TEGRA_DC_CRC_IDX_CAPACITY - 1)];
+			idx->id = id;
+			idx->slot = slot;
+			if (id > dc->crc_idx.last_id)
+				dc->crc_idx.last_id = id;
+		}
 		mutex_unlock(&dc->crc_buf.lock);
 	}
 
@@ -2877,6 +2877,13 @@ static int dbg_flip_stats_show(struct seq_file *m, void *unused)
 		(long long int)atomic64_read(&dc->flip_stats.flips_skipped));
 	seq_printf(m, "Flips completed: %lld\n",
 		(long long int)atomic64_read(&dc->flip_stats.flips_cmpltd));
+	seq_printf(m, "Pin cache hits: %lld\n",
+		(long long int)atomic64_read(&dc->flip_stats.pin_cache_hits));
+	seq_printf(m, "Pin cache misses: %lld\n",
+		(long long int)atomic64_read(&dc->flip_stats.pin_cache_misses));
+	seq_printf(m, "Pin cache evictions: %lld\n",
+		(long long int)atomic64_read(
+			&dc->flip_stats.pin_cache_evictions));
 
 	return 0;
 }
@@ -2893,6 +2900,51 @@ static const struct file_operations dbg_flip_stats_ops = {
 	.release = single_release,
 };
 
+static int dbg_flip_latency_show(struct seq_file *m, void *unused)
+{
+	static const char * const stage_names[] = {
+		[TEGRA_DC_FLIP_LAT_PIN] = "ioctl_to_pin",
+		[TEGRA_DC_FLIP_LAT_FENCE] = "pin_to_fence",
+		[TEGRA_DC_FLIP_LAT_LATCH] = "fence_to_latch",
+	};
+	struct tegra_dc *dc = m->private;
+	int win, stage, b;
+
+	if (WARN_ON(!dc))
+		return -EINVAL;
+
+	seq_puts(m, "# bucket upper bounds (us):");
+	for (b = 0; b < TEGRA_DC_FLIP_LAT_BUCKETS - 1; b++)
+		seq_printf(m, " %lu", 1UL << b);
+	seq_puts(m, " inf\n");
+
+	for_each_set_bit(win, &dc->valid_windows, DC_N_WINDOWS) {
+		struct tegra_dc_flip_lat *lat = &dc->flip_lat[win];
+
+		for (stage = 0; stage < TEGRA_DC_FLIP_LAT_NUM_STAGES; stage++) {
+			seq_printf(m, "win%d %s:", win, stage_names[stage]);
+			for (b = 0; b < TEGRA_DC_FLIP_LAT_BUCKETS; b++)
+				seq_printf(m, " %lld", (long long int)
+					atomic64_read(&lat->hist[stage][b]));
+			seq_puts(m, "\n");
+		}
+	}
+
+	return 0;
+}
+
+static int dbg_flip_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dbg_flip_latency_show, inode->i_private);
+}
+
+static const struct file_operations dbg_flip_latency_ops = {
+	.open = dbg_flip_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int dbg_measure_latency_show(struct seq_file *m, void *unused)
 {
 	struct tegra_dc *dc = m->private;
@@ -3078,6 +3130,11 @@ static void tegra_dc_create_debugfs(struct tegra_dc *dc)
 	if (!retval)
 		goto remove_out;
 
+	retval = debugfs_create_file("flip_latency", 0444, dc->debugdir,
+				dc, &dbg_flip_latency_ops);
+	if (!retval)
+		goto remove_out;
+
 	if (dc->out_ops->get_connector_instance) {
 		char sor_path[CHAR_BUF_SIZE_MAX];
 		int ctrl_num = -1;
@@ -6818,6 +6875,9 @@ static int tegra_dc_probe(struct platform_device *ndev)
 	atomic64_set(&dc->flip_stats.flips_queued, 0);
 	atomic64_set(&dc->flip_stats.flips_skipped, 0);
 	atomic64_set(&dc->flip_stats.flips_cmpltd, 0);
+	atomic64_set(&dc->flip_stats.pin_cache_hits, 0);
+	atomic64_set(&dc->flip_stats.pin_cache_misses, 0);
+	atomic64_set(&dc->flip_stats.pin_cache_evictions, 0);
 
 	tegra_dc_create_debugfs(dc);
 
@@ -1201,5 +1201,7 @@ long tegra_dc_crc_enable(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg);
 long tegra_dc_crc_disable(struct tegra_dc *dc,
 			  struct tegra_dc_ext_crc_arg *arg);
 long tegra_dc_crc_get(struct tegra_dc *dc, struct tegra_dc_ext_crc_arg *arg);
+long tegra_dc_crc_get_range(struct tegra_dc *dc,
+			    struct tegra_dc_ext_crc_range_arg *arg);
 
 #endif
@@ -267,6 +267,35 @@ struct tegra_dc_flip_stats {
 	atomic64_t flips_skipped;
 	atomic64_t flips_queued;
 	atomic64_t flips_cmpltd;
+	/* dc ext scanout pin cache, see tegra_dc_ext_pin_window() */
+	atomic64_t pin_cache_hits;
+	atomic64_t pin_cache_misses;
+	atomic64_t pin_cache_evictions;
+};
+
+/*
+ * tegra_dc_flip_lat - Always-on flip latency histograms for one window
+ * @hist - Flip counts per stage and log2 bucket. Bucket 0 counts latencies
+ *         below 1 us, bucket i counts [2^(i-1), 2^i) us and the last bucket
+ *         is open-ended. The stages are:
+ *         TEGRA_DC_FLIP_LAT_PIN   - from the flip IOCTL until its buffers are
+ *                                   pinned
+ *         TEGRA_DC_FLIP_LAT_FENCE - from pinning until the pre-fences have
+ *                                   signaled
+ *         TEGRA_DC_FLIP_LAT_LATCH - from the pre-fences until the window
+ *                                   update is latched for scanout
+ */
+#define TEGRA_DC_FLIP_LAT_BUCKETS 24
+
+enum tegra_dc_flip_lat_stage {
+	TEGRA_DC_FLIP_LAT_PIN,
+	TEGRA_DC_FLIP_LAT_FENCE,
+	TEGRA_DC_FLIP_LAT_LATCH,
+	TEGRA_DC_FLIP_LAT_NUM_STAGES,
+};
+
+struct tegra_dc_flip_lat {
+	atomic64_t hist[TEGRA_DC_FLIP_LAT_NUM_STAGES][TEGRA_DC_FLIP_LAT_BUCKETS];
 };
 
 /*
@@ -381,6 +410,26 @@ struct tegra_dc_ring_buf {
 	struct mutex lock;
 };
 
+/*
+ * tegra_dc_crc_idx - Flip ID to CRC ring buffer slot index
+ * @data    - Direct mapped table indexed by the low bits of the flip ID.
+ *            An entry is trusted only if @id matches and the CRC element in
+ *            @slot still lists the flip among its matching flips
+ * @last_id - The most recently matched flip ID. Flips are matched in the
+ *            order they are queued, so any flip ID not above this one has
+ *            either been matched or will never be
+ * Protected by the lock of the CRC ring buffer
+ */
+struct tegra_dc_crc_idx_ele {
+	u64 id;
+	u16 slot;
+};
+
+struct tegra_dc_crc_idx {
+	struct tegra_dc_crc_idx_ele *data;
+	u64 last_id;
+};
+
 /*
  * tegra_dc_crc_ref_count - Reference counts for various CRC features
  *                ### Note ###
@@ -669,9 +718,11 @@ struct tegra_dc {
 	unsigned long act_req_mask;
 	struct tegra_dc_clients_info clients_info;
 	struct tegra_dc_flip_stats flip_stats;
+	struct tegra_dc_flip_lat flip_lat[DC_N_WINDOWS];
 
 	struct tegra_dc_ring_buf flip_buf; /* Buffer to save flip requests */
 	struct tegra_dc_ring_buf crc_buf; /* Buffer to save HW generated CRCs */
+	struct tegra_dc_crc_idx crc_idx; /* Index into crc_buf by flip ID */
 	struct tegra_dc_crc_ref_cnt crc_ref_cnt;
 	bool crc_initialized;
 	struct tegra_dc_latency_measurement_data msrmnt_info;
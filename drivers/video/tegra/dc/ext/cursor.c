@@ -157,13 +157,8 @@ int tegra_dc_ext_set_cursor_image(struct tegra_dc_ext_user *user,
 	tegra_dc_scrncapt_disp_pause_unlock(dc);
 	mutex_unlock(&ext->cursor.lock);
 
-	if (old_handle) {
-		dma_buf_unmap_attachment(old_handle->attach,
-			old_handle->sgt, DMA_TO_DEVICE);
-		dma_buf_detach(old_handle->buf, old_handle->attach);
-		dma_buf_put(old_handle->buf);
-		kfree(old_handle);
-	}
+	if (old_handle)
+		tegra_dc_ext_put_dmabuf(old_handle);
 
 	return ret;
 
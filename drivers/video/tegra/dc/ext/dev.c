@@ -25,6 +25,9 @@
 #include <linux/workqueue.h>
 #include <linux/export.h>
 #include <linux/delay.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <linux/fb.h>
 #include <linux/version.h>
 #include <linux/string.h>
@@ -51,6 +54,8 @@
 
 #define TEGRA_DC_TS_MAX_DELAY_US 1000000
 #define TEGRA_DC_TS_SLACK_US 2000
+/* Longest a flip waits for its pre-fences before it is shown anyway */
+#define TEGRA_DC_EXT_FENCE_TIMEOUT_MS 5000
 
 #ifdef CONFIG_COMPAT
 /* compat versions that happen to be the same size as the uapi version. */
@@ -107,7 +112,23 @@ struct tegra_dc_ext_flip_win {
 
 struct tegra_dc_ext_flip_data {
 	struct tegra_dc_ext		*ext;
-	struct kthread_work		work;
+	/* held by the flip queue and by every armed pre-fence notifier */
+	struct kref			ref;
+	struct tegra_dc_ext_win		*queue_win;
+	struct list_head		queue_node;
+	/* armed pre-fences not yet signaled, plus one while arming */
+	atomic_t			fences_pending;
+	/* readies the flip if its pre-fences never signal */
+	struct hrtimer			fence_timer;
+	ktime_t				fence_deadline;
+	/* protected by queue_win->flip_lock */
+	bool				ready;
+	bool				superseded;
+	unsigned long			win_mask;
+	/* ktime_get_ns() at the flip IOCTL, after pinning and once ready */
+	u64				ioctl_ns;
+	u64				pin_ns;
+	u64				ready_ns;
 	struct tegra_dc_ext_flip_win	win[DC_N_WINDOWS];
 	struct list_head		timestamp_node;
 	int act_window_num;
@@ -141,6 +162,7 @@ struct tegra_dc_ext_scanline_data {
 
 static int tegra_dc_ext_set_vblank(struct tegra_dc_ext *ext, bool enable);
 static void tegra_dc_ext_unpin_window(struct tegra_dc_ext_win *win);
+static void tegra_dc_ext_flush_flips(struct tegra_dc_ext_win *win);
 static void tegra_dc_flip_trace(struct tegra_dc_ext_flip_data *data,
 				display_syncpt_notifier trace_fn);
 
@@ -226,7 +248,7 @@ static int tegra_dc_ext_put_window(struct tegra_dc_ext_user *user,
 	mutex_lock(&win->lock);
 
 	if (win->user == user) {
-		kthread_flush_worker(&win->flip_worker);
+		tegra_dc_ext_flush_flips(win);
 		win->user = NULL;
 		win->enabled = false;
 	} else {
@@ -327,7 +349,7 @@ int tegra_dc_ext_disable(struct tegra_dc_ext *ext)
 	for (i = 0; i < ext->dc->n_windows; i++) {
 		struct tegra_dc_ext_win *win = &ext->win[i];
 
-		kthread_flush_worker(&win->flip_worker);
+		tegra_dc_ext_flush_flips(win);
 	}
 
 	tegra_dc_en_dis_latency_msrmnt_mode(ext->dc, false);
@@ -515,7 +537,8 @@ static void tegra_dc_ext_set_windowattr_basic(struct tegra_dc_win *win,
 
 static int tegra_dc_ext_set_windowattr(struct tegra_dc_ext *ext,
 			       struct tegra_dc_win *win,
-			       const struct tegra_dc_ext_flip_win *flip_win)
+			       const struct tegra_dc_ext_flip_win *flip_win,
+			       unsigned int fence_timeout_ms)
 {
 	int err = 0;
 	struct tegra_dc_ext_win *ext_win = &ext->win[win->idx];
@@ -580,13 +603,13 @@ static int tegra_dc_ext_set_windowattr(struct tegra_dc_ext *ext,
 				"Window atrributes are invalid.\n");
 
 	if (flip_win->pre_syncpt_fence) {
-		nvhost_fence_wait(flip_win->pre_syncpt_fence, 5000);
+		nvhost_fence_wait(flip_win->pre_syncpt_fence, fence_timeout_ms);
 		nvhost_fence_put(flip_win->pre_syncpt_fence);
 	} else if ((s32)flip_win->attr.pre_syncpt_id >= 0) {
 		nvhost_syncpt_wait_timeout_ext(ext->dc->ndev,
 				flip_win->attr.pre_syncpt_id,
 				flip_win->attr.pre_syncpt_val,
-				msecs_to_jiffies(5000), NULL, NULL);
+				msecs_to_jiffies(fence_timeout_ms), NULL, NULL);
 	}
 
 	if (err < 0)
@@ -877,14 +900,8 @@ static void tegra_dc_ext_unpin_handles(struct tegra_dc_dmabuf *unpin_handles[],
 {
 	int i;
 
-	for (i = 0; i < nr_unpin; i++) {
-		dma_buf_unmap_attachment(unpin_handles[i]->attach,
-			unpin_handles[i]->sgt, DMA_TO_DEVICE);
-		dma_buf_detach(unpin_handles[i]->buf,
-			       unpin_handles[i]->attach);
-		dma_buf_put(unpin_handles[i]->buf);
-		kfree(unpin_handles[i]);
-	}
+	for (i = 0; i < nr_unpin; i++)
+		tegra_dc_ext_put_dmabuf(unpin_handles[i]);
 }
 
 static void tegra_dc_flip_trace(struct tegra_dc_ext_flip_data *data,
@@ -1009,10 +1026,83 @@ static void tegra_dc_ext_store_latency_msrmnt_info(struct tegra_dc *dc,
 	mutex_unlock(&dc->msrmnt_info.lock);
 }
 
-static void tegra_dc_ext_flip_worker(struct kthread_work *work)
+static void tegra_dc_ext_flip_release(struct kref *ref)
 {
 	struct tegra_dc_ext_flip_data *data =
-		container_of(work, struct tegra_dc_ext_flip_data, work);
+		container_of(ref, struct tegra_dc_ext_flip_data, ref);
+
+	kfree(data);
+}
+
+static void tegra_dc_ext_flip_put(struct tegra_dc_ext_flip_data *data)
+{
+	kref_put(&data->ref, tegra_dc_ext_flip_release);
+}
+
+/* What is left of the pre-fence timeout armed when @data was queued */
+static unsigned int tegra_dc_ext_flip_fence_timeout_ms(
+	struct tegra_dc_ext_flip_data *data)
+{
+	s64 ms = ktime_ms_delta(data->fence_deadline, ktime_get());
+
+	return ms > 0 ? ms : 0;
+}
+
+static void tegra_dc_ext_flip_lat_add(struct tegra_dc *dc, int win,
+				      enum tegra_dc_flip_lat_stage stage,
+				      u64 delta_ns)
+{
+	u64 us = div_u64(delta_ns, NSEC_PER_USEC);
+	int bucket = min_t(int, fls64(us), TEGRA_DC_FLIP_LAT_BUCKETS - 1);
+
+	atomic64_inc(&dc->flip_lat[win].hist[stage][bucket]);
+}
+
+/*
+ * Account the latency of each window of @data. Windows in @latched (by
+ * index into data->win) were latched for scanout at @latch_ns; the others
+ * were skipped and only count towards the earlier stages.
+ */
+static void tegra_dc_ext_flip_record_latency(struct tegra_dc_ext_flip_data *data,
+					     unsigned long latched,
+					     u64 latch_ns)
+{
+	struct tegra_dc *dc = data->ext->dc;
+	u64 pin_ns = data->pin_ns - data->ioctl_ns;
+	int i;
+
+	for (i = 0; i < data->act_window_num; i++) {
+		int index = data->win[i].attr.index;
+		u64 fence_ns = 0, scan_ns = 0;
+
+		if (index < 0 || !test_bit(index, &dc->valid_windows))
+			continue;
+
+		tegra_dc_ext_flip_lat_add(dc, index, TEGRA_DC_FLIP_LAT_PIN,
+					  pin_ns);
+
+		/* a superseded flip stopped waiting for its fences */
+		if (!data->superseded) {
+			fence_ns = data->ready_ns - data->pin_ns;
+			tegra_dc_ext_flip_lat_add(dc, index,
+						  TEGRA_DC_FLIP_LAT_FENCE,
+						  fence_ns);
+		}
+
+		if (test_bit(i, &latched)) {
+			scan_ns = latch_ns - data->ready_ns;
+			tegra_dc_ext_flip_lat_add(dc, index,
+						  TEGRA_DC_FLIP_LAT_LATCH,
+						  scan_ns);
+		}
+
+		trace_flip_latency(dc->ctrl_num, index, pin_ns, fence_ns,
+				   scan_ns);
+	}
+}
+
+static void tegra_dc_ext_do_flip(struct tegra_dc_ext_flip_data *data)
+{
 	int win_num = data->act_window_num;
 	struct tegra_dc_ext *ext = data->ext;
 	struct tegra_dc_win *wins[DC_N_WINDOWS];
@@ -1022,6 +1112,8 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 	struct tegra_dc_dmabuf *old_handle;
 	struct tegra_dc *dc = ext->dc;
 	int i, nr_unpin = 0, nr_win = 0;
+	unsigned long latched = 0;
+	u64 latch_ns = 0;
 	bool skip_flip = true;
 	bool wait_for_vblank = false;
 	bool lock_flip = false;
@@ -1089,6 +1181,10 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 			list_del(&data->timestamp_node);
 		mutex_unlock(&ext_win->queue_lock);
 
+		/* replaced by a later mailbox flip before it was latched */
+		if (data->superseded)
+			win_skip_flip = true;
+
 		skip_flip = skip_flip && win_skip_flip;
 
 		if (win_skip_flip) {
@@ -1163,8 +1259,13 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 			}
 		}
 
-		if (!win_skip_flip)
-			tegra_dc_ext_set_windowattr(ext, win, &data->win[i]);
+		if (!win_skip_flip) {
+			tegra_dc_ext_set_windowattr(ext, win, &data->win[i],
+				tegra_dc_ext_flip_fence_timeout_ms(data));
+			latched |= BIT(i);
+		} else if (flip_win->pre_syncpt_fence) {
+			nvhost_fence_put(flip_win->pre_syncpt_fence);
+		}
 
 		if (dc->yuv_bypass) {
 			reg_val = tegra_dc_readl(dc,
@@ -1198,6 +1299,10 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 	 */
 	BUG_ON(show_background);
 
+	/* Flushed before its fences signaled; it has waited for them above */
+	if (!data->ready_ns)
+		data->ready_ns = ktime_get_ns();
+
 	if (trace_sync_wt_ovr_syncpt_upd_enabled())
 		tegra_dc_flip_trace(data, trace_sync_wt_ovr_syncpt_upd);
 
@@ -1246,6 +1351,7 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 
 		/* TODO: implement swapinterval here */
 		tegra_dc_sync_windows(wins, nr_win);
+		latch_ns = ktime_get_ns();
 
 		if (flip_ele)
 			flip_ele->state = TEGRA_DC_FLIP_STATE_FLIPPED;
@@ -1294,18 +1400,261 @@ static void tegra_dc_ext_flip_worker(struct kthread_work *work)
 		atomic64_inc(&dc->flip_stats.flips_skipped);
 	}
 
+	if (!latch_ns)
+		latched = 0;
+	tegra_dc_ext_flip_record_latency(data, latched, latch_ns);
+
 	/* unpin and deref previous front buffers */
 	tegra_dc_ext_unpin_handles(unpin_handles, nr_unpin);
 #ifdef CONFIG_ANDROID
 	/* now DC has submitted buffer for display, try to release fbmem */
 	tegra_fb_release_fbmem(ext->dc->fb);
 #endif
-	kfree(data);
+	tegra_dc_ext_flip_put(data);
 	kfree(blank_win);
 	/* Updating wins with coming user data */
 	spec_bar();
 }
 
+/*
+ * A flip may be skipped in favour of a later one only if everything it
+ * changes is changed again by that flip, i.e. it carries no head state.
+ */
+static bool tegra_dc_ext_flip_replaceable(struct tegra_dc_ext_flip_data *data)
+{
+	int i;
+
+	if (data->imp_dirty || data->hdr_cache_dirty ||
+	    data->avi_cache_dirty || data->dv_cache_dirty ||
+	    data->cmu_update_needed || data->output_colorspace_update_needed ||
+	    data->output_range_update_needed ||
+	    data->background_color_update_needed)
+		return false;
+
+	for (i = 0; i < data->act_window_num; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+
+		if (flip_win->user_nvdisp_win_csc ||
+		    (flip_win->attr.flags & (TEGRA_DC_EXT_FLIP_FLAG_UPDATE_CSC |
+					     TEGRA_DC_EXT_FLIP_FLAG_CURSOR)))
+			return false;
+	}
+
+	return true;
+}
+
+/*
+ * Mark @data ready for the worker. A mailbox flip also marks the earlier
+ * replaceable flips of the same windows, so that the worker skips them
+ * without waiting for their fences. Called with win->flip_lock held.
+ */
+static void tegra_dc_ext_flip_ready_locked(struct tegra_dc_ext_win *win,
+					   struct tegra_dc_ext_flip_data *data)
+{
+	struct tegra_dc_ext_flip_data *old;
+
+	data->ready = true;
+	data->ready_ns = ktime_get_ns();
+
+	if (!(data->flags & TEGRA_DC_EXT_FLIP_HEAD_FLAG_MAILBOX))
+		return;
+
+	list_for_each_entry(old, &win->flip_queue, queue_node) {
+		if (old == data)
+			break;
+		if (old->win_mask != data->win_mask ||
+		    !tegra_dc_ext_flip_replaceable(old))
+			continue;
+
+		old->superseded = true;
+		old->ready = true;
+	}
+}
+
+static void tegra_dc_ext_flip_fence_done(struct tegra_dc_ext_flip_data *data)
+{
+	struct tegra_dc_ext_win *win = data->queue_win;
+	unsigned long flags;
+
+	if (!atomic_dec_and_test(&data->fences_pending))
+		return;
+
+	spin_lock_irqsave(&win->flip_lock, flags);
+	if (!data->ready)
+		tegra_dc_ext_flip_ready_locked(win, data);
+	spin_unlock_irqrestore(&win->flip_lock, flags);
+
+	kthread_queue_work(&win->flip_worker, &win->flip_work);
+}
+
+static void tegra_dc_ext_flip_fence_signaled(void *priv, int nr_completed)
+{
+	struct tegra_dc_ext_flip_data *data = priv;
+
+	tegra_dc_ext_flip_fence_done(data);
+	tegra_dc_ext_flip_put(data);
+}
+
+/*
+ * The pre-fences did not signal in time: hand the flip to the worker,
+ * which waits out whatever is left of the timeout and shows it anyway,
+ * as the blocking wait in the worker used to do.
+ */
+static enum hrtimer_restart tegra_dc_ext_flip_fence_timeout(
+	struct hrtimer *timer)
+{
+	struct tegra_dc_ext_flip_data *data =
+		container_of(timer, struct tegra_dc_ext_flip_data, fence_timer);
+	struct tegra_dc_ext_win *win = data->queue_win;
+	unsigned long flags;
+
+	spin_lock_irqsave(&win->flip_lock, flags);
+	if (!data->ready)
+		tegra_dc_ext_flip_ready_locked(win, data);
+	spin_unlock_irqrestore(&win->flip_lock, flags);
+
+	kthread_queue_work(&win->flip_worker, &win->flip_work);
+	tegra_dc_ext_flip_put(data);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Arm a host1x notifier for one pre-fence point. Points that cannot be
+ * armed are left to the blocking wait in tegra_dc_ext_set_windowattr().
+ */
+static void tegra_dc_ext_flip_arm_pt(struct tegra_dc_ext_flip_data *data,
+				     u32 id, u32 thresh)
+{
+	struct platform_device *ndev = data->ext->dc->ndev;
+
+	if (nvhost_syncpt_is_expired_ext(ndev, id, thresh))
+		return;
+
+	atomic_inc(&data->fences_pending);
+	kref_get(&data->ref);
+	if (nvhost_intr_register_notifier(ndev, id, thresh,
+					  tegra_dc_ext_flip_fence_signaled,
+					  data)) {
+		atomic_dec(&data->fences_pending);
+		kref_put(&data->ref, tegra_dc_ext_flip_release);
+	}
+}
+
+static int tegra_dc_ext_flip_arm_fence_pt(
+	struct nvhost_ctrl_sync_fence_info info, void *priv)
+{
+	tegra_dc_ext_flip_arm_pt(priv, info.id, info.thresh);
+
+	return 0;
+}
+
+/*
+ * Queue @data on @win. The flip is handed to the worker from the fence
+ * notifiers once all its pre-fences have signaled, instead of the worker
+ * blocking on them in turn.
+ */
+static void tegra_dc_ext_queue_flip(struct tegra_dc_ext_win *win,
+				    struct tegra_dc_ext_flip_data *data)
+{
+	unsigned long flags;
+	int i;
+
+	data->queue_win = win;
+	atomic_set(&data->fences_pending, 1);
+	/* a concurrent flush may run the flip before arming is done */
+	kref_get(&data->ref);
+
+	/* dropped by the timer, or by the worker if it cancels the timer */
+	kref_get(&data->ref);
+	hrtimer_init(&data->fence_timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	data->fence_timer.function = tegra_dc_ext_flip_fence_timeout;
+	data->fence_deadline = ktime_add_ms(ktime_get(),
+					    TEGRA_DC_EXT_FENCE_TIMEOUT_MS);
+
+	/* started before the flip is visible to the worker, which cancels it */
+	hrtimer_start(&data->fence_timer, data->fence_deadline,
+		      HRTIMER_MODE_ABS);
+
+	spin_lock_irqsave(&win->flip_lock, flags);
+	list_add_tail(&data->queue_node, &win->flip_queue);
+	spin_unlock_irqrestore(&win->flip_lock, flags);
+
+	for (i = 0; i < data->act_window_num; i++) {
+		struct tegra_dc_ext_flip_win *flip_win = &data->win[i];
+
+		if (!(data->win_mask & BIT(flip_win->attr.index)))
+			continue;
+
+		if (flip_win->pre_syncpt_fence)
+			nvhost_fence_foreach_pt(flip_win->pre_syncpt_fence,
+						tegra_dc_ext_flip_arm_fence_pt,
+						data);
+		else if ((s32)flip_win->attr.pre_syncpt_id >= 0)
+			tegra_dc_ext_flip_arm_pt(data,
+						 flip_win->attr.pre_syncpt_id,
+						 flip_win->attr.pre_syncpt_val);
+	}
+
+	tegra_dc_ext_flip_fence_done(data);
+	tegra_dc_ext_flip_put(data);
+}
+
+static struct tegra_dc_ext_flip_data *tegra_dc_ext_dequeue_flip(
+	struct tegra_dc_ext_win *win)
+{
+	struct tegra_dc_ext_flip_data *data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&win->flip_lock, flags);
+	data = list_first_entry_or_null(&win->flip_queue,
+					struct tegra_dc_ext_flip_data,
+					queue_node);
+	if (data && data->ready) {
+		list_del(&data->queue_node);
+		/* late notifiers must no longer touch the queue */
+		atomic_inc(&data->fences_pending);
+	} else {
+		data = NULL;
+	}
+	spin_unlock_irqrestore(&win->flip_lock, flags);
+
+	/* Not under flip_lock: the timer callback takes it */
+	if (data && hrtimer_cancel(&data->fence_timer))
+		tegra_dc_ext_flip_put(data);
+
+	return data;
+}
+
+static void tegra_dc_ext_flip_worker(struct kthread_work *work)
+{
+	struct tegra_dc_ext_win *win =
+		container_of(work, struct tegra_dc_ext_win, flip_work);
+	struct tegra_dc_ext_flip_data *data;
+
+	while ((data = tegra_dc_ext_dequeue_flip(win)))
+		tegra_dc_ext_do_flip(data);
+}
+
+/*
+ * Run every queued flip of @win to completion. Flips whose pre-fences
+ * have not signaled yet are handed to the worker right away and wait
+ * there with the usual timeout.
+ */
+static void tegra_dc_ext_flush_flips(struct tegra_dc_ext_win *win)
+{
+	struct tegra_dc_ext_flip_data *data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&win->flip_lock, flags);
+	list_for_each_entry(data, &win->flip_queue, queue_node)
+		data->ready = true;
+	spin_unlock_irqrestore(&win->flip_lock, flags);
+
+	kthread_queue_work(&win->flip_worker, &win->flip_work);
+	kthread_flush_worker(&win->flip_worker);
+}
+
 static int lock_windows_for_flip(struct tegra_dc_ext_user *user,
 			struct tegra_dc_ext_flip_windowattr *win_attr,
 			int win_num)
@@ -1872,6 +2221,7 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 	int i, ret = 0;
 	bool has_timestamp = false;
 	u64 flip_id_local;
+	u64 ioctl_ns = ktime_get_ns();
 
 	/* If display has been disconnected return with error. */
 	if (!ext->dc->connected)
@@ -1884,9 +2234,10 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 	if (!data)
 		return -ENOMEM;
 
-	kthread_init_work(&data->work, &tegra_dc_ext_flip_worker);
+	kref_init(&data->ref);
 	data->ext = ext;
 	data->act_window_num = win_num;
+	data->ioctl_ns = ioctl_ns;
 
 	BUG_ON(win_num > tegra_dc_get_numof_dispwindows());
 
@@ -1895,6 +2246,7 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 				     syncpt_fd != NULL);
 	if (ret)
 		goto fail_pin;
+	data->pin_ns = ktime_get_ns();
 
 	ret = tegra_dc_ext_read_user_data(data, flip_user_data, nr_user_data);
 	if (ret)
@@ -1958,6 +2310,7 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 		post_sync_id = tegra_dc_get_syncpt_id(ext->dc, index);
 
 		work_index = index;
+		data->win_mask |= BIT(index);
 
 		atomic_inc(&ext->win[work_index].nr_pending_flips);
 	}
@@ -2026,7 +2379,7 @@ static int tegra_dc_ext_flip(struct tegra_dc_ext_user *user,
 		data->flip_buf_ele = in_q_ptr;
 	}
 
-	kthread_queue_work(&ext->win[work_index].flip_worker, &data->work);
+	tegra_dc_ext_queue_flip(&ext->win[work_index], data);
 
 	unlock_windows_for_flip(user, win, win_num);
 
@@ -2043,12 +2396,7 @@ fail_pin:
 			if (!data->win[i].handle[j])
 				continue;
 
-			dma_buf_unmap_attachment(data->win[i].handle[j]->attach,
-				data->win[i].handle[j]->sgt, DMA_TO_DEVICE);
-			dma_buf_detach(data->win[i].handle[j]->buf,
-				data->win[i].handle[j]->attach);
-			dma_buf_put(data->win[i].handle[j]->buf);
-			kfree(data->win[i].handle[j]);
+			tegra_dc_ext_put_dmabuf(data->win[i].handle[j]);
 		}
 
 		if (data->win[i].pre_syncpt_fence) {
@@ -3632,6 +3980,57 @@ free_and_ret:
 		return ret;
 	}
 
+	case TEGRA_DC_EXT_CRC_GET_RANGE:
+	{
+		struct tegra_dc_ext_crc_range_arg args;
+		struct tegra_dc_ext_crc_conf *conf;
+		struct tegra_dc_ext_crc_conf __user *user_conf;
+		struct tegra_dc *dc = user->ext->dc;
+		size_t sz;
+
+		if (copy_from_user(&args, user_arg, sizeof(args)))
+			return -EFAULT;
+
+		ret = tegra_dc_crc_sanitize_args(&args.crc);
+		if (ret)
+			return ret;
+
+		if (!args.num_flips ||
+		    args.num_flips > TEGRA_DC_EXT_CRC_RANGE_MAX_FLIPS ||
+		    args.crc.flip_id == U64_MAX)
+			return -EINVAL;
+
+		user_conf = (struct tegra_dc_ext_crc_conf *)args.crc.conf;
+		sz = sizeof(*conf) * args.crc.num_conf * args.num_flips;
+
+		conf = kzalloc(sz, GFP_KERNEL);
+		if (!conf)
+			return -ENOMEM;
+
+		if (copy_from_user(conf, user_conf, sz)) {
+			kfree(conf);
+			return -EFAULT;
+		}
+
+		args.crc.conf = (__u64)conf;
+
+		ret = tegra_dc_crc_get_range(dc, &args);
+		if (ret) {
+			kfree(conf);
+			return ret;
+		}
+
+		args.crc.conf = (__u64)user_conf;
+
+		if (copy_to_user(user_conf, conf, sz))
+			ret = -EFAULT;
+		else if (copy_to_user(user_arg, &args, sizeof(args)))
+			ret = -EFAULT;
+
+		kfree(conf);
+		return ret;
+	}
+
 	default:
 		return -EINVAL;
 	}
@@ -3649,6 +4048,7 @@ static int tegra_dc_open(struct inode *inode, struct file *filp)
 
 	ext = container_of(inode->i_cdev, struct tegra_dc_ext, cdev);
 	user->ext = ext;
+	tegra_dc_ext_pin_cache_init(user);
 
 	atomic_inc(&ext->users_count);
 
@@ -3691,6 +4091,7 @@ static int tegra_dc_release(struct inode *inode, struct file *filp)
 	if (ext->cursor.user == user)
 		tegra_dc_ext_put_cursor(user);
 
+	tegra_dc_ext_pin_cache_flush(user);
 	kfree(user);
 
 	open_count = atomic_dec_return(&dc_open_count);
@@ -3732,6 +4133,9 @@ static int tegra_dc_ext_setup_windows(struct tegra_dc_ext *ext)
 		snprintf(name, sizeof(name), "tegradc.%d/%c",
 			 ext->dc->ndev->id, 'a' + i);
 		kthread_init_worker(&win->flip_worker);
+		kthread_init_work(&win->flip_work, tegra_dc_ext_flip_worker);
+		spin_lock_init(&win->flip_lock);
+		INIT_LIST_HEAD(&win->flip_queue);
 		win->flip_kthread = kthread_run(&kthread_worker_fn,
 			&win->flip_worker, name);
 		if (!win->flip_kthread) {
@@ -3846,7 +4250,7 @@ void tegra_dc_ext_unregister(struct tegra_dc_ext *ext)
 	for (i = 0; i < ext->dc->n_windows; i++) {
 		struct tegra_dc_ext_win *win = &ext->win[i];
 
-		kthread_flush_worker(&win->flip_worker);
+		tegra_dc_ext_flush_flips(win);
 		kthread_stop(win->flip_kthread);
 	}
 
@@ -21,24 +21,47 @@
 
 #include <linux/cdev.h>
 #include <linux/dma-buf.h>
+#include <linux/kref.h>
 #include <linux/kthread.h>
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/poll.h>
+#include <linux/spinlock.h>
 #include <uapi/video/tegra_dc_ext.h>
 
 #include "../dc.h"
 
 struct tegra_dc_ext;
 
+/*
+ * Scanout buffers pinned by one user, kept mapped across flips. Entries are
+ * tegra_dc_dmabuf keyed by their dma_buf and ordered most recently used
+ * first.
+ */
+struct tegra_dc_ext_pin_cache {
+	struct mutex		lock;
+	struct list_head	lru;
+	unsigned int		count;
+};
+
 struct tegra_dc_ext_user {
 	struct tegra_dc_ext	*ext;
+
+	struct tegra_dc_ext_pin_cache	pin_cache;
 };
 
+/*
+ * One reference is held by each flip or cursor using the buffer and one by
+ * the pin cache while the buffer is listed there; the mapping is torn down
+ * when the last one is dropped with tegra_dc_ext_put_dmabuf().
+ */
 struct tegra_dc_dmabuf {
 	struct dma_buf *buf;
 	struct dma_buf_attachment *attach;
 	struct sg_table *sgt;
+	dma_addr_t phys_addr;
+	struct kref ref;
+	struct list_head lru;
 };
 
 enum {
@@ -64,6 +87,15 @@ struct tegra_dc_ext_win {
 	struct task_struct	*flip_kthread;
 	struct kthread_worker	flip_worker;
 
+	/*
+	 * Flips queued on this window's worker, in submission order. A flip
+	 * is handed to flip_work once its pre-fences have signaled and every
+	 * flip ahead of it has been taken.
+	 */
+	spinlock_t		flip_lock;
+	struct list_head	flip_queue;
+	struct kthread_work	flip_work;
+
 	atomic_t		nr_pending_flips;
 
 	struct mutex		queue_lock;
@@ -148,6 +180,9 @@ extern struct class *tegra_dc_ext_class;
 extern int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, s32 id,
 				   struct tegra_dc_dmabuf **handle,
 				   dma_addr_t *phys_addr);
+extern void tegra_dc_ext_put_dmabuf(struct tegra_dc_dmabuf *handle);
+extern void tegra_dc_ext_pin_cache_init(struct tegra_dc_ext_user *user);
+extern void tegra_dc_ext_pin_cache_flush(struct tegra_dc_ext_user *user);
 
 extern int tegra_dc_ext_cpy_caps_from_user(void __user *user_arg,
 				struct tegra_dc_ext_caps **caps_ptr,
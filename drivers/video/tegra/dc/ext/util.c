@@ -19,33 +19,138 @@
 #include <linux/err.h>
 #include <linux/types.h>
 #include <linux/dma-buf.h>
+#include <linux/fs.h>
 #include <linux/iommu.h>
+#include <linux/kref.h>
+#include <linux/module.h>
+#include <linux/version.h>
 
 #include "../dc.h"
 #include "../dc_priv.h"
 #include "tegra_dc_ext_priv.h"
 
-int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, s32 fd,
-			    struct tegra_dc_dmabuf **dc_buf,
-			    dma_addr_t *phys_addr)
+static unsigned int pin_cache_size = 8;
+module_param(pin_cache_size, uint, 0644);
+MODULE_PARM_DESC(pin_cache_size,
+	"Idle scanout buffers kept mapped per dc ext user, 0 disables caching");
+
+static inline unsigned int tegra_dc_dmabuf_refs(struct tegra_dc_dmabuf *handle)
+{
+#if LINUX_VERSION_CODE < KERNEL_VERSION(4, 11, 0)
+	return atomic_read(&handle->ref.refcount);
+#else
+	return kref_read(&handle->ref);
+#endif
+}
+
+static void tegra_dc_ext_release_dmabuf(struct kref *ref)
+{
+	struct tegra_dc_dmabuf *handle =
+		container_of(ref, struct tegra_dc_dmabuf, ref);
+
+	dma_buf_unmap_attachment(handle->attach, handle->sgt, DMA_TO_DEVICE);
+	dma_buf_detach(handle->buf, handle->attach);
+	dma_buf_put(handle->buf);
+	kfree(handle);
+}
+
+void tegra_dc_ext_put_dmabuf(struct tegra_dc_dmabuf *handle)
+{
+	kref_put(&handle->ref, tegra_dc_ext_release_dmabuf);
+}
+
+void tegra_dc_ext_pin_cache_init(struct tegra_dc_ext_user *user)
+{
+	struct tegra_dc_ext_pin_cache *cache = &user->pin_cache;
+
+	mutex_init(&cache->lock);
+	INIT_LIST_HEAD(&cache->lru);
+	cache->count = 0;
+}
+
+/*
+ * Move idle entries to @evict, least recently used first, until the cache
+ * is back within pin_cache_size. Entries whose dma_buf has no other owner
+ * left go regardless of the limit, so that buffers freed by the client are
+ * not kept alive by the cache. Called with the cache lock held.
+ */
+static void tegra_dc_ext_pin_cache_prune(struct tegra_dc_ext_pin_cache *cache,
+					 struct list_head *evict)
+{
+	struct tegra_dc_dmabuf *handle, *tmp;
+
+	list_for_each_entry_safe_reverse(handle, tmp, &cache->lru, lru) {
+		if (tegra_dc_dmabuf_refs(handle) > 1)
+			continue;
+
+		if (cache->count <= pin_cache_size &&
+		    file_count(handle->buf->file) > 1)
+			continue;
+
+		list_move(&handle->lru, evict);
+		cache->count--;
+	}
+}
+
+static void tegra_dc_ext_pin_cache_put_list(struct tegra_dc_ext *ext,
+					    struct list_head *evict)
+{
+	struct tegra_dc_dmabuf *handle, *tmp;
+
+	list_for_each_entry_safe(handle, tmp, evict, lru) {
+		list_del(&handle->lru);
+		tegra_dc_ext_put_dmabuf(handle);
+		atomic64_inc(&ext->dc->flip_stats.pin_cache_evictions);
+	}
+}
+
+/*
+ * Drop the cache reference of every entry. Buffers still on screen stay
+ * mapped until the flip or cursor holding them lets go.
+ */
+void tegra_dc_ext_pin_cache_flush(struct tegra_dc_ext_user *user)
+{
+	struct tegra_dc_ext_pin_cache *cache = &user->pin_cache;
+	LIST_HEAD(evict);
+
+	mutex_lock(&cache->lock);
+	list_splice_init(&cache->lru, &evict);
+	cache->count = 0;
+	mutex_unlock(&cache->lock);
+
+	tegra_dc_ext_pin_cache_put_list(user->ext, &evict);
+}
+
+static struct tegra_dc_dmabuf *tegra_dc_ext_pin_cache_get(
+	struct tegra_dc_ext_pin_cache *cache, struct dma_buf *buf)
+{
+	struct tegra_dc_dmabuf *handle;
+
+	list_for_each_entry(handle, &cache->lru, lru) {
+		if (handle->buf == buf) {
+			kref_get(&handle->ref);
+			list_move(&handle->lru, &cache->lru);
+			return handle;
+		}
+	}
+
+	return NULL;
+}
+
+static struct tegra_dc_dmabuf *tegra_dc_ext_map_dmabuf(
+	struct tegra_dc_ext *ext, struct dma_buf *buf)
 {
-	struct tegra_dc_ext *ext = user->ext;
 	struct tegra_dc_dmabuf *dc_dmabuf;
 	struct device *parent = ext->dev->parent;
 	dma_addr_t dma_addr;
 
-	*dc_buf = NULL;
-	*phys_addr = -1;
-	if (fd < 0)
-		return 0;
-
 	dc_dmabuf = kzalloc(sizeof(*dc_dmabuf), GFP_KERNEL);
 	if (!dc_dmabuf)
-		return -ENOMEM;
+		return NULL;
 
-	dc_dmabuf->buf = dma_buf_get(fd);
-	if (IS_ERR_OR_NULL(dc_dmabuf->buf))
-		goto buf_fail;
+	dc_dmabuf->buf = buf;
+	kref_init(&dc_dmabuf->ref);
+	INIT_LIST_HEAD(&dc_dmabuf->lru);
 
 	dc_dmabuf->attach = dma_buf_attach(dc_dmabuf->buf, parent);
 	if (IS_ERR_OR_NULL(dc_dmabuf->attach))
@@ -66,29 +171,89 @@ int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, s32 fd,
 				"Cannot use non-contiguous buffer w/ IOMMU disabled\n");
 			goto iommu_fail;
 		} else {
-			*phys_addr = sg_phys(dc_dmabuf->sgt->sgl);
+			dc_dmabuf->phys_addr = sg_phys(dc_dmabuf->sgt->sgl);
 		}
 	} else {
 		dma_addr = sg_dma_address(dc_dmabuf->sgt->sgl);
 		if (dma_addr)
-			*phys_addr = dma_addr;
+			dc_dmabuf->phys_addr = dma_addr;
 		else
-			*phys_addr = sg_phys(dc_dmabuf->sgt->sgl);
+			dc_dmabuf->phys_addr = sg_phys(dc_dmabuf->sgt->sgl);
 	}
 
-	*dc_buf = dc_dmabuf;
-
-	return 0;
+	return dc_dmabuf;
 iommu_fail:
 	dma_buf_unmap_attachment(dc_dmabuf->attach, dc_dmabuf->sgt,
 		DMA_TO_DEVICE);
 sgt_fail:
 	dma_buf_detach(dc_dmabuf->buf, dc_dmabuf->attach);
 attach_fail:
-	dma_buf_put(dc_dmabuf->buf);
-buf_fail:
 	kfree(dc_dmabuf);
-	return -ENOMEM;
+	return NULL;
+}
+
+/*
+ * Pin the dma_buf behind @fd for scanout. Buffers already mapped for this
+ * user are taken from its pin cache; the returned handle must be released
+ * with tegra_dc_ext_put_dmabuf().
+ *
+ * The exporters used for scanout map with DMA_ATTR_SKIP_CPU_SYNC, so a
+ * cached mapping needs no cache maintenance when it is reused.
+ */
+int tegra_dc_ext_pin_window(struct tegra_dc_ext_user *user, s32 fd,
+			    struct tegra_dc_dmabuf **dc_buf,
+			    dma_addr_t *phys_addr)
+{
+	struct tegra_dc_ext *ext = user->ext;
+	struct tegra_dc_ext_pin_cache *cache = &user->pin_cache;
+	struct tegra_dc_dmabuf *dc_dmabuf;
+	struct dma_buf *buf;
+	LIST_HEAD(evict);
+
+	*dc_buf = NULL;
+	*phys_addr = -1;
+	if (fd < 0)
+		return 0;
+
+	buf = dma_buf_get(fd);
+	if (IS_ERR_OR_NULL(buf))
+		return -ENOMEM;
+
+	mutex_lock(&cache->lock);
+	dc_dmabuf = tegra_dc_ext_pin_cache_get(cache, buf);
+	if (dc_dmabuf) {
+		/* the cache entry already holds a reference */
+		dma_buf_put(buf);
+		atomic64_inc(&ext->dc->flip_stats.pin_cache_hits);
+		goto prune;
+	}
+	mutex_unlock(&cache->lock);
+
+	atomic64_inc(&ext->dc->flip_stats.pin_cache_misses);
+
+	dc_dmabuf = tegra_dc_ext_map_dmabuf(ext, buf);
+	if (!dc_dmabuf) {
+		dma_buf_put(buf);
+		return -ENOMEM;
+	}
+
+	if (!pin_cache_size)
+		goto out;
+
+	mutex_lock(&cache->lock);
+	kref_get(&dc_dmabuf->ref);
+	list_add(&dc_dmabuf->lru, &cache->lru);
+	cache->count++;
+prune:
+	tegra_dc_ext_pin_cache_prune(cache, &evict);
+	mutex_unlock(&cache->lock);
+
+	tegra_dc_ext_pin_cache_put_list(ext, &evict);
+out:
+	*dc_buf = dc_dmabuf;
+	*phys_addr = dc_dmabuf->phys_addr;
+
+	return 0;
 }
 
 int tegra_dc_ext_cpy_caps_from_user(void __user *user_arg,
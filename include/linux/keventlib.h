@@ -24,6 +24,15 @@ keventlib_write(int id, void *data, size_t size, uint32_t type, uint64_t ts);
 
 int keventlib_register(size_t size, const char *name,
 		       const char *schema, size_t schema_size);
+
+/*
+ * Same as keventlib_register(), but the events are spread over per-CPU trace
+ * buffers, so keventlib_write() may be called concurrently from several CPUs
+ * without contending on a single buffer. Readers should use
+ * eventlib_read_merged() to get the events in timestamp order.
+ */
+int keventlib_register_multi_writer(size_t size, const char *name,
+				    const char *schema, size_t schema_size);
 void keventlib_unregister(int id);
 
 #endif  /* __KEVENTLIB_H */
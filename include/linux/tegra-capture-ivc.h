@@ -47,6 +47,22 @@ int tegra_capture_ivc_capture_submit(
 	const void *capture_desc,
 	size_t len);
 
+/**
+ * @brief Submit @a count capture messages of @a len bytes each, laid out
+ *	back to back in @a capture_descs, holding the capture channel writer
+ *	lock across the whole batch.
+ *
+ * @param[in]	capture_descs	array of capture message descriptors.
+ * @param[in]	len		size of one descriptor.
+ * @param[in]	count		number of descriptors.
+ *
+ * @returns	number of messages sent (> 0), neg. errno if none was sent
+ */
+int tegra_capture_ivc_capture_submit_batch(
+	const void *capture_descs,
+	size_t len,
+	unsigned int count);
+
 /**
  * @brief Callback function to be registered by client to receive the rtcpu
  *	notifications through control or capture IVC channel.
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2026, NVIDIA CORPORATION.  All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms and conditions of the GNU General Public License,
+ * version 2, as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+ * more details.
+ */
+
+#ifndef _LINUX_TEGRA_IVC_BULK_H
+#define _LINUX_TEGRA_IVC_BULK_H
+
+#include <linux/tegra-ivc.h>
+#include <linux/atomic.h>
+#include <linux/hrtimer.h>
+#include <linux/types.h>
+
+/* Upper bound for the doorbell deferral window */
+#define TEGRA_IVC_DOORBELL_MAX_WINDOW_US	10000U
+
+/*
+ * Coalesced notification of the remote end of an IVC channel.
+ *
+ * The bulk calls below ring the doorbell instead of calling ivc->notify()
+ * directly. With a zero window the peer is notified before the call
+ * returns, once per batch. With a non-zero window the notification is
+ * deferred by up to window_us so that batches issued back to back share a
+ * single notification; ivc->notify() is then called from hrtimer context
+ * and must not sleep.
+ *
+ * The doorbell is owned by the caller, which must serialize its bulk calls
+ * on one channel direction as for the single frame calls.
+ */
+struct tegra_ivc_doorbell {
+	struct ivc *ivc;
+	struct hrtimer timer;
+	ktime_t window;
+	atomic_t pending;
+	/* frames moved through bulk calls using this doorbell */
+	atomic64_t frames;
+	/* calls of ivc->notify(), and how many of them came from the timer */
+	atomic64_t notifications;
+	atomic64_t deferred;
+};
+
+struct tegra_ivc_doorbell_stats {
+	u64 frames;
+	u64 notifications;
+	u64 deferred;
+};
+
+void tegra_ivc_doorbell_init(struct tegra_ivc_doorbell *db, struct ivc *ivc,
+		unsigned window_us);
+void tegra_ivc_doorbell_flush(struct tegra_ivc_doorbell *db);
+void tegra_ivc_doorbell_stop(struct tegra_ivc_doorbell *db);
+void tegra_ivc_doorbell_get_stats(struct tegra_ivc_doorbell *db,
+		struct tegra_ivc_doorbell_stats *stats);
+
+/*
+ * Move up to count frames with a single counter update, barrier and
+ * notification. Frames are packed in buf with a stride of size (write) or
+ * max_read (read) bytes. Return the number of frames moved, or a negative
+ * error code as tegra_ivc_write()/tegra_ivc_read() when none could be.
+ * A NULL doorbell notifies the peer directly through ivc->notify().
+ */
+int tegra_ivc_write_bulk(struct ivc *ivc, const void *buf, size_t size,
+		unsigned count, struct tegra_ivc_doorbell *db);
+int tegra_ivc_read_bulk(struct ivc *ivc, void *buf, size_t max_read,
+		unsigned count, struct tegra_ivc_doorbell *db);
+
+#endif /* _LINUX_TEGRA_IVC_BULK_H */
@@ -23,6 +23,7 @@
 #define ERR_NOT_FOUND           (-2)
 
 struct tipc_chan;
+struct tipc_memref;
 
 struct tipc_msg_buf {
 	void *buf_va;
@@ -31,6 +32,8 @@ struct tipc_msg_buf {
 	size_t wpos;
 	size_t rpos;
 	struct list_head node;
+	/* pages referenced by a memref message, released with the buffer */
+	struct tipc_memref *memref;
 };
 
 enum tipc_chan_event {
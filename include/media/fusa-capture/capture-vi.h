@@ -205,6 +205,15 @@ struct vi_capture_req {
 		 */
 } __VI_CAPTURE_ALIGN;
 
+/**
+ * @brief VI capture request batch (IOCTL payload)
+ */
+struct vi_capture_req_batch {
+	uint64_t reqs; /**< User pointer to an array of @ref vi_capture_req */
+	uint32_t num_reqs; /**< No. of requests in the array */
+	uint32_t num_done; /**< [out] No. of requests submitted to RCE */
+} __VI_CAPTURE_ALIGN;
+
 /**
  * @brief VI capture progress status setup config (IOCTL payload)
  */
@@ -430,6 +439,23 @@ int vi_capture_request(
 	struct tegra_vi_channel *chan,
 	struct vi_capture_req *req);
 
+/**
+ * @brief Send a batch of capture requests via the capture IVC channel to RCE,
+ * holding the channel reset lock and the IVC writer once for the whole batch.
+ *
+ * This is a non-blocking call.
+ *
+ * @param[in]	chan	VI channel context
+ * @param[in]	reqs	VI capture requests
+ * @param[in]	num	No. of requests in @a reqs
+ *
+ * @returns	No. of requests sent (> 0), neg. errno (failure)
+ */
+int vi_capture_request_batch(
+	struct tegra_vi_channel *chan,
+	const struct vi_capture_req *reqs,
+	uint32_t num);
+
 /**
  * @brief Wait on receipt of the capture status of the head of the capture
  *	  request FIFO queue to RCE. The RCE VI driver sends a
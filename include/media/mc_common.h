@@ -45,6 +45,8 @@
 
 #define CAPTURE_MIN_BUFFERS	1U
 #define CAPTURE_MAX_BUFFERS	240U
+/* must be a power of two no smaller than CAPTURE_MAX_BUFFERS */
+#define CAPTURE_DEQUEUE_RING_SIZE	256U
 
 #define TEGRA_MEM_FORMAT 0
 #define TEGRA_ISP_FORMAT 1
@@ -133,6 +135,9 @@ struct tegra_vi_graph_entity {
  *
  * @capture: list of queued buffers for capture
  * @queued_lock: protects the buf_queued list
+ * @dequeue_ring: single-producer/single-consumer ring of buffers submitted
+ *                to the capture channel; @dequeue_head is only written by the
+ *                enqueue thread and @dequeue_tail only by the dequeue thread
  *
  * @csi: CSI register bases
  * @stride_align: channel buffer stride alignment, default is 1
@@ -203,10 +208,11 @@ struct tegra_channel {
 	bool init_done;
 	struct list_head capture;
 	struct list_head release;
-	struct list_head dequeue;
+	struct tegra_channel_buffer *dequeue_ring[CAPTURE_DEQUEUE_RING_SIZE];
+	unsigned int dequeue_head;
+	unsigned int dequeue_tail;
 	spinlock_t start_lock;
 	spinlock_t release_lock;
-	spinlock_t dequeue_lock;
 	struct work_struct status_work;
 	struct work_struct error_work;
 
@@ -394,6 +400,12 @@ void tegra_channel_ring_buffer(struct tegra_channel *chan,
 struct tegra_channel_buffer *dequeue_buffer(struct tegra_channel *chan,
 	bool requeue);
 struct tegra_channel_buffer *dequeue_dequeue_buffer(struct tegra_channel *chan);
+bool enqueue_dequeue_buffer(struct tegra_channel *chan,
+	struct tegra_channel_buffer *buf);
+static inline bool tegra_channel_dequeue_empty(struct tegra_channel *chan)
+{
+	return READ_ONCE(chan->dequeue_head) == READ_ONCE(chan->dequeue_tail);
+}
 int tegra_channel_error_recover(struct tegra_channel *chan, bool queue_error);
 int tegra_channel_alloc_buffer_queue(struct tegra_channel *chan,
 					unsigned int num_buffers);
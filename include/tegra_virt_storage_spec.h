@@ -54,6 +54,7 @@ enum blk_cmd_op {
 	VS_BLK_DISCARD = 4,
 	VS_BLK_SECURE_ERASE = 5,
 	VS_BLK_IOCTL = 6,
+	VS_BLK_DISCARD_RANGES = 7,
 	VS_BLK_INVAL_REQ = 32,
 	VS_UNKNOWN_BLK_CMD = 0xffffffff,
 };
@@ -65,6 +66,7 @@ enum blk_cmd_op {
 #define VS_BLK_DISCARD_OP_F       (1 << VS_BLK_DISCARD)
 #define VS_BLK_SECURE_ERASE_OP_F  (1 << VS_BLK_SECURE_ERASE)
 #define VS_BLK_IOCTL_OP_F         (1 << VS_BLK_IOCTL)
+#define VS_BLK_DISCARD_RANGES_OP_F (1 << VS_BLK_DISCARD_RANGES)
 #define VS_BLK_READ_ONLY_MASK     ~(VS_BLK_READ_OP_F)
 
 #pragma pack(push)
@@ -76,11 +78,46 @@ struct vs_blk_request {
 	uint32_t num_blks;		/* Total Block number to transfer */
 	uint32_t data_offset;		/* Offset into mempool for data region
 						*/
-	/* IOVA address of the buffer. In case of read request, VSC will get
-	 * the response to this address. In case of write request, VSC will
-	 * get the data from this address.
-	 */
-	uint64_t iova_addr;
+	union {
+		/* IOVA address of the buffer. In case of read request, VSC
+		 * will get the response to this address. In case of write
+		 * request, VSC will get the data from this address.
+		 */
+		uint64_t iova_addr;
+		/* Used when VS_BLK_VM_ADDR_SGL is negotiated. If non zero,
+		 * data_offset points to num_sg_ents vs_blk_sg_entry records
+		 * in the mempool describing the buffer. If zero, the data
+		 * itself is in the mempool at data_offset.
+		 */
+		struct {
+			uint32_t num_sg_ents;
+			uint32_t sg_reserved;
+		};
+		/* VS_BLK_DISCARD_RANGES: data_offset points to num_ranges
+		 * vs_blk_range records in the mempool. blk_offset is the
+		 * first range and num_blks the total over all ranges.
+		 */
+		struct {
+			uint32_t num_ranges;
+			uint32_t range_reserved;
+		};
+	};
+};
+
+struct vs_blk_range {
+	uint64_t blk_offset;		/* Offset in blocks */
+	uint32_t num_blks;		/* Number of blocks */
+	uint32_t reserved;
+};
+
+/* Buffer segment lives in the mempool, addr is a mempool offset */
+#define VS_BLK_SG_F_MEMPOOL	(1U << 0)
+
+struct vs_blk_sg_entry {
+	uint64_t addr;			/* IOVA, or mempool offset with
+						VS_BLK_SG_F_MEMPOOL */
+	uint32_t len;			/* Segment length in bytes */
+	uint32_t flags;			/* VS_BLK_SG_F_* */
 };
 
 struct vs_mtd_request {
@@ -156,13 +193,20 @@ struct vs_blk_dev_config {
 	uint64_t num_blks;		/* Total number of blks */
 
 	/*
-	 * If true, then VM need to provide local IOVA address for read and
-	 * write requests. For IOCTL requests, mempool will be used
+	 * If VS_BLK_VM_ADDR_IOVA is set, then VM need to provide local IOVA
+	 * address for read and write requests. If VS_BLK_VM_ADDR_SGL is
+	 * set, VM may describe read and write buffers with a scatter list
+	 * of IOVA and mempool segments; this takes precedence over
+	 * VS_BLK_VM_ADDR_IOVA. For IOCTL requests, mempool will be used
 	 * irrespective of this flag.
 	 */
 	uint32_t use_vm_address;
 };
 
+/* use_vm_address capability bits */
+#define VS_BLK_VM_ADDR_IOVA	(1U << 0)
+#define VS_BLK_VM_ADDR_SGL	(1U << 1)
+
 struct vs_mtd_dev_config {
 	uint32_t max_read_bytes_per_io;	/* Limit number of bytes
 						per I/O */
@@ -321,6 +321,29 @@ TRACE_EVENT(scanout_vrr_stats,
 		__entry->syncpt_val_value,__entry->db_val_value)
 );
 
+TRACE_EVENT(flip_latency,
+	TP_PROTO(u32 ctrl_num, int win, u64 pin_ns, u64 fence_ns,
+		 u64 latch_ns),
+	TP_ARGS(ctrl_num, win, pin_ns, fence_ns, latch_ns),
+	TP_STRUCT__entry(
+		__field(u32, ctrl_num)
+		__field(int, win)
+		__field(u64, pin_ns)
+		__field(u64, fence_ns)
+		__field(u64, latch_ns)
+	),
+	TP_fast_assign(
+		__entry->ctrl_num = ctrl_num;
+		__entry->win = win;
+		__entry->pin_ns = pin_ns;
+		__entry->fence_ns = fence_ns;
+		__entry->latch_ns = latch_ns;
+	),
+	TP_printk("ctrl_num=%u win=%d ioctl_to_pin=%llu pin_to_fence=%llu fence_to_latch=%llu",
+		__entry->ctrl_num, __entry->win, __entry->pin_ns,
+		__entry->fence_ns, __entry->latch_ns)
+);
+
 TRACE_EVENT(dc_flip_dropped,
 	TP_PROTO(bool dc_enabled, bool flip_skipped),
 	TP_ARGS(dc_enabled, flip_skipped),
@@ -294,7 +294,19 @@ enum {
 	/* struct nv_camera_task_log */
 	NVHOST_CAMERA_TASK_LOG = 35,
 
-	NVHOST_NUM_EVENT_TYPES = 36
+	/* struct nv_camera_task_log, frame submitted by the VI enqueue thread */
+	NVHOST_CAMERA_VI_FRAME_ENQUEUE = 36,
+
+	/* struct nv_camera_task_log, start of frame reported by RCE */
+	NVHOST_CAMERA_VI_FRAME_SOF = 37,
+
+	/* struct nv_camera_task_log, end of frame reported by RCE */
+	NVHOST_CAMERA_VI_FRAME_EOF = 38,
+
+	/* struct nv_camera_task_log, frame returned to videobuf2 */
+	NVHOST_CAMERA_VI_FRAME_DONE = 39,
+
+	NVHOST_NUM_EVENT_TYPES = 40
 };
 
 enum {
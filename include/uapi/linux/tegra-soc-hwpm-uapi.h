@@ -287,6 +287,53 @@ struct tegra_soc_hwpm_update_get_put {
 	__u8 b_overflowed;
 };
 
+/*
+ * TEGRA_CTRL_CMD_SOC_HWPM_STREAM_NOTIFY IOCTL
+ *
+ * Arms PMA stream readiness notification. The driver samples MEM_HEAD every
+ * period_us and signals readiness when at least watermark_bytes are
+ * available after the SW get pointer, or when the stream buffer overflows.
+ * Readiness is reported through poll() (POLLIN, POLLPRI on overflow) and,
+ * if TEGRA_SOC_HWPM_STREAM_NOTIFY_EVENTFD is set in flags, by signaling
+ * eventfd. Without the flag, eventfd is ignored.
+ *
+ * With the default watermark of half the stream buffer, userspace can
+ * consume one half directly from its own mapping of the stream dma_buf
+ * while PMA fills the other half, then release it with UPDATE_GET_PUT.
+ */
+struct tegra_soc_hwpm_stream_notify {
+	/*
+	 * Inputs
+	 */
+	__u64 watermark_bytes;	/* 0: half of stream buffer */
+	__u32 period_us;	/* 0: disarm notification */
+	__s32 eventfd;		/* used with STREAM_NOTIFY_EVENTFD only */
+	__u32 flags;		/* TEGRA_SOC_HWPM_STREAM_NOTIFY_* */
+	__u32 reserved;		/* must be 0 */
+};
+
+#define TEGRA_SOC_HWPM_STREAM_NOTIFY_EVENTFD	(1U << 0)
+
+/* TEGRA_CTRL_CMD_SOC_HWPM_STREAM_STATUS IOCTL */
+struct tegra_soc_hwpm_stream_status {
+	/*
+	 * Outputs
+	 */
+	__u64 mem_head;		/* HW put offset */
+	__u64 mem_get;		/* SW get offset */
+	__u64 bytes_available;	/* Unconsumed bytes */
+	__u64 bytes_streamed;	/* Bytes written by PMA */
+	__u64 bytes_consumed;	/* Bytes released by UPDATE_GET_PUT */
+	__u64 notify_count;	/* Readiness notifications sent */
+	/*
+	 * PMA drops records while the stream buffer is overflowed.
+	 * There is no HW drop counter, so drops are accounted as number of
+	 * overflows and time spent overflowed.
+	 */
+	__u64 overflow_count;
+	__u64 overflow_ns;
+};
+
 /* IOCTL enum */
 enum tegra_soc_hwpm_ioctl_num {
 	TEGRA_SOC_HWPM_IOCTL_DEVICE_INFO,
@@ -298,6 +345,8 @@ enum tegra_soc_hwpm_ioctl_num {
 	TEGRA_SOC_HWPM_IOCTL_QUERY_ALLOWLIST,
 	TEGRA_SOC_HWPM_IOCTL_EXEC_REG_OPS,
 	TEGRA_SOC_HWPM_IOCTL_UPDATE_GET_PUT,
+	TEGRA_SOC_HWPM_IOCTL_STREAM_NOTIFY,
+	TEGRA_SOC_HWPM_IOCTL_STREAM_STATUS,
 	TERGA_SOC_HWPM_NUM_IOCTLS
 };
 
@@ -402,6 +451,26 @@ enum tegra_soc_hwpm_ioctl_num {
 				TEGRA_SOC_HWPM_IOCTL_UPDATE_GET_PUT,	\
 				struct tegra_soc_hwpm_update_get_put)
 
+/*
+ * IOCTL for arming PMA stream readiness notification
+ *
+ * This IOCTL can only be called after the BIND IOCTL
+ */
+#define	TEGRA_CTRL_CMD_SOC_HWPM_STREAM_NOTIFY				\
+			_IOW(TEGRA_SOC_HWPM_IOC_MAGIC,			\
+				TEGRA_SOC_HWPM_IOCTL_STREAM_NOTIFY,	\
+				struct tegra_soc_hwpm_stream_notify)
+
+/*
+ * IOCTL for reading PMA stream occupancy and drop accounting
+ *
+ * This IOCTL can only be called after the BIND IOCTL
+ */
+#define	TEGRA_CTRL_CMD_SOC_HWPM_STREAM_STATUS				\
+			_IOR(TEGRA_SOC_HWPM_IOC_MAGIC,			\
+				TEGRA_SOC_HWPM_IOCTL_STREAM_STATUS,	\
+				struct tegra_soc_hwpm_stream_status)
+
 
 /* Interface for IP driver communication */
 
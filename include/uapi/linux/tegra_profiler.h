@@ -20,8 +20,8 @@
 #include <linux/ioctl.h>
 #include <linux/types.h>
 
-#define QUADD_SAMPLES_VERSION	51
-#define QUADD_IO_VERSION	30
+#define QUADD_SAMPLES_VERSION	52
+#define QUADD_IO_VERSION	31
 
 #define QUADD_IO_VERSION_DYNAMIC_RB		5
 #define QUADD_IO_VERSION_RB_MAX_FILL_COUNT	6
@@ -49,6 +49,7 @@
 #define QUADD_IO_VERSION_UNCORE_EVENTS		28
 #define QUADD_IO_VERSION_EVENT_FILTER		29
 #define QUADD_IO_VERSION_CPUS_UINT		30
+#define QUADD_IO_VERSION_CC_DELTA		31
 
 #define QUADD_SAMPLE_VERSION_THUMB_MODE_FLAG	17
 #define QUADD_SAMPLE_VERSION_GROUP_SAMPLES	18
@@ -83,6 +84,7 @@
 #define QUADD_SAMPLE_VERSION_SEQID		49
 #define QUADD_SAMPLE_VERSION_EVENT_FILTER	50
 #define QUADD_SAMPLE_VERSION_CPUS_UINT		51
+#define QUADD_SAMPLE_VERSION_CC_DELTA		52
 
 #define QUADD_MMAP_HEADER_VERSION	1
 
@@ -259,6 +261,19 @@ enum {
 #define QUADD_SAMPLE_FLAG_URCS		(1 << 7)
 #define QUADD_SAMPLE_FLAG_IP64		(1 << 8)
 #define QUADD_SAMPLE_FLAG_UNCORE	(1 << 9)
+#define QUADD_SAMPLE_FLAG_CC_DELTA	(1 << 10)
+
+/*
+ * QUADD_SAMPLE_FLAG_CC_DELTA: the callchain addresses are replaced by
+ *   __u8 nr_common: number of outermost frames equal to the outermost frames
+ *                   of the previous delta sample in the same ring buffer;
+ *   (callchain_nr - nr_common) innermost frames, each one stored as
+ *                   zigzag LEB128 of the difference to the previous frame
+ *                   (the first one is relative to sample->ip);
+ *   zero padding up to a multiple of 4 bytes.
+ * The unwind types are stored for all callchain_nr frames, as usual.
+ */
+#define QUADD_CC_DELTA_ALIGN		4
 
 struct quadd_sample_data {
 	__u64 ip;
@@ -379,6 +394,7 @@ struct quadd_comm_data {
 #define QUADD_HDR_FLAG_EXCLUDE_USER	(1ULL << 20)
 #define QUADD_HDR_FLAG_EXCLUDE_KERNEL	(1ULL << 21)
 #define QUADD_HDR_FLAG_EXCLUDE_HV	(1ULL << 22)
+#define QUADD_HDR_FLAG_CC_DELTA		(1ULL << 23)
 
 struct quadd_header_data {
 	__u16 magic;
@@ -448,6 +464,7 @@ enum {
 #define QUADD_PARAM_EXTRA_EXCLUDE_USER		(1 << 17)
 #define QUADD_PARAM_EXTRA_EXCLUDE_KERNEL	(1 << 18)
 #define QUADD_PARAM_EXTRA_EXCLUDE_HV		(1 << 19)
+#define QUADD_PARAM_EXTRA_CC_DELTA		(1 << 20)
 
 enum {
 	QUADD_EVENT_TYPE_RAW			= 0,
@@ -531,6 +548,7 @@ enum {
 #define QUADD_COMM_CAP_EXTRA_CPU_MASK		(1 << 10)
 #define QUADD_COMM_CAP_EXTRA_ARCH_TIMER_USR	(1 << 11)
 #define QUADD_COMM_CAP_EXTRA_CPUFREQ		(1 << 12)
+#define QUADD_COMM_CAP_EXTRA_CC_DELTA		(1 << 13)
 
 struct quadd_comm_cap {
 	__u32	pmu:1,
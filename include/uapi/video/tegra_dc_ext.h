@@ -173,6 +173,11 @@
 /*Passthrough condition for running 4K HDMI*/
 #define TEGRA_DC_EXT_FLIP_HEAD_FLAG_YUVBYPASS	(1 << 0)
 #define TEGRA_DC_EXT_FLIP_HEAD_FLAG_VRR_MODE	(1 << 1)
+/*
+ * Latest-wins flip: once this flip's pre-fences signal, earlier flips of
+ * the same windows that have not been latched yet are skipped.
+ */
+#define TEGRA_DC_EXT_FLIP_HEAD_FLAG_MAILBOX	(1 << 2)
 /* Flag for HDR_DATA handling */
 #define TEGRA_DC_EXT_FLIP_FLAG_HDR_ENABLE	(1 << 0)
 #define TEGRA_DC_EXT_FLIP_FLAG_HDR_DATA_UPDATED (1 << 1)
@@ -1657,11 +1662,32 @@ struct tegra_dc_ext_scanline_info {
  *           or it was programmed a long time ago, such that the corresponding
  *           CRCs are dropped from the kernel CRC buffer, or
  *           if arg.flip_id is set to U64_MAX, but no flips have been
- *           programmed
+ *           programmed, or
+ *           if a later flip has already been matched with a frame while
+ *           this one never was, e.g. a cursor mode flip
  */
 #define TEGRA_DC_EXT_CRC_GET \
 	_IOWR('D', 0x28, struct tegra_dc_ext_crc_arg)
 
+/* Retrieve the CRCs for a range of consecutive flip IDs in a single call, see
+ * struct tegra_dc_ext_crc_range_arg. The call blocks until the last flip of
+ * the range has been matched with a frame. Flips of the range that never got
+ * a frame of their own are reported with every crc.valid cleared.
+ *
+ * Returns
+ * -EINVAL   Same conditions as mentioned for TEGRA_DC_EXT_CRC_ENABLE, or
+ *           if arg.num_flips is 0 or above TEGRA_DC_EXT_CRC_RANGE_MAX_FLIPS, or
+ *           if arg.crc.flip_id is U64_MAX
+ * -ENODEV   Same conditions as mentioned for TEGRA_DC_EXT_CRC_ENABLE
+ * -EPERM    Same conditions as mentioned for TEGRA_DC_EXT_CRC_DISABLE
+ * -ENOTSUPP if the arg.crc.conf.type is not supported
+ * -ETIME    if wait for the next Frame End Interrupt timed out
+ * -ENODATA  if either end of the range is out of the bounds described for
+ *           TEGRA_DC_EXT_CRC_GET
+ */
+#define TEGRA_DC_EXT_CRC_GET_RANGE \
+	_IOWR('D', 0x29, struct tegra_dc_ext_crc_range_arg)
+
 enum tegra_dc_ext_control_output_type {
 	TEGRA_DC_EXT_DSI,
 	TEGRA_DC_EXT_LVDS,
@@ -1949,6 +1975,25 @@ struct tegra_dc_ext_crc_arg {
 	__u8 reserved[32]; /* unused - must be 0 */
 } __attribute__((__packed__));
 
+#define TEGRA_DC_EXT_CRC_RANGE_MAX_FLIPS	64
+
+/*
+ * tegra_dc_ext_crc_range_arg - The argument to CRC GET RANGE IOCTL
+ * @crc         - As for the GET IOCTL, with @crc.flip_id the first flip of
+ *                the range. @crc.conf points to @num_flips groups of
+ *                @crc.num_conf configurations; group i is filled in like the
+ *                @conf array of the GET IOCTL, for flip @crc.flip_id + i
+ * @num_flips   - Number of consecutive flip IDs in the range
+ * @num_matched - Output. Number of flips of the range that had CRCs
+ * @reserved    - Easier way to extend the data structure
+ */
+struct tegra_dc_ext_crc_range_arg {
+	struct tegra_dc_ext_crc_arg crc;
+	__u32 num_flips;
+	__u32 num_matched;
+	__u8 reserved[16]; /* unused - must be 0 */
+} __attribute__((__packed__));
+
 #define TEGRA_DC_EXT_CONTROL_GET_NUM_OUTPUTS \
 	_IOR('C', 0x00, __u32)
 #define TEGRA_DC_EXT_CONTROL_GET_OUTPUT_PROPERTIES \
@@ -1976,7 +1976,7 @@ static int tegra_ivc_start_playback(
 
 
 	if (ack_required)
-		err = nvaudio_ivc_send_receive(adsp->hivc_client,
+		err = nvaudio_ivc_send_receive_atomic(adsp->hivc_client,
 					&msg,
 					sizeof(struct nvaudio_ivc_msg));
 	else
@@ -2000,7 +2000,7 @@ static int tegra_ivc_start_capture(
 	msg.params.dmaif_info.id = ivc_msg_admaif_id;
 
 	if (ack_required)
-		err = nvaudio_ivc_send_receive(adsp->hivc_client,
+		err = nvaudio_ivc_send_receive_atomic(adsp->hivc_client,
 					&msg,
 					sizeof(struct nvaudio_ivc_msg));
 	else
@@ -2024,7 +2024,7 @@ static int tegra_ivc_stop_playback(
 	msg.ack_required = ack_required;
 
 	if (ack_required)
-		err = nvaudio_ivc_send_receive(adsp->hivc_client,
+		err = nvaudio_ivc_send_receive_atomic(adsp->hivc_client,
 					&msg,
 					sizeof(struct nvaudio_ivc_msg));
 	else
@@ -2048,7 +2048,7 @@ static int tegra_ivc_stop_capture(
 	msg.ack_required = ack_required;
 
 	if (ack_required)
-		err = nvaudio_ivc_send_receive(adsp->hivc_client,
+		err = nvaudio_ivc_send_receive_atomic(adsp->hivc_client,
 					&msg,
 					sizeof(struct nvaudio_ivc_msg));
 	else
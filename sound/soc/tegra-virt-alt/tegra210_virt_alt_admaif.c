@@ -132,7 +132,7 @@ static void tegra210_admaif_start_playback(struct snd_soc_dai *dai)
 	msg.cmd = NVAUDIO_START_PLAYBACK;
 	msg.params.dmaif_info.id = dai->id;
 	msg.ack_required = true;
-	err = nvaudio_ivc_send_receive(data->hivc_client,
+	err = nvaudio_ivc_send_receive_atomic(data->hivc_client,
 			&msg, sizeof(struct nvaudio_ivc_msg));
 
 	if (err < 0)
@@ -151,7 +151,7 @@ static void tegra210_admaif_stop_playback(struct snd_soc_dai *dai)
 	msg.params.dmaif_info.id = dai->id;
 
 	msg.ack_required = true;
-	err = nvaudio_ivc_send_receive(data->hivc_client,
+	err = nvaudio_ivc_send_receive_atomic(data->hivc_client,
 			&msg, sizeof(struct nvaudio_ivc_msg));
 
 	if (err < 0)
@@ -170,7 +170,7 @@ static void tegra210_admaif_start_capture(struct snd_soc_dai *dai)
 	msg.params.dmaif_info.id = dai->id;
 
 	msg.ack_required = true;
-	err = nvaudio_ivc_send_receive(data->hivc_client,
+	err = nvaudio_ivc_send_receive_atomic(data->hivc_client,
 			&msg, sizeof(struct nvaudio_ivc_msg));
 
 	if (err < 0)
@@ -189,7 +189,7 @@ static void tegra210_admaif_stop_capture(struct snd_soc_dai *dai)
 	msg.params.dmaif_info.id = dai->id;
 
 	msg.ack_required = true;
-	err = nvaudio_ivc_send_receive(data->hivc_client,
+	err = nvaudio_ivc_send_receive_atomic(data->hivc_client,
 			&msg, sizeof(struct nvaudio_ivc_msg));
 	if (err < 0)
 		pr_err("%s: error on ivc_send\n", __func__);
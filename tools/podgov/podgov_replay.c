@@ -0,0 +1,529 @@
+/*
+ * podgov_replay - replay recorded device load through
+ * drivers/devfreq/governor_pod_scaling_v2.c on a host and compare policy
+ * settings.
+ *
+ * Copyright (c) 2026, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * A trace holds one devfreq sample per line, "<total_us> <busy_us>", as
+ * recorded with the device clocked at the recording frequency. Comment lines
+ * start with '#'. The busy time is turned into work in cycles, which the
+ * simulated device then serves at whatever frequency the governor picks.
+ * Work that does not fit in a sample is carried over as backlog, so a slow
+ * ramp shows up as late samples. Without a trace a synthetic one is used:
+ * light load broken by bursts near full load, such as VIC or NVDEC.
+ *
+ * For each policy the report gives:
+ *	ttm	time from the start of a burst to reaching the maximum frequency
+ *	missed	bursts that ended before the maximum was reached
+ *	energy	integral of (f / fmax)^3 over time, in % of running at fmax
+ *	late	samples that ended with work left over
+ *	backlog	largest leftover work, in ms at fmax
+ *	ns/est	host cost of one governor estimate
+ *
+ * A policy is a comma separated list of governor tunables, named as the
+ * debugfs files of the governor (block_window, load_max, load_target, bias,
+ * damp, smooth, burst). The default policies are the defaults and burst=1.
+ *
+ * Example Usage:
+ *	podgov_replay
+ *	podgov_replay -t vic.trace -r 1036 -P "" -P burst=1 -P block_window=0
+ *	podgov_replay -P burst=1 -v > burst.csv
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "governor.h"
+
+#define MAX_FREQS	32
+#define MAX_TUNABLES	16
+#define MAX_POLICIES	16
+
+struct sample {
+	unsigned long total_us;
+	unsigned long busy_us;
+};
+
+struct trace {
+	struct sample *samples;
+	size_t count;
+	size_t size;
+};
+
+struct tunable {
+	const char *name;
+	u32 *value;
+};
+
+struct result {
+	double ttm_sum_ms;
+	double ttm_max_ms;
+	unsigned reached;
+	unsigned missed;
+	double energy;
+	unsigned late;
+	double backlog_max_ms;
+	double est_ns;
+};
+
+struct options {
+	unsigned long freqs[MAX_FREQS];
+	unsigned nfreqs;
+	double rec_hz;
+	double burst_load;
+	unsigned long period_us;
+	const char *policies[MAX_POLICIES];
+	unsigned npolicies;
+	bool verbose;
+};
+
+ktime_t shim_now;
+
+static struct devfreq_governor *governor;
+static struct tunable tunables[MAX_TUNABLES];
+static unsigned ntunables;
+static struct dentry debugfs_dir;
+
+static struct {
+	struct platform_device pdev;
+	struct devfreq df;
+	struct devfreq_dev_profile profile;
+	struct devfreq_dev_status status;
+	unsigned long freq;
+} sim;
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* devfreq core, debugfs and PM QoS as seen by the governor */
+
+int devfreq_add_governor(struct devfreq_governor *gov)
+{
+	governor = gov;
+	return 0;
+}
+
+int devfreq_remove_governor(struct devfreq_governor *gov)
+{
+	governor = NULL;
+	return 0;
+}
+
+void devfreq_monitor_start(struct devfreq *devfreq)
+{
+}
+
+void devfreq_monitor_stop(struct devfreq *devfreq)
+{
+}
+
+void devfreq_monitor_suspend(struct devfreq *devfreq)
+{
+}
+
+void devfreq_monitor_resume(struct devfreq *devfreq)
+{
+}
+
+void devfreq_update_interval(struct devfreq *devfreq, unsigned int *delay)
+{
+}
+
+int devfreq_update_stats(struct devfreq *df)
+{
+	return df->profile->get_dev_status(df->dev.parent, &df->last_status);
+}
+
+/* lowest table frequency at or above freq, as devfreq_set_target() does */
+static unsigned long table_ceil(unsigned long freq)
+{
+	unsigned i;
+
+	for (i = 0; i < sim.profile.max_state - 1; i++)
+		if (sim.profile.freq_table[i] >= freq)
+			break;
+	return sim.profile.freq_table[i];
+}
+
+int update_devfreq(struct devfreq *df)
+{
+	unsigned long freq;
+	int err;
+
+	err = governor->get_target_freq(df, &freq);
+	if (err)
+		return err < 0 ? err : 0;
+
+	sim.freq = table_ceil(freq);
+	df->previous_freq = sim.freq;
+	return 0;
+}
+
+s32 dev_pm_qos_read_value(struct device *dev, enum dev_pm_qos_req_type type)
+{
+	unsigned long hz = type == DEV_PM_QOS_MIN_FREQUENCY ?
+		sim.profile.freq_table[0] :
+		sim.profile.freq_table[sim.profile.max_state - 1];
+
+	return hz / 1000;
+}
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent)
+{
+	return &debugfs_dir;
+}
+
+void shim_debugfs_create_u32(const char *name, mode_t mode,
+		struct dentry *parent, u32 *value)
+{
+	if (ntunables == MAX_TUNABLES) {
+		fprintf(stderr, "too many tunables\n");
+		exit(1);
+	}
+	tunables[ntunables].name = name;
+	tunables[ntunables].value = value;
+	ntunables++;
+}
+
+static int get_dev_status(struct device *dev, struct devfreq_dev_status *stat)
+{
+	*stat = sim.status;
+	return 0;
+}
+
+/* traces */
+
+static void trace_add(struct trace *t, unsigned long total_us,
+		unsigned long busy_us)
+{
+	if (t->count == t->size) {
+		t->size = t->size ? 2 * t->size : 1024;
+		t->samples = realloc(t->samples, t->size * sizeof(*t->samples));
+		if (!t->samples) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	t->samples[t->count].total_us = total_us;
+	t->samples[t->count].busy_us = busy_us > total_us ? total_us : busy_us;
+	t->count++;
+}
+
+static int trace_load(struct trace *t, const char *path)
+{
+	unsigned long total_us, busy_us;
+	char line[256];
+	unsigned lineno = 0;
+	FILE *f;
+
+	f = strcmp(path, "-") ? fopen(path, "r") : stdin;
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		char *p = line + strspn(line, " \t");
+
+		lineno++;
+		if (*p == '#' || *p == '\n' || !*p)
+			continue;
+		if (sscanf(p, "%lu %lu", &total_us, &busy_us) != 2 ||
+		    !total_us) {
+			fprintf(stderr, "%s:%u: expected <total_us> <busy_us>\n",
+				path, lineno);
+			return -1;
+		}
+		trace_add(t, total_us, busy_us);
+	}
+
+	if (f != stdin)
+		fclose(f);
+	return t->count ? 0 : -1;
+}
+
+/* light load broken by four bursts near full load */
+static void trace_synthetic(struct trace *t, unsigned long period_us)
+{
+	unsigned burst, i;
+
+	for (burst = 0; burst < 4; burst++) {
+		for (i = 0; i < 60; i++)
+			trace_add(t, period_us, period_us * 15 / 100);
+		for (i = 0; i < 30; i++)
+			trace_add(t, period_us, period_us * 95 / 100);
+	}
+	for (i = 0; i < 60; i++)
+		trace_add(t, period_us, period_us * 15 / 100);
+}
+
+/* policies */
+
+static int policy_apply(const char *spec)
+{
+	char buf[256], *tok, *save = NULL, *eq;
+	unsigned i;
+
+	snprintf(buf, sizeof(buf), "%s", spec);
+	for (tok = strtok_r(buf, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		eq = strchr(tok, '=');
+		if (!eq) {
+			fprintf(stderr, "policy: expected name=value: %s\n",
+				tok);
+			return -1;
+		}
+		*eq = '\0';
+		for (i = 0; i < ntunables; i++)
+			if (!strcmp(tunables[i].name, tok))
+				break;
+		if (i == ntunables) {
+			fprintf(stderr, "policy: unknown tunable %s\n", tok);
+			return -1;
+		}
+		*tunables[i].value = strtoul(eq + 1, NULL, 0);
+	}
+	return 0;
+}
+
+static int replay(const struct trace *t, const struct options *opt,
+		const char *policy, struct result *r)
+{
+	unsigned long fmax = opt->freqs[opt->nfreqs - 1];
+	double backlog = 0, elapsed_us = 0, burst_start_us = 0;
+	bool in_burst = false, tracking = false;
+	uint64_t est_ns = 0;
+	size_t i;
+	int err;
+
+	memset(r, 0, sizeof(*r));
+	memset(&sim, 0, sizeof(sim));
+	ntunables = 0;
+	shim_now = 0;
+
+	sim.pdev.name = "replay";
+	sim.df.dev.parent = &sim.pdev.dev;
+	sim.profile.freq_table = (unsigned long *)opt->freqs;
+	sim.profile.max_state = opt->nfreqs;
+	sim.profile.get_dev_status = get_dev_status;
+	sim.df.profile = &sim.profile;
+	sim.freq = opt->freqs[0];
+	sim.df.previous_freq = sim.freq;
+
+	err = governor->event_handler(&sim.df, DEVFREQ_GOV_START, NULL);
+	if (err) {
+		fprintf(stderr, "governor start failed: %d\n", err);
+		return err;
+	}
+
+	err = policy_apply(policy);
+	if (err)
+		goto out;
+
+	for (i = 0; i < t->count; i++) {
+		const struct sample *s = &t->samples[i];
+		double load = (double)s->busy_us / s->total_us;
+		double capacity = (double)sim.freq * s->total_us / 1e6;
+		double demand = backlog + opt->rec_hz * s->busy_us / 1e6;
+		double served = demand < capacity ? demand : capacity;
+		double ratio = (double)sim.freq / fmax;
+		uint64_t start;
+
+		if (load >= opt->burst_load && !in_burst) {
+			in_burst = true;
+			tracking = sim.freq != fmax;
+			burst_start_us = elapsed_us;
+		} else if (load < opt->burst_load && in_burst) {
+			in_burst = false;
+			if (tracking)
+				r->missed++;
+			tracking = false;
+		}
+
+		backlog = demand - served;
+		if (backlog > 0.5)
+			r->late++;
+		if (backlog / fmax * 1e3 > r->backlog_max_ms)
+			r->backlog_max_ms = backlog / fmax * 1e3;
+		r->energy += ratio * ratio * ratio * s->total_us;
+
+		shim_now += (ktime_t)s->total_us * 1000;
+		elapsed_us += s->total_us;
+
+		sim.status.total_time = s->total_us;
+		sim.status.busy_time = (unsigned long)(served / sim.freq * 1e6);
+		sim.status.current_frequency = sim.freq;
+
+		start = now_ns();
+		update_devfreq(&sim.df);
+		est_ns += now_ns() - start;
+
+		if (tracking && sim.freq == fmax) {
+			double ms = (elapsed_us - burst_start_us) / 1e3;
+
+			r->ttm_sum_ms += ms;
+			if (ms > r->ttm_max_ms)
+				r->ttm_max_ms = ms;
+			r->reached++;
+			tracking = false;
+		}
+
+		if (opt->verbose)
+			printf("%s,%.3f,%.3f,%.1f,%.3f\n",
+			       *policy ? policy : "default",
+			       elapsed_us / 1e3, load, sim.freq / 1e6,
+			       backlog / fmax * 1e3);
+	}
+	if (tracking)
+		r->missed++;
+
+	r->energy = 100.0 * r->energy / elapsed_us;
+	r->est_ns = (double)est_ns / t->count;
+
+out:
+	governor->event_handler(&sim.df, DEVFREQ_GOV_STOP, NULL);
+	return err;
+}
+
+static int parse_freqs(struct options *opt, const char *list)
+{
+	char buf[512], *tok, *save = NULL;
+
+	snprintf(buf, sizeof(buf), "%s", list);
+	opt->nfreqs = 0;
+	for (tok = strtok_r(buf, ",", &save); tok;
+	     tok = strtok_r(NULL, ",", &save)) {
+		if (opt->nfreqs == MAX_FREQS)
+			return -1;
+		opt->freqs[opt->nfreqs] = strtod(tok, NULL) * 1e6;
+		if (opt->nfreqs &&
+		    opt->freqs[opt->nfreqs] <= opt->freqs[opt->nfreqs - 1])
+			return -1;
+		opt->nfreqs++;
+	}
+	return opt->nfreqs ? 0 : -1;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-t trace] [-f MHz,MHz,...] [-r MHz] [-p period_us]\n"
+		"       [-b burst_load] [-P policy]... [-v]\n"
+		"  -t  trace of \"<total_us> <busy_us>\" lines, - for stdin\n"
+		"  -f  ascending frequency table (default 115.2 .. 1036.8)\n"
+		"  -r  frequency the trace was recorded at (default max)\n"
+		"  -p  sample period of the synthetic trace (default 16000)\n"
+		"  -b  load that marks a burst (default 0.9)\n"
+		"  -P  comma separated tunable=value list, may be repeated\n"
+		"  -v  print time_ms,load,freq_mhz,backlog_ms per sample\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	struct options opt = {
+		.burst_load = 0.9,
+		.period_us = 16000,
+	};
+	const char *trace_path = NULL;
+	struct trace t = { 0 };
+	struct result r;
+	unsigned i;
+	int c;
+
+	parse_freqs(&opt, "115.2,230.4,345.6,460.8,576,691.2,806.4,921.6,1036.8");
+
+	while ((c = getopt(argc, argv, "t:f:r:p:b:P:vh")) != -1) {
+		switch (c) {
+		case 't':
+			trace_path = optarg;
+			break;
+		case 'f':
+			if (parse_freqs(&opt, optarg)) {
+				fprintf(stderr, "bad frequency table\n");
+				return 1;
+			}
+			break;
+		case 'r':
+			opt.rec_hz = strtod(optarg, NULL) * 1e6;
+			break;
+		case 'p':
+			opt.period_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			opt.burst_load = strtod(optarg, NULL);
+			break;
+		case 'P':
+			if (opt.npolicies == MAX_POLICIES) {
+				fprintf(stderr, "too many policies\n");
+				return 1;
+			}
+			opt.policies[opt.npolicies++] = optarg;
+			break;
+		case 'v':
+			opt.verbose = true;
+			break;
+		default:
+			usage(argv[0]);
+			return c == 'h' ? 0 : 1;
+		}
+	}
+
+	if (!governor) {
+		fprintf(stderr, "governor did not register\n");
+		return 1;
+	}
+
+	if (!opt.rec_hz)
+		opt.rec_hz = opt.freqs[opt.nfreqs - 1];
+	if (!opt.npolicies) {
+		opt.policies[opt.npolicies++] = "";
+		opt.policies[opt.npolicies++] = "burst=1";
+	}
+
+	if (trace_path) {
+		if (trace_load(&t, trace_path))
+			return 1;
+	} else {
+		if (!opt.period_us) {
+			fprintf(stderr, "bad sample period\n");
+			return 1;
+		}
+		trace_synthetic(&t, opt.period_us);
+	}
+
+	if (!opt.verbose)
+		printf("%-24s %8s %8s %6s %8s %6s %10s %8s\n", "policy",
+		       "ttm ms", "max ms", "missed", "energy%", "late",
+		       "backlog ms", "ns/est");
+
+	for (i = 0; i < opt.npolicies; i++) {
+		if (replay(&t, &opt, opt.policies[i], &r))
+			return 1;
+		if (opt.verbose)
+			continue;
+		printf("%-24s %8.1f %8.1f %6u %8.1f %6u %10.2f %8.0f\n",
+		       *opt.policies[i] ? opt.policies[i] : "default",
+		       r.reached ? r.ttm_sum_ms / r.reached : 0.0,
+		       r.ttm_max_ms, r.missed, r.energy, r.late,
+		       r.backlog_max_ms, r.est_ns);
+	}
+
+	free(t.samples);
+	return 0;
+}
@@ -0,0 +1,36 @@
+/*
+ * Userspace stand-in for drivers/devfreq/governor.h, see podgov_shim.h.
+ */
+
+#ifndef _SHIM_GOVERNOR_H
+#define _SHIM_GOVERNOR_H
+
+#include "podgov_shim.h"
+
+#define DEVFREQ_GOV_START			0x1
+#define DEVFREQ_GOV_STOP			0x2
+#define DEVFREQ_GOV_UPDATE_INTERVAL		0x3
+#define DEVFREQ_GOV_SUSPEND			0x4
+#define DEVFREQ_GOV_RESUME			0x5
+
+#define DEVFREQ_MIN_FREQ			0
+#define DEVFREQ_MAX_FREQ			ULONG_MAX
+
+struct devfreq_governor {
+	const char *name;
+	int (*get_target_freq)(struct devfreq *this, unsigned long *freq);
+	int (*event_handler)(struct devfreq *devfreq,
+			     unsigned int event, void *data);
+};
+
+void devfreq_monitor_start(struct devfreq *devfreq);
+void devfreq_monitor_stop(struct devfreq *devfreq);
+void devfreq_monitor_suspend(struct devfreq *devfreq);
+void devfreq_monitor_resume(struct devfreq *devfreq);
+void devfreq_update_interval(struct devfreq *devfreq, unsigned int *delay);
+int update_devfreq(struct devfreq *devfreq);
+int devfreq_update_stats(struct devfreq *df);
+int devfreq_add_governor(struct devfreq_governor *governor);
+int devfreq_remove_governor(struct devfreq_governor *governor);
+
+#endif /* _SHIM_GOVERNOR_H */
@@ -0,0 +1,10 @@
+/*
+ * Userspace stand-in for the kernel header of the same name, see podgov_shim.h.
+ */
+
+#ifndef _SHIM_LINUX_DEVFREQ_H
+#define _SHIM_LINUX_DEVFREQ_H
+
+#include "../podgov_shim.h"
+
+#endif
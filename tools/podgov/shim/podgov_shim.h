@@ -0,0 +1,223 @@
+/*
+ * podgov_shim.h - minimal kernel environment for building
+ * governor_pod_scaling_v2.c in userspace.
+ *
+ * Copyright (c) 2026, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * Only what drivers/devfreq/governor_pod_scaling_v2.c uses is provided, for
+ * the non-module (PM QoS) build. The harness is single threaded, so locks are
+ * no-ops; time is the simulated clock of the replay. Functions of the devfreq
+ * core, debugfs and PM QoS are implemented by podgov_replay.c.
+ */
+
+#ifndef _PODGOV_SHIM_H
+#define _PODGOV_SHIM_H
+
+#include <errno.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#define CONFIG_DEBUG_FS 1
+
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t s32;
+typedef int64_t s64;
+typedef s64 ktime_t;
+
+#define __init
+#define __exit
+#define EXPORT_SYMBOL(sym)
+#define MODULE_LICENSE(lic)
+
+/* run the governor registration before main(), as the initcall would */
+#define rootfs_initcall(fn) \
+	static void __attribute__((constructor)) __initcall_##fn(void) \
+	{ fn(); }
+#define module_exit(fn) \
+	static void (*__exitcall_##fn)(void) __attribute__((unused)) = fn
+
+#define pr_err(fmt, ...)	fprintf(stderr, fmt, ##__VA_ARGS__)
+#define dev_err(dev, fmt, ...) \
+	do { (void)(dev); fprintf(stderr, fmt, ##__VA_ARGS__); } while (0)
+
+#define lockdep_assert_held(l)	do { } while (0)
+
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define max(a, b)		((a) > (b) ? (a) : (b))
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define PAGE_SIZE		4096
+#ifndef S_IRUGO
+#define S_IRUGO			(S_IRUSR | S_IRGRP | S_IROTH)
+#endif
+
+static inline u64 div_u64(u64 dividend, u32 divisor)
+{
+	return dividend / divisor;
+}
+
+/* memory */
+#define GFP_KERNEL		0
+
+static inline void *kzalloc(size_t size, int flags)
+{
+	return calloc(1, size ? size : 1);
+}
+
+static inline void kfree(const void *p)
+{
+	free((void *)p);
+}
+
+/* locking */
+struct mutex {
+	int unused;
+};
+
+#define mutex_init(m)		do { } while (0)
+#define mutex_lock(m)		do { } while (0)
+#define mutex_unlock(m)		do { } while (0)
+
+/* time: the replay clock, in nanoseconds */
+extern ktime_t shim_now;
+
+static inline ktime_t ktime_get(void)
+{
+	return shim_now;
+}
+
+static inline s64 ktime_us_delta(ktime_t later, ktime_t earlier)
+{
+	return (later - earlier) / 1000;
+}
+
+/* devices and sysfs */
+struct kobject {
+	int unused;
+};
+
+struct device {
+	struct device *parent;
+	struct kobject kobj;
+};
+
+struct platform_device {
+	const char *name;
+	struct device dev;
+};
+
+#define to_platform_device(d)	container_of((d), struct platform_device, dev)
+
+struct attribute {
+	const char *name;
+	mode_t mode;
+};
+
+struct kobj_attribute {
+	struct attribute attr;
+	ssize_t (*show)(struct kobject *kobj, struct kobj_attribute *attr,
+			char *buf);
+	ssize_t (*store)(struct kobject *kobj, struct kobj_attribute *attr,
+			 const char *buf, size_t count);
+};
+
+#define sysfs_attr_init(a)	do { } while (0)
+
+static inline int sysfs_create_file(struct kobject *kobj,
+		const struct attribute *attr)
+{
+	return 0;
+}
+
+static inline void sysfs_remove_file(struct kobject *kobj,
+		const struct attribute *attr)
+{
+}
+
+static inline int kstrtoul(const char *s, unsigned int base,
+		unsigned long *res)
+{
+	char *end;
+
+	*res = strtoul(s, &end, base);
+	return end == s ? -22 : 0;
+}
+
+/* runtime PM: the replayed device is always powered */
+#define pm_runtime_get_noresume(dev)	((void)(dev))
+#define pm_runtime_put(dev)		((void)(dev))
+#define pm_runtime_active(dev)		((void)(dev), 1)
+
+/* PM QoS frequency limits, in kHz */
+enum dev_pm_qos_req_type {
+	DEV_PM_QOS_MIN_FREQUENCY,
+	DEV_PM_QOS_MAX_FREQUENCY,
+};
+
+s32 dev_pm_qos_read_value(struct device *dev, enum dev_pm_qos_req_type type);
+
+/* debugfs: u32 files are recorded so the harness can set tunables by name */
+struct dentry {
+	int unused;
+};
+
+struct dentry *debugfs_create_dir(const char *name, struct dentry *parent);
+void shim_debugfs_create_u32(const char *name, mode_t mode,
+		struct dentry *parent, u32 *value);
+#define debugfs_create_u32(name, mode, parent, value) \
+	shim_debugfs_create_u32(name, mode, parent, (u32 *)(value))
+
+static inline void debugfs_remove_recursive(struct dentry *dentry)
+{
+}
+
+/* devfreq */
+struct devfreq_dev_status {
+	unsigned long total_time;
+	unsigned long busy_time;
+	unsigned long current_frequency;
+	void *private_data;
+};
+
+struct devfreq_dev_profile {
+	unsigned long initial_freq;
+	unsigned int polling_ms;
+	int (*get_dev_status)(struct device *dev,
+			      struct devfreq_dev_status *stat);
+	unsigned long *freq_table;
+	unsigned int max_state;
+};
+
+struct devfreq {
+	struct mutex lock;
+	struct device dev;
+	struct devfreq_dev_profile *profile;
+	unsigned long previous_freq;
+	struct devfreq_dev_status last_status;
+	void *data;
+};
+
+/* no tracing on the host */
+#define trace_podgov_enabled(...)		do { } while (0)
+#define trace_podgov_set_user_ctl(...)		do { } while (0)
+#define trace_podgov_set_freq_request(...)	do { } while (0)
+#define trace_podgov_load(...)			do { } while (0)
+#define trace_podgov_busy(...)			do { } while (0)
+#define trace_podgov_scaling_state_check(...)	do { } while (0)
+#define trace_podgov_estimate_freq(...)		do { } while (0)
+
+#endif /* _PODGOV_SHIM_H */
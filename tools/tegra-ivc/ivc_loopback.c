@@ -0,0 +1,812 @@
+/*
+ * ivc_loopback - run drivers/platform/tegra/tegra-ivc.c between two peers
+ * in one process, for benchmarking and fuzzing the IVC protocol on a host.
+ *
+ * Copyright (c) 2026, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * The two peers live on threads and share one anonymous mapping holding
+ * both queues; a notification is a condition variable signal. See the
+ * Makefile for the build and ivc_shim.h for the kernel environment.
+ *
+ * Example Usage:
+ *	ivc_loopback bench -s 256 -n 64 -c 1000000 -b 16 -w 20
+ *	ivc_loopback sweep
+ *	ivc_loopback latency -s 64 -n 16 -c 100000
+ *	ivc_loopback fuzz -i 1000000 -r 1 -x
+ *	ivc_loopback bench -s 4096 -n 16 -g 800	(exit 1 below 800 MB/s)
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <linux/tegra-ivc.h>
+#include <linux/tegra-ivc-bulk.h>
+
+#define MAX_BATCH	256
+
+struct peer {
+	struct ivc ivc;
+	struct peer *remote;
+	struct tegra_ivc_doorbell db;
+	bool use_db;
+
+	pthread_mutex_t lock;
+	pthread_cond_t cond;
+	/* bumped by every notification from the remote end */
+	uint64_t doorbell;
+	uint64_t notifies;
+	/* fuzz mode: notifications are queued instead of signalled */
+	bool pending;
+};
+
+struct loopback {
+	struct peer a, b;
+	void *area;
+	size_t area_size;
+	unsigned frame_size;
+	unsigned nframes;
+	volatile bool stop;
+};
+
+struct options {
+	unsigned frame_size;
+	unsigned nframes;
+	uint64_t count;
+	unsigned batch;
+	unsigned window_us;
+	double gate_mbps;
+	uint64_t iterations;
+	unsigned seed;
+	bool corrupt;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void peer_notify(struct ivc *ivc)
+{
+	struct peer *self = container_of(ivc, struct peer, ivc);
+	struct peer *remote = self->remote;
+
+	__atomic_fetch_add(&self->notifies, 1, __ATOMIC_RELAXED);
+
+	pthread_mutex_lock(&remote->lock);
+	remote->doorbell++;
+	remote->pending = true;
+	pthread_cond_signal(&remote->cond);
+	pthread_mutex_unlock(&remote->lock);
+}
+
+static uint64_t peer_doorbell(struct peer *p)
+{
+	uint64_t seen;
+
+	pthread_mutex_lock(&p->lock);
+	seen = p->doorbell;
+	pthread_mutex_unlock(&p->lock);
+	return seen;
+}
+
+/* sleep until the remote end notifies after @seen was sampled */
+static void peer_wait(struct loopback *lb, struct peer *p, uint64_t seen)
+{
+	struct timespec ts;
+
+	pthread_mutex_lock(&p->lock);
+	while (p->doorbell == seen && !lb->stop) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_nsec += 10000000;
+		if (ts.tv_nsec >= 1000000000) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000;
+		}
+		pthread_cond_timedwait(&p->cond, &p->lock, &ts);
+	}
+	pthread_mutex_unlock(&p->lock);
+}
+
+static int loopback_init(struct loopback *lb, unsigned frame_size,
+		unsigned nframes, unsigned window_us)
+{
+	unsigned qsize;
+	uintptr_t q0, q1;
+	int ret;
+
+	memset(lb, 0, sizeof(*lb));
+	lb->frame_size = frame_size;
+	lb->nframes = nframes;
+
+	if (!frame_size || frame_size != tegra_ivc_align(frame_size)) {
+		fprintf(stderr, "frame size %u must be a multiple of %u\n",
+			frame_size, IVC_ALIGN);
+		return -EINVAL;
+	}
+	qsize = tegra_ivc_total_queue_size(frame_size * nframes);
+
+	lb->area_size = 2 * (size_t)qsize;
+	lb->area = mmap(NULL, lb->area_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (lb->area == MAP_FAILED)
+		return -errno;
+
+	q0 = (uintptr_t)lb->area;
+	q1 = q0 + qsize;
+
+	ret = tegra_ivc_init(&lb->a.ivc, q1, q0, nframes, frame_size, NULL,
+			peer_notify);
+	if (!ret)
+		ret = tegra_ivc_init(&lb->b.ivc, q0, q1, nframes, frame_size,
+				NULL, peer_notify);
+	if (ret) {
+		munmap(lb->area, lb->area_size);
+		return ret;
+	}
+
+	lb->a.remote = &lb->b;
+	lb->b.remote = &lb->a;
+	pthread_mutex_init(&lb->a.lock, NULL);
+	pthread_mutex_init(&lb->b.lock, NULL);
+	pthread_cond_init(&lb->a.cond, NULL);
+	pthread_cond_init(&lb->b.cond, NULL);
+	tegra_ivc_doorbell_init(&lb->a.db, &lb->a.ivc, window_us);
+	tegra_ivc_doorbell_init(&lb->b.db, &lb->b.ivc, window_us);
+
+	return 0;
+}
+
+static void loopback_free(struct loopback *lb)
+{
+	tegra_ivc_doorbell_stop(&lb->a.db);
+	tegra_ivc_doorbell_stop(&lb->b.db);
+	munmap(lb->area, lb->area_size);
+}
+
+/* run the reset handshake on one peer until it reaches ESTABLISHED */
+static void peer_establish(struct loopback *lb, struct peer *p)
+{
+	uint64_t seen = peer_doorbell(p);
+
+	tegra_ivc_channel_reset(&p->ivc);
+	while (tegra_ivc_channel_notified(&p->ivc)) {
+		peer_wait(lb, p, seen);
+		seen = peer_doorbell(p);
+	}
+}
+
+struct worker {
+	struct loopback *lb;
+	struct peer *p;
+	const struct options *opt;
+	uint64_t errors;
+	uint64_t *rtt;
+};
+
+static void *handshake_worker(void *data)
+{
+	struct worker *w = data;
+
+	peer_establish(w->lb, w->p);
+	return NULL;
+}
+
+static void loopback_connect(struct loopback *lb)
+{
+	struct worker wa = { .lb = lb, .p = &lb->a };
+	struct worker wb = { .lb = lb, .p = &lb->b };
+	pthread_t ta, tb;
+
+	pthread_create(&ta, NULL, handshake_worker, &wa);
+	pthread_create(&tb, NULL, handshake_worker, &wb);
+	pthread_join(ta, NULL);
+	pthread_join(tb, NULL);
+	lb->a.notifies = 0;
+	lb->b.notifies = 0;
+}
+
+static void frame_fill(uint8_t *frame, unsigned size, uint64_t seq)
+{
+	unsigned i;
+
+	memcpy(frame, &seq, sizeof(seq));
+	for (i = sizeof(seq); i < size; i++)
+		frame[i] = (uint8_t)(seq + i);
+}
+
+static bool frame_check(const uint8_t *frame, unsigned size, uint64_t seq)
+{
+	uint64_t got;
+	unsigned i;
+
+	memcpy(&got, frame, sizeof(got));
+	if (got != seq)
+		return false;
+	for (i = sizeof(seq); i < size; i++)
+		if (frame[i] != (uint8_t)(seq + i))
+			return false;
+	return true;
+}
+
+static void *bench_writer(void *data)
+{
+	struct worker *w = data;
+	struct ivc *ivc = &w->p->ivc;
+	unsigned size = w->lb->frame_size;
+	unsigned batch = w->opt->batch;
+	uint8_t *buf = malloc((size_t)size * batch);
+	uint64_t seq = 0;
+
+	while (seq < w->opt->count && !w->lb->stop) {
+		uint64_t seen = peer_doorbell(w->p);
+		unsigned n = batch;
+		unsigned i;
+		int ret;
+
+		if (w->opt->count - seq < n)
+			n = w->opt->count - seq;
+		for (i = 0; i < n; i++)
+			frame_fill(buf + (size_t)i * size, size, seq + i);
+
+		if (batch > 1)
+			ret = tegra_ivc_write_bulk(ivc, buf, size, n,
+					w->p->use_db ? &w->p->db : NULL);
+		else if ((ret = tegra_ivc_write(ivc, buf, size)) >= 0)
+			ret = 1;
+
+		if (ret > 0) {
+			seq += ret;
+			continue;
+		}
+		if (ret != -ENOMEM) {
+			w->errors++;
+			break;
+		}
+		/* the doorbell may still hold frames the reader needs */
+		if (w->p->use_db)
+			tegra_ivc_doorbell_flush(&w->p->db);
+		peer_wait(w->lb, w->p, seen);
+	}
+	if (w->p->use_db)
+		tegra_ivc_doorbell_stop(&w->p->db);
+	free(buf);
+	return NULL;
+}
+
+static void *bench_reader(void *data)
+{
+	struct worker *w = data;
+	struct ivc *ivc = &w->p->ivc;
+	unsigned size = w->lb->frame_size;
+	unsigned batch = w->opt->batch;
+	uint8_t *buf = malloc((size_t)size * batch);
+	uint64_t seq = 0;
+
+	while (seq < w->opt->count && !w->lb->stop) {
+		uint64_t seen = peer_doorbell(w->p);
+		int ret, i;
+
+		if (batch > 1)
+			ret = tegra_ivc_read_bulk(ivc, buf, size, batch,
+					w->p->use_db ? &w->p->db : NULL);
+		else if ((ret = tegra_ivc_read(ivc, buf, size)) >= 0)
+			ret = 1;
+
+		if (ret == -ENOMEM) {
+			if (w->p->use_db)
+				tegra_ivc_doorbell_flush(&w->p->db);
+			peer_wait(w->lb, w->p, seen);
+			continue;
+		}
+		if (ret < 0) {
+			w->errors++;
+			break;
+		}
+		for (i = 0; i < ret; i++, seq++) {
+			if (!frame_check(buf + (size_t)i * size, size, seq)) {
+				fprintf(stderr, "corrupt frame %" PRIu64 "\n",
+					seq);
+				w->errors++;
+				w->lb->stop = true;
+				break;
+			}
+		}
+	}
+	if (w->p->use_db)
+		tegra_ivc_doorbell_stop(&w->p->db);
+	free(buf);
+	return NULL;
+}
+
+struct bench_result {
+	double mbps;
+	double fps;
+	double frames_per_notify;
+	uint64_t errors;
+};
+
+static int run_bench(const struct options *opt, struct bench_result *res)
+{
+	struct loopback lb;
+	struct worker ww, wr;
+	pthread_t tw, tr;
+	uint64_t start, elapsed, notifies;
+	int ret;
+
+	ret = loopback_init(&lb, opt->frame_size, opt->nframes, opt->window_us);
+	if (ret)
+		return ret;
+	lb.a.use_db = lb.b.use_db = opt->batch > 1;
+	loopback_connect(&lb);
+
+	ww = (struct worker){ .lb = &lb, .p = &lb.a, .opt = opt };
+	wr = (struct worker){ .lb = &lb, .p = &lb.b, .opt = opt };
+
+	start = now_ns();
+	pthread_create(&tr, NULL, bench_reader, &wr);
+	pthread_create(&tw, NULL, bench_writer, &ww);
+	pthread_join(tw, NULL);
+	pthread_join(tr, NULL);
+	elapsed = now_ns() - start;
+
+	notifies = lb.a.notifies + lb.b.notifies;
+	res->errors = ww.errors + wr.errors;
+	res->fps = opt->count * 1e9 / elapsed;
+	res->mbps = res->fps * opt->frame_size / 1e6;
+	res->frames_per_notify = notifies ? (double)opt->count / notifies : 0;
+
+	loopback_free(&lb);
+	return 0;
+}
+
+static void print_bench_header(void)
+{
+	printf("%8s %8s %6s %8s %12s %10s %12s\n", "size", "nframes",
+	       "batch", "win_us", "frames/s", "MB/s", "frames/ntfy");
+}
+
+static void print_bench(const struct options *opt,
+		const struct bench_result *res)
+{
+	printf("%8u %8u %6u %8u %12.0f %10.1f %12.2f%s\n", opt->frame_size,
+	       opt->nframes, opt->batch, opt->window_us, res->fps, res->mbps,
+	       res->frames_per_notify, res->errors ? "  ERRORS" : "");
+}
+
+static int cmd_bench(const struct options *opt)
+{
+	struct bench_result res;
+	int ret;
+
+	ret = run_bench(opt, &res);
+	if (ret) {
+		fprintf(stderr, "bench setup failed: %d\n", ret);
+		return 2;
+	}
+	print_bench_header();
+	print_bench(opt, &res);
+
+	if (res.errors)
+		return 1;
+	if (opt->gate_mbps > 0 && res.mbps < opt->gate_mbps) {
+		fprintf(stderr, "gate: %.1f MB/s below %.1f MB/s\n",
+			res.mbps, opt->gate_mbps);
+		return 1;
+	}
+	return 0;
+}
+
+static int cmd_sweep(const struct options *base)
+{
+	static const unsigned sizes[] = { 64, 256, 1024, 4096 };
+	static const unsigned depths[] = { 4, 16, 64, 256 };
+	static const unsigned batches[] = { 1, 16 };
+	struct options opt = *base;
+	struct bench_result res;
+	unsigned i, j, k;
+	int status = 0;
+
+	print_bench_header();
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		for (j = 0; j < sizeof(depths) / sizeof(depths[0]); j++) {
+			for (k = 0; k < sizeof(batches) / sizeof(batches[0]); k++) {
+				opt.frame_size = sizes[i];
+				opt.nframes = depths[j];
+				opt.batch = batches[k] < depths[j] ?
+					batches[k] : depths[j];
+				if (run_bench(&opt, &res))
+					return 2;
+				print_bench(&opt, &res);
+				if (res.errors)
+					status = 1;
+			}
+		}
+	}
+	return status;
+}
+
+static void *latency_echo(void *data)
+{
+	struct worker *w = data;
+	struct ivc *ivc = &w->p->ivc;
+	unsigned size = w->lb->frame_size;
+	uint8_t *buf = malloc(size);
+	uint64_t n;
+
+	for (n = 0; n < w->opt->count && !w->lb->stop; ) {
+		uint64_t seen = peer_doorbell(w->p);
+
+		if (tegra_ivc_read(ivc, buf, size) < 0) {
+			peer_wait(w->lb, w->p, seen);
+			continue;
+		}
+		/* the queue cannot be full: one frame is in flight */
+		if (tegra_ivc_write(ivc, buf, size) < 0)
+			w->errors++;
+		n++;
+	}
+	free(buf);
+	return NULL;
+}
+
+static void *latency_ping(void *data)
+{
+	struct worker *w = data;
+	struct ivc *ivc = &w->p->ivc;
+	unsigned size = w->lb->frame_size;
+	uint8_t *buf = malloc(size);
+	uint64_t n;
+
+	for (n = 0; n < w->opt->count && !w->lb->stop; n++) {
+		uint64_t start = now_ns();
+
+		frame_fill(buf, size, n);
+		if (tegra_ivc_write(ivc, buf, size) < 0) {
+			w->errors++;
+			break;
+		}
+		for (;;) {
+			uint64_t seen = peer_doorbell(w->p);
+
+			if (tegra_ivc_read(ivc, buf, size) >= 0)
+				break;
+			peer_wait(w->lb, w->p, seen);
+		}
+		w->rtt[n] = now_ns() - start;
+		if (!frame_check(buf, size, n))
+			w->errors++;
+	}
+	free(buf);
+	return NULL;
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int cmd_latency(const struct options *opt)
+{
+	struct loopback lb;
+	struct worker wp, we;
+	pthread_t tp, te;
+	uint64_t *rtt;
+	int ret;
+
+	rtt = calloc(opt->count, sizeof(*rtt));
+	if (!rtt)
+		return 2;
+	ret = loopback_init(&lb, opt->frame_size, opt->nframes, 0);
+	if (ret) {
+		free(rtt);
+		return 2;
+	}
+	loopback_connect(&lb);
+
+	wp = (struct worker){ .lb = &lb, .p = &lb.a, .opt = opt, .rtt = rtt };
+	we = (struct worker){ .lb = &lb, .p = &lb.b, .opt = opt };
+	pthread_create(&te, NULL, latency_echo, &we);
+	pthread_create(&tp, NULL, latency_ping, &wp);
+	pthread_join(tp, NULL);
+	lb.stop = true;
+	pthread_join(te, NULL);
+
+	qsort(rtt, opt->count, sizeof(*rtt), cmp_u64);
+	printf("%8s %8s %10s %10s %10s %10s\n", "size", "nframes",
+	       "p50_us", "p99_us", "p999_us", "max_us");
+	printf("%8u %8u %10.2f %10.2f %10.2f %10.2f%s\n", opt->frame_size,
+	       opt->nframes, rtt[opt->count / 2] / 1e3,
+	       rtt[opt->count * 99 / 100] / 1e3,
+	       rtt[opt->count * 999 / 1000] / 1e3,
+	       rtt[opt->count - 1] / 1e3,
+	       wp.errors + we.errors ? "  ERRORS" : "");
+
+	loopback_free(&lb);
+	free(rtt);
+	return wp.errors + we.errors ? 1 : 0;
+}
+
+/*
+ * Fuzzing runs both peers on one thread and picks every step at random,
+ * so any failure replays exactly from its seed. Notifications are only
+ * latched; delivering one is a separate random step, which lets the
+ * reset/ack handshake interleave with traffic in any order.
+ */
+/* traffic sent by one peer; sequence numbers start at 1 */
+struct fuzz_dir {
+	uint64_t sent;
+	uint64_t last_rx;
+};
+
+static unsigned fuzz_rand(unsigned *state)
+{
+	*state = *state * 1103515245U + 12345U;
+	return *state >> 8;
+}
+
+static int fuzz_fail(unsigned seed, uint64_t step, const char *what)
+{
+	fprintf(stderr, "fuzz: seed %u step %" PRIu64 ": %s\n",
+		seed, step, what);
+	return 1;
+}
+
+static bool fuzz_ret_ok(int ret, int ok)
+{
+	return ret == ok || ret == -ECONNRESET || ret == -ENOMEM ||
+		ret == -E2BIG;
+}
+
+/* frames must arrive in order, and only after they have been sent */
+static int fuzz_rx(struct fuzz_dir *rx, const uint8_t *frame, bool corrupt)
+{
+	uint64_t seq;
+
+	memcpy(&seq, frame, sizeof(seq));
+	if (!corrupt && seq > rx->sent)
+		return -3;
+	if (!corrupt && seq <= rx->last_rx)
+		return -2;
+	rx->last_rx = seq;
+	return 0;
+}
+
+static int fuzz_step(struct loopback *lb, struct fuzz_dir dir[2],
+		unsigned *rnd, bool corrupt, uint8_t *buf)
+{
+	unsigned side = fuzz_rand(rnd) & 1;
+	struct peer *p = side ? &lb->b : &lb->a;
+	struct fuzz_dir *tx = &dir[side], *rx = &dir[!side];
+	unsigned size = lb->frame_size;
+	unsigned op = fuzz_rand(rnd) % 100;
+	unsigned len, n;
+	int ret, i;
+
+	if (op < 5) {
+		tegra_ivc_channel_reset(&p->ivc);
+	} else if (op < 35) {
+		if (p->pending) {
+			p->pending = false;
+			tegra_ivc_channel_notified(&p->ivc);
+		}
+	} else if (op < 55) {
+		/* short frames are zero padded, oversized ones rejected */
+		len = sizeof(uint64_t) + fuzz_rand(rnd) % (size + 8);
+		frame_fill(buf, size, tx->sent + 1);
+		ret = tegra_ivc_write(&p->ivc, buf, len);
+		if (!fuzz_ret_ok(ret, len))
+			return -1;
+		if (ret == (int)len)
+			tx->sent++;
+	} else if (op < 65) {
+		n = 1 + fuzz_rand(rnd) % 8;
+		for (i = 0; i < (int)n; i++)
+			frame_fill(buf + (size_t)i * size, size,
+				   tx->sent + 1 + i);
+		ret = tegra_ivc_write_bulk(&p->ivc, buf, size, n, NULL);
+		if (ret > (int)n || (ret <= 0 && !fuzz_ret_ok(ret, 0)))
+			return -1;
+		if (ret > 0)
+			tx->sent += ret;
+	} else if (op < 85) {
+		ret = tegra_ivc_read(&p->ivc, buf, size);
+		if (!fuzz_ret_ok(ret, size))
+			return -1;
+		if (ret == (int)size)
+			return fuzz_rx(rx, buf, corrupt);
+	} else if (op < 95) {
+		n = 1 + fuzz_rand(rnd) % 8;
+		ret = tegra_ivc_read_bulk(&p->ivc, buf, size, n, NULL);
+		if (ret > (int)n || (ret <= 0 && !fuzz_ret_ok(ret, 0)))
+			return -1;
+		for (i = 0; i < ret; i++) {
+			int err = fuzz_rx(rx, buf + (size_t)i * size, corrupt);
+
+			if (err)
+				return err;
+		}
+	} else if (corrupt) {
+		/* a misbehaving peer scribbles over the counters it owns */
+		uint32_t *word = (uint32_t *)p->ivc.tx_channel;
+
+		word[fuzz_rand(rnd) & 1] = fuzz_rand(rnd);
+		*(uint32_t *)((uint8_t *)p->ivc.rx_channel + IVC_ALIGN) =
+			fuzz_rand(rnd);
+	}
+	return 0;
+}
+
+/* after fuzzing, both ends must still be able to connect and talk */
+static int fuzz_recover(struct loopback *lb, uint8_t *buf)
+{
+	unsigned size = lb->frame_size;
+	int step, ra = -EAGAIN, rb = -EAGAIN;
+	uint64_t seq;
+
+	tegra_ivc_channel_reset(&lb->a.ivc);
+	tegra_ivc_channel_reset(&lb->b.ivc);
+	for (step = 0; step < 16 && (ra || rb); step++) {
+		lb->a.pending = lb->b.pending = false;
+		ra = tegra_ivc_channel_notified(&lb->a.ivc);
+		rb = tegra_ivc_channel_notified(&lb->b.ivc);
+	}
+	if (ra || rb)
+		return -1;
+
+	for (seq = 1; seq <= lb->nframes; seq++) {
+		frame_fill(buf, size, seq);
+		if (tegra_ivc_write(&lb->a.ivc, buf, size) != (int)size)
+			return -2;
+	}
+	for (seq = 1; seq <= lb->nframes; seq++) {
+		if (tegra_ivc_read(&lb->b.ivc, buf, size) != (int)size ||
+		    !frame_check(buf, size, seq))
+			return -3;
+	}
+	return 0;
+}
+
+static int cmd_fuzz(const struct options *opt)
+{
+	static const unsigned sizes[] = { 64, 128, 256 };
+	static const unsigned depths[] = { 1, 2, 3, 8, 32 };
+	uint64_t step, round = 0;
+	unsigned seed = opt->seed;
+
+	for (step = 0; step < opt->iterations; round++, seed++) {
+		unsigned size = sizes[seed % 3], depth = depths[seed % 5];
+		struct fuzz_dir dir[2] = { { 0 } };
+		struct loopback lb;
+		unsigned rnd = seed;
+		uint8_t *buf;
+		uint64_t end = step + 10000;
+		int ret;
+
+		if (loopback_init(&lb, size, depth, 0))
+			return 2;
+		buf = malloc((size_t)size * 8);
+		for (; step < end && step < opt->iterations; step++) {
+			ret = fuzz_step(&lb, dir, &rnd, opt->corrupt, buf);
+			if (ret == -1)
+				return fuzz_fail(seed, step, "invalid return");
+			if (ret == -2)
+				return fuzz_fail(seed, step, "frame reordered");
+			if (ret == -3)
+				return fuzz_fail(seed, step, "frame never sent");
+		}
+		if (fuzz_recover(&lb, buf))
+			return fuzz_fail(seed, step, "no recovery after reset");
+		free(buf);
+		loopback_free(&lb);
+	}
+	printf("fuzz: %" PRIu64 " steps in %" PRIu64 " rounds from seed %u%s: ok\n",
+	       opt->iterations, round, opt->seed,
+	       opt->corrupt ? " with counter corruption" : "");
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s bench|sweep|latency|fuzz [options]\n"
+		"  -s <bytes>	frame size, multiple of %u (default 256)\n"
+		"  -n <frames>	frames per queue (default 64)\n"
+		"  -c <count>	frames to transfer (default 1000000)\n"
+		"  -b <frames>	bulk batch size, 1 uses the single frame API\n"
+		"  -w <us>	doorbell coalescing window for bulk runs\n"
+		"  -g <MB/s>	bench: exit 1 when throughput is below this\n"
+		"  -i <steps>	fuzz: number of random steps (default 1000000)\n"
+		"  -r <seed>	fuzz: first seed (default 1)\n"
+		"  -x		fuzz: let peers corrupt their shared counters\n",
+		prog, IVC_ALIGN);
+}
+
+int main(int argc, char **argv)
+{
+	struct options opt = {
+		.frame_size = 256,
+		.nframes = 64,
+		.count = 1000000,
+		.batch = 1,
+		.iterations = 1000000,
+		.seed = 1,
+	};
+	const char *cmd;
+	int c;
+
+	if (argc < 2) {
+		usage(argv[0]);
+		return 2;
+	}
+	cmd = argv[1];
+	optind = 2;
+
+	while ((c = getopt(argc, argv, "s:n:c:b:w:g:i:r:x")) != -1) {
+		switch (c) {
+		case 's':
+			opt.frame_size = strtoul(optarg, NULL, 0);
+			break;
+		case 'n':
+			opt.nframes = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			opt.count = strtoull(optarg, NULL, 0);
+			break;
+		case 'b':
+			opt.batch = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			opt.window_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			opt.gate_mbps = strtod(optarg, NULL);
+			break;
+		case 'i':
+			opt.iterations = strtoull(optarg, NULL, 0);
+			break;
+		case 'r':
+			opt.seed = strtoul(optarg, NULL, 0);
+			break;
+		case 'x':
+			opt.corrupt = true;
+			break;
+		default:
+			usage(argv[0]);
+			return 2;
+		}
+	}
+	if (!opt.batch || opt.batch > MAX_BATCH || !opt.count ||
+	    !opt.nframes) {
+		usage(argv[0]);
+		return 2;
+	}
+
+	if (!strcmp(cmd, "bench"))
+		return cmd_bench(&opt);
+	if (!strcmp(cmd, "sweep"))
+		return cmd_sweep(&opt);
+	if (!strcmp(cmd, "latency"))
+		return cmd_latency(&opt);
+	if (!strcmp(cmd, "fuzz"))
+		return cmd_fuzz(&opt);
+
+	usage(argv[0]);
+	return 2;
+}
@@ -0,0 +1,240 @@
+/*
+ * ivc_shim.h - minimal kernel environment for building tegra-ivc.c in
+ * userspace.
+ *
+ * Copyright (c) 2026, NVIDIA CORPORATION. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published by
+ * the Free Software Foundation.
+ *
+ * Only what drivers/platform/tegra/tegra-ivc.c uses is provided. Both peers
+ * share cache coherent memory, so every DMA sync is a no-op and peer_device
+ * is always NULL.
+ */
+
+#ifndef _IVC_SHIM_H
+#define _IVC_SHIM_H
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CONFIG_SMP 1
+
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int64_t s64;
+typedef uint64_t dma_addr_t;
+
+#define __user
+
+#define EXPORT_SYMBOL(sym)
+#define MODULE_LICENSE(lic)
+
+#define pr_err(fmt, ...)	fprintf(stderr, fmt, ##__VA_ARGS__)
+
+#define BUG()			abort()
+#define BUG_ON(cond)		do { if (cond) abort(); } while (0)
+
+#define READ_ONCE(x)		__atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define WRITE_ONCE(x, v)	__atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+
+#define smp_rmb()		__atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define smp_wmb()		__atomic_thread_fence(__ATOMIC_RELEASE)
+#define smp_mb()		__atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define rmb()			smp_rmb()
+#define wmb()			smp_wmb()
+#define mb()			smp_mb()
+
+#define min(a, b)		((a) < (b) ? (a) : (b))
+#define min_t(type, a, b)	((type)(a) < (type)(b) ? (type)(a) : (type)(b))
+
+#define container_of(ptr, type, member) \
+	((type *)((char *)(ptr) - offsetof(type, member)))
+
+#define MAX_ERRNO		4095
+#define IS_ERR_VALUE(x)		((unsigned long)(x) >= (unsigned long)-MAX_ERRNO)
+
+static inline void *ERR_PTR(long error)
+{
+	return (void *)error;
+}
+
+static inline long PTR_ERR(const void *ptr)
+{
+	return (long)ptr;
+}
+
+static inline bool IS_ERR(const void *ptr)
+{
+	return IS_ERR_VALUE((unsigned long)ptr);
+}
+
+static inline unsigned long copy_to_user(void *to, const void *from,
+		unsigned long n)
+{
+	memcpy(to, from, n);
+	return 0;
+}
+
+static inline unsigned long copy_from_user(void *to, const void *from,
+		unsigned long n)
+{
+	memcpy(to, from, n);
+	return 0;
+}
+
+/* DMA: the peers share coherent memory and never pass a peer_device */
+struct device;
+
+enum dma_data_direction {
+	DMA_BIDIRECTIONAL,
+	DMA_TO_DEVICE,
+	DMA_FROM_DEVICE,
+};
+
+static inline void dma_sync_single_for_cpu(struct device *dev,
+		dma_addr_t addr, size_t size, enum dma_data_direction dir)
+{
+}
+
+static inline void dma_sync_single_for_device(struct device *dev,
+		dma_addr_t addr, size_t size, enum dma_data_direction dir)
+{
+}
+
+static inline dma_addr_t dma_map_single(struct device *dev, void *ptr,
+		size_t size, enum dma_data_direction dir)
+{
+	return (dma_addr_t)(uintptr_t)ptr;
+}
+
+static inline void dma_unmap_single(struct device *dev, dma_addr_t addr,
+		size_t size, enum dma_data_direction dir)
+{
+}
+
+static inline int dma_mapping_error(struct device *dev, dma_addr_t addr)
+{
+	return 0;
+}
+
+/* atomics */
+typedef struct { int counter; } atomic_t;
+typedef struct { s64 counter; } atomic64_t;
+
+#define atomic_set(v, i)	__atomic_store_n(&(v)->counter, (i), __ATOMIC_SEQ_CST)
+#define atomic_read(v)		__atomic_load_n(&(v)->counter, __ATOMIC_SEQ_CST)
+#define atomic_xchg(v, i)	__atomic_exchange_n(&(v)->counter, (i), __ATOMIC_SEQ_CST)
+#define atomic64_set(v, i)	__atomic_store_n(&(v)->counter, (i), __ATOMIC_SEQ_CST)
+#define atomic64_read(v)	__atomic_load_n(&(v)->counter, __ATOMIC_SEQ_CST)
+#define atomic64_add(i, v)	__atomic_fetch_add(&(v)->counter, (i), __ATOMIC_SEQ_CST)
+#define atomic64_inc(v)		atomic64_add(1, v)
+
+/* time */
+#define NSEC_PER_USEC		1000ULL
+#define NSEC_PER_SEC		1000000000ULL
+
+typedef s64 ktime_t;
+
+static inline ktime_t ns_to_ktime(u64 ns)
+{
+	return (ktime_t)ns;
+}
+
+static inline s64 ktime_to_ns(ktime_t kt)
+{
+	return kt;
+}
+
+static inline u64 shim_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/*
+ * One-shot relative hrtimer. Each start spawns a detached thread that
+ * sleeps for the timeout and then runs the callback; good enough for the
+ * doorbell deferral window, which is the only user.
+ */
+enum hrtimer_restart {
+	HRTIMER_NORESTART,
+	HRTIMER_RESTART,
+};
+
+enum hrtimer_mode {
+	HRTIMER_MODE_REL,
+};
+
+struct hrtimer {
+	enum hrtimer_restart (*function)(struct hrtimer *);
+	ktime_t timeout;
+	int queued;
+	/* callbacks started and not yet returned */
+	int running;
+};
+
+static inline void hrtimer_init(struct hrtimer *timer, clockid_t clock,
+		enum hrtimer_mode mode)
+{
+	memset(timer, 0, sizeof(*timer));
+}
+
+static inline void *shim_hrtimer_thread(void *data)
+{
+	struct hrtimer *timer = data;
+	struct timespec ts = {
+		.tv_sec = timer->timeout / NSEC_PER_SEC,
+		.tv_nsec = timer->timeout % NSEC_PER_SEC,
+	};
+
+	nanosleep(&ts, NULL);
+	__atomic_store_n(&timer->queued, 0, __ATOMIC_SEQ_CST);
+	timer->function(timer);
+	__atomic_fetch_sub(&timer->running, 1, __ATOMIC_SEQ_CST);
+	return NULL;
+}
+
+static inline bool hrtimer_is_queued(struct hrtimer *timer)
+{
+	return __atomic_load_n(&timer->queued, __ATOMIC_SEQ_CST);
+}
+
+static inline void hrtimer_start(struct hrtimer *timer, ktime_t timeout,
+		enum hrtimer_mode mode)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+
+	timer->timeout = timeout;
+	__atomic_store_n(&timer->queued, 1, __ATOMIC_SEQ_CST);
+	__atomic_fetch_add(&timer->running, 1, __ATOMIC_SEQ_CST);
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	if (pthread_create(&thread, &attr, shim_hrtimer_thread, timer))
+		abort();
+	pthread_attr_destroy(&attr);
+}
+
+/* waits for the callback instead of dequeuing it, which is equivalent here */
+static inline int hrtimer_cancel(struct hrtimer *timer)
+{
+	while (__atomic_load_n(&timer->running, __ATOMIC_SEQ_CST))
+		sched_yield();
+	return 0;
+}
+
+#endif /* _IVC_SHIM_H */
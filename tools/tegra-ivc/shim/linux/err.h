@@ -0,0 +1,10 @@
+/*
+ * Userspace stand-in for the kernel header of the same name, see ivc_shim.h.
+ */
+
+#ifndef _SHIM_LINUX_ERR_H
+#define _SHIM_LINUX_ERR_H
+
+#include "../ivc_shim.h"
+
+#endif
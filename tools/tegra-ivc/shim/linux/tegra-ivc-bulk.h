@@ -0,0 +1,4 @@
+/*
+ * The bulk API header is used as is; the shim supplies what it includes.
+ */
+#include "../../../../include/linux/tegra-ivc-bulk.h"
@@ -0,0 +1,27 @@
+/*
+ * Userspace stand-in for the kernel header of the same name, see ivc_shim.h.
+ * The layout follows the kernel's struct ivc; only the fields used by
+ * tegra-ivc.c are present.
+ */
+
+#ifndef _SHIM_LINUX_TEGRA_IVC_INSTANCE_H
+#define _SHIM_LINUX_TEGRA_IVC_INSTANCE_H
+
+#include "../ivc_shim.h"
+
+#define IVC_ALIGN 64
+
+struct ivc_channel_header;
+
+struct ivc {
+	struct ivc_channel_header *rx_channel, *tx_channel;
+	uint32_t w_pos, r_pos;
+
+	void (*notify)(struct ivc *);
+	uint32_t nframes, frame_size;
+
+	struct device *peer_device;
+	dma_addr_t rx_handle, tx_handle;
+};
+
+#endif
@@ -0,0 +1,31 @@
+/*
+ * Userspace stand-in for the kernel header of the same name, see ivc_shim.h.
+ */
+
+#ifndef _SHIM_LINUX_TEGRA_IVC_H
+#define _SHIM_LINUX_TEGRA_IVC_H
+
+#include <linux/tegra-ivc-instance.h>
+
+int tegra_ivc_init(struct ivc *ivc, uintptr_t rx_base, uintptr_t tx_base,
+		unsigned nframes, unsigned frame_size,
+		struct device *peer_device, void (*notify)(struct ivc *));
+size_t tegra_ivc_align(size_t size);
+unsigned tegra_ivc_total_queue_size(unsigned queue_size);
+void tegra_ivc_channel_reset(struct ivc *ivc);
+int tegra_ivc_channel_notified(struct ivc *ivc);
+int tegra_ivc_can_read(struct ivc *ivc);
+int tegra_ivc_can_write(struct ivc *ivc);
+int tegra_ivc_tx_empty(struct ivc *ivc);
+uint32_t tegra_ivc_tx_frames_available(struct ivc *ivc);
+int tegra_ivc_read(struct ivc *ivc, void *buf, size_t max_read);
+int tegra_ivc_read_peek(struct ivc *ivc, void *buf, size_t off, size_t count);
+void *tegra_ivc_read_get_next_frame(struct ivc *ivc);
+int tegra_ivc_read_advance(struct ivc *ivc);
+int tegra_ivc_write(struct ivc *ivc, const void *buf, size_t size);
+int tegra_ivc_write_poke(struct ivc *ivc, const void *buf, size_t off,
+		size_t count);
+void *tegra_ivc_write_get_next_frame(struct ivc *ivc);
+int tegra_ivc_write_advance(struct ivc *ivc);
+
+#endif